@@ -1422,6 +1422,7 @@ void MainWindow::updateSettings()
 
     // Cache
     m_controlView->marbleModel()->setPersistentTileCacheLimit( m_configDialog->persistentTileCacheLimit() * 1024 );
+    m_controlView->marbleModel()->setSharedTileCacheLimit( m_configDialog->sharedTileCacheLimit() * 1024 );
     m_controlView->marbleWidget()->setVolatileTileCacheLimit( m_configDialog->volatileTileCacheLimit() * 1024 );
 
     /*
@@ -13,12 +13,20 @@
 
 // Qt
 #include <QtCore/QUrl>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
 #include <QtCore/QTimer>
 #include <QtCore/QPointF>
 #include <QtCore/QtAlgorithms>
 #include <QtCore/QVariant>
 #include <QtCore/QAbstractListModel>
 #include <QtCore/QMetaProperty>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QtConcurrentRun>
+#include <QtCore/QTime>
+#include <QtCore/QSet>
+#include <QtCore/QRectF>
+#include <QtCore/qmath.h>
 
 // Marble
 #include "MarbleDebug.h"
@@ -50,11 +58,37 @@ const qreal boxComparisonFactor = 16.0;
 // Separator to separate the id of the item from the file type
 const char fileIdSeparator = '_';
 
+// Time in seconds a downloaded description file is reused for the same request
+const int descriptionFileTimeToLive = 10 * 60;
+
+// Highest level of the grid that requested boxes are aligned to
+const int maximumGridLevel = 16;
+
+// Maximum number of items kept in memory. Items that have not been displayed for the longest
+// time are removed when it is exceeded.
+const int maximumItemCount = 1000;
+
+// Fraction of the number of items removed at once when the maximum item count is exceeded
+const qreal itemEvictionFactor = 0.1;
+
+// Extension of the view box on each side (relative to its size) used to cull items, such that
+// items just outside the view whose icons still reach into the view are kept
+const qreal viewBoxMargin = 0.2;
+
+// Edge length of the cells used for collision detection in pixels
+const int collisionCellSize = 64;
+
 class FavoritesModel;
 
 class AbstractDataPluginModelPrivate
 {
 public:
+    struct ParseResult
+    {
+        QVariantList records;
+        int parseTime;
+    };
+
     AbstractDataPluginModelPrivate( const QString& name,
                                     const MarbleModel *marbleModel,
                                     AbstractDataPluginModel * parent );
@@ -62,7 +96,37 @@ public:
     ~AbstractDataPluginModelPrivate();
 
     void updateFavoriteItems();
-    
+
+    /**
+     * Removes the least recently displayed items if there are more than maximumItemCount.
+     * Displayed, favorite, sticky and downloading items are kept, as well as the items
+     * just @p added, which have not had the chance to be displayed yet.
+     */
+    void evictItems( const QSet<AbstractDataPluginItem*> &added );
+
+    /**
+     * Whether the description file @p fileName has been downloaded recently enough to be reused.
+     */
+    bool isDescriptionFileValid( const QString &fileName ) const;
+
+    /**
+     * Removes the description files that are too old to be reused from the cache.
+     */
+    void removeExpiredDescriptionFiles();
+
+    /**
+     * Returns the box aligned to the smallest grid whose cells are at least as large as
+     * @p box, such that slightly different boxes result in the same request.
+     */
+    static GeoDataLatLonAltBox alignedBox( const GeoDataLatLonAltBox &box );
+
+    /**
+     * Runs the record @p parser on @p file. This is executed in a worker thread.
+     */
+    static ParseResult parseRecords( AbstractDataPluginModel::RecordParser parser, const QByteArray &file );
+
+    void addParseTime( int milliseconds );
+
     AbstractDataPluginModel *m_parent;
     const QString m_name;
     const MarbleModel *const m_marbleModel;
@@ -74,8 +138,11 @@ public:
     QList<AbstractDataPluginItem*> m_itemSet;
     QHash<QString, AbstractDataPluginItem*> m_downloadingItems;
     QList<AbstractDataPluginItem*> m_displayedItems;
+    QHash<AbstractDataPluginItem*, quint64> m_lastDisplayed;
+    quint64 m_displayCount;
     QTimer m_downloadTimer;
-    quint32 m_descriptionFileNumber;
+    // Description files in the cache, removed once they expire
+    QStringList m_descriptionFiles;
     QHash<QString, QVariant> m_itemSettings;
     QStringList m_favoriteItems;
     bool m_favoriteItemsOnly;
@@ -86,6 +153,10 @@ public:
     QMetaObject m_metaObject;
     bool m_hasMetaObject;
     bool m_needsSorting;
+    AbstractDataPluginModel::RecordParser m_recordParser;
+    QList<QFutureWatcher<ParseResult>*> m_parseWatchers;
+    int m_parsedFileCount;
+    qint64 m_parseTime;
 };
 
 class FavoritesModel : public QAbstractListModel
@@ -112,15 +183,18 @@ AbstractDataPluginModelPrivate::AbstractDataPluginModelPrivate( const QString& n
       m_downloadedBox(),
       m_lastNumber( 0 ),
       m_downloadedNumber( 0 ),
+      m_displayCount( 0 ),
       m_downloadTimer( m_parent ),
-      m_descriptionFileNumber( 0 ),
       m_itemSettings(),
       m_favoriteItemsOnly( false ),
       m_storagePolicy( MarbleDirs::localPath() + "/cache/" + m_name + '/' ),
       m_downloadManager( &m_storagePolicy ),
       m_favoritesModel( 0 ),
       m_hasMetaObject( false ),
-      m_needsSorting( false )
+      m_needsSorting( false ),
+      m_recordParser( 0 ),
+      m_parsedFileCount( 0 ),
+      m_parseTime( 0 )
 {
 }
 
@@ -137,6 +211,9 @@ AbstractDataPluginModelPrivate::~AbstractDataPluginModelPrivate() {
         (*hIt)->deleteLater();
     }
 
+    // Running parser jobs only work on their own copy of the data, their results are dropped
+    qDeleteAll( m_parseWatchers );
+
     m_storagePolicy.clearCache();
 }
 
@@ -151,6 +228,204 @@ void AbstractDataPluginModelPrivate::updateFavoriteItems()
     }
 }
 
+void AbstractDataPluginModelPrivate::evictItems( const QSet<AbstractDataPluginItem*> &added )
+{
+    if ( m_itemSet.size() <= maximumItemCount ) {
+        return;
+    }
+
+    QSet<AbstractDataPluginItem*> keep = m_displayedItems.toSet() + added;
+    foreach( AbstractDataPluginItem *item, m_downloadingItems ) {
+        keep.insert( item );
+    }
+
+    QList<QPair<quint64, AbstractDataPluginItem*> > candidates;
+    foreach( AbstractDataPluginItem *item, m_itemSet ) {
+        if ( keep.contains( item ) || item->isFavorite() || item->isSticky() || !item->initialized() ) {
+            continue;
+        }
+        candidates << qMakePair( m_lastDisplayed.value( item, 0 ), item );
+    }
+
+    // Remove more than needed to not evict again on every new item
+    int const excess = m_itemSet.size() - int( maximumItemCount * ( 1.0 - itemEvictionFactor ) );
+    qSort( candidates );
+
+    QSet<AbstractDataPluginItem*> evicted;
+    for ( int i = 0; i < candidates.size() && evicted.size() < excess; ++i ) {
+        evicted.insert( candidates.at( i ).second );
+    }
+
+    if ( evicted.isEmpty() ) {
+        return;
+    }
+
+    QList<AbstractDataPluginItem*> itemSet;
+    itemSet.reserve( m_itemSet.size() - evicted.size() );
+    foreach( AbstractDataPluginItem *item, m_itemSet ) {
+        if ( evicted.contains( item ) ) {
+            m_lastDisplayed.remove( item );
+            item->deleteLater();
+        } else {
+            itemSet << item;
+        }
+    }
+    m_itemSet = itemSet;
+
+    mDebug() << "Removed" << evicted.size() << "items from" << m_name << "to stay below" << maximumItemCount;
+}
+
+bool AbstractDataPluginModelPrivate::isDescriptionFileValid( const QString &fileName ) const
+{
+    QDateTime const lastModified = m_storagePolicy.lastModified( fileName );
+    return lastModified.isValid()
+           && lastModified.secsTo( QDateTime::currentDateTime() ) < descriptionFileTimeToLive;
+}
+
+void AbstractDataPluginModelPrivate::removeExpiredDescriptionFiles()
+{
+    QStringList descriptionFiles;
+    foreach( const QString &fileName, m_descriptionFiles ) {
+        if ( isDescriptionFileValid( fileName ) ) {
+            descriptionFiles << fileName;
+        } else {
+            m_storagePolicy.removeFile( fileName );
+        }
+    }
+    m_descriptionFiles = descriptionFiles;
+}
+
+AbstractDataPluginModelPrivate::ParseResult AbstractDataPluginModelPrivate::parseRecords( AbstractDataPluginModel::RecordParser parser,
+                                                                                      const QByteArray &file )
+{
+    QTime timer;
+    timer.start();
+
+    ParseResult result;
+    result.records = parser( file );
+    result.parseTime = timer.elapsed();
+
+    return result;
+}
+
+void AbstractDataPluginModelPrivate::addParseTime( int milliseconds )
+{
+    ++m_parsedFileCount;
+    m_parseTime += milliseconds;
+    mDebug() << "Parsing a description file of" << m_name << "took" << milliseconds << "ms";
+}
+
+GeoDataLatLonAltBox AbstractDataPluginModelPrivate::alignedBox( const GeoDataLatLonAltBox &box )
+{
+    qreal const size = qMax( box.width(), box.height() );
+
+    int level = 0;
+    qreal cellSize = 2 * M_PI;
+    while ( level < maximumGridLevel && cellSize / 2 >= size ) {
+        cellSize /= 2;
+        ++level;
+    }
+
+    qreal const north = qMin<qreal>( qCeil( box.north() / cellSize ) * cellSize, M_PI / 2 );
+    qreal const south = qMax<qreal>( qFloor( box.south() / cellSize ) * cellSize, -M_PI / 2 );
+    qreal const east = qCeil( box.east() / cellSize ) * cellSize;
+    qreal const west = qFloor( box.west() / cellSize ) * cellSize;
+
+    qreal width = east - west;
+    if ( box.crossesDateLine() ) {
+        width += 2 * M_PI;
+    }
+
+    GeoDataLatLonBox result( north, south, east, west );
+    if ( level == 0 || width >= 2 * M_PI ) {
+        result = GeoDataLatLonBox( north, south, M_PI, -M_PI );
+    }
+
+    return GeoDataLatLonAltBox( result, box.minAltitude(), box.maxAltitude() );
+}
+
+/**
+ * Screen space grid of the bounding rects of the items placed so far. Collision tests only
+ * need to look at the rects in the cells touched by the tested item.
+ */
+class CollisionGrid
+{
+public:
+    bool intersects( const QList<QRectF> &rects ) const;
+
+    void insert( const QList<QRectF> &rects );
+
+private:
+    static QList<QPair<int, int> > cells( const QRectF &rect );
+
+    QHash<QPair<int, int>, QList<QRectF> > m_cells;
+};
+
+bool CollisionGrid::intersects( const QList<QRectF> &rects ) const
+{
+    foreach( const QRectF &rect, rects ) {
+        foreach( const QPair<int, int> &cell, cells( rect ) ) {
+            QHash<QPair<int, int>, QList<QRectF> >::const_iterator iter = m_cells.constFind( cell );
+            if ( iter == m_cells.constEnd() ) {
+                continue;
+            }
+            foreach( const QRectF &other, iter.value() ) {
+                if ( other.intersects( rect ) ) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void CollisionGrid::insert( const QList<QRectF> &rects )
+{
+    foreach( const QRectF &rect, rects ) {
+        foreach( const QPair<int, int> &cell, cells( rect ) ) {
+            m_cells[cell] << rect;
+        }
+    }
+}
+
+QList<QPair<int, int> > CollisionGrid::cells( const QRectF &rect )
+{
+    int const left = qFloor( rect.left() / collisionCellSize );
+    int const right = qFloor( rect.right() / collisionCellSize );
+    int const top = qFloor( rect.top() / collisionCellSize );
+    int const bottom = qFloor( rect.bottom() / collisionCellSize );
+
+    QList<QPair<int, int> > result;
+    for ( int x = left; x <= right; ++x ) {
+        for ( int y = top; y <= bottom; ++y ) {
+            result << qMakePair( x, y );
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Returns the view box extended by viewBoxMargin on each side.
+ */
+static GeoDataLatLonBox cullingBox( const GeoDataLatLonBox &viewBox )
+{
+    qreal const latMargin = viewBox.height() * viewBoxMargin;
+    qreal const lonMargin = viewBox.width() * viewBoxMargin;
+
+    qreal const north = qMin<qreal>( viewBox.north() + latMargin, M_PI / 2 );
+    qreal const south = qMax<qreal>( viewBox.south() - latMargin, -M_PI / 2 );
+
+    if ( viewBox.width() + 2 * lonMargin >= 2 * M_PI ) {
+        return GeoDataLatLonBox( north, south, M_PI, -M_PI );
+    }
+
+    return GeoDataLatLonBox( north, south,
+                             GeoDataCoordinates::normalizeLon( viewBox.east() + lonMargin ),
+                             GeoDataCoordinates::normalizeLon( viewBox.west() - lonMargin ) );
+}
+
 static bool lessThanByPointer( const AbstractDataPluginItem *item1,
                                const AbstractDataPluginItem *item2 )
 {
@@ -258,11 +533,15 @@ QList<AbstractDataPluginItem*> AbstractDataPluginModel::items( const ViewportPar
     GeoDataLatLonAltBox currentBox = viewport->viewLatLonAltBox();
     QString target = d->m_marbleModel->planetId();
     QList<AbstractDataPluginItem*> list;
+    QSet<AbstractDataPluginItem*> listed;
+    CollisionGrid collisionGrid;
     
     Q_ASSERT( !d->m_displayedItems.contains( 0 ) && "Null item in m_displayedItems. Please report a bug to marble-devel@kde.org" );
     Q_ASSERT( !d->m_itemSet.contains( 0 ) && "Null item in m_itemSet. Please report a bug to marble-devel@kde.org" );
 
     QList<AbstractDataPluginItem*> candidates = d->m_displayedItems + d->m_itemSet;
+    QSet<AbstractDataPluginItem*> const displayed = d->m_displayedItems.toSet();
+    GeoDataLatLonBox const viewBox = cullingBox( currentBox );
 
     if ( d->m_needsSorting ) {
         // Both the candidates list and the list of all items need to be sorted
@@ -271,6 +550,8 @@ QList<AbstractDataPluginItem*> AbstractDataPluginModel::items( const ViewportPar
         d->m_needsSorting =  false;
     }
 
+    ++d->m_displayCount;
+
     QList<AbstractDataPluginItem*>::const_iterator i = candidates.constBegin();
     QList<AbstractDataPluginItem*>::const_iterator end = candidates.constEnd();
 
@@ -290,6 +571,15 @@ QList<AbstractDataPluginItem*> AbstractDataPluginModel::items( const ViewportPar
         if( d->m_favoriteItemsOnly && !(*i)->isFavorite() ) {
             continue;
         }
+
+        if ( listed.contains( *i ) ) {
+            continue;
+        }
+
+        // Skip items far outside of the viewport before doing the costly projection
+        if ( !viewBox.contains( (*i)->coordinate() ) ) {
+            continue;
+        }
         
         (*i)->setProjection( viewport );
         if( (*i)->positions().isEmpty() ) {
@@ -298,21 +588,14 @@ QList<AbstractDataPluginItem*> AbstractDataPluginModel::items( const ViewportPar
         
         // If the item was added initially at a nearer position, they don't have priority,
         // because we zoomed out since then.
-        bool const alreadyDisplayed = d->m_displayedItems.contains( *i );
-        if( !list.contains( *i ) && ( !alreadyDisplayed || (*i)->addedAngularResolution() >= viewport->angularResolution() ) ) {
-            bool collides = false;
-            int const length = list.length();
-            for ( int j=0; !collides && j<length; ++j ) {
-                foreach( const QRectF &rect, list[j]->boundingRects() ) {
-                    foreach( const QRectF &itemRect, (*i)->boundingRects() ) {
-                        if ( rect.intersects( itemRect ) )
-                            collides = true;
-                    }
-                }
-            }
-
-            if ( !collides ) {
+        bool const alreadyDisplayed = displayed.contains( *i );
+        if( !alreadyDisplayed || (*i)->addedAngularResolution() >= viewport->angularResolution() ) {
+            QList<QRectF> const boundingRects = (*i)->boundingRects();
+            if ( !collisionGrid.intersects( boundingRects ) ) {
                 list.append( *i );
+                listed.insert( *i );
+                collisionGrid.insert( boundingRects );
+                d->m_lastDisplayed[*i] = d->m_displayCount;
                 (*i)->setSettings( d->m_itemSettings );
 
                 // We want to save the angular resolution of the first time the item got added.
@@ -321,7 +604,6 @@ QList<AbstractDataPluginItem*> AbstractDataPluginModel::items( const ViewportPar
                 }
             }
         }
-        // TODO: Do we have to cleanup at some point? The list of all items keeps growing
     }
 
     d->m_lastBox = currentBox;
@@ -347,6 +629,30 @@ void AbstractDataPluginModel::parseFile( const QByteArray& file )
     Q_UNUSED( file );
 }
 
+void AbstractDataPluginModel::setRecordParser( RecordParser parser )
+{
+    d->m_recordParser = parser;
+}
+
+void AbstractDataPluginModel::addRecords( const QVariantList &records )
+{
+    Q_UNUSED( records );
+}
+
+int AbstractDataPluginModel::parsedFileCount() const
+{
+    return d->m_parsedFileCount;
+}
+
+qreal AbstractDataPluginModel::averageParseTime() const
+{
+    if ( d->m_parsedFileCount == 0 ) {
+        return 0.0;
+    }
+
+    return d->m_parseTime / qreal( d->m_parsedFileCount );
+}
+
 void AbstractDataPluginModel::downloadItemData( const QUrl& url,
                                                 const QString& type,
                                                 AbstractDataPluginItem *item )
@@ -373,11 +679,20 @@ void AbstractDataPluginModel::downloadItem( const QUrl& url,
 void AbstractDataPluginModel::downloadDescriptionFile( const QUrl& url )
 {
     if( !url.isEmpty() ) {
+        // The same url always maps to the same file, such that the download queue merges
+        // requests that are in flight already and recent downloads can be reused
         QString name( descriptionPrefix );
-        name += QString::number( d->m_descriptionFileNumber );
-        
+        name += QCryptographicHash::hash( url.toEncoded(), QCryptographicHash::Md5 ).toHex();
+
+        d->removeExpiredDescriptionFiles();
+        if ( d->isDescriptionFileValid( name ) ) {
+            mDebug() << "Reusing description file" << name << "for" << url;
+            QMetaObject::invokeMethod( this, "processFinishedJob", Qt::QueuedConnection,
+                                       Q_ARG( QString, name ), Q_ARG( QString, name ) );
+            return;
+        }
+
         d->m_downloadManager.addJob( url, name, name, DownloadBrowse );
-        d->m_descriptionFileNumber++;
     }
 }
 
@@ -390,6 +705,7 @@ void AbstractDataPluginModel::addItemsToList( const QList<AbstractDataPluginItem
 {
     bool needsUpdate = false;
     bool favoriteChanged = false;
+    QSet<AbstractDataPluginItem*> added;
     foreach( AbstractDataPluginItem *item, items ) {
         if( !item ) {
             continue;
@@ -414,6 +730,9 @@ void AbstractDataPluginModel::addItemsToList( const QList<AbstractDataPluginItem
                                                                   lessThanByPointer );
         // Insert the item on the right position in the list
         d->m_itemSet.insert( i, item );
+        // New items rank as recently displayed, otherwise they would be evicted before being drawn
+        d->m_lastDisplayed.insert( item, d->m_displayCount );
+        added.insert( item );
 
         connect( item, SIGNAL(stickyChanged()), this, SLOT(scheduleItemSort()) );
         connect( item, SIGNAL(destroyed(QObject*)), this, SLOT(removeItem(QObject*)) );
@@ -430,6 +749,8 @@ void AbstractDataPluginModel::addItemsToList( const QList<AbstractDataPluginItem
         }
     }
 
+    d->evictItems( added );
+
     if ( favoriteChanged && d->m_favoritesModel ) {
         d->m_favoritesModel->reset();
     }
@@ -583,7 +904,7 @@ void AbstractDataPluginModel::handleChangedViewport()
         d->m_downloadedTarget = d->m_marbleModel->planetId();
         
         // Get items
-        getAdditionalItems( d->m_lastBox, d->m_lastNumber );
+        getAdditionalItems( AbstractDataPluginModelPrivate::alignedBox( d->m_lastBox ), d->m_lastNumber );
     }
     else {
         // Don't wait to long to start the next download as we decided not to download anything.
@@ -598,7 +919,24 @@ void AbstractDataPluginModel::processFinishedJob( const QString& relativeUrlStri
     Q_UNUSED( relativeUrlString );
     
     if( id.startsWith( descriptionPrefix ) ) {
-        parseFile( d->m_storagePolicy.data( id ) );
+        if ( !d->m_descriptionFiles.contains( id ) ) {
+            d->m_descriptionFiles << id;
+        }
+
+        const QByteArray file = d->m_storagePolicy.data( id );
+        if ( d->m_recordParser ) {
+            QFutureWatcher<AbstractDataPluginModelPrivate::ParseResult> *watcher =
+                    new QFutureWatcher<AbstractDataPluginModelPrivate::ParseResult>( this );
+            connect( watcher, SIGNAL(finished()), this, SLOT(handleParsedRecords()) );
+            watcher->setFuture( QtConcurrent::run( &AbstractDataPluginModelPrivate::parseRecords,
+                                                   d->m_recordParser, file ) );
+            d->m_parseWatchers << watcher;
+        } else {
+            QTime timer;
+            timer.start();
+            parseFile( file );
+            d->addParseTime( timer.elapsed() );
+        }
     }
     else {
         // The downloaded file contains item data.
@@ -629,9 +967,26 @@ void AbstractDataPluginModel::processFinishedJob( const QString& relativeUrlStri
     }
 }
 
+void AbstractDataPluginModel::handleParsedRecords()
+{
+    QFutureWatcher<AbstractDataPluginModelPrivate::ParseResult> *watcher =
+            static_cast<QFutureWatcher<AbstractDataPluginModelPrivate::ParseResult>*>( sender() );
+    if ( !d->m_parseWatchers.removeOne( watcher ) ) {
+        return;
+    }
+
+    const AbstractDataPluginModelPrivate::ParseResult result = watcher->result();
+    watcher->deleteLater();
+
+    d->addParseTime( result.parseTime );
+    addRecords( result.records );
+}
+
 void AbstractDataPluginModel::removeItem( QObject *item )
 {
     d->m_itemSet.removeAll( (AbstractDataPluginItem *) item );
+    d->m_displayedItems.removeAll( (AbstractDataPluginItem *) item );
+    d->m_lastDisplayed.remove( (AbstractDataPluginItem *) item );
     QHash<QString, AbstractDataPluginItem *>::iterator i;
     for( i = d->m_downloadingItems.begin(); i != d->m_downloadingItems.end(); ++i ) {
         if( (*i) == (AbstractDataPluginItem *) item ) {
@@ -649,6 +1004,7 @@ void AbstractDataPluginModel::clear()
         (*iter)->deleteLater();
     }
     d->m_itemSet.clear();
+    d->m_lastDisplayed.clear();
     emit itemsUpdated();
 }
 
@@ -15,6 +15,7 @@
 #include <QtCore/QList>
 #include <QtCore/QHash>
 #include <QtCore/QString>
+#include <QtCore/QVariant>
 
 #include "marble_export.h"
 #include "MarbleGlobal.h"
@@ -40,7 +41,8 @@ class ViewportParams;
  * downloading item data.
  *
  * The functions <b>getAdditionalItems()</b> and <b>parseFile()</b> have to be reimplemented in
- * a subclass.
+ * a subclass. Alternatively to parseFile(), a subclass can set a thread-safe parser with
+ * <b>setRecordParser()</b> and reimplement <b>addRecords()</b> to keep parsing out of the GUI thread.
  **/
 class MARBLE_EXPORT AbstractDataPluginModel : public QObject
 {
@@ -50,6 +52,11 @@ class MARBLE_EXPORT AbstractDataPluginModel : public QObject
     Q_PROPERTY( QObject* favoritesModel READ favoritesModel CONSTANT )
  
  public:
+    /**
+     * A function turning a description file into plain data records, see setRecordParser().
+     */
+    typedef QVariantList (*RecordParser)( const QByteArray &file );
+
     explicit AbstractDataPluginModel( const QString& name, const MarbleModel *marbleModel, QObject *parent = 0 );
     virtual ~AbstractDataPluginModel();
         
@@ -97,6 +104,16 @@ class MARBLE_EXPORT AbstractDataPluginModel : public QObject
      */
     bool itemExists( const QString& id ) const;
 
+    /**
+     * Returns the number of description files parsed so far.
+     */
+    int parsedFileCount() const;
+
+    /**
+     * Returns the average time in ms parsing a description file took so far.
+     */
+    qreal averageParseTime() const;
+
 public Q_SLOTS:
     /**
      * Adds the @p items to the list of initialized items. It checks if items with the same id are
@@ -135,6 +152,22 @@ public Q_SLOTS:
      * This method has to be implemented in a subclass.
      **/
     virtual void parseFile( const QByteArray& file );
+
+    /**
+     * Sets a @p parser that turns description files into plain data records in a worker thread.
+     * It is used instead of parseFile(). The records are passed to addRecords() in the thread
+     * of the model afterwards.
+     * The parser must be thread-safe: it must neither access the model nor create items.
+     * Pass 0 to parse with parseFile() again.
+     */
+    void setRecordParser( RecordParser parser );
+
+    /**
+     * Creates items from the @p records of a description file that the parser set with
+     * setRecordParser() returned, and adds them to the list.
+     * This method has to be implemented in a subclass which sets a record parser.
+     **/
+    virtual void addRecords( const QVariantList &records );
         
     /**
      * Downloads the file from @p url. @p item -> addDownloadedFile() will be called when the
@@ -203,6 +236,11 @@ public Q_SLOTS:
 
     void scheduleItemSort();
 
+    /**
+     * @brief Passes the records of a finished record parser job to addRecords().
+     */
+    void handleParsedRecords();
+
  Q_SIGNALS:
     void itemsUpdated();
     void favoriteItemsChanged( const QStringList& favoriteItems );
@@ -43,6 +43,26 @@ bool CacheStoragePolicy::updateFile( const QString &fileName, const QByteArray &
     return true;
 }
 
+QDateTime CacheStoragePolicy::lastModified( const QString &fileName ) const
+{
+    return m_cache.lastModified( fileName );
+}
+
+QByteArray CacheStoragePolicy::fileData( const QString &fileName ) const
+{
+    // Finding an entry only updates its access time
+    QByteArray data;
+    const_cast<DiscCache &>( m_cache ).find( fileName, data );
+
+    return data;
+}
+
+void CacheStoragePolicy::removeFile( const QString &fileName )
+{
+    m_cache.remove( fileName );
+    m_cache.remove( TileMetaData::metaDataFileName( fileName ) );
+}
+
 void CacheStoragePolicy::clearCache()
 {
     m_cache.clear();
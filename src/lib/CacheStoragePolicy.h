@@ -49,6 +49,21 @@ class MARBLE_EXPORT CacheStoragePolicy : public StoragePolicy
          */
         bool updateFile( const QString &fileName, const QByteArray &data );
 
+        /**
+         * Returns when @p fileName was written to the cache.
+         */
+        QDateTime lastModified( const QString &fileName ) const;
+
+        /**
+         * Returns the data of @p fileName, e.g. its meta data, or an empty array.
+         */
+        QByteArray fileData( const QString &fileName ) const;
+
+        /**
+         * Removes @p fileName from the cache, along with its meta data.
+         */
+        void removeFile( const QString &fileName );
+
         /**
          * Clears the cache.
          */
@@ -0,0 +1,338 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "DecodedTilePack.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QPair>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+#include <cstring>
+
+#include "MarbleDebug.h"
+
+namespace Marble
+{
+
+namespace
+{
+// The pack starts with this marker ("MTRW")
+const quint32 packMagic = 0x4d545257;
+const quint32 packVersion = 1;
+
+const char *const packFileName = "tiles.raw";
+
+// Size of the header and of each index entry as written by QDataStream
+const qint64 headerSize = 13;
+const qint64 entrySize = 48;
+
+// Color tables and pixels start at multiples of this, QImage needs aligned scanlines
+const quint64 dataAlignment = 16;
+
+QMutex s_packsMutex;
+// Directories without a pack map to 0, so that they are only looked at once
+QHash<QString, DecodedTilePack *> s_packs;
+
+struct Entry
+{
+    qint32 format;
+    qint32 width;
+    qint32 height;
+    qint32 bytesPerLine;
+    quint32 colorCount;
+    quint64 colorOffset;
+    quint64 pixelOffset;
+};
+
+struct TileFile
+{
+    int level;
+    int x;
+    int y;
+    QString fileName;
+};
+
+quint64 tileKey( int level, int x, int y )
+{
+    return ( quint64( level ) << 56 ) | ( quint64( x ) << 28 ) | quint64( y );
+}
+
+quint64 aligned( quint64 offset )
+{
+    return ( offset + dataAlignment - 1 ) / dataAlignment * dataAlignment;
+}
+
+// Returns the tile files in Marble's storage layout "<level>/<row>/<row>_<column>.<suffix>"
+QList<TileFile> tileFiles( const QString &directory, int maximumLevel )
+{
+    QList<TileFile> result;
+    for ( int level = 0; level <= maximumLevel; ++level ) {
+        const QDir levelDir( directory + '/' + QString::number( level ) );
+        foreach ( const QString &row, levelDir.entryList( QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name ) ) {
+            const QDir rowDir( levelDir.filePath( row ) );
+            foreach ( const QString &name, rowDir.entryList( QDir::Files, QDir::Name ) ) {
+                const QStringList parts = QFileInfo( name ).completeBaseName().split( '_' );
+                bool xOk = false;
+                bool yOk = false;
+                TileFile tile;
+                tile.level = level;
+                tile.x = parts.size() == 2 ? parts.at( 1 ).toInt( &xOk ) : -1;
+                tile.y = parts.size() == 2 ? parts.at( 0 ).toInt( &yOk ) : -1;
+                tile.fileName = rowDir.filePath( name );
+                if ( xOk && yOk ) {
+                    result.append( tile );
+                }
+            }
+        }
+    }
+
+    return result;
+}
+}
+
+class DecodedTilePack::Private
+{
+ public:
+    Private();
+
+    bool open( const QString &fileName );
+
+    QFile m_file;
+    QDateTime m_lastModified;
+    const uchar *m_memory;
+    QHash<quint64, Entry> m_entries;
+};
+
+DecodedTilePack::Private::Private()
+    : m_file(),
+      m_memory( 0 ),
+      m_entries()
+{
+}
+
+bool DecodedTilePack::Private::open( const QString &fileName )
+{
+    m_file.setFileName( fileName );
+    if ( !m_file.open( QIODevice::ReadOnly ) ) {
+        return false;
+    }
+
+    QDataStream stream( &m_file );
+    stream.setVersion( QDataStream::Qt_4_5 );
+
+    quint32 magic;
+    quint32 version;
+    quint8 byteOrder;
+    quint32 count;
+    stream >> magic >> version >> byteOrder >> count;
+    if ( stream.status() != QDataStream::Ok || magic != packMagic || version != packVersion ) {
+        mDebug() << "Ignoring invalid decoded tile pack" << fileName;
+        return false;
+    }
+
+    // The pixels are stored in the byte order of the machine which wrote them
+    if ( byteOrder != QSysInfo::ByteOrder ) {
+        mDebug() << "Ignoring decoded tile pack of another byte order" << fileName;
+        return false;
+    }
+
+    const quint64 size = m_file.size();
+    for ( quint32 i = 0; i < count; ++i ) {
+        qint32 level, x, y;
+        Entry entry;
+        stream >> level >> x >> y >> entry.format >> entry.width >> entry.height >> entry.bytesPerLine
+               >> entry.colorCount >> entry.colorOffset >> entry.pixelOffset;
+        if ( stream.status() != QDataStream::Ok
+             || entry.colorOffset + 4 * quint64( entry.colorCount ) > size
+             || entry.pixelOffset + quint64( entry.bytesPerLine ) * entry.height > size ) {
+            mDebug() << "Ignoring damaged decoded tile pack" << fileName;
+            m_entries.clear();
+            return false;
+        }
+
+        m_entries.insert( tileKey( level, x, y ), entry );
+    }
+
+    m_memory = m_file.map( 0, size );
+    if ( !m_memory ) {
+        mDebug() << "Cannot map decoded tile pack" << fileName << m_file.errorString();
+        m_entries.clear();
+        return false;
+    }
+
+    m_lastModified = QFileInfo( m_file ).lastModified();
+    mDebug() << "Opened decoded tile pack" << fileName << "with" << m_entries.size() << "tiles";
+    return true;
+}
+
+DecodedTilePack::DecodedTilePack()
+    : d( new Private )
+{
+}
+
+DecodedTilePack::~DecodedTilePack()
+{
+    delete d;
+}
+
+DecodedTilePack *DecodedTilePack::open( const QString &directory )
+{
+    const QString path = QDir::cleanPath( directory );
+
+    QMutexLocker locker( &s_packsMutex );
+    QHash<QString, DecodedTilePack *>::const_iterator const it = s_packs.constFind( path );
+    if ( it != s_packs.constEnd() ) {
+        return it.value();
+    }
+
+    DecodedTilePack *pack = 0;
+    const QString fileName = path + '/' + packFileName;
+    if ( QFile::exists( fileName ) ) {
+        pack = new DecodedTilePack;
+        if ( !pack->d->open( fileName ) ) {
+            delete pack;
+            pack = 0;
+        }
+    }
+
+    s_packs.insert( path, pack );
+    return pack;
+}
+
+QImage DecodedTilePack::image( int level, int x, int y, const QDateTime &downloaded ) const
+{
+    QHash<quint64, Entry>::const_iterator const it = d->m_entries.constFind( tileKey( level, x, y ) );
+    if ( it == d->m_entries.constEnd() || ( downloaded.isValid() && downloaded > d->m_lastModified ) ) {
+        return QImage();
+    }
+
+    const Entry &entry = it.value();
+    QImage image( d->m_memory + entry.pixelOffset, entry.width, entry.height, entry.bytesPerLine,
+                  QImage::Format( entry.format ) );
+
+    if ( entry.colorCount > 0 ) {
+        // QImage copies read-only pixels when the color table is set,
+        // which is still much cheaper than decoding them
+        QVector<QRgb> colors( entry.colorCount );
+        std::memcpy( colors.data(), d->m_memory + entry.colorOffset, 4 * entry.colorCount );
+        image.setColorTable( colors );
+    }
+
+    return image;
+}
+
+QDateTime DecodedTilePack::lastModified() const
+{
+    return d->m_lastModified;
+}
+
+int DecodedTilePack::tileCount() const
+{
+    return d->m_entries.size();
+}
+
+bool DecodedTilePack::write( const QString &directory, int maximumLevel )
+{
+    const QString path = QDir::cleanPath( directory );
+    const QList<TileFile> tiles = tileFiles( path, maximumLevel );
+    if ( tiles.isEmpty() ) {
+        mDebug() << "No tiles to decode in" << path;
+        return false;
+    }
+
+    const QString fileName = path + '/' + packFileName;
+    QFile file( fileName + ".new" );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+        mDebug() << "Cannot write decoded tile pack" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    // The index precedes the pixels, so there is room for all tiles found
+    quint64 end = headerSize + entrySize * tiles.size();
+    QList<QPair<TileFile, Entry> > written;
+    foreach ( const TileFile &tile, tiles ) {
+        QImage image( tile.fileName );
+        if ( image.isNull() ) {
+            mDebug() << "Cannot decode" << tile.fileName;
+            continue;
+        }
+        if ( image.format() != QImage::Format_Indexed8 ) {
+            // Blending and shading work on this format, so they need no conversion either
+            image = image.convertToFormat( QImage::Format_ARGB32_Premultiplied );
+        }
+
+        const QImage &constImage = image;
+        const QVector<QRgb> colors = constImage.colorTable();
+        Entry entry;
+        entry.format = constImage.format();
+        entry.width = constImage.width();
+        entry.height = constImage.height();
+        entry.bytesPerLine = constImage.bytesPerLine();
+        entry.colorCount = colors.size();
+        entry.colorOffset = aligned( end );
+        entry.pixelOffset = aligned( entry.colorOffset + 4 * colors.size() );
+
+        const qint64 colorSize = 4 * colors.size();
+        const qint64 pixelSize = qint64( entry.bytesPerLine ) * entry.height;
+        if ( !file.seek( entry.colorOffset )
+             || file.write( reinterpret_cast<const char *>( colors.constData() ), colorSize ) != colorSize
+             || !file.seek( entry.pixelOffset )
+             || file.write( reinterpret_cast<const char *>( constImage.bits() ), pixelSize ) != pixelSize ) {
+            mDebug() << "Cannot write decoded tile pack" << file.fileName() << file.errorString();
+            file.remove();
+            return false;
+        }
+
+        end = entry.pixelOffset + pixelSize;
+        written.append( qMakePair( tile, entry ) );
+    }
+
+    file.seek( 0 );
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_5 );
+    stream << packMagic << packVersion << quint8( QSysInfo::ByteOrder ) << quint32( written.size() );
+    for ( int i = 0; i < written.size(); ++i ) {
+        const TileFile &tile = written.at( i ).first;
+        const Entry &entry = written.at( i ).second;
+        stream << qint32( tile.level ) << qint32( tile.x ) << qint32( tile.y )
+               << entry.format << entry.width << entry.height << entry.bytesPerLine
+               << entry.colorCount << entry.colorOffset << entry.pixelOffset;
+    }
+
+    if ( stream.status() != QDataStream::Ok || !file.flush() ) {
+        mDebug() << "Cannot write decoded tile pack" << file.fileName() << file.errorString();
+        file.remove();
+        return false;
+    }
+    file.close();
+
+    QFile::remove( fileName );
+    if ( !file.rename( fileName ) ) {
+        mDebug() << "Cannot replace decoded tile pack" << fileName << file.errorString();
+        return false;
+    }
+
+    // Let the next open() find the new pack if there was none before
+    QMutexLocker locker( &s_packsMutex );
+    if ( s_packs.contains( path ) && !s_packs.value( path ) ) {
+        s_packs.remove( path );
+    }
+
+    mDebug() << "Wrote" << written.size() << "decoded tiles to" << fileName;
+    return true;
+}
+
+}
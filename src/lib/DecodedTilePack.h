@@ -0,0 +1,80 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_DECODEDTILEPACK_H
+#define MARBLE_DECODEDTILEPACK_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QString>
+#include <QtGui/QImage>
+
+#include "marble_export.h"
+
+namespace Marble
+{
+
+/**
+ * @short Read-only container of pre-decoded tiles of an installed map theme.
+ *
+ * The file tiles.raw in the theme directory holds the raw pixels of the
+ * tiles of the lowest levels, either premultiplied ARGB32 or Indexed8 as
+ * used by the shaded relief themes. The file is memory mapped, so loading
+ * a tile needs neither an image codec nor a copy of its pixels: the
+ * returned image refers to the mapped pixels directly.
+ *
+ * The pack is created from the tile files in Marble's storage layout by
+ * write(), see TileCreator::setDecodedTileLevel(). Tiles which change after
+ * the pack was written, e.g. by downloads, are not updated in it, so it
+ * only suits tiles that are installed with the theme. Tiles downloaded
+ * later on take precedence, see image().
+ *
+ * Packs are never closed: they stay mapped until the application exits,
+ * so the images referring to them stay valid in any case.
+ */
+class MARBLE_EXPORT DecodedTilePack
+{
+ public:
+    /**
+     * Returns the pack of the given theme @p directory, or 0 if there is none.
+     */
+    static DecodedTilePack *open( const QString &directory );
+
+    /**
+     * Returns the tile @p x, @p y of @p level, or a null image if the pack does not contain it
+     * or if the tile was @p downloaded after the pack was written, so the download is used instead.
+     * The image refers to the mapped pack, which stays mapped as long as the application runs.
+     */
+    QImage image( int level, int x, int y, const QDateTime &downloaded = QDateTime() ) const;
+
+    /**
+     * Returns when the pack was written.
+     */
+    QDateTime lastModified() const;
+
+    int tileCount() const;
+
+    /**
+     * Writes the pack of the tiles of the levels up to @p maximumLevel found
+     * below @p directory in Marble's storage layout. Returns whether the pack
+     * was written.
+     */
+    static bool write( const QString &directory, int maximumLevel );
+
+ private:
+    Q_DISABLE_COPY( DecodedTilePack )
+
+    DecodedTilePack();
+    ~DecodedTilePack();
+
+    class Private;
+    Private *const d;
+};
+
+}
+
+#endif
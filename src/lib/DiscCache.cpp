@@ -14,99 +14,121 @@
 
 // Qt
 #include <QtCore/QtGlobal>
-#include <QtCore/QFile>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
 #include <QtCore/QDirIterator>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMap>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QPair>
+#include <QtCore/QtConcurrentRun>
 
 using namespace Marble;
 
+// Marks index files which store the entries in LRU order
+static const quint32 indexMagic = 0x4d444349; // "MDCI"
+static const quint32 indexVersion = 2;
+
+// The journal is flushed every this many records and folded into
+// the index once it has grown to this many records
+static const int journalFlushInterval = 64;
+static const int maximumJournalRecords = 4096;
+
 static QString indexFileName( const QString &cacheDirectory )
 {
     return cacheDirectory + "/cache_index.idx";
 }
 
+static QString journalFileName( const QString &cacheDirectory )
+{
+    return cacheDirectory + "/cache_index.journal";
+}
+
 DiscCache::DiscCache( const QString &cacheDirectory )
     : m_CacheDirectory( cacheDirectory ),
       m_CacheLimit( 300 * 1024 * 1024 ),
-      m_CurrentCacheSize( 0 )
+      m_CurrentCacheSize( 0 ),
+      m_Journal( journalFileName( cacheDirectory ) ),
+      m_JournalRecords( 0 ),
+      m_UnflushedRecords( 0 ),
+      m_CleanupRunning( false )
 {
     Q_ASSERT( !m_CacheDirectory.isEmpty() && "Passed empty cache directory!" );
 
-    QFile file( indexFileName( m_CacheDirectory ) );
-
-    if ( file.exists() ) {
-        if ( file.open( QIODevice::ReadOnly ) ) {
-            QDataStream s( &file );
-            s.setVersion( 8 );
+    readIndex();
 
-            s >> m_CacheLimit;
-            s >> m_CurrentCacheSize;
-            s >> m_Entries;
-
-        } else {
-            qWarning( "Unable to open cache directory %s", qPrintable( m_CacheDirectory ) );
-        }
+    if ( !m_Journal.open( QIODevice::ReadWrite ) ) {
+        qWarning( "Unable to open cache journal in %s", qPrintable( m_CacheDirectory ) );
     }
+
+    // Changes recorded after the index was written last, then start with a fresh journal
+    replayJournal();
+    writeIndex();
 }
 
 DiscCache::~DiscCache()
 {
-    QFile file( indexFileName( m_CacheDirectory ) );
-
-    if ( file.open( QIODevice::WriteOnly ) ) {
-        QDataStream s( &file );
-        s.setVersion( 8 );
-
-        s << m_CacheLimit;
-        s << m_CurrentCacheSize;
-        s << m_Entries;
-    }
+    m_Cleanup.waitForFinished();
 
-    file.close();
+    QMutexLocker locker( &m_Mutex );
+    writeIndex();
 }
 
 quint64 DiscCache::cacheLimit() const
 {
+    QMutexLocker locker( &m_Mutex );
     return m_CacheLimit;
 }
 
 void DiscCache::clear()
 {
-    QDirIterator it( m_CacheDirectory );
+    QMutexLocker locker( &m_Mutex );
+
+    QDirIterator it( m_CacheDirectory, QDir::Files );
 
     // Remove all files from cache directory
     while ( it.hasNext() ) {
         it.next();
 
-        if ( it.fileName() == indexFileName( m_CacheDirectory ) ) // skip index file
+        if ( it.filePath() == indexFileName( m_CacheDirectory )
+             || it.filePath() == journalFileName( m_CacheDirectory ) ) // skip index files
             continue;
 
-        QFile::remove( it.fileName() );
+        QFile::remove( it.filePath() );
     }
 
     // Delete entries
     m_Entries.clear();
+    m_Lru.clear();
+    m_EvictedKeys.clear();
 
     // Reset current cache size
     m_CurrentCacheSize = 0;
+
+    writeIndex();
 }
 
 bool DiscCache::exists( const QString &key ) const
 {
+    QMutexLocker locker( &m_Mutex );
     return m_Entries.contains( key );
 }
 
 bool DiscCache::find( const QString &key, QByteArray &data )
 {
+    QMutexLocker locker( &m_Mutex );
+
     // Return error if we don't know this key
     if ( !m_Entries.contains( key ) )
         return false;
 
-    // If we can open the file, load all data and update access timestamp
+    // If we can open the file, load all data and update access order
     QFile file( keyToFileName( key ) );
     if ( file.open( QIODevice::ReadOnly ) ) {
         data = file.readAll();
 
-        m_Entries[ key ].first = QDateTime::currentDateTime();
+        touchEntry( key );
+        appendJournal( AccessRecord, key );
         return true;
     }
 
@@ -115,31 +137,39 @@ bool DiscCache::find( const QString &key, QByteArray &data )
 
 bool DiscCache::insert( const QString &key, const QByteArray &data )
 {
+    QMutexLocker locker( &m_Mutex );
+
     // If we can't open/create a file for this entry signal an error
     QFile file( keyToFileName( key ) );
     if ( !file.open( QIODevice::WriteOnly ) )
         return false;
 
-    // If we overwrite an existing entry, subtract the size first
-    if ( m_Entries.contains( key ) )
-        m_CurrentCacheSize -= m_Entries.value( key ).second;
-
     // Store the data on disc
     file.write( data );
 
     // Create/Overwrite with a new entry
-    m_Entries.insert( key, QPair<QDateTime, quint64>(QDateTime::currentDateTime(), data.length()) );
-
-    // Add the size of the new entry
-    m_CurrentCacheSize += data.length();
+    addEntry( key, data.length() );
+    appendJournal( InsertRecord, key, data.length() );
 
     cleanup();
 
     return true;
 }
 
+QDateTime DiscCache::lastModified( const QString &key ) const
+{
+    QMutexLocker locker( &m_Mutex );
+
+    if ( !m_Entries.contains( key ) )
+        return QDateTime();
+
+    return QFileInfo( keyToFileName( key ) ).lastModified();
+}
+
 void DiscCache::remove( const QString &key )
 {
+    QMutexLocker locker( &m_Mutex );
+
     // Do nothing if we don't know the key
     if ( !m_Entries.contains( key ) )
         return;
@@ -149,21 +179,20 @@ void DiscCache::remove( const QString &key )
     if ( !QFile::remove( keyToFileName( key ) ) )
         return;
 
-    // Subtract from current size
-    m_CurrentCacheSize -= m_Entries.value( key ).second;
-
-    // Finally remove entry
-    m_Entries.remove( key );
+    removeEntry( key );
+    appendJournal( RemoveRecord, key );
 }
 
 void DiscCache::setCacheLimit( quint64 n )
 {
+    QMutexLocker locker( &m_Mutex );
+
     m_CacheLimit = n;
 
     cleanup();
 }
 
-QString DiscCache::keyToFileName( const QString &key )
+QString DiscCache::keyToFileName( const QString &key ) const
 {
     QString fileName( key );
     fileName.replace( '/', '_' );
@@ -171,29 +200,213 @@ QString DiscCache::keyToFileName( const QString &key )
     return m_CacheDirectory + '/' + fileName;
 }
 
-void DiscCache::cleanup()
+void DiscCache::readIndex()
 {
-    // Calculate 5% of our current cache limit
-    quint64 fivePercent = quint64( m_CacheLimit * 0.05 );
+    QFile file( indexFileName( m_CacheDirectory ) );
+
+    if ( !file.exists() )
+        return;
 
-    while ( m_CurrentCacheSize > (m_CacheLimit - fivePercent) ) {
-        QDateTime oldestDate( QDateTime::currentDateTime() );
-        QString oldestKey;
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        qWarning( "Unable to open cache directory %s", qPrintable( m_CacheDirectory ) );
+        return;
+    }
+
+    QDataStream s( &file );
+    s.setVersion( 8 );
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    s >> magic >> version;
+
+    if ( magic == indexMagic && version == indexVersion ) {
+        quint32 count = 0;
+        s >> m_CacheLimit >> count;
+
+        // Entries are stored from least to most recently used
+        for ( quint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i ) {
+            QString key;
+            quint64 size;
+            s >> key >> size;
+            if ( s.status() == QDataStream::Ok )
+                addEntry( key, size );
+        }
+        return;
+    }
 
-        QMapIterator<QString, QPair<QDateTime, quint64> > it( m_Entries );
-        while ( it.hasNext() ) {
-            it.next();
+    // Index of older versions, stored access times instead of the LRU order
+    file.seek( 0 );
+    QMap<QString, QPair<QDateTime, quint64> > entries;
+    quint64 currentCacheSize;
+    s >> m_CacheLimit;
+    s >> currentCacheSize;
+    s >> entries;
+
+    QList<QPair<QDateTime, QString> > accessOrder;
+    QMap<QString, QPair<QDateTime, quint64> >::const_iterator it = entries.constBegin();
+    for (; it != entries.constEnd(); ++it )
+        accessOrder.append( qMakePair( it.value().first, it.key() ) );
+    qSort( accessOrder );
+
+    for ( int i = 0; i < accessOrder.size(); ++i ) {
+        const QString &key = accessOrder.at( i ).second;
+        addEntry( key, entries.value( key ).second );
+    }
+}
+
+void DiscCache::replayJournal()
+{
+    if ( !m_Journal.isOpen() )
+        return;
 
-            if ( it.value().first < oldestDate ) {
-                oldestDate = it.value().first;
-                oldestKey = it.key();
-            }
+    QDataStream s( &m_Journal );
+    s.setVersion( 8 );
+
+    // A record cut off by a crash ends the replay
+    while ( !s.atEnd() ) {
+        quint8 record;
+        QString key;
+        s >> record >> key;
+
+        quint64 size = 0;
+        if ( record == InsertRecord )
+            s >> size;
+
+        if ( s.status() != QDataStream::Ok )
+            break;
+
+        switch ( record ) {
+        case InsertRecord:
+            addEntry( key, size );
+            break;
+        case AccessRecord:
+            if ( m_Entries.contains( key ) )
+                touchEntry( key );
+            break;
+        case RemoveRecord:
+            if ( m_Entries.contains( key ) )
+                removeEntry( key );
+            break;
         }
+    }
+}
+
+void DiscCache::writeIndex()
+{
+    QFile file( indexFileName( m_CacheDirectory ) );
+
+    if ( file.open( QIODevice::WriteOnly ) ) {
+        QDataStream s( &file );
+        s.setVersion( 8 );
 
-        if ( !oldestKey.isEmpty() ) {
-            // We found the oldest key, so using remove() to
-            // remove it from cache
-            remove( oldestKey );
+        s << indexMagic << indexVersion;
+        s << m_CacheLimit;
+        s << quint32( m_Lru.size() );
+        foreach ( const QString &key, m_Lru ) {
+            s << key << m_Entries.value( key ).size;
         }
     }
+
+    file.close();
+
+    // Everything journaled so far is part of the index now
+    if ( m_Journal.isOpen() ) {
+        m_Journal.resize( 0 );
+        m_Journal.seek( 0 );
+    }
+    m_JournalRecords = 0;
+    m_UnflushedRecords = 0;
+}
+
+void DiscCache::appendJournal( JournalRecord record, const QString &key, quint64 size )
+{
+    if ( !m_Journal.isOpen() )
+        return;
+
+    QDataStream s( &m_Journal );
+    s.setVersion( 8 );
+
+    s << quint8( record ) << key;
+    if ( record == InsertRecord )
+        s << size;
+
+    if ( ++m_JournalRecords >= maximumJournalRecords ) {
+        writeIndex();
+    } else if ( ++m_UnflushedRecords >= journalFlushInterval ) {
+        m_Journal.flush();
+        m_UnflushedRecords = 0;
+    }
+}
+
+void DiscCache::addEntry( const QString &key, quint64 size )
+{
+    // If we overwrite an existing entry, subtract the size first
+    if ( m_Entries.contains( key ) )
+        removeEntry( key );
+
+    Entry entry;
+    entry.size = size;
+    entry.position = m_Lru.insert( m_Lru.end(), key );
+    m_Entries.insert( key, entry );
+
+    // Add the size of the new entry
+    m_CurrentCacheSize += size;
+}
+
+void DiscCache::touchEntry( const QString &key )
+{
+    Entry &entry = m_Entries[ key ];
+    m_Lru.erase( entry.position );
+    entry.position = m_Lru.insert( m_Lru.end(), key );
+}
+
+void DiscCache::removeEntry( const QString &key )
+{
+    const Entry entry = m_Entries.take( key );
+    m_Lru.erase( entry.position );
+
+    // Subtract from current size
+    m_CurrentCacheSize -= entry.size;
+}
+
+void DiscCache::cleanup()
+{
+    if ( m_CurrentCacheSize <= m_CacheLimit )
+        return;
+
+    // Evict down to 95% of our current cache limit, so that
+    // cleanups only happen every few insertions
+    const quint64 fivePercent = quint64( m_CacheLimit * 0.05 );
+
+    while ( m_CurrentCacheSize > ( m_CacheLimit - fivePercent ) && !m_Lru.isEmpty() ) {
+        const QString oldestKey = m_Lru.first();
+        removeEntry( oldestKey );
+        appendJournal( RemoveRecord, oldestKey );
+        m_EvictedKeys.append( oldestKey );
+    }
+
+    // The files are removed in the background
+    if ( !m_CleanupRunning && !m_EvictedKeys.isEmpty() ) {
+        m_CleanupRunning = true;
+        m_Cleanup = QtConcurrent::run( this, &DiscCache::removeEvictedFiles );
+    }
+}
+
+void DiscCache::removeEvictedFiles()
+{
+    QMutexLocker locker( &m_Mutex );
+
+    while ( !m_EvictedKeys.isEmpty() ) {
+        const QString key = m_EvictedKeys.takeFirst();
+
+        // The key may have been inserted again in the meantime
+        if ( !m_Entries.contains( key ) )
+            QFile::remove( keyToFileName( key ) );
+
+        // Let insert() and find() through between two removals
+        locker.unlock();
+        locker.relock();
+    }
+
+    m_CleanupRunning = false;
 }
@@ -12,9 +12,13 @@
 #define MARBLE_DISCCACHE_H
 
 #include <QtCore/QDateTime>
-#include <QtCore/QMap>
-#include <QtCore/QPair>
+#include <QtCore/QFile>
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
+#include <QtCore/QLinkedList>
+#include <QtCore/QMutex>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 
 class QByteArray;
 
@@ -32,19 +36,46 @@ class DiscCache
         bool exists( const QString &key ) const;
         bool find( const QString &key, QByteArray &data );
         bool insert( const QString &key, const QByteArray &data );
+        QDateTime lastModified( const QString &key ) const;
         void remove( const QString &key );
         void setCacheLimit( quint64 n );
 
     private:
-        QString keyToFileName( const QString& );
+        enum JournalRecord { InsertRecord, AccessRecord, RemoveRecord };
+
+        struct Entry
+        {
+            quint64 size;
+            QLinkedList<QString>::iterator position;
+        };
+
+        QString keyToFileName( const QString& ) const;
+        void readIndex();
+        void replayJournal();
+        void writeIndex();
+        void appendJournal( JournalRecord record, const QString &key, quint64 size = 0 );
+        void addEntry( const QString &key, quint64 size );
+        void touchEntry( const QString &key );
+        void removeEntry( const QString &key );
         void cleanup();
+        void removeEvictedFiles();
 
         QString m_CacheDirectory;
         quint64 m_CacheLimit;
         quint64 m_CurrentCacheSize;
 
-        typedef QPair<QDateTime, quint64> Entry;
-        QMap<QString, Entry> m_Entries;
+        QHash<QString, Entry> m_Entries;
+        // Keys ordered from least to most recently used
+        QLinkedList<QString> m_Lru;
+
+        QFile m_Journal;
+        int m_JournalRecords;
+        int m_UnflushedRecords;
+
+        QStringList m_EvictedKeys;
+        bool m_CleanupRunning;
+        QFuture<void> m_Cleanup;
+        mutable QMutex m_Mutex;
 };
 
 }
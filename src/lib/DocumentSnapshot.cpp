@@ -0,0 +1,306 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "DocumentSnapshot.h"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+#include "GeoDataDocument.h"
+#include "GeoDataMultiGeometry.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataTypes.h"
+#include "MarbleDebug.h"
+#include "MarbleDirs.h"
+
+namespace Marble
+{
+
+namespace
+{
+// Snapshots start with this marker ("MDSN")
+const quint32 snapshotMagic = 0x4d44534e;
+// Increase whenever the pack hooks of the GeoData classes change
+const quint32 snapshotVersion = 3;
+
+const QDataStream::Version streamVersion = QDataStream::Qt_4_6;
+
+// Least recently written snapshots beyond this size are deleted
+const qint64 maximumSnapshotsSize = 100 * 1024 * 1024;
+
+const QDataStream::ByteOrder hostByteOrder = QSysInfo::ByteOrder == QSysInfo::BigEndian
+                                             ? QDataStream::BigEndian : QDataStream::LittleEndian;
+
+qint64 lastModified( const QFileInfo &info )
+{
+    const QDateTime modified = info.lastModified().toUTC();
+    return qint64( modified.toTime_t() ) * 1000 + modified.time().msec();
+}
+
+QByteArray contentHash( const QString &fileName )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash( QCryptographicHash::Sha1 );
+    while ( !file.atEnd() ) {
+        hash.addData( file.read( 1024 * 1024 ) );
+    }
+    return hash.result();
+}
+
+bool isSupportedGeometry( const GeoDataGeometry *geometry )
+{
+    const char *const type = geometry->nodeType();
+    if ( type == GeoDataTypes::GeoDataPointType
+         || type == GeoDataTypes::GeoDataLineStringType
+         || type == GeoDataTypes::GeoDataLinearRingType
+         || type == GeoDataTypes::GeoDataPolygonType ) {
+        return true;
+    }
+
+    if ( type == GeoDataTypes::GeoDataMultiGeometryType ) {
+        const GeoDataMultiGeometry *const multiGeometry = static_cast<const GeoDataMultiGeometry *>( geometry );
+        QVector<GeoDataGeometry *>::ConstIterator i = multiGeometry->constBegin();
+        QVector<GeoDataGeometry *>::ConstIterator const end = multiGeometry->constEnd();
+        for ( ; i != end; ++i ) {
+            if ( !isSupportedGeometry( *i ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    return false;
+}
+
+// Returns whether the snapshot has the current version and its source still exists
+bool isCurrent( const QString &snapshotFileName )
+{
+    QFile file( snapshotFileName );
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        return false;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( streamVersion );
+    quint32 magic;
+    quint32 version;
+    quint8 byteOrder;
+    QString sourcePath;
+    stream >> magic >> version >> byteOrder >> sourcePath;
+
+    return stream.status() == QDataStream::Ok && magic == snapshotMagic && version == snapshotVersion
+            && QFile::exists( sourcePath );
+}
+
+void pruneSnapshots( const QString &path )
+{
+    const QFileInfoList snapshots = QDir( path ).entryInfoList( QStringList() << "*.snapshot",
+                                                                QDir::Files, QDir::Time );
+    qint64 size = 0;
+    foreach ( const QFileInfo &snapshot, snapshots ) {
+        if ( size + snapshot.size() <= maximumSnapshotsSize && isCurrent( snapshot.filePath() ) ) {
+            size += snapshot.size();
+        } else {
+            mDebug() << "Removing snapshot" << snapshot.filePath();
+            QFile::remove( snapshot.filePath() );
+        }
+    }
+}
+
+// Features refer to the shared styles of their document by the style url only
+void resolveStyles( GeoDataFeature *feature )
+{
+    if ( !feature->styleUrl().isEmpty() ) {
+        feature->setStyleUrl( feature->styleUrl() );
+    }
+
+    if ( feature->nodeType() == GeoDataTypes::GeoDataFolderType
+         || feature->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        GeoDataContainer *const container = static_cast<GeoDataContainer *>( feature );
+        QVector<GeoDataFeature *>::Iterator i = container->begin();
+        QVector<GeoDataFeature *>::Iterator const end = container->end();
+        for ( ; i != end; ++i ) {
+            resolveStyles( *i );
+        }
+    }
+}
+}
+
+QString DocumentSnapshot::fileName( const QString &sourceFileName )
+{
+    const QByteArray path = QFileInfo( sourceFileName ).absoluteFilePath().toUtf8();
+    const QByteArray key = QCryptographicHash::hash( path, QCryptographicHash::Sha1 ).toHex();
+    return MarbleDirs::localPath() + "/cache/documents/" + QString::fromLatin1( key ) + ".snapshot";
+}
+
+bool DocumentSnapshot::isSupported( const GeoDataFeature *feature )
+{
+    if ( feature->abstractView() ) {
+        return false;
+    }
+
+    if ( feature->nodeType() == GeoDataTypes::GeoDataFolderType
+         || feature->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        const GeoDataContainer *const container = static_cast<const GeoDataContainer *>( feature );
+        const QVector<GeoDataFeature *> features = container->featureList();
+        QVector<GeoDataFeature *>::ConstIterator i = features.constBegin();
+        QVector<GeoDataFeature *>::ConstIterator const end = features.constEnd();
+        for ( ; i != end; ++i ) {
+            if ( !isSupported( *i ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if ( feature->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+        const GeoDataPlacemark *const placemark = static_cast<const GeoDataPlacemark *>( feature );
+        return !placemark->geometry() || isSupportedGeometry( placemark->geometry() );
+    }
+
+    // network links, overlays and tours
+    return false;
+}
+
+GeoDataDocument *DocumentSnapshot::load( const QString &sourceFileName )
+{
+    const QFileInfo sourceInfo( sourceFileName );
+    if ( !sourceInfo.exists() ) {
+        return 0;
+    }
+
+    QFile file( fileName( sourceFileName ) );
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        return 0;
+    }
+
+    // Map the snapshot instead of reading it, the strings and coordinate
+    // blocks are copied into the document directly from the page cache
+    QByteArray data;
+    const uchar *const mapped = file.map( 0, file.size() );
+    if ( mapped ) {
+        data = QByteArray::fromRawData( reinterpret_cast<const char *>( mapped ), file.size() );
+    } else {
+        data = file.readAll();
+    }
+    QBuffer buffer( &data );
+    buffer.open( QIODevice::ReadOnly );
+    QDataStream stream( &buffer );
+    stream.setVersion( streamVersion );
+
+    quint32 magic;
+    quint32 version;
+    quint8 byteOrder;
+    QString sourcePath;
+    qint64 sourceSize;
+    qint64 sourceModified;
+    QByteArray sourceHash;
+    stream >> magic >> version >> byteOrder >> sourcePath >> sourceSize;
+    const qint64 modifiedOffset = buffer.pos();
+    stream >> sourceModified >> sourceHash;
+
+    if ( stream.status() != QDataStream::Ok || magic != snapshotMagic || version != snapshotVersion
+         || sourcePath != sourceInfo.absoluteFilePath() || sourceSize != sourceInfo.size() ) {
+        mDebug() << "Removing outdated snapshot of" << sourceFileName;
+        file.remove();
+        return 0;
+    }
+
+    const qint64 modified = lastModified( sourceInfo );
+    if ( sourceModified != modified ) {
+        if ( contentHash( sourceFileName ) != sourceHash ) {
+            mDebug() << "Removing stale snapshot of" << sourceFileName;
+            file.remove();
+            return 0;
+        }
+    }
+
+    stream.setByteOrder( QDataStream::ByteOrder( byteOrder ) );
+    GeoDataDocument *const document = new GeoDataDocument;
+    document->unpack( stream );
+    if ( stream.status() != QDataStream::Ok ) {
+        mDebug() << "Snapshot of" << sourceFileName << "is damaged";
+        delete document;
+        return 0;
+    }
+    resolveStyles( document );
+
+    if ( sourceModified != modified ) {
+        // Only the time stamp changed, avoid hashing the source next time
+        file.close();
+        if ( file.open( QIODevice::ReadWrite ) && file.seek( modifiedOffset ) ) {
+            QDataStream header( &file );
+            header.setVersion( streamVersion );
+            header << modified;
+        }
+    }
+
+    return document;
+}
+
+bool DocumentSnapshot::save( const GeoDataDocument *document, const QString &sourceFileName )
+{
+    if ( !isSupported( document ) ) {
+        mDebug() << "Not creating a snapshot of" << sourceFileName << ", it has unsupported content";
+        return false;
+    }
+
+    const QFileInfo sourceInfo( sourceFileName );
+    const QByteArray sourceHash = contentHash( sourceFileName );
+    if ( sourceHash.isEmpty() ) {
+        return false;
+    }
+
+    const QString snapshotFileName = fileName( sourceFileName );
+    QDir().mkpath( QFileInfo( snapshotFileName ).path() );
+
+    // Write to a temporary file first, so that other processes never see partial snapshots
+    const QString partialFileName = snapshotFileName + ".part";
+    QFile file( partialFileName );
+    if ( !file.open( QIODevice::WriteOnly ) ) {
+        mDebug() << "Can't open" << partialFileName << "for writing";
+        return false;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( streamVersion );
+    stream << snapshotMagic << snapshotVersion << quint8( hostByteOrder );
+    stream << sourceInfo.absoluteFilePath() << qint64( sourceInfo.size() );
+    stream << lastModified( sourceInfo ) << sourceHash;
+
+    // Line strings write their coordinates as one block in native byte order
+    stream.setByteOrder( hostByteOrder );
+    document->pack( stream );
+    file.close();
+
+    if ( stream.status() != QDataStream::Ok || file.error() != QFile::NoError ) {
+        QFile::remove( partialFileName );
+        return false;
+    }
+
+    QFile::remove( snapshotFileName );
+    if ( !QFile::rename( partialFileName, snapshotFileName ) ) {
+        QFile::remove( partialFileName );
+        return false;
+    }
+
+    mDebug() << "Created snapshot of" << sourceFileName << "in" << snapshotFileName;
+    pruneSnapshots( QFileInfo( snapshotFileName ).path() );
+    return true;
+}
+
+}
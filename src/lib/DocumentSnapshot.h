@@ -0,0 +1,74 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_DOCUMENTSNAPSHOT_H
+#define MARBLE_DOCUMENTSNAPSHOT_H
+
+#include <QtCore/QString>
+
+#include "marble_export.h"
+
+namespace Marble
+{
+
+class GeoDataDocument;
+class GeoDataFeature;
+
+/**
+ * @short Binary snapshots of parsed documents.
+ *
+ * A snapshot holds the complete feature tree of a document parsed from a
+ * source file, written with the GeoDataObject::pack() hooks: folders,
+ * placemarks with their geometries, extended data and inline styles, and
+ * the shared styles and style maps of the document. Coordinates of line
+ * strings are stored as flat blocks of native doubles. Loading a snapshot
+ * replaces parsing the source file.
+ *
+ * Each snapshot records the size, modification time and SHA-1 hash of its
+ * source file. A snapshot whose source changed in size or content is
+ * stale and not loaded. If only the modification time differs, the hash
+ * decides, so touching or copying a file does not discard its snapshot.
+ * Stale snapshots are deleted when they are found. Whenever a snapshot is
+ * written, snapshots of removed sources and the least recently written
+ * ones beyond 100 MB in total are deleted.
+ *
+ * Documents with content the pack hooks do not cover, e.g. network links,
+ * overlays, tours, tracks or cameras, are not snapshotted.
+ */
+class MARBLE_EXPORT DocumentSnapshot
+{
+ public:
+    /**
+     * Returns the document stored in the snapshot of @p sourceFileName, or 0
+     * if there is no snapshot or it is stale. The document belongs to the caller.
+     */
+    static GeoDataDocument *load( const QString &sourceFileName );
+
+    /**
+     * Writes the snapshot of @p document, which was parsed from @p sourceFileName.
+     * Returns whether the snapshot was written.
+     */
+    static bool save( const GeoDataDocument *document, const QString &sourceFileName );
+
+    /**
+     * Returns whether a snapshot of @p feature keeps all of its content.
+     */
+    static bool isSupported( const GeoDataFeature *feature );
+
+    /**
+     * Returns the file the snapshot of @p sourceFileName is stored in.
+     */
+    static QString fileName( const QString &sourceFileName );
+
+ private:
+    DocumentSnapshot();
+};
+
+}
+
+#endif
@@ -15,6 +15,8 @@
 
 #include "DownloadQueueSet.h"
 
+#include <algorithm>
+
 #include "MarbleDebug.h"
 
 #include "HttpJob.h"
@@ -23,13 +25,15 @@ namespace Marble
 {
 
 DownloadQueueSet::DownloadQueueSet( QObject * const parent )
-    : QObject( parent )
+    : QObject( parent ),
+      m_prioritizer( 0 )
 {
 }
 
 DownloadQueueSet::DownloadQueueSet( DownloadPolicy const & policy, QObject * const parent )
     : QObject( parent ),
-      m_downloadPolicy( policy )
+      m_downloadPolicy( policy ),
+      m_prioritizer( 0 )
 {
 }
 
@@ -48,6 +52,48 @@ void DownloadQueueSet::setDownloadPolicy( DownloadPolicy const & policy )
     m_downloadPolicy = policy;
 }
 
+void DownloadQueueSet::setPrioritizer( const DownloadPrioritizer *prioritizer )
+{
+    m_prioritizer = prioritizer;
+}
+
+void DownloadQueueSet::reprioritize()
+{
+    if ( !m_prioritizer )
+        return;
+
+    QList<HttpJob*> obsoleteJobs = m_jobs.reprioritize( *m_prioritizer );
+
+    foreach ( HttpJob * const job, m_activeJobs ) {
+        if ( m_prioritizer->isObsolete( job ) ) {
+            deactivateJob( job );
+            obsoleteJobs.append( job );
+        }
+    }
+
+    QQueue<HttpJob*> retryQueue;
+    foreach ( HttpJob * const job, m_retryQueue ) {
+        if ( m_prioritizer->isObsolete( job ) ) {
+            m_retryQueueContent.remove( job->destinationFileName() );
+            obsoleteJobs.append( job );
+        } else {
+            retryQueue.enqueue( job );
+        }
+    }
+    m_retryQueue = retryQueue;
+
+    if ( obsoleteJobs.isEmpty() )
+        return;
+
+    mDebug() << "Canceling" << obsoleteJobs.size() << "obsolete jobs";
+    foreach ( HttpJob * const job, obsoleteJobs ) {
+        cancelJob( job );
+    }
+
+    emit progressChanged( m_activeJobs.size(), m_jobs.count() );
+    activateJobs();
+}
+
 bool DownloadQueueSet::canAcceptJob( const QUrl& sourceUrl,
                                      const QString& destinationFileName ) const
 {
@@ -75,7 +121,7 @@ bool DownloadQueueSet::canAcceptJob( const QUrl& sourceUrl,
 
 void DownloadQueueSet::addJob( HttpJob * const job )
 {
-    m_jobs.push( job );
+    m_jobs.push( job, m_prioritizer ? m_prioritizer->priority( job ) : 0 );
     mDebug() << "addJob: new job queue size:" << m_jobs.count();
     emit jobAdded();
     emit progressChanged( m_activeJobs.size(), m_jobs.count() );
@@ -96,6 +142,7 @@ void DownloadQueueSet::retryJobs()
 {
     while ( !m_retryQueue.isEmpty() ) {
         HttpJob * const job = m_retryQueue.dequeue();
+        m_retryQueueContent.remove( job->destinationFileName() );
         mDebug() << "Requeuing" << job->destinationFileName();
         // FIXME: addJob calls activateJobs every time
         addJob( job );
@@ -113,6 +160,7 @@ void DownloadQueueSet::purgeJobs()
     // purge all retry jobs
     qDeleteAll( m_retryQueue );
     m_retryQueue.clear();
+    m_retryQueueContent.clear();
 
     // cancel all current jobs
     while( !m_activeJobs.isEmpty() ) {
@@ -122,13 +170,20 @@ void DownloadQueueSet::purgeJobs()
     emit progressChanged( m_activeJobs.size(), m_jobs.count() );
 }
 
+QHash<QString, DownloadStatistics> DownloadQueueSet::statistics() const
+{
+    return m_statistics;
+}
+
 void DownloadQueueSet::finishJob( HttpJob * job, const QByteArray& data )
 {
     mDebug() << "finishJob: " << job->sourceUrl() << job->destinationFileName();
 
+    m_statistics[ job->sourceUrl().host() ].addDownload( data.size(), job->latency(),
+                                                         job->transferTime() );
     deactivateJob( job );
     emit jobRemoved();
-    emit jobFinished( data, job->destinationFileName(), job->initiatorId() );
+    emit jobFinished( data, job->destinationFileName(), job->initiatorId(), job->metaData() );
     job->deleteLater();
     activateJobs();
 }
@@ -144,11 +199,24 @@ void DownloadQueueSet::redirectJob( HttpJob * job, const QUrl& newSourceUrl )
     job->deleteLater();
 }
 
+void DownloadQueueSet::refreshJob( HttpJob * job )
+{
+    mDebug() << "jobNotModified:" << job->sourceUrl() << job->destinationFileName();
+
+    m_statistics[ job->sourceUrl().host() ].addNotModified( job->latency() );
+    deactivateJob( job );
+    emit jobRemoved();
+    emit jobNotModified( job->destinationFileName(), job->initiatorId(), job->metaData() );
+    job->deleteLater();
+    activateJobs();
+}
+
 void DownloadQueueSet::retryOrBlacklistJob( HttpJob * job, const int errorCode )
 {
     Q_ASSERT( errorCode != 0 );
     Q_ASSERT( !m_retryQueue.contains( job ));
 
+    m_statistics[ job->sourceUrl().host() ].addFailure();
     deactivateJob( job );
     emit jobRemoved();
 
@@ -156,6 +224,7 @@ void DownloadQueueSet::retryOrBlacklistJob( HttpJob * job, const int errorCode )
         mDebug() << QString( "Download of %1 to %2 failed, but trying again soon" )
             .arg( job->sourceUrl().toString() ).arg( job->destinationFileName() );
         m_retryQueue.enqueue( job );
+        m_retryQueueContent.insert( job->destinationFileName() );
         emit jobRetry();
     }
     else {
@@ -176,6 +245,7 @@ void DownloadQueueSet::retryOrBlacklistJob( HttpJob * job, const int errorCode )
 void DownloadQueueSet::activateJob( HttpJob * const job )
 {
     m_activeJobs.push_back( job );
+    m_activeJobsContent.insert( job->destinationFileName() );
     emit progressChanged( m_activeJobs.size(), m_jobs.count() );
 
     connect( job, SIGNAL(jobDone(HttpJob*,int)),
@@ -184,6 +254,8 @@ void DownloadQueueSet::activateJob( HttpJob * const job )
              SLOT(redirectJob(HttpJob*,QUrl)));
     connect( job, SIGNAL(dataReceived(HttpJob*,QByteArray)),
              SLOT(finishJob(HttpJob*,QByteArray)));
+    connect( job, SIGNAL(notModified(HttpJob*)),
+             SLOT(refreshJob(HttpJob*)));
 
     job->execute();
 }
@@ -203,19 +275,26 @@ void DownloadQueueSet::deactivateJob( HttpJob * const job )
     const bool removed = m_activeJobs.removeOne( job );
     Q_ASSERT( removed );
     Q_UNUSED( removed ); // for Q_ASSERT in release mode
+    m_activeJobsContent.remove( job->destinationFileName() );
     emit progressChanged( m_activeJobs.size(), m_jobs.count() );
 }
 
+/**
+   pre condition: - job is not in any queue and not connected to our slots
+   post condition: - job's download is aborted and job is going to be destroyed
+ */
+void DownloadQueueSet::cancelJob( HttpJob * const job )
+{
+    mDebug() << "cancelJob:" << job->destinationFileName();
+    job->abort();
+    emit jobCanceled( job->destinationFileName(), job->initiatorId() );
+    emit jobRemoved();
+    job->deleteLater();
+}
+
 bool DownloadQueueSet::jobIsActive( QString const & destinationFileName ) const
 {
-    QList<HttpJob*>::const_iterator pos = m_activeJobs.constBegin();
-    QList<HttpJob*>::const_iterator const end = m_activeJobs.constEnd();
-    for (; pos != end; ++pos) {
-        if ( (*pos)->destinationFileName() == destinationFileName ) {
-            return true;
-        }
-    }
-    return false;
+    return m_activeJobsContent.contains( destinationFileName );
 }
 
 inline bool DownloadQueueSet::jobIsQueued( QString const & destinationFileName ) const
@@ -225,14 +304,7 @@ inline bool DownloadQueueSet::jobIsQueued( QString const & destinationFileName )
 
 bool DownloadQueueSet::jobIsWaitingForRetry( QString const & destinationFileName ) const
 {
-    QList<HttpJob*>::const_iterator pos = m_retryQueue.constBegin();
-    QList<HttpJob*>::const_iterator const end = m_retryQueue.constEnd();
-    for (; pos != end; ++pos) {
-        if ( (*pos)->destinationFileName() == destinationFileName ) {
-            return true;
-        }
-    }
-    return false;
+    return m_retryQueueContent.contains( destinationFileName );
 }
 
 bool DownloadQueueSet::jobIsBlackListed( const QUrl& sourceUrl ) const
@@ -243,36 +315,77 @@ bool DownloadQueueSet::jobIsBlackListed( const QUrl& sourceUrl ) const
 }
 
 
-inline bool DownloadQueueSet::JobStack::contains( const QString& destinationFileName ) const
+DownloadQueueSet::JobQueue::JobQueue()
+    : m_sequence( 0 )
+{
+}
+
+inline bool DownloadQueueSet::JobQueue::contains( const QString& destinationFileName ) const
 {
     return m_jobsContent.contains( destinationFileName );
 }
 
-inline int DownloadQueueSet::JobStack::count() const
+inline int DownloadQueueSet::JobQueue::count() const
 {
     return m_jobs.count();
 }
 
-inline bool DownloadQueueSet::JobStack::isEmpty() const
+inline bool DownloadQueueSet::JobQueue::isEmpty() const
 {
     return m_jobs.isEmpty();
 }
 
-inline HttpJob * DownloadQueueSet::JobStack::pop()
+inline HttpJob * DownloadQueueSet::JobQueue::pop()
 {
-    HttpJob * const job = m_jobs.pop();
+    std::pop_heap( m_jobs.begin(), m_jobs.end(), isLessUrgent );
+    HttpJob * const job = m_jobs.last().job;
+    m_jobs.pop_back();
     bool const removed = m_jobsContent.remove( job->destinationFileName() );
     Q_UNUSED( removed ); // for Q_ASSERT in release mode
     Q_ASSERT( removed );
     return job;
 }
 
-inline void DownloadQueueSet::JobStack::push( HttpJob * const job )
+inline void DownloadQueueSet::JobQueue::push( HttpJob * const job, qreal priority )
 {
-    m_jobs.push( job );
+    Entry entry;
+    entry.job = job;
+    entry.priority = priority;
+    entry.sequence = m_sequence++;
+    m_jobs.append( entry );
+    std::push_heap( m_jobs.begin(), m_jobs.end(), isLessUrgent );
     m_jobsContent.insert( job->destinationFileName() );
 }
 
+QList<HttpJob*> DownloadQueueSet::JobQueue::reprioritize( const DownloadPrioritizer &prioritizer )
+{
+    QList<HttpJob*> obsoleteJobs;
+    QVector<Entry> jobs;
+    jobs.reserve( m_jobs.size() );
+
+    foreach ( Entry entry, m_jobs ) {
+        if ( prioritizer.isObsolete( entry.job ) ) {
+            m_jobsContent.remove( entry.job->destinationFileName() );
+            obsoleteJobs.append( entry.job );
+        } else {
+            entry.priority = prioritizer.priority( entry.job );
+            jobs.append( entry );
+        }
+    }
+
+    m_jobs = jobs;
+    std::make_heap( m_jobs.begin(), m_jobs.end(), isLessUrgent );
+
+    return obsoleteJobs;
+}
+
+bool DownloadQueueSet::JobQueue::isLessUrgent( const Entry &lhs, const Entry &rhs )
+{
+    // Among jobs of equal priority the most recently added one comes first
+    if ( lhs.priority != rhs.priority )
+        return lhs.priority > rhs.priority;
+    return lhs.sequence < rhs.sequence;
+}
 
 }
 
@@ -16,20 +16,43 @@
 #ifndef MARBLE_DOWNLOADQUEUESET_H
 #define MARBLE_DOWNLOADQUEUESET_H
 
+#include <QtCore/QHash>
 #include <QtCore/QList>
 #include <QtCore/QQueue>
 #include <QtCore/QObject>
 #include <QtCore/QSet>
-#include <QtCore/QStack>
 #include <QtCore/QUrl>
+#include <QtCore/QVector>
 
 #include "DownloadPolicy.h"
+#include "DownloadStatistics.h"
+#include "TileMetaData.h"
 
 namespace Marble
 {
 
 class HttpJob;
 
+/**
+ * Decides in which order the waiting jobs of a DownloadQueueSet are
+ * activated and which jobs are not needed anymore.
+ */
+class DownloadPrioritizer
+{
+ public:
+    virtual ~DownloadPrioritizer() {}
+
+    /**
+     * Returns the priority of @p job, jobs with lower values are activated first.
+     */
+    virtual qreal priority( const HttpJob *job ) const = 0;
+
+    /**
+     * Returns whether @p job is not needed anymore and may be canceled.
+     */
+    virtual bool isObsolete( const HttpJob *job ) const = 0;
+};
+
 /**
    Life of a HttpJob
    =================
@@ -37,7 +60,9 @@ class HttpJob;
      the HttpJob is put into the m_jobQueue where it waits for "activation"
      signal jobAdded is emitted
    - Job is activated
-     Job is moved from m_jobQueue to m_activeJobs and signals of the job
+     The most urgent job according to the DownloadPrioritizer (the most
+     recently added one among jobs of equal priority) is moved from
+     m_jobQueue to m_activeJobs and signals of the job
      are connected to slots (local or HttpDownloadManager)
      Job is executed by calling the jobs execute() method
 
@@ -57,6 +82,14 @@ class HttpJob;
       Job is removed from m_activeJobs, disconnected and destroyed
       signal jobRemoved is emitted
 
+   4) Job emits notModified (the conditional request found the stored copy up to date)
+      Job is removed from m_activeJobs, disconnected and destroyed
+      signal jobRemoved is emitted
+
+   5) Job becomes obsolete (see reprioritize())
+      Job is removed from the queue it is in, disconnected, aborted and destroyed
+      signals jobCanceled and jobRemoved are emitted
+
    so we can conclude following rules:
    - Job is only connected to signals when in "active" state
 
@@ -81,6 +114,19 @@ class DownloadQueueSet: public QObject
     DownloadPolicy downloadPolicy() const;
     void setDownloadPolicy( const DownloadPolicy& );
 
+    /**
+     * Sets the @p prioritizer ordering the waiting jobs, by default
+     * jobs are activated in reverse order of addition.
+     * The queue set doesn't take ownership of @p prioritizer.
+     */
+    void setPrioritizer( const DownloadPrioritizer *prioritizer );
+
+    /**
+     * Reorders the waiting jobs after the priorities have changed
+     * and cancels all jobs which are obsolete.
+     */
+    void reprioritize();
+
     bool canAcceptJob( const QUrl& sourceUrl,
                        const QString& destinationFileName ) const;
     void addJob( HttpJob * const job );
@@ -89,24 +135,38 @@ class DownloadQueueSet: public QObject
     void retryJobs();
     void purgeJobs();
 
+    /**
+     * Returns the statistics of all finished jobs by host name.
+     */
+    QHash<QString, DownloadStatistics> statistics() const;
+
  Q_SIGNALS:
     void jobAdded();
     void jobRemoved();
     void jobRetry();
     void jobFinished( const QByteArray& data, const QString& destinationFileName,
-                      const QString& id );
+                      const QString& id, const TileMetaData& metaData );
+    void jobNotModified( const QString& destinationFileName, const QString& id,
+                         const TileMetaData& metaData );
     void jobRedirected( const QUrl& newSourceUrl, const QString& destinationFileName,
                         const QString& id, DownloadUsage );
+    /**
+     * Is emitted when the job of @p id has been canceled by reprioritize(),
+     * so it has to be added again once the file is needed.
+     */
+    void jobCanceled( const QString& destinationFileName, const QString& id );
     void progressChanged( int active, int queued );
 
  private Q_SLOTS:
     void finishJob( HttpJob * job, const QByteArray& data );
     void redirectJob( HttpJob * job, const QUrl& newSourceUrl );
+    void refreshJob( HttpJob * job );
     void retryOrBlacklistJob( HttpJob * job, const int errorCode );
 
  private:
     void activateJob( HttpJob * const job );
     void deactivateJob( HttpJob * const job );
+    void cancelJob( HttpJob * const job );
     bool jobIsActive( const QString& destinationFileName ) const;
     bool jobIsQueued( const QString& destinationFileName ) const;
     bool jobIsWaitingForRetry( const QString& destinationFileName ) const;
@@ -117,30 +177,54 @@ class DownloadQueueSet: public QObject
     /** This is the first stage a job enters, from this queue it will get
      *  into the activatedJobs container.
      */
-    class JobStack
+    class JobQueue
     {
     public:
+        JobQueue();
         bool contains( const QString& destinationFileName ) const;
         int count() const;
         bool isEmpty() const;
         HttpJob * pop();
-        void push( HttpJob * const );
+        void push( HttpJob * const, qreal priority );
+
+        /**
+         * Updates the priorities of all jobs and takes the obsolete
+         * ones out of the queue.
+         */
+        QList<HttpJob*> reprioritize( const DownloadPrioritizer &prioritizer );
+
     private:
-        QStack<HttpJob*> m_jobs;
+        struct Entry
+        {
+            HttpJob *job;
+            qreal priority;
+            quint64 sequence;
+        };
+        static bool isLessUrgent( const Entry &lhs, const Entry &rhs );
+
+        // binary heap with the most urgent job on top
+        QVector<Entry> m_jobs;
         QSet<QString> m_jobsContent;
+        quint64 m_sequence;
     };
-    JobStack m_jobs;
+    JobQueue m_jobs;
+
+    const DownloadPrioritizer *m_prioritizer;
 
     /// Contains the jobs which are currently being downloaded.
     QList<HttpJob*> m_activeJobs;
+    QSet<QString> m_activeJobsContent;
 
     /** Contains jobs which failed to download and which are scheduled for
      *  retry according to retry settings.
      */
     QQueue<HttpJob*> m_retryQueue;
+    QSet<QString> m_retryQueueContent;
 
     /// Contains the blacklisted source urls
     QSet<QString> m_jobBlackList;
+
+    QHash<QString, DownloadStatistics> m_statistics;
 };
 
 }
@@ -0,0 +1,92 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "DownloadStatistics.h"
+
+namespace Marble
+{
+
+DownloadStatistics::DownloadStatistics()
+    : m_requests( 0 ),
+      m_notModified( 0 ),
+      m_failures( 0 ),
+      m_bytes( 0 ),
+      m_latencySum( 0 ),
+      m_transferTimeSum( 0 )
+{
+}
+
+void DownloadStatistics::addDownload( qint64 bytes, int latency, int transferTime )
+{
+    ++m_requests;
+    m_bytes += bytes;
+    m_latencySum += qMax( 0, latency );
+    m_transferTimeSum += qMax( 0, transferTime );
+}
+
+void DownloadStatistics::addNotModified( int latency )
+{
+    ++m_requests;
+    ++m_notModified;
+    m_latencySum += qMax( 0, latency );
+    m_transferTimeSum += qMax( 0, latency );
+}
+
+void DownloadStatistics::addFailure()
+{
+    ++m_failures;
+}
+
+int DownloadStatistics::requests() const
+{
+    return m_requests;
+}
+
+int DownloadStatistics::notModified() const
+{
+    return m_notModified;
+}
+
+int DownloadStatistics::failures() const
+{
+    return m_failures;
+}
+
+qint64 DownloadStatistics::bytes() const
+{
+    return m_bytes;
+}
+
+qreal DownloadStatistics::throughput() const
+{
+    if ( m_transferTimeSum == 0 )
+        return 0.0;
+
+    return 1000.0 * m_bytes / m_transferTimeSum;
+}
+
+qreal DownloadStatistics::averageLatency() const
+{
+    if ( m_requests == 0 )
+        return 0.0;
+
+    return qreal( m_latencySum ) / m_requests;
+}
+
+DownloadStatistics &DownloadStatistics::operator+=( const DownloadStatistics &other )
+{
+    m_requests += other.m_requests;
+    m_notModified += other.m_notModified;
+    m_failures += other.m_failures;
+    m_bytes += other.m_bytes;
+    m_latencySum += other.m_latencySum;
+    m_transferTimeSum += other.m_transferTimeSum;
+    return *this;
+}
+
+}
@@ -0,0 +1,74 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_DOWNLOADSTATISTICS_H
+#define MARBLE_DOWNLOADSTATISTICS_H
+
+#include <QtCore/QtGlobal>
+
+#include "marble_export.h"
+
+namespace Marble
+{
+
+/**
+ * @short Accumulated throughput and latency of the downloads from one host.
+ */
+class MARBLE_EXPORT DownloadStatistics
+{
+ public:
+    DownloadStatistics();
+
+    /**
+     * Records a completed download of @p bytes, with @p latency and
+     * @p transferTime in milliseconds as reported by HttpJob.
+     */
+    void addDownload( qint64 bytes, int latency, int transferTime );
+
+    /**
+     * Records a conditional request which was answered with "not modified".
+     */
+    void addNotModified( int latency );
+
+    void addFailure();
+
+    /**
+     * Number of downloads, including the ones answered with "not modified".
+     */
+    int requests() const;
+
+    int notModified() const;
+
+    int failures() const;
+
+    qint64 bytes() const;
+
+    /**
+     * Average throughput of a single request in bytes per second.
+     */
+    qreal throughput() const;
+
+    /**
+     * Average time in milliseconds until the response headers arrived.
+     */
+    qreal averageLatency() const;
+
+    DownloadStatistics &operator+=( const DownloadStatistics &other );
+
+ private:
+    int m_requests;
+    int m_notModified;
+    int m_failures;
+    qint64 m_bytes;
+    qint64 m_latencySum;
+    qint64 m_transferTimeSum;
+};
+
+}
+
+#endif
@@ -11,11 +11,13 @@
 #include "FileLoader.h"
 
 #include <QtCore/QBuffer>
-#include <QtCore/QDataStream>
 #include <QtCore/QDateTime>
 #include <QtCore/QFile>
+#include <QtCore/QRunnable>
 #include <QtCore/QThread>
+#include <QtCore/QThreadPool>
 
+#include "DocumentSnapshot.h"
 #include "GeoDataParser.h"
 #include "GeoDataDocument.h"
 #include "GeoDataFolder.h"
@@ -36,6 +38,32 @@
 namespace Marble
 {
 
+namespace
+{
+// Writes the snapshot of a parsed document before it is set up for display
+class SnapshotWriter : public QRunnable
+{
+public:
+    SnapshotWriter( FileLoader *loader, const GeoDataDocument *document, const QString &sourceFileName )
+        : m_loader( loader ),
+          m_document( document ),
+          m_sourceFileName( sourceFileName )
+    {
+    }
+
+    virtual void run()
+    {
+        DocumentSnapshot::save( m_document, m_sourceFileName );
+        QMetaObject::invokeMethod( m_loader, "snapshotSaved", Qt::QueuedConnection );
+    }
+
+private:
+    FileLoader *const m_loader;
+    const GeoDataDocument *const m_document;
+    const QString m_sourceFileName;
+};
+}
+
 class FileLoaderPrivate
 {
 public:
@@ -49,6 +77,8 @@ public:
           m_documentRole ( role ),
           m_styleMap( new GeoDataStyleMap ),
           m_document( 0 ),
+          m_savingSnapshot( false ),
+          m_parsingFinished( false ),
           m_clock( model->clock() )
     {
         if( m_style ) {
@@ -65,6 +95,8 @@ public:
           m_contents ( contents ),
           m_documentRole ( role ),
           m_document( 0 ),
+          m_savingSnapshot( false ),
+          m_parsingFinished( false ),
           m_clock( model->clock() )
     {
     }
@@ -73,27 +105,31 @@ public:
     {
     }
 
-    void saveFile(const QString& filename );
-    void savePlacemarks(QDataStream &out, const GeoDataContainer *container);
-
     void createFilterProperties( GeoDataContainer *container );
     int cityPopIdx( qint64 population ) const;
     int spacePopIdx( qint64 population ) const;
     int areaPopIdx( qreal area ) const;
 
     void documentParsed( GeoDataDocument *doc, const QString& error);
+    void setupDocument();
+    void snapshotSaved();
+    void parsingFinished();
 
     FileLoader *q;
     MarbleRunnerManager m_runner;
     QString m_filepath;
     QString m_contents;
-    QString m_nonExistentLocalCacheFile;
+    QString m_snapshotSource;
     QString m_property;
     GeoDataStyle* m_style;
     DocumentRole m_documentRole;
     GeoDataStyleMap* m_styleMap;
     GeoDataDocument *m_document;
     QString m_error;
+    // runs the snapshot writer, waits for it when the loader is deleted
+    QThreadPool m_snapshotPool;
+    bool m_savingSnapshot;
+    bool m_parsingFinished;
 
     const MarbleClock *m_clock;
 };
@@ -103,6 +139,7 @@ FileLoader::FileLoader( QObject* parent, MarbleModel *model,
     : QThread( parent ),
       d( new FileLoaderPrivate( this, model, file, property, style, role ) )
 {
+    connect( &d->m_runner, SIGNAL(parsingFinished()), this, SLOT(parsingFinished()) );
 }
 
 FileLoader::FileLoader( QObject* parent, MarbleModel *model,
@@ -132,6 +169,11 @@ QString FileLoader::error() const
     return d->m_error;
 }
 
+DocumentRole FileLoader::documentRole() const
+{
+    return d->m_documentRole;
+}
+
 void FileLoader::run()
 {
     if ( d->m_contents.isEmpty() ) {
@@ -162,9 +204,6 @@ void FileLoader::run()
             cacheFile = MarbleDirs::path( "placemarks/" + path + name + ".cache" );
             if ( cacheFile.isEmpty()) {
                 cacheFile = MarbleDirs::localPath() + "/placemarks/" + path + name + ".cache";
-                if ( !QFileInfo( cacheFile ).exists() ) {
-                    d->m_nonExistentLocalCacheFile = cacheFile;
-                }
             }
         }
 
@@ -184,20 +223,42 @@ void FileLoader::run()
                 connect( &d->m_runner, SIGNAL(parsingFinished(GeoDataDocument*,QString)),
                          this, SLOT(documentParsed(GeoDataDocument*,QString)) );
                 d->m_runner.parseFile( cacheFile, d->m_documentRole );
+                return;
             }
         }
         // we load source file, multiple cases
         else if ( QFile::exists( defaultSourceName ) ) {
             mDebug() << "No recent Default Placemark Cache File available!";
 
+            // the resources of kmz files live in a temporary directory only while parsing
+            const bool useSnapshot = suffix.compare( "kmz", Qt::CaseInsensitive ) != 0;
+            GeoDataDocument *const snapshot = useSnapshot ? DocumentSnapshot::load( defaultSourceName ) : 0;
+            if ( snapshot ) {
+                mDebug() << "Loaded snapshot of" << defaultSourceName;
+                snapshot->setDocumentRole( d->m_documentRole );
+                snapshot->setFileName( defaultSourceName );
+                snapshot->setBaseUri( defaultSourceName );
+                d->documentParsed( snapshot, QString() );
+                emit loaderFinished( this );
+                return;
+            }
+
+            if ( useSnapshot ) {
+                d->m_snapshotSource = defaultSourceName;
+            }
+
             // use runners: pnt, gpx, osm
             connect( &d->m_runner, SIGNAL(parsingFinished(GeoDataDocument*,QString)),
                     this, SLOT(documentParsed(GeoDataDocument*,QString)) );
             d->m_runner.parseFile( defaultSourceName, d->m_documentRole );
+            return;
         }
         else {
             mDebug() << "No Default Placemark Source File for " << name;
         }
+
+        // nothing is parsed, the loader is done
+        emit loaderFinished( this );
     // content is not empty, we load from data
     } else {
         // Read the KML Data
@@ -230,85 +291,55 @@ void FileLoader::run()
 
 }
 
-const quint32 MarbleMagicNumber = 0x31415926;
-
-void FileLoaderPrivate::saveFile( const QString& filename )
+void FileLoaderPrivate::documentParsed( GeoDataDocument* doc, const QString& error )
 {
-
-    if ( !QDir( MarbleDirs::localPath() + "/placemarks/" ).exists() )
-        ( QDir::root() ).mkpath( MarbleDirs::localPath() + "/placemarks/" );
-   
-    mDebug() << "Creating cache at " << filename ;
-
-    QFile file( filename );
-    if ( !file.open( QIODevice::WriteOnly ) ) {
-        mDebug() << Q_FUNC_INFO << "Can't open" << filename << "for writing";
-        return;
+    m_error = error;
+    if ( doc && m_document ) {
+        // only the result of the first runner that could parse the file is used
+        delete doc;
     }
-    QDataStream out( &file );
-
-    // Write a header with a "magic number" and a version
-    // out << (quint32)0xA0B0C0D0;
-    out << (quint32)MarbleMagicNumber;
-    out << (qint32)015;
+    else if ( doc ) {
+        m_document = doc;
 
-    out.setVersion( QDataStream::Qt_4_2 );
+        // snapshot the document as parsed, hashing and writing it is kept off the GUI thread
+        if ( !m_snapshotSource.isEmpty() && error.isEmpty() && DocumentSnapshot::isSupported( doc ) ) {
+            m_savingSnapshot = true;
+            m_snapshotPool.start( new SnapshotWriter( q, doc, m_snapshotSource ) );
+            return;
+        }
 
-    savePlacemarks(out, m_document);
+        setupDocument();
+    }
 }
 
-void FileLoaderPrivate::savePlacemarks(QDataStream &out, const GeoDataContainer *container)
+void FileLoaderPrivate::setupDocument()
 {
-
-    qreal lon;
-    qreal lat;
-    qreal alt;
-
-    const QVector<GeoDataPlacemark*> placemarks = container->placemarkList();
-    QVector<GeoDataPlacemark*>::const_iterator it = placemarks.constBegin();
-    QVector<GeoDataPlacemark*>::const_iterator const end = placemarks.constEnd();
-    for (; it != end; ++it ) {
-        out << (*it)->name();
-        (*it)->coordinate( m_clock->dateTime() ).geoCoordinates( lon, lat, alt );
-
-        // Use double to provide a single cache file format across architectures
-        out << (double)(lon) << (double)(lat) << (double)(alt);
-        out << QString( (*it)->role() );
-        out << QString( (*it)->description() );
-        out << QString( (*it)->countryCode() );
-        out << QString( (*it)->state() );
-        out << (double) (*it)->area();
-        out << (qint64) (*it)->population();
-        out << ( qint16 ) ( (*it)->extendedData().value("gmt").value().toInt() );
-        out << ( qint8 ) ( (*it)->extendedData().value("dst").value().toInt() );
+    m_document->setProperty( m_property );
+    if( m_style ) {
+        m_document->addStyleMap( *m_styleMap );
+        m_document->addStyle( *m_style );
     }
 
-    const QVector<GeoDataFolder*> folders = container->folderList();
-    QVector<GeoDataFolder*>::const_iterator cont = folders.constBegin();
-    QVector<GeoDataFolder*>::const_iterator endcont = folders.constEnd();
-    for (; cont != endcont; ++cont ) {
-            savePlacemarks(out, *cont);
-    }
+    createFilterProperties( m_document );
+    emit q->newGeoDataDocumentAdded( m_document );
 }
 
-void FileLoaderPrivate::documentParsed( GeoDataDocument* doc, const QString& error )
+void FileLoaderPrivate::snapshotSaved()
 {
-    m_error = error;
-    if ( doc ) {
-        m_document = doc;
-        doc->setProperty( m_property );
-        if( m_style ) {
-            doc->addStyleMap( *m_styleMap );
-            doc->addStyle( *m_style );
-        }
+    m_savingSnapshot = false;
+    setupDocument();
+    if ( m_parsingFinished ) {
+        emit q->loaderFinished( q );
+    }
+}
 
-        createFilterProperties( doc );
-        emit q->newGeoDataDocumentAdded( m_document );
-        if ( !m_nonExistentLocalCacheFile.isEmpty() ) {
-            saveFile( m_nonExistentLocalCacheFile );
-        }
+void FileLoaderPrivate::parsingFinished()
+{
+    // all runners are done, whether or not one of them delivered a document
+    m_parsingFinished = true;
+    if ( !m_savingSnapshot ) {
+        emit q->loaderFinished( q );
     }
-    emit q->loaderFinished( q );
 }
 
 void FileLoaderPrivate::createFilterProperties( GeoDataContainer *container )
@@ -36,6 +36,7 @@ class FileLoader : public QThread
         QString path() const;
         GeoDataDocument *document();
         QString error() const;
+        DocumentRole documentRole() const;
 
     Q_SIGNALS:
         void loaderFinished( FileLoader* );
@@ -43,6 +44,8 @@ class FileLoader : public QThread
 
 private:
         Q_PRIVATE_SLOT ( d, void documentParsed( GeoDataDocument *, QString) )
+        Q_PRIVATE_SLOT ( d, void snapshotSaved() )
+        Q_PRIVATE_SLOT ( d, void parsingFinished() )
 
         friend class FileLoaderPrivate;
 
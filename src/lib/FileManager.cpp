@@ -13,6 +13,7 @@
 
 #include <QtCore/QDir>
 #include <QtCore/QFileInfo>
+#include <QtCore/QThread>
 #include <QtCore/QTime>
 #include <QtGui/QMessageBox>
 
@@ -36,13 +37,15 @@ public:
     FileManagerPrivate( MarbleModel* model, FileManager* parent )
         : m_model( model ),
           q( parent ),
+          m_maxRunningLoaders( qMax( 2, QThread::idealThreadCount() ) ),
           m_recenter( false )
     {
     }
 
     ~FileManagerPrivate()
     {
-        foreach ( FileLoader *loader, m_loaderList ) {
+        qDeleteAll( m_pendingLoaders );
+        foreach ( FileLoader *loader, m_loaderList + m_cancelledLoaders ) {
             if ( loader ) {
                 loader->wait();
             }
@@ -50,14 +53,24 @@ public:
     }
 
     void appendLoader( FileLoader *loader );
+    void startLoaders();
+    bool isLoading( const QString &path ) const;
     void closeFile( const QString &key );
     void cleanupLoader( FileLoader *loader );
 
+    static int priority( DocumentRole role );
+
     MarbleModel* const m_model;
 
     FileManager * const q;
+    // loaders waiting for a free slot, ordered by priority
+    QList<FileLoader*> m_pendingLoaders;
     QList<FileLoader*> m_loaderList;
+    // loaders of removed files, their documents are dropped when done
+    QList<FileLoader*> m_cancelledLoaders;
+    const int m_maxRunningLoaders;
     QHash < QString, GeoDataDocument* > m_fileItemHash;
+    QHash < const FileLoader*, QTime > m_loadingTimes;
     bool m_recenter;
     QTime m_timer;
 };
@@ -81,9 +94,17 @@ void FileManager::addFile( const QString& filepath, const QString& property, Geo
             return;  // already loaded
     }
 
-    foreach ( const FileLoader *loader, d->m_loaderList ) {
-        if ( loader->path() == filepath )
-            return;  // currently loading
+    foreach ( FileLoader *loader, d->m_cancelledLoaders ) {
+        if ( loader->path() == filepath ) {
+            // removed while loading, but its document is wanted after all
+            d->m_cancelledLoaders.removeAll( loader );
+            d->m_loaderList.append( loader );
+            return;
+        }
+    }
+
+    if ( d->isLoading( filepath ) ) {
+        return;  // currently loading
     }
 
     mDebug() << "adding container:" << filepath;
@@ -109,21 +130,71 @@ void FileManager::addData( const QString &name, const QString &data, DocumentRol
 
 void FileManagerPrivate::appendLoader( FileLoader *loader )
 {
+    // queued, as the loader is deleted once it is cleaned up
     QObject::connect( loader, SIGNAL(loaderFinished(FileLoader*)),
-             q, SLOT(cleanupLoader(FileLoader*)) );
+             q, SLOT(cleanupLoader(FileLoader*)), Qt::QueuedConnection );
+
+    // Map documents are needed to show the map at all, so they are loaded first.
+    // Loaders of the same priority start in the order they were added.
+    const int loaderPriority = priority( loader->documentRole() );
+    int index = m_pendingLoaders.size();
+    while ( index > 0 && priority( m_pendingLoaders.at( index - 1 )->documentRole() ) > loaderPriority ) {
+        --index;
+    }
+    m_pendingLoaders.insert( index, loader );
+
+    startLoaders();
+}
 
-    m_loaderList.append( loader );
-    loader->start();
+void FileManagerPrivate::startLoaders()
+{
+    // cancelled loaders keep running until their parser is done
+    while ( m_loaderList.size() + m_cancelledLoaders.size() < m_maxRunningLoaders
+            && !m_pendingLoaders.isEmpty() ) {
+        FileLoader *loader = m_pendingLoaders.takeFirst();
+        m_loaderList.append( loader );
+        m_loadingTimes[loader].start();
+        loader->start();
+    }
+}
+
+bool FileManagerPrivate::isLoading( const QString &path ) const
+{
+    foreach ( const FileLoader *loader, m_pendingLoaders + m_loaderList + m_cancelledLoaders ) {
+        if ( loader->path() == path ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int FileManagerPrivate::priority( DocumentRole role )
+{
+    switch ( role ) {
+    case MapDocument:
+        return 0;
+    case UserDocument:
+        return 1;
+    default:
+        return 2;
+    }
 }
 
 void FileManager::removeFile( const QString& key )
 {
+    foreach ( FileLoader *loader, d->m_pendingLoaders ) {
+        if ( loader->path() == key ) {
+            d->m_pendingLoaders.removeAll( loader );
+            delete loader;
+            return;
+        }
+    }
+
     foreach ( FileLoader *loader, d->m_loaderList ) {
         if ( loader->path() == key ) {
-            disconnect( loader, 0, this, 0 );
-            loader->wait();
+            // running parsers can't be interrupted, the result is dropped in cleanupLoader
             d->m_loaderList.removeAll( loader );
-            delete loader->document();
+            d->m_cancelledLoaders.append( loader );
             return;
         }
     }
@@ -179,33 +250,46 @@ GeoDataDocument * FileManager::at( const QString &key )
 
 void FileManagerPrivate::cleanupLoader( FileLoader* loader )
 {
+    // loaderFinished may be emitted by the thread itself shortly before it ends
+    loader->wait();
+    const int loadingTime = m_loadingTimes.take( loader ).elapsed();
     GeoDataDocument *doc = loader->document();
+
+    if ( m_cancelledLoaders.removeAll( loader ) ) {
+        mDebug() << "Dropping" << loader->path() << "which was removed while loading";
+        delete doc;
+        delete loader;
+        startLoaders();
+        return;
+    }
+
     m_loaderList.removeAll( loader );
-    if ( loader->isFinished() ) {
-        if ( doc ) {
-            if ( doc->name().isEmpty() && !doc->fileName().isEmpty() )
-            {
-                QFileInfo file( doc->fileName() );
-                doc->setName( file.baseName() );
-            }
-            m_model->treeModel()->addDocument( doc );
-            m_fileItemHash.insert( loader->path(), doc );
-            emit q->fileAdded( loader->path() );
-            if( m_recenter ) {
-                emit q->centeredDocument( doc->latLonAltBox() );
-                m_recenter = false;
-            }
+    mDebug() << "Loaded" << loader->path() << "in" << loadingTime << "ms";
+    if ( doc ) {
+        if ( doc->name().isEmpty() && !doc->fileName().isEmpty() )
+        {
+            QFileInfo file( doc->fileName() );
+            doc->setName( file.baseName() );
         }
-        if ( !loader->error().isEmpty() ) {
-            QMessageBox errorBox;
-            errorBox.setWindowTitle( QObject::tr("File Parsing Error"));
-            errorBox.setText( loader->error() );
-            errorBox.setIcon( QMessageBox::Warning );
-            errorBox.exec();
-            qWarning() << "File Parsing error " << loader->error();
+        m_model->treeModel()->addDocument( doc );
+        m_fileItemHash.insert( loader->path(), doc );
+        emit q->fileAdded( loader->path() );
+        if( m_recenter ) {
+            emit q->centeredDocument( doc->latLonAltBox() );
+            m_recenter = false;
         }
-        delete loader;
     }
+    if ( !loader->error().isEmpty() ) {
+        QMessageBox errorBox;
+        errorBox.setWindowTitle( QObject::tr("File Parsing Error"));
+        errorBox.setText( loader->error() );
+        errorBox.setIcon( QMessageBox::Warning );
+        errorBox.exec();
+        qWarning() << "File Parsing error " << loader->error();
+    }
+    delete loader;
+
+    startLoaders();
     if ( m_loaderList.isEmpty()  )
     {
         mDebug() << "Finished loading all placemarks " << m_timer.elapsed();
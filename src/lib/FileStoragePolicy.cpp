@@ -78,6 +78,7 @@ bool FileStoragePolicy::updateFile( const QString &fileName, const QByteArray &d
     }
 
     emit sizeChanged( file.size() - oldSize );
+    emit fileUpdated( fullName, file.size() );
     file.close();
 
     return true;
@@ -124,6 +125,7 @@ void FileStoragePolicy::clearCache()
                       || lowerCase.endsWith( QLatin1String( ".png" ) )
                       || lowerCase.endsWith( QLatin1String( ".gif" ) )
                       || lowerCase.endsWith( QLatin1String( ".svg" ) )
+                      || lowerCase.endsWith( QLatin1String( ".meta" ) )
                     )
                     {
                         // We cannot emit clear, because we don't make a full clear
@@ -142,4 +144,39 @@ QString FileStoragePolicy::lastErrorMessage() const
     return m_errorMsg;
 }
 
+void FileStoragePolicy::accessFile( const QString &fileName )
+{
+    QFileInfo const dirInfo( fileName );
+    emit fileAccessed( dirInfo.isAbsolute() ? fileName : m_dataDirectory + '/' + fileName );
+}
+
+QDateTime FileStoragePolicy::lastModified( const QString &fileName ) const
+{
+    QFileInfo const dirInfo( fileName );
+    QFileInfo const info( dirInfo.isAbsolute() ? fileName : m_dataDirectory + '/' + fileName );
+    return info.exists() ? info.lastModified() : QDateTime();
+}
+
+QByteArray FileStoragePolicy::fileData( const QString &fileName ) const
+{
+    QFileInfo const dirInfo( fileName );
+    QFile file( dirInfo.isAbsolute() ? fileName : m_dataDirectory + '/' + fileName );
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return QByteArray();
+
+    return file.readAll();
+}
+
+void FileStoragePolicy::removeFile( const QString &fileName )
+{
+    QFileInfo const dirInfo( fileName );
+    QFile file( dirInfo.isAbsolute() ? fileName : m_dataDirectory + '/' + fileName );
+    if ( !file.exists() )
+        return;
+
+    const qint64 size = file.size();
+    if ( file.remove() )
+        emit sizeChanged( -size );
+}
+
 #include "FileStoragePolicy.moc"
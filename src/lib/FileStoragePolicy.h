@@ -53,6 +53,26 @@ class FileStoragePolicy : public StoragePolicy
          */
         QString lastErrorMessage() const;
 
+        /**
+         * Emits fileAccessed() for @p fileName.
+         */
+        void accessFile( const QString &fileName );
+
+        /**
+         * Returns the modification time of @p fileName.
+         */
+        QDateTime lastModified( const QString &fileName ) const;
+
+        /**
+         * Reads @p fileName.
+         */
+        QByteArray fileData( const QString &fileName ) const;
+
+        /**
+         * Removes @p fileName from the data directory.
+         */
+        void removeFile( const QString &fileName );
+
     private:
 	Q_DISABLE_COPY( FileStoragePolicy )
 	
@@ -12,16 +12,21 @@
 #include "FileStorageWatcher.h"
 
 // Qt
+#include <QtCore/QDataStream>
 #include <QtCore/QDateTime>
 #include <QtCore/QDir>
 #include <QtCore/QDirIterator>
 #include <QtCore/QFileInfo>
+#include <QtCore/QPair>
+#include <QtCore/QStringList>
 #include <QtCore/QTimer>
 
 // Marble
 #include "MarbleGlobal.h"
 #include "MarbleDebug.h"
 #include "MarbleDirs.h"
+#include "TileMetaData.h"
+#include "TilePack.h"
 
 using namespace Marble;
 
@@ -31,14 +36,33 @@ static const int maxFilesDelete = 20;
 // Delete only files that are older than 120 Seconds
 static const int deleteOnlyFilesOlderThan = 120;
 static const int softLimitPercent = 5;
+// Save a changed index at most every 60 seconds
+static const int indexSaveInterval = 60;
+static const quint32 indexMagic = 0x4d465349; // "MFSI"
+static const quint32 indexVersion = 1;
+
+static QString indexFileName( const QString &dataDirectory )
+{
+    return dataDirectory + "/tilecache.idx";
+}
+
+// Exists while the index on disc is known to be complete
+static QString cleanMarkerFileName( const QString &dataDirectory )
+{
+    return dataDirectory + "/tilecache.clean";
+}
 
 
 // Methods of FileStorageWatcherThread
 FileStorageWatcherThread::FileStorageWatcherThread( const QString &dataDirectory, QObject *parent )
     : QObject( parent ),
-      m_dataDirectory( dataDirectory ),
+      m_dataDirectory( QDir::cleanPath( dataDirectory ) ),
+      m_currentCacheSize( 0 ),
       m_deleting( false ),
-      m_willQuit( false )
+      m_willQuit( false ),
+      m_indexChanged( false ),
+      m_saveScheduled( false ),
+      m_indexComplete( false )
 {
     // For now setting cache limit to 0. This won't delete anything
     setCacheLimit( 0 );
@@ -67,20 +91,31 @@ void FileStorageWatcherThread::setCacheLimit( quint64 bytes )
     emit variableChanged();
 }
 
-void FileStorageWatcherThread::addToCurrentSize( qint64 bytes )
+void FileStorageWatcherThread::addFile( const QString &fileName, qint64 size )
 {
-//     mDebug() << "Current cache size changed by " << bytes;
-    qint64 changedSize = bytes + m_currentCacheSize;
-    if( changedSize >= 0 )
-	m_currentCacheSize = changedSize;
-    else
-	m_currentCacheSize = 0;
+    const QString key = indexKey( fileName );
+    if ( key.isEmpty() )
+        return;
+
+    insertEntry( key, size, QDateTime::currentDateTime().toTime_t() );
+    indexChanged();
     emit variableChanged();
 }
 
+void FileStorageWatcherThread::accessFile( const QString &fileName )
+{
+    const QString key = indexKey( fileName );
+    if ( !m_entries.contains( key ) )
+        return;
+
+    insertEntry( key, m_entries.value( key ).size, QDateTime::currentDateTime().toTime_t() );
+    indexChanged();
+}
+
 void FileStorageWatcherThread::resetCurrentSize()
 {
-    m_currentCacheSize = 0;
+    // Base tiles and files written meanwhile survive a clear
+    getCurrentCacheSize();
     emit variableChanged();
 }
 
@@ -98,19 +133,122 @@ void FileStorageWatcherThread::prepareQuit()
     m_willQuit = true;
 }
 
+void FileStorageWatcherThread::loadIndex()
+{
+    QFile file( indexFileName( m_dataDirectory ) );
+    const bool clean = QFile::exists( cleanMarkerFileName( m_dataDirectory ) );
+
+    if ( clean && file.open( QIODevice::ReadOnly ) ) {
+        QDataStream stream( &file );
+        stream.setVersion( QDataStream::Qt_4_5 );
+
+        quint32 magic = 0;
+        quint32 version = 0;
+        quint32 count = 0;
+        stream >> magic >> version >> count;
+
+        if ( magic == indexMagic && version == indexVersion ) {
+            // Entries are stored from least to most recently used
+            for ( quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i ) {
+                QString key;
+                quint64 size;
+                uint lastAccess;
+                stream >> key >> size >> lastAccess;
+                if ( stream.status() == QDataStream::Ok )
+                    insertEntry( key, size, lastAccess );
+            }
+
+            if ( stream.status() == QDataStream::Ok ) {
+                m_indexComplete = true;
+                mDebug() << "FileStorageWatcher: Loaded index of" << m_entries.size() << "files";
+                // From now on the index on disc lags behind until it is saved cleanly
+                QFile::remove( cleanMarkerFileName( m_dataDirectory ) );
+                return;
+            }
+        }
+    }
+
+    // Recover from a missing or outdated index
+    getCurrentCacheSize();
+    saveIndex( false );
+}
+
+void FileStorageWatcherThread::saveIndex( bool clean )
+{
+    const QString fileName = indexFileName( m_dataDirectory );
+    QFile file( fileName + ".new" );
+    if ( !file.open( QIODevice::WriteOnly ) ) {
+        mDebug() << "FileStorageWatcher: Could not save index" << file.errorString();
+        return;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_5 );
+    stream << indexMagic << indexVersion << quint32( m_lru.size() );
+    foreach ( const QString &key, m_lru ) {
+        const Entry &entry = m_entries[ key ];
+        stream << key << entry.size << entry.lastAccess;
+    }
+    file.close();
+
+    QFile::remove( fileName );
+    file.rename( fileName );
+    m_indexChanged = false;
+
+    if ( clean && m_indexComplete ) {
+        QFile marker( cleanMarkerFileName( m_dataDirectory ) );
+        marker.open( QIODevice::WriteOnly );
+    }
+}
+
+void FileStorageWatcherThread::saveChangedIndex()
+{
+    m_saveScheduled = false;
+    if ( m_indexChanged )
+        saveIndex( false );
+}
+
 void FileStorageWatcherThread::getCurrentCacheSize()
 {
-    mDebug() << "FileStorageWatcher: Creating cache size";
-    quint64 dataSize = 0;
-    QDirIterator it( m_dataDirectory, QDir::Files, QDirIterator::Subdirectories );
+    mDebug() << "FileStorageWatcher: Scanning cache directory";
+
+    // Keep the access times of files that are still known
+    QHash<QString, uint> lastAccess;
+    foreach ( const QString &key, m_lru ) {
+        lastAccess.insert( key, m_entries[ key ].lastAccess );
+    }
+    m_entries.clear();
+    m_lru.clear();
+    m_currentCacheSize = 0;
+
+    QList<QPair<uint, QString> > accessOrder;
+    QHash<QString, quint64> sizes;
+    QDirIterator it( m_dataDirectory + "/maps", QDir::Files | QDir::NoSymLinks, QDirIterator::Subdirectories );
     
     while( it.hasNext() && !m_willQuit )
     {
 	it.next();
+	const QString key = indexKey( it.filePath() );
+	if ( key.isEmpty() )
+	    continue;
+
 	QFileInfo file = it.fileInfo();
-	dataSize += file.size();
+	const uint time = qMax( file.lastModified().toTime_t(), lastAccess.value( key ) );
+	accessOrder.append( qMakePair( time, key ) );
+	sizes.insert( key, file.size() );
     }
-    m_currentCacheSize = dataSize;
+
+    // An interrupted scan must not be trusted later on
+    m_indexComplete = !m_willQuit;
+
+    qSort( accessOrder );
+    for ( int i = 0; i < accessOrder.size(); ++i ) {
+	const QString &key = accessOrder.at( i ).second;
+	insertEntry( key, sizes.value( key ), accessOrder.at( i ).first );
+    }
+    indexChanged();
+
+    mDebug() << "FileStorageWatcher: Indexed" << m_entries.size() << "files," << m_currentCacheSize << "bytes";
 }
 
 void FileStorageWatcherThread::ensureCacheSize()
@@ -141,42 +279,44 @@ void FileStorageWatcherThread::ensureCacheSize()
 	     << "unknown conditions for safety reasons!";
 	    return;
 	}
-	
-	// Which planet do we show now.
-	// We have to delete files for this planet at last
-	QStringList currentList = m_mapThemeId.split( '/' );
-	QString shownPlanet( currentList.first() );
-	currentList.removeFirst();
-	// The QString to save the path of the directory to the current planet
-	QString lastPlanet;
-	
-	QString cachedMapsDirectory = m_dataDirectory + "/maps";
-
-	// Iterator over planet directories
-	QDirIterator it( cachedMapsDirectory,
-			 QDir::NoDotAndDotDot | QDir::Dirs );
-
-	while ( it.hasNext() &&
-	        keepDeleting() ) {
-	    it.next();
-	    
-	    // Our current planet directory
-	    QString planetDirectory = it.filePath();
-	    QFileInfo fileInfo = it.fileInfo();
-	    
-	    // We have found the currently shown planet.
-	    // Please delete here at last.
-	    if( fileInfo.fileName() == shownPlanet ) {
-		lastPlanet = planetDirectory;
+
+	// Delete the least recently used files of all planets and themes first
+	const qint64 now = QDateTime::currentDateTime().toTime_t();
+	bool onlyRecentFiles = false;
+	QSet<QString> shrunkPacks;
+	while ( keepDeleting() && !m_lru.isEmpty() ) {
+	    const QString key = m_lru.first();
+
+	    // A tile pack is shrunk by its least recently written tiles instead.
+	    // The pack is written by every download, so its own access time is no hint.
+	    if ( key.endsWith( QLatin1String( "/tiles.pack" ) ) ) {
+		if ( shrunkPacks.contains( key ) ) {
+		    onlyRecentFiles = true;
+		    break;
+		}
+		shrunkPacks.insert( key );
+		TilePack *const pack = TilePack::find( m_dataDirectory + '/' + key );
+		const qint64 freed = pack ? pack->shrink( m_currentCacheSize - m_cacheSoftLimit ) : 0;
+		mDebug() << "FileStorageWatcher: Shrunk" << key << "by" << freed << "bytes";
+		insertEntry( key, pack ? pack->size() : m_entries[ key ].size, now );
+		m_filesDeleted++;
 		continue;
 	    }
-	    
-	    ensureSizePerPlanet( planetDirectory );
-	}
-	
-	if( keepDeleting() ) {
-	    ensureSizePerPlanet( lastPlanet, currentList.first() );
+
+	    // Do not delete files used within the last two minutes.
+	    if ( now - qint64( m_entries[ key ].lastAccess ) <= deleteOnlyFilesOlderThan ) {
+		onlyRecentFiles = true;
+		break;
+	    }
+
+	    // A file which is gone already is dropped from the index as well
+	    mDebug() << "FileStorageWatcher: Delete " << key;
+	    QFile::remove( m_dataDirectory + '/' + key );
+	    QFile::remove( TileMetaData::metaDataFileName( m_dataDirectory + '/' + key ) );
+	    removeEntry( key );
+	    m_filesDeleted++;
 	}
+	indexChanged();
 	
 	// We have deleted enough files. 
 	// Perhaps there are changes.
@@ -189,7 +329,7 @@ void FileStorageWatcherThread::ensureCacheSize()
 	    m_deleting = false;
 	}
 	
-	if( m_currentCacheSize > m_cacheSoftLimit ) {
+	if( m_currentCacheSize > m_cacheSoftLimit && !onlyRecentFiles ) {
 	    mDebug() << "FileStorageWatcher: Could not set cache size.";
 	    // Set the cache limit to a higher value, so we won't start
 	    // trying to delete something next time.  Softlimit is now exactly
@@ -199,97 +339,68 @@ void FileStorageWatcherThread::ensureCacheSize()
     }
 }
 
-void FileStorageWatcherThread::ensureSizePerPlanet( const QString &planetDirectory,
-                                                    const QString &currentTheme )
+QString FileStorageWatcherThread::indexKey( const QString &fileName ) const
 {
-    mDebug() << "Deleting from folder: " << planetDirectory;
-    
-    // lastTheme will store the path to our currentTheme
-    QString lastTheme;
-    
-    QDirIterator itPlanet( planetDirectory,
-	                   QDir::NoDotAndDotDot | QDir::Dirs );
-    while( itPlanet.hasNext() &&
-	   keepDeleting() ) {
-	itPlanet.next();
-	QString themeDirectory = itPlanet.filePath();
-	QFileInfo fileInfo = itPlanet.fileInfo();
-	
-	// We have found the currently shown theme.
-	// Please delete here at last.
-	if( !currentTheme.isEmpty() && fileInfo.fileName() == currentTheme ) {
-	    mDebug() << "FileStorageWatcher: Skipping " << themeDirectory
-	             << " for now";
-	    lastTheme = themeDirectory;
-	    continue;
-	}
-	
-	ensureSizePerTheme( themeDirectory );
-    }
-    
-    if( keepDeleting() ) {
-	mDebug() << "Removing files of: "
-	         << lastTheme;
-	ensureSizePerTheme( lastTheme );
-    }
+    const QString path = QDir::cleanPath( fileName );
+    if ( !path.startsWith( m_dataDirectory + '/' ) )
+        return QString();
+
+    // We try to be very careful and just delete images of
+    // maps/<planet>/<theme>/<level>/..., but no base tiles
+    // FIXME, when vectortiling I suppose also vector tiles will have
+    // to be deleted
+    const QString key = path.mid( m_dataDirectory.length() + 1 );
+    const QStringList components = key.split( '/' );
+    if ( components.size() < 4 || components.first() != QLatin1String( "maps" ) )
+        return QString();
+
+    // Packs of downloaded tiles are shrunk rather than deleted
+    if ( components.size() == 4 && components.last() == QLatin1String( "tiles.pack" ) )
+        return key;
+
+    if ( components.size() < 5 )
+        return QString();
+
+    bool ok = false;
+    if ( components.at( 3 ).toInt( &ok ) <= maxBaseTileLevel || !ok )
+        return QString();
+
+    const QString lowerCase = key.toLower();
+    if (    lowerCase.endsWith( QLatin1String( ".jpg" ) )
+         || lowerCase.endsWith( QLatin1String( ".png" ) )
+         || lowerCase.endsWith( QLatin1String( ".gif" ) )
+         || lowerCase.endsWith( QLatin1String( ".svg" ) ) )
+        return key;
+
+    return QString();
 }
 
-static bool greaterThanByNumber( const QString &s1, const QString &s2)
+void FileStorageWatcherThread::insertEntry( const QString &key, quint64 size, uint lastAccess )
 {
-    return s1.toInt() > s2.toInt();
+    if ( m_entries.contains( key ) )
+        removeEntry( key );
+
+    Entry entry;
+    entry.size = size;
+    entry.lastAccess = lastAccess;
+    entry.position = m_lru.insert( m_lru.end(), key );
+    m_entries.insert( key, entry );
+    m_currentCacheSize += size;
 }
 
-void FileStorageWatcherThread::ensureSizePerTheme( const QString &themeDirectory )
+void FileStorageWatcherThread::removeEntry( const QString &key )
 {
-    mDebug() << "Deleting from folder: " << themeDirectory;
-
-    // Delete from folders with high numbers first
-    QStringList folders =
-	QDir( themeDirectory ).entryList(   QDir::Dirs
-					  | QDir::NoDotAndDotDot );
-    qSort( folders.begin(), folders.end(), greaterThanByNumber );
-    
-    QStringListIterator itTheme( folders );
-    while ( itTheme.hasNext() &&
-	    keepDeleting() ) {
-	QString subDirectory = itTheme.next();
+    const Entry entry = m_entries.take( key );
+    m_lru.erase( entry.position );
+    m_currentCacheSize -= qMin( entry.size, m_currentCacheSize );
+}
 
-	// Do not delete base tiles
-	if ( subDirectory.toInt() <= maxBaseTileLevel ) {
-	    continue;
-	}
-	
-	QString tileDirectory = themeDirectory + '/' + subDirectory;
-	
-	QDirIterator itTile( tileDirectory,
-			     QDir::Files | QDir::NoSymLinks,
-			     QDirIterator::Subdirectories );
-	while ( itTile.hasNext() &&
-	        keepDeleting() ) {
-	    itTile.next();
-	    QString filePath = itTile.filePath();
-	    QString lowerCase = filePath.toLower();
-	
-	    QFileInfo info( filePath );
-	
-	    // We try to be very careful and just delete images
-	    // Do not delete files younger than two minutes.
-        // FIXME, when vectortiling I suppose also vector tiles will have
-        // to be deleted
-	    if (   (    lowerCase.endsWith( QLatin1String( ".jpg" ) ) 
-	             || lowerCase.endsWith( QLatin1String( ".png" ) )
-	             || lowerCase.endsWith( QLatin1String( ".gif" ) )
-	             || lowerCase.endsWith( QLatin1String( ".svg" ) ) )
-		&& ( info.lastModified().secsTo( QDateTime::currentDateTime() )
-		     > deleteOnlyFilesOlderThan ) )
-	    {
-		mDebug() << "FileStorageWatcher: Delete "
-		         << filePath;
-		m_filesDeleted++;
-		m_currentCacheSize -= info.size();
-		QFile::remove( filePath );
-	    }
-	}
+void FileStorageWatcherThread::indexChanged()
+{
+    m_indexChanged = true;
+    if ( !m_saveScheduled ) {
+        m_saveScheduled = true;
+        QTimer::singleShot( indexSaveInterval * 1000, this, SLOT(saveChangedIndex()) );
     }
 }
 
@@ -318,6 +429,7 @@ FileStorageWatcher::FileStorageWatcher( const QString &dataDirectory, QObject *
     
     m_thread = 0;
     m_quitting = false;
+    m_indexInvalidated = 0;
 }
 
 FileStorageWatcher::~FileStorageWatcher()
@@ -359,9 +471,18 @@ quint64 FileStorageWatcher::cacheLimit()
 	return m_limit;
 }
 
-void FileStorageWatcher::addToCurrentSize( qint64 bytes )
+void FileStorageWatcher::addFile( const QString &fileName, qint64 size )
 {
-    emit sizeChanged( bytes );
+    if( !m_started && m_indexInvalidated.testAndSetOrdered( 0, 1 ) ) {
+	// Nobody records this change, so the index has to be rebuilt on the next start
+	QFile::remove( cleanMarkerFileName( QDir::cleanPath( m_dataDirectory ) ) );
+    }
+    emit fileAdded( fileName, size );
+}
+
+void FileStorageWatcher::accessFile( const QString &fileName )
+{
+    emit fileAccessed( fileName );
 }
 
 void FileStorageWatcher::resetCurrentSize()
@@ -383,6 +504,14 @@ void FileStorageWatcher::run()
 {
     m_thread = new FileStorageWatcherThread( m_dataDirectory );
     if( !m_quitting ) {
+	// Changes reported while the index is loaded are queued and applied afterwards
+	connect( this, SIGNAL(fileAdded(QString,qint64)),
+		 m_thread, SLOT(addFile(QString,qint64)) );
+	connect( this, SIGNAL(fileAccessed(QString)),
+		 m_thread, SLOT(accessFile(QString)) );
+	connect( this, SIGNAL(cleared()),
+		 m_thread, SLOT(resetCurrentSize()) );
+
 	m_themeLimitMutex->lock();
 	m_thread->setCacheLimit( m_limit );
 	m_thread->updateTheme( m_theme );
@@ -390,19 +519,16 @@ void FileStorageWatcher::run()
 	mDebug() << m_started;
 	m_themeLimitMutex->unlock();
 	
-	m_thread->getCurrentCacheSize();
+	m_thread->loadIndex();
+	m_indexInvalidated = 0;
 	
-	connect( this, SIGNAL(sizeChanged(qint64)),
-		 m_thread, SLOT(addToCurrentSize(qint64)) );
-	connect( this, SIGNAL(cleared()),
-		 m_thread, SLOT(resetCurrentSize()) );
-    
 	// Make sure that we don't want to stop process.
 	// The thread wouldn't exit from event loop.
 	if( !m_quitting )
 	    exec();
     
 	m_started = false;
+	m_thread->saveIndex( true );
     }
     delete m_thread;
     m_thread = 0;
@@ -11,7 +11,10 @@
 #ifndef MARBLE_FILESTORAGEWATCHER_H
 #define MARBLE_FILESTORAGEWATCHER_H
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QThread>
+#include <QtCore/QHash>
+#include <QtCore/QLinkedList>
 #include <QtCore/QMutex>
 #include <QtCore/QSet>
 
@@ -43,13 +46,19 @@ class FileStorageWatcherThread : public QObject
 	void setCacheLimit( quint64 bytes );
 	
 	/**
-	 * Add @p bytes to the current cache size.
+	 * Records that @p fileName has been written with @p size bytes.
 	 * So FileStorageWatcher is aware of the current cache size.
 	 */
-	void addToCurrentSize( qint64 bytes );
-	
+	void addFile( const QString &fileName, qint64 size );
+
 	/**
-	 * Setting current cache size to 0.
+	 * Records that @p fileName has been read, making it the most
+	 * recently used file.
+	 */
+	void accessFile( const QString &fileName );
+
+	/**
+	 * Rebuilds the index after the cache has been cleared.
 	 */
 	void resetCurrentSize();
 	
@@ -66,8 +75,22 @@ class FileStorageWatcherThread : public QObject
 	 */
 	void prepareQuit();
 	
+	/**
+	 * Loads the index of cached files. The cache directory is only
+	 * scanned if the index is missing or was not saved properly.
+	 */
+	void loadIndex();
+
+	/**
+	 * Saves the index of cached files. A @p clean index is trusted
+	 * on the next start, so it must only be saved when no more
+	 * changes will be reported.
+	 */
+	void saveIndex( bool clean );
+
 	/**
 	 * Getting the current size of the data stored on the disc
+	 * by scanning the whole cache directory.
 	 */
 	void getCurrentCacheSize();
 
@@ -76,19 +99,31 @@ class FileStorageWatcherThread : public QObject
 	 * Ensures that the cache doesn't exceed limits.
 	 */
 	void ensureCacheSize();
+
+	/**
+	 * Saves the index if it changed since it was saved last.
+	 */
+	void saveChangedIndex();
     
     private:
 	Q_DISABLE_COPY( FileStorageWatcherThread )
-	
-	/**
-	 * Deletes files of a planet if needed
-	 */
-	void ensureSizePerPlanet( const QString &planetDirectory, const QString &currentTheme = QString() );
-	
+
+	struct Entry
+	{
+	    quint64 size;
+	    uint lastAccess;
+	    QLinkedList<QString>::iterator position;
+	};
+
 	/**
-	 * Deletes files of a theme if needed
+	 * Returns the path of @p fileName relative to the data directory
+	 * if it is a tile which may be deleted, or an empty string.
 	 */
-	void ensureSizePerTheme( const QString &themeDirectory );
+	QString indexKey( const QString &fileName ) const;
+
+	void insertEntry( const QString &key, quint64 size, uint lastAccess );
+	void removeEntry( const QString &key );
+	void indexChanged();
 	
 	/**
 	 * Returns true if it is necessary to delete files.
@@ -106,6 +141,13 @@ class FileStorageWatcherThread : public QObject
 	QMutex	m_limitMutex;
 	QMutex	m_themeMutex;
 	bool	m_willQuit;
+
+	QHash<QString, Entry> m_entries;
+	// Index keys ordered from least to most recently used
+	QLinkedList<QString> m_lru;
+	bool	m_indexChanged;
+	bool	m_saveScheduled;
+	bool	m_indexComplete;
 };
 
 
@@ -138,13 +180,18 @@ class FileStorageWatcher : public QThread
 	void setCacheLimit( quint64 bytes );
 	
 	/**
-	 * Add @p bytes to the current cache size.
+	 * Records that @p fileName has been written with @p size bytes.
 	 * So FileStorageWatcher is aware of the current cache size.
 	 */
-	void addToCurrentSize( qint64 bytes );
+	void addFile( const QString &fileName, qint64 size );
+
+	/**
+	 * Records that @p fileName has been read.
+	 */
+	void accessFile( const QString &fileName );
 	
 	/**
-	 * Setting current cache size to 0.
+	 * Rebuilds the index after the cache has been cleared.
 	 */
 	void resetCurrentSize();
 	
@@ -157,7 +204,8 @@ class FileStorageWatcher : public QThread
 	void updateTheme( const QString &mapTheme );
 	
     Q_SIGNALS:
-	void sizeChanged( qint64 bytes );
+	void fileAdded( const QString &fileName, qint64 size );
+	void fileAccessed( const QString &fileName );
 	void cleared();
 	
     protected:
@@ -177,6 +225,8 @@ class FileStorageWatcher : public QThread
 	quint64 m_limit;
 	bool m_started;
 	bool m_quitting;
+	// Set by the main thread when a change is not recorded by the index
+	QAtomicInt m_indexInvalidated;
 };
 
 }
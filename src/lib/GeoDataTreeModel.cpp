@@ -15,6 +15,7 @@
 // Qt
 #include <QtCore/QModelIndex>
 #include <QtCore/QFile>
+#include <QtCore/QHash>
 #include <QtCore/QList>
 #include <QtGui/QPixmap>
 #include <QtGui/QItemSelectionModel>
@@ -24,6 +25,7 @@
 #include "GeoDataDocument.h"
 #include "GeoDataContainer.h"
 #include "GeoDataExtendedData.h"
+#include "GeoDataMultiGeometry.h"
 #include "GeoDataPlacemark.h"
 #include "GeoDataStyle.h"
 #include "GeoDataTypes.h"
@@ -33,6 +35,19 @@
 
 using namespace Marble;
 
+namespace
+{
+bool isContainerType( const char *type )
+{
+    return type == GeoDataTypes::GeoDataFolderType || type == GeoDataTypes::GeoDataDocumentType;
+}
+
+bool hasMultiGeometry( const GeoDataPlacemark *placemark )
+{
+    return placemark->geometry() && placemark->geometry()->nodeType() == GeoDataTypes::GeoDataMultiGeometryType;
+}
+}
+
 class GeoDataTreeModel::Private {
  public:
     Private( QAbstractItemModel* model );
@@ -40,9 +55,22 @@ class GeoDataTreeModel::Private {
 
     void checkParenting( GeoDataObject *object );
 
+    /**
+     * Returns the row of @p object below its parent in the model, or -1.
+     */
+    int row( const GeoDataObject *object ) const;
+
+    template<class Parent>
+    int cachedRow( const Parent *parent, const GeoDataObject *child ) const;
+
     GeoDataDocument* m_rootDocument;
     bool             m_ownsRootDocument;
     QItemSelectionModel m_selectionModel;
+
+    // Rows of the children of containers and multi geometries, looked up by
+    // parent() for every index. Entries are checked on use, so changes of
+    // the tree that bypass the model only cost a rebuild.
+    mutable QHash<const GeoDataObject*, int> m_rows;
 };
 
 GeoDataTreeModel::Private::Private( QAbstractItemModel *model ) :
@@ -63,8 +91,7 @@ GeoDataTreeModel::Private::~Private()
 void GeoDataTreeModel::Private::checkParenting( GeoDataObject *object )
 {
     GeoDataContainer *container;
-    if(    object->nodeType() == GeoDataTypes::GeoDataDocumentType
-        || object->nodeType() == GeoDataTypes::GeoDataFolderType ) {
+    if ( isContainerType( object->nodeType() ) ) {
         container = static_cast<GeoDataContainer*>( object );
         foreach( GeoDataFeature *child, container->featureList() ) {
             if ( child->parent() != container ) {
@@ -75,6 +102,53 @@ void GeoDataTreeModel::Private::checkParenting( GeoDataObject *object )
     }
 }
 
+int GeoDataTreeModel::Private::row( const GeoDataObject *object ) const
+{
+    const GeoDataObject *parent = object->parent();
+    if ( !parent ) {
+        return -1;
+    }
+
+    const char *const type = parent->nodeType();
+    if ( isContainerType( type ) ) {
+        return cachedRow( static_cast<const GeoDataContainer*>( parent ), object );
+    }
+
+    // The multi geometry of a placemark is its only child
+    if ( type == GeoDataTypes::GeoDataPlacemarkType ) {
+        return object->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ? 0 : -1;
+    }
+
+    if ( type == GeoDataTypes::GeoDataMultiGeometryType ) {
+        return cachedRow( static_cast<const GeoDataMultiGeometry*>( parent ), object );
+    }
+
+    return -1;
+}
+
+template<class Parent>
+int GeoDataTreeModel::Private::cachedRow( const Parent *parent, const GeoDataObject *child ) const
+{
+    const QHash<const GeoDataObject*, int>::ConstIterator cached = m_rows.constFind( child );
+    if ( cached != m_rows.constEnd() && cached.value() < parent->size()
+         && parent->child( cached.value() ) == child ) {
+        return cached.value();
+    }
+
+    // Unknown or moved by an insertion or removal in front of it,
+    // refresh the rows of all siblings at once
+    int result = -1;
+    const int size = parent->size();
+    for ( int i = 0; i < size; ++i ) {
+        const GeoDataObject *sibling = parent->child( i );
+        m_rows.insert( sibling, i );
+        if ( sibling == child ) {
+            result = i;
+        }
+    }
+    return result;
+}
+
 GeoDataTreeModel::GeoDataTreeModel( QObject *parent )
     : QAbstractItemModel( parent ),
       d( new Private( this ) )
@@ -103,18 +177,18 @@ bool GeoDataTreeModel::hasChildren( const QModelIndex &parent ) const
         return false;
     }
 
-    if ( parentItem->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+    const char *const type = parentItem->nodeType();
+    if ( type == GeoDataTypes::GeoDataPlacemarkType ) {
         GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark*>( parentItem );
-        return dynamic_cast<GeoDataMultiGeometry*>( placemark->geometry() );
+        return hasMultiGeometry( placemark );
     }
 
-    if ( parentItem->nodeType() == GeoDataTypes::GeoDataFolderType
-         || parentItem->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+    if ( isContainerType( type ) ) {
         GeoDataContainer *container = static_cast<GeoDataContainer*>( parentItem );
         return container->size();
     }
 
-    if ( parentItem->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ) {
+    if ( type == GeoDataTypes::GeoDataMultiGeometryType ) {
         GeoDataMultiGeometry *geometry = static_cast<GeoDataMultiGeometry*>( parentItem );
         return geometry->size();
     }
@@ -143,8 +217,8 @@ int GeoDataTreeModel::rowCount( const QModelIndex &parent ) const
         return 0;
     }
 
-    if ( parentItem->nodeType() == GeoDataTypes::GeoDataFolderType
-         || parentItem->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+    const char *const type = parentItem->nodeType();
+    if ( isContainerType( type ) ) {
         GeoDataContainer *container = static_cast<GeoDataContainer*>( parentItem );
 //        mDebug() << "rowCount " << type << "(" << parentItem << ") =" << container->size();
         return container->size();
@@ -152,15 +226,15 @@ int GeoDataTreeModel::rowCount( const QModelIndex &parent ) const
 //        mDebug() << "rowCount bad container " << container;
     }
 
-    if ( parentItem->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+    if ( type == GeoDataTypes::GeoDataPlacemarkType ) {
         GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark*>( parentItem );
-        if ( dynamic_cast<GeoDataMultiGeometry*>( placemark->geometry() ) ) {
+        if ( hasMultiGeometry( placemark ) ) {
 //            mDebug() << "rowCount " << type << "(" << parentItem << ") = 1";
             return 1;
         }
     }
 
-    if ( parentItem->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ) {
+    if ( type == GeoDataTypes::GeoDataMultiGeometryType ) {
         GeoDataMultiGeometry *geometry = static_cast<GeoDataMultiGeometry*>( parentItem );
 //        mDebug() << "rowCount " << parent << " " << type << " " << geometry->size();
         return geometry->size();
@@ -202,16 +276,17 @@ QVariant GeoDataTreeModel::data( const QModelIndex &index, int role ) const
         return QVariant();
 
     GeoDataObject *object = static_cast<GeoDataObject*>( index.internalPointer() );
+    const char *const type = object->nodeType();
     if ( role == Qt::DisplayRole ) {
 
-        if ( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+        if ( index.column() == 1 ){
+            return QVariant( type );
+        }
+        if ( type == GeoDataTypes::GeoDataPlacemarkType ) {
             GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark*>( object );
                 if ( index.column() == 0 ){
                     return QVariant( placemark->name() );
                 }
-                else if ( index.column() == 1 ){
-                    return QVariant( placemark->nodeType() );
-                }
                 else if ( index.column() == 2 ){
                     return QVariant( placemark->popularity() );
                 }
@@ -219,38 +294,24 @@ QVariant GeoDataTreeModel::data( const QModelIndex &index, int role ) const
                     return QVariant( placemark->zoomLevel() );
                 }
         }
-        if ( object->nodeType() == GeoDataTypes::GeoDataFolderType
-             || object->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        if ( isContainerType( type ) ) {
             GeoDataFeature *feature = static_cast<GeoDataFeature*>( object );
             if ( index.column() == 0 ){
                 return QVariant( feature->name() );
             }
-            else if ( index.column() == 1 ){
-                return QVariant( feature->nodeType() );
-            }
-        }
-
-        GeoDataGeometry *geometry = dynamic_cast<GeoDataGeometry*>( object );
-        if ( geometry && index.column() == 1 ){
-            return QVariant( geometry->nodeType() );
-        }
-
-        GeoDataObject *item = dynamic_cast<GeoDataObject*>( object );
-        if ( item && index.column() == 1 ){
-            return QVariant( item->nodeType() );
         }
 
     }
     else if ( role == Qt::CheckStateRole
               && index.column() == 0 ) {
-        if ( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+        if ( type == GeoDataTypes::GeoDataPlacemarkType ) {
             GeoDataPlacemark *feature = static_cast<GeoDataPlacemark*>( object );
-            const char* type = feature->geometry()->nodeType();
-            if ( type == GeoDataTypes::GeoDataLineStringType
-                 || type == GeoDataTypes::GeoDataPolygonType
-                 || type == GeoDataTypes::GeoDataLinearRingType
-                 || type == GeoDataTypes::GeoDataMultiGeometryType
-                 || type == GeoDataTypes::GeoDataTrackType
+            const char* geometryType = feature->geometry()->nodeType();
+            if ( geometryType == GeoDataTypes::GeoDataLineStringType
+                 || geometryType == GeoDataTypes::GeoDataPolygonType
+                 || geometryType == GeoDataTypes::GeoDataLinearRingType
+                 || geometryType == GeoDataTypes::GeoDataMultiGeometryType
+                 || geometryType == GeoDataTypes::GeoDataTrackType
                  ) {
                 if ( feature->isGloballyVisible() ) {
                     return QVariant( Qt::Checked );
@@ -260,8 +321,7 @@ QVariant GeoDataTreeModel::data( const QModelIndex &index, int role ) const
                     return QVariant( Qt::Unchecked );
                 }
             }
-        } else if ( object->nodeType() == GeoDataTypes::GeoDataFolderType
-                    || object->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        } else if ( isContainerType( type ) ) {
             GeoDataFeature *feature = static_cast<GeoDataFeature*>( object );
             if ( feature->isGloballyVisible() ) {
                 return QVariant( Qt::Checked );
@@ -274,34 +334,30 @@ QVariant GeoDataTreeModel::data( const QModelIndex &index, int role ) const
     }
     else if ( role == Qt::DecorationRole
               && index.column() == 0 ) {
-        if ( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType
-             || object->nodeType() == GeoDataTypes::GeoDataFolderType
-             || object->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        if ( type == GeoDataTypes::GeoDataPlacemarkType || isContainerType( type ) ) {
             GeoDataFeature *feature = static_cast<GeoDataFeature*>( object );
             return QVariant(feature->style()->iconStyle().icon());
         }
     } else if ( role == Qt::ToolTipRole
               && index.column() == 0 ) {
-        if ( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType
-             || object->nodeType() == GeoDataTypes::GeoDataFolderType
-             || object->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        if ( type == GeoDataTypes::GeoDataPlacemarkType || isContainerType( type ) ) {
             GeoDataFeature *feature = static_cast<GeoDataFeature*>( object );
             return QVariant( feature->description() );
         }
     } else if ( role == MarblePlacemarkModel::ObjectPointerRole ) {
         return qVariantFromValue( object );
     } else if ( role == MarblePlacemarkModel::PopularityIndexRole ) {
-        if ( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+        if ( type == GeoDataTypes::GeoDataPlacemarkType ) {
             GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark*>( object );
             return QVariant( placemark->zoomLevel() );
         }
     } else if ( role == MarblePlacemarkModel::PopularityRole ) {
-        if ( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+        if ( type == GeoDataTypes::GeoDataPlacemarkType ) {
             GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark*>( object );
             return QVariant( placemark->popularity() );
         }
     } else if ( role == MarblePlacemarkModel::CoordinateRole ) {
-        if ( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+        if ( type == GeoDataTypes::GeoDataPlacemarkType ) {
             GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark*>( object );
             return qVariantFromValue( placemark->coordinate() );
         }
@@ -333,22 +389,22 @@ QModelIndex GeoDataTreeModel::index( int row, int column, const QModelIndex &par
     GeoDataObject *childItem = 0;
 
 
-    if ( parentItem->nodeType() == GeoDataTypes::GeoDataFolderType
-         || parentItem->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+    const char *const type = parentItem->nodeType();
+    if ( isContainerType( type ) ) {
         GeoDataContainer *container = static_cast<GeoDataContainer*>( parentItem );
         childItem = container->child( row );
         return createIndex( row, column, childItem );
     }
 
-    if ( parentItem->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+    if ( type == GeoDataTypes::GeoDataPlacemarkType ) {
         GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark*>( parentItem );
-        childItem = placemark->geometry();
-        if ( dynamic_cast<GeoDataMultiGeometry*>( childItem ) ) {
+        if ( hasMultiGeometry( placemark ) ) {
+            childItem = placemark->geometry();
             return createIndex( row, column, childItem );
         }
     }
 
-    if ( parentItem->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ) {
+    if ( type == GeoDataTypes::GeoDataMultiGeometryType ) {
         GeoDataMultiGeometry *geometry = static_cast<GeoDataMultiGeometry*>( parentItem );
         childItem = geometry->child( row );
         return createIndex( row, column, childItem );
@@ -376,39 +432,16 @@ QModelIndex GeoDataTreeModel::parent( const QModelIndex &index ) const
             return QModelIndex();
         }
 
-        GeoDataObject *greatParentObject = parentObject->parent();
-
         // Avoid crashing when there is no grandparent
-        if ( greatParentObject == 0 )
+        if ( parentObject->parent() == 0 )
         {
             return QModelIndex();
         }
 
-        // greatParent can be a container
-        if ( greatParentObject->nodeType() == GeoDataTypes::GeoDataFolderType
-             || greatParentObject->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
-            GeoDataContainer *greatparentContainer = static_cast<GeoDataContainer*>( greatParentObject );
-            GeoDataFeature *parentFeature = static_cast<GeoDataFeature*>( parentObject );
-//            mDebug() << "parent " << childObject->nodeType() << "(" << childObject << ") = "
-//                    << parentObject->nodeType() << "[" << greatparentContainer->childPosition( parentFeature ) << "](" << parentObject << ")";
-            return createIndex( greatparentContainer->childPosition( parentFeature ), 0, parentObject );
-        }
-
-        // greatParent can be a placemark
-        if ( greatParentObject->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
-//            GeoDataPlacemark *greatparentPlacemark = static_cast<GeoDataPlacemark*>( greatParentObject );
-//                mDebug() << "parent " << childObject->nodeType() << "(" << childObject << ") = "
-//                        << parentObject->nodeType() << "[0](" << parentObject << ")";
-            return createIndex( 0, 0, parentObject );
-        }
-
-        // greatParent can be a multigeometry
-        if ( greatParentObject->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ) {
-            GeoDataMultiGeometry *greatparentMultiGeo = static_cast<GeoDataMultiGeometry*>( greatParentObject );
-            GeoDataGeometry *parentGeometry = static_cast<GeoDataGeometry*>( parentObject );
-//                mDebug() << "parent " << childObject->nodeType() << "(" << childObject << ") = "
-//                        << parentObject->nodeType() << "[" << greatParentItem->childPosition( parentGeometry ) << "](" << parentObject << ")";
-            return createIndex( greatparentMultiGeo->childPosition( parentGeometry ), 0, parentObject );
+        // the grandparent can be a container, placemark or multigeometry
+        const int row = d->row( parentObject );
+        if ( row >= 0 ) {
+            return createIndex( row, 0, parentObject );
         }
     }
 
@@ -427,10 +460,9 @@ bool GeoDataTreeModel::setData ( const QModelIndex & index, const QVariant & val
         return false;
 
     GeoDataObject *object = static_cast<GeoDataObject*>( index.internalPointer() );
+    const char *const type = object->nodeType();
     if ( role == Qt::CheckStateRole ) {
-        if ( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType
-             || object->nodeType() == GeoDataTypes::GeoDataFolderType
-             || object->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        if ( type == GeoDataTypes::GeoDataPlacemarkType || isContainerType( type ) ) {
             GeoDataFeature *feature = static_cast<GeoDataFeature*>( object );
             feature->setVisible( value.toBool() );
             mDebug() << "setData " << feature->name() << " " << value.toBool();
@@ -438,9 +470,7 @@ bool GeoDataTreeModel::setData ( const QModelIndex & index, const QVariant & val
             return true;
         }
     } else if ( role == Qt::EditRole ) {
-        if ( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType
-             || object->nodeType() == GeoDataTypes::GeoDataFolderType
-             || object->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        if ( type == GeoDataTypes::GeoDataPlacemarkType || isContainerType( type ) ) {
             GeoDataFeature *feature = static_cast<GeoDataFeature*>( object );
             feature->setName( value.toString() );
             mDebug() << "setData " << feature->name() << " " << value.toString();
@@ -458,14 +488,15 @@ Qt::ItemFlags GeoDataTreeModel::flags ( const QModelIndex & index ) const
         return Qt::NoItemFlags;
 
     GeoDataObject *object = static_cast<GeoDataObject*>( index.internalPointer() );
-    if ( object->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+    const char *const type = object->nodeType();
+    if ( type == GeoDataTypes::GeoDataDocumentType ) {
         GeoDataDocument *document = static_cast<GeoDataDocument*>( object );
         if( document->documentRole() == UserDocument ) {
             return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable | Qt::ItemIsEditable;
         }
     }
-    if( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType
-     || object->nodeType() == GeoDataTypes::GeoDataFolderType ) {
+    if( type == GeoDataTypes::GeoDataPlacemarkType
+     || type == GeoDataTypes::GeoDataFolderType ) {
         GeoDataFeature *feature = static_cast<GeoDataFeature*>( object );
         GeoDataObject *parent = feature->parent();
         while( parent->nodeType() != GeoDataTypes::GeoDataDocumentType ) {
@@ -477,9 +508,7 @@ Qt::ItemFlags GeoDataTreeModel::flags ( const QModelIndex & index ) const
         }
     }
 
-    if ( object->nodeType() == GeoDataTypes::GeoDataPlacemarkType
-         || object->nodeType() == GeoDataTypes::GeoDataFolderType
-         || object->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+    if ( type == GeoDataTypes::GeoDataPlacemarkType || isContainerType( type ) ) {
         return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable;
     }
     return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
@@ -488,9 +517,6 @@ Qt::ItemFlags GeoDataTreeModel::flags ( const QModelIndex & index ) const
 
 QModelIndex GeoDataTreeModel::index( GeoDataObject *object )
 {
-    //It first runs bottom-top, storing every ancestor of the object, and
-    //then goes top-down retrieving the QModelIndex of every ancestor until reaching the
-    //index of the requested object.
     //The TreeModel contains: Documents, Folders, Placemarks, MultiGeometries
     //and Geometries that are children of MultiGeometries
     //You can not call this function with an element that does not belong to the tree
@@ -508,54 +534,19 @@ QModelIndex GeoDataTreeModel::index( GeoDataObject *object )
                    && ( object->parent()->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ) )
               || ( object->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ) );
 
-
-    QList< GeoDataObject* > ancestors;
-
-    GeoDataObject *itup = object; //Iterator to reach the top of the GeoDataDocument (bottom-up)
-
-    while ( itup && ( itup != d->m_rootDocument ) ) {//We reach up to the rootDocument
-
-        ancestors.append( itup );
-        itup = itup->parent() ;
+    //The index only needs the row of the object below its parent, the
+    //ancestors are walked up just to check that the object is in the tree
+    GeoDataObject *ancestor = object;
+    while ( ancestor && ( ancestor != d->m_rootDocument ) ) {
+        ancestor = ancestor->parent();
     }
 
-    QModelIndex itdown;
-    if ( !ancestors.isEmpty() ) {
-
-        itdown = index( d->m_rootDocument->childPosition( static_cast<GeoDataFeature*>( ancestors.last() ) ),0,QModelIndex());//Iterator to go top down
-
-        GeoDataObject *parent;
-
-        while ( ( ancestors.size() > 1 ) ) {
-
-            parent = static_cast<GeoDataObject*>( ancestors.last() );
-
-            if ( ( parent->nodeType() == GeoDataTypes::GeoDataFolderType )
-                || ( parent->nodeType() == GeoDataTypes::GeoDataDocumentType ) ) {
-
-                ancestors.removeLast();
-                itdown = index( static_cast<GeoDataContainer*>(parent)->childPosition( static_cast<GeoDataFeature*>( ancestors.last() ) ) , 0, itdown );
-            } else if ( ( parent->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) ) {
-                //The only child of the model is a Geometry or MultiGeometry object
-                //If it is a geometry object, we should be on the bottom of the list
-                ancestors.removeLast();
-                if( ancestors.last()->nodeType() == GeoDataTypes::GeoDataMultiGeometryType )
-                    itdown = index( 0 , 0, itdown );
-                else
-                    itdown = QModelIndex();
-
-            }  else if ( ( parent->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ) ) {
-                //The child is one of the geometry children of MultiGeometry
-                ancestors.removeLast();
-                itdown = index( static_cast<GeoDataMultiGeometry*>(parent)->childPosition( static_cast<GeoDataGeometry*>(ancestors.last()) ) , 0, itdown );
-            }
-            else  {   //If the element is not found on the tree, it will be added under m_rootDocument
-                itdown = QModelIndex();
-                break;
-            }
-        }
+    if ( !ancestor || object == d->m_rootDocument ) {
+        return QModelIndex();
     }
-    return itdown;
+
+    const int row = d->row( object );
+    return row < 0 ? QModelIndex() : createIndex( row, 0, object );
 }
 
 QItemSelectionModel *GeoDataTreeModel::selectionModel()
@@ -580,6 +571,7 @@ int GeoDataTreeModel::addFeature( GeoDataContainer *parent, GeoDataFeature *feat
             }
             beginInsertRows( modelindex , row , row );
             parent->insert( feature, row );
+            d->m_rows.insert( feature, row );
             d->checkParenting( parent );
             endInsertRows();
             emit added(feature);
@@ -603,6 +595,12 @@ bool GeoDataTreeModel::removeFeature( GeoDataContainer *parent, int row )
         beginRemoveRows( index( parent ), row , row );
         GeoDataFeature *feature = parent->child( row );
         parent->remove( row );
+        if ( isContainerType( feature->nodeType() ) ) {
+            // forget the rows of the whole subtree
+            d->m_rows.clear();
+        } else {
+            d->m_rows.remove( feature );
+        }
         emit removed(feature);
         endRemoveRows();
         return true;
@@ -619,10 +617,9 @@ int GeoDataTreeModel::removeFeature( const GeoDataFeature *feature )
 
         GeoDataObject *parent = static_cast< GeoDataObject* >( feature->parent() );
 
-        if ( ( parent->nodeType() == GeoDataTypes::GeoDataFolderType )
-            || ( parent->nodeType() == GeoDataTypes::GeoDataDocumentType ) ) {
+        if ( isContainerType( parent->nodeType() ) ) {
 
-            int row = static_cast< GeoDataContainer* >( feature->parent() )->childPosition( feature );
+            int row = d->row( feature );
             if ( row != -1 ) {
                 bool removed = removeFeature( static_cast< GeoDataContainer* >( feature->parent() ) , row );
                 if( removed ) {
@@ -656,6 +653,7 @@ void GeoDataTreeModel::removeDocument( GeoDataDocument *document )
 void GeoDataTreeModel::update()
 {
 //    mDebug() << "updating GeoDataTreeModel";
+    d->m_rows.clear();
     reset();
 }
 
@@ -668,6 +666,7 @@ void GeoDataTreeModel::setRootDocument( GeoDataDocument* document )
 
     d->m_ownsRootDocument = ( document == 0 );
     d->m_rootDocument = document ? document : new GeoDataDocument;
+    d->m_rows.clear();
     endResetModel();
 }
 
@@ -12,9 +12,12 @@
 
 #include "HttpDownloadManager.h"
 
+#include <QtCore/QHash>
 #include <QtCore/QList>
 #include <QtCore/QMap>
+#include <QtCore/QStringList>
 #include <QtCore/QTimer>
+#include <QtCore/qmath.h>
 #include <QtNetwork/QNetworkAccessManager>
 
 #include "DownloadPolicy.h"
@@ -28,7 +31,27 @@ using namespace Marble;
 // Time before a failed download job is requeued in ms
 const quint32 requeueTime = 60000;
 
-class HttpDownloadManager::Private
+// Browse downloads of tiles further away from the focus than the visible
+// radius plus this margin (in tiles), or more than one level apart, are canceled
+const qreal obsoleteTileMargin = 2.0;
+const int maximumTileLevelDelta = 1;
+// Tiles of another level than the focused one are downloaded after all
+// tiles of the focused level
+const qreal tileLevelDeltaPriority = 1e6;
+
+namespace
+{
+struct TileFocus
+{
+    int level;
+    int columns;
+    qreal x;
+    qreal y;
+    qreal radius;
+};
+}
+
+class HttpDownloadManager::Private : public DownloadPrioritizer
 {
   public:
     explicit Private( StoragePolicy *policy );
@@ -36,6 +59,15 @@ class HttpDownloadManager::Private
 
     DownloadQueueSet *findQueues( const QString& hostName, const DownloadUsage usage );
 
+    qreal priority( const HttpJob *job ) const;
+    bool isObsolete( const HttpJob *job ) const;
+
+    /**
+     * Returns whether @p job downloads a tile near a focus, as well as the
+     * tile level difference and the distance in tiles to it.
+     */
+    bool tileDistance( const HttpJob *job, int &levelDelta, qreal &distance, qreal &radius ) const;
+
     bool m_downloadEnabled;
     QTimer *m_requeueTimer;
     /**
@@ -47,6 +79,7 @@ class HttpDownloadManager::Private
     QMap<DownloadUsage, DownloadQueueSet *> m_defaultQueueSets;
     StoragePolicy *const m_storagePolicy;
     QNetworkAccessManager m_networkAccessManager;
+    QHash<QString, TileFocus> m_tileFocus;
 
 };
 
@@ -94,6 +127,65 @@ DownloadQueueSet *HttpDownloadManager::Private::findQueues( const QString& hostN
 }
 
 
+qreal HttpDownloadManager::Private::priority( const HttpJob *job ) const
+{
+    int levelDelta;
+    qreal distance;
+    qreal radius;
+    if ( !tileDistance( job, levelDelta, distance, radius ) )
+        return 0;
+
+    return levelDelta * tileLevelDeltaPriority + distance;
+}
+
+bool HttpDownloadManager::Private::isObsolete( const HttpJob *job ) const
+{
+    int levelDelta;
+    qreal distance;
+    qreal radius;
+    if ( !tileDistance( job, levelDelta, distance, radius ) )
+        return false;
+
+    return levelDelta > maximumTileLevelDelta || distance > radius + obsoleteTileMargin;
+}
+
+bool HttpDownloadManager::Private::tileDistance( const HttpJob *job, int &levelDelta,
+                                                 qreal &distance, qreal &radius ) const
+{
+    // Bulk downloads keep their order and are never canceled
+    if ( job->downloadUsage() != DownloadBrowse )
+        return false;
+
+    // Tile jobs are identified by "sourceDir:level:x:y", see TileLoader
+    const QStringList components = job->initiatorId().split( ':' );
+    if ( components.size() != 4 )
+        return false;
+
+    QHash<QString, TileFocus>::const_iterator const pos = m_tileFocus.constFind( components.at( 0 ) );
+    if ( pos == m_tileFocus.constEnd() )
+        return false;
+
+    bool levelOk, xOk, yOk;
+    const int level = components.at( 1 ).toInt( &levelOk );
+    const int x = components.at( 2 ).toInt( &xOk );
+    const int y = components.at( 3 ).toInt( &yOk );
+    if ( !levelOk || !xOk || !yOk )
+        return false;
+
+    // Scale the focus to the level of the tile
+    const TileFocus &focus = pos.value();
+    const qreal scale = qPow( 2.0, level - focus.level );
+    levelDelta = qAbs( level - focus.level );
+    // The columns wrap around at the date line
+    const qreal dx = qAbs( x + 0.5 - focus.x * scale );
+    const qreal wrappedDx = qMin( dx, qAbs( focus.columns * scale - dx ) );
+    distance = qSqrt( qPow( wrappedDx, 2 ) + qPow( y + 0.5 - focus.y * scale, 2 ) );
+    radius = focus.radius * scale;
+
+    return true;
+}
+
+
 HttpDownloadManager::HttpDownloadManager( StoragePolicy *policy )
     : d( new Private( policy ) )
 {
@@ -129,6 +221,25 @@ void HttpDownloadManager::addDownloadPolicy( const DownloadPolicy& policy )
                            ( queueSet->downloadPolicy().key(), queueSet ));
 }
 
+void HttpDownloadManager::setTileFocus( const QString &sourceDir, int tileLevel, int tileColumns,
+                                        qreal x, qreal y, qreal radius )
+{
+    TileFocus focus;
+    focus.level = tileLevel;
+    focus.columns = tileColumns;
+    focus.x = x;
+    focus.y = y;
+    focus.radius = radius;
+    d->m_tileFocus[ sourceDir ] = focus;
+
+    QList<QPair<DownloadPolicyKey, DownloadQueueSet *> >::iterator pos = d->m_queueSets.begin();
+    QList<QPair<DownloadPolicyKey, DownloadQueueSet *> >::iterator const end = d->m_queueSets.end();
+    for (; pos != end; ++pos ) {
+        (*pos).second->reprioritize();
+    }
+    d->m_defaultQueueSets[ DownloadBrowse ]->reprioritize();
+}
+
 void HttpDownloadManager::addJob( const QUrl& sourceUrl, const QString& destFileName,
                                   const QString &id, const DownloadUsage usage )
 {
@@ -140,17 +251,33 @@ void HttpDownloadManager::addJob( const QUrl& sourceUrl, const QString& destFile
         HttpJob * const job = new HttpJob( sourceUrl, destFileName, id, &d->m_networkAccessManager );
         job->setUserAgentPluginId( "QNamNetworkPlugin" );
         job->setDownloadUsage( usage );
+        // An expired or reloaded file is only transferred again if it changed on the server
+        if ( d->m_storagePolicy ) {
+            job->setIfModifiedSince( d->m_storagePolicy->lastModified( destFileName ) );
+            job->setIfNoneMatch( d->m_storagePolicy->metaData( destFileName ).eTag() );
+        }
         queueSet->addJob( job );
     }
 }
 
+void HttpDownloadManager::accessFile( const QString &fileName )
+{
+    if ( d->m_storagePolicy )
+        d->m_storagePolicy->accessFile( fileName );
+}
+
 void HttpDownloadManager::finishJob( const QByteArray& data, const QString& destinationFileName,
-                                     const QString& id )
+                                     const QString& id, const TileMetaData& metaData )
 {
     mDebug() << "emitting downloadComplete( QByteArray, " << id << ")";
     emit downloadComplete( data, id );
     if ( d->m_storagePolicy ) {
         const bool saved = d->m_storagePolicy->updateFile( destinationFileName, data );
+        if ( saved && !d->m_storagePolicy->updateMetaData( destinationFileName, metaData ) ) {
+            // The meta data of the previous download would mark the new file as expired
+            qWarning() << "Could not save:" << TileMetaData::metaDataFileName( destinationFileName );
+            d->m_storagePolicy->removeFile( TileMetaData::metaDataFileName( destinationFileName ) );
+        }
         if ( saved ) {
             mDebug() << "emitting downloadComplete( " << destinationFileName << ", " << id << ")";
             emit downloadComplete( destinationFileName, id );
@@ -160,6 +287,47 @@ void HttpDownloadManager::finishJob( const QByteArray& data, const QString& dest
     }
 }
 
+void HttpDownloadManager::refreshJob( const QString& destinationFileName, const QString& id,
+                                      const TileMetaData& metaData )
+{
+    if ( !d->m_storagePolicy )
+        return;
+
+    if ( !d->m_storagePolicy->lastModified( destinationFileName ).isValid() ) {
+        qWarning() << "Not modified, but not stored anymore:" << destinationFileName;
+        return;
+    }
+
+    // The stored copy is shown already, only its new expiry time is stored
+    if ( d->m_storagePolicy->updateMetaData( destinationFileName, metaData ) ) {
+        emit downloadComplete( destinationFileName, id );
+    } else {
+        qWarning() << "Could not save:" << TileMetaData::metaDataFileName( destinationFileName );
+    }
+}
+
+QMap<QString, DownloadStatistics> HttpDownloadManager::hostStatistics() const
+{
+    QList<DownloadQueueSet *> queueSets = d->m_defaultQueueSets.values();
+    QList<QPair<DownloadPolicyKey, DownloadQueueSet *> >::const_iterator pos = d->m_queueSets.constBegin();
+    QList<QPair<DownloadPolicyKey, DownloadQueueSet *> >::const_iterator const end = d->m_queueSets.constEnd();
+    for (; pos != end; ++pos ) {
+        queueSets.append( (*pos).second );
+    }
+
+    QMap<QString, DownloadStatistics> result;
+    foreach ( const DownloadQueueSet *queueSet, queueSets ) {
+        const QHash<QString, DownloadStatistics> statistics = queueSet->statistics();
+        QHash<QString, DownloadStatistics>::const_iterator it = statistics.constBegin();
+        QHash<QString, DownloadStatistics>::const_iterator const itEnd = statistics.constEnd();
+        for (; it != itEnd; ++it ) {
+            result[ it.key() ] += it.value();
+        }
+    }
+
+    return result;
+}
+
 void HttpDownloadManager::requeue()
 {
     d->m_requeueTimer->stop();
@@ -187,11 +355,16 @@ void HttpDownloadManager::connectDefaultQueueSets()
 
 void HttpDownloadManager::connectQueueSet( DownloadQueueSet * queueSet )
 {
-    connect( queueSet, SIGNAL(jobFinished(QByteArray,QString,QString)),
-             SLOT(finishJob(QByteArray,QString,QString)));
+    queueSet->setPrioritizer( d );
+    connect( queueSet, SIGNAL(jobFinished(QByteArray,QString,QString,TileMetaData)),
+             SLOT(finishJob(QByteArray,QString,QString,TileMetaData)));
+    connect( queueSet, SIGNAL(jobNotModified(QString,QString,TileMetaData)),
+             SLOT(refreshJob(QString,QString,TileMetaData)));
     connect( queueSet, SIGNAL(jobRetry()), SLOT(startRetryTimer()));
     connect( queueSet, SIGNAL(jobRedirected(QUrl,QString,QString,DownloadUsage)),
              SLOT(addJob(QUrl,QString,QString,DownloadUsage)));
+    connect( queueSet, SIGNAL(jobCanceled(QString,QString)),
+             SIGNAL(downloadCanceled(QString,QString)));
     // relay jobAdded/jobRemoved signals (interesting for progress bar)
     connect( queueSet, SIGNAL(jobAdded()), SIGNAL(jobAdded()));
     connect( queueSet, SIGNAL(jobRemoved()), SIGNAL(jobRemoved()));
@@ -17,9 +17,12 @@
 #ifndef MARBLE_HTTPDOWNLOADMANAGER_H
 #define MARBLE_HTTPDOWNLOADMANAGER_H
 
+#include <QtCore/QMap>
 #include <QtCore/QObject>
 
+#include "DownloadStatistics.h"
 #include "MarbleGlobal.h"
+#include "TileMetaData.h"
 #include "marble_export.h"
 
 class QUrl;
@@ -66,6 +69,24 @@ class MARBLE_EXPORT HttpDownloadManager : public QObject
     void setDownloadEnabled( const bool enable );
     void addDownloadPolicy( const DownloadPolicy& );
 
+    /**
+     * Sets the position the user looks at in the tiles of @p sourceDir.
+     * Browse downloads of tiles close to it are started first, those
+     * of tiles out of sight are canceled.
+     *
+     * @param tileLevel The tile level shown
+     * @param tileColumns The number of tile columns of @p tileLevel, after which they wrap around
+     * @param x The horizontal position in tiles of @p tileLevel
+     * @param y The vertical position in tiles of @p tileLevel
+     * @param radius The distance in tiles up to which tiles are visible
+     */
+    void setTileFocus( const QString &sourceDir, int tileLevel, int tileColumns, qreal x, qreal y, qreal radius );
+
+    /**
+     * Returns the statistics of the downloads since the start by host name.
+     */
+    QMap<QString, DownloadStatistics> hostStatistics() const;
+
  public Q_SLOTS:
 
     /**
@@ -74,6 +95,11 @@ class MARBLE_EXPORT HttpDownloadManager : public QObject
     void addJob( const QUrl& sourceUrl, const QString& destFilename, const QString &id,
                  const DownloadUsage usage );
 
+    /**
+     * Tells the storage policy that the stored file @p fileName has been read.
+     */
+    void accessFile( const QString &fileName );
+
 
  Q_SIGNALS:
     void downloadComplete( QString, QString );
@@ -85,6 +111,12 @@ class MARBLE_EXPORT HttpDownloadManager : public QObject
      */
     void downloadComplete( QByteArray data, QString initiatorId );
 
+    /**
+     * This signal is emitted if the download of a file has been canceled
+     * because it is not needed anymore, see setTileFocus().
+     */
+    void downloadCanceled( QString destinationFileName, QString initiatorId );
+
     /**
      * Signal is emitted when a new job is added to the queue.
      */
@@ -103,7 +135,9 @@ class MARBLE_EXPORT HttpDownloadManager : public QObject
 
  private Q_SLOTS:
     void finishJob( const QByteArray& data, const QString& destinationFileName,
-		    const QString& id );
+		    const QString& id, const TileMetaData& metaData );
+    void refreshJob( const QString& destinationFileName, const QString& id,
+                     const TileMetaData& metaData );
     void requeue();
     void startRetryTimer();
 
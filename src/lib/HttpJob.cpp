@@ -16,6 +16,8 @@
 #include "MarbleDebug.h"
 #include "TinyWebBrowser.h"
 
+#include <QtCore/QLocale>
+#include <QtCore/QTime>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkReply>
 
@@ -35,6 +37,14 @@ class Marble::HttpJobPrivate
     QString m_pluginId;
     QNetworkAccessManager *const m_networkAccessManager;
     QNetworkReply *m_networkReply;
+    QDateTime      m_ifModifiedSince;
+    QByteArray     m_ifNoneMatch;
+    TileMetaData   m_metaData;
+    QTime          m_requestTime;
+    int            m_latency;
+    int            m_transferTime;
+    // the received content, read from the reply as it arrives
+    QByteArray     m_data;
 };
 
 HttpJobPrivate::HttpJobPrivate( const QUrl & sourceUrl, const QString & destFileName,
@@ -48,7 +58,14 @@ HttpJobPrivate::HttpJobPrivate( const QUrl & sourceUrl, const QString & destFile
       // results in valid user agent string
       m_pluginId( "unknown" ),
       m_networkAccessManager( networkAccessManager ),
-      m_networkReply( 0 )
+      m_networkReply( 0 ),
+      m_ifModifiedSince(),
+      m_ifNoneMatch(),
+      m_metaData(),
+      m_requestTime(),
+      m_latency( -1 ),
+      m_transferTime( -1 ),
+      m_data()
 {
 }
 
@@ -60,6 +77,7 @@ HttpJob::HttpJob( const QUrl & sourceUrl, const QString & destFileName, const QS
 
 HttpJob::~HttpJob()
 {
+    abort();
     delete d;
 }
 
@@ -134,20 +152,85 @@ QByteArray HttpJob::userAgent() const
     }
 }
 
+void HttpJob::setIfModifiedSince( const QDateTime &lastModified )
+{
+    d->m_ifModifiedSince = lastModified;
+}
+
+QDateTime HttpJob::ifModifiedSince() const
+{
+    return d->m_ifModifiedSince;
+}
+
+void HttpJob::setIfNoneMatch( const QByteArray &eTag )
+{
+    d->m_ifNoneMatch = eTag;
+}
+
+QByteArray HttpJob::ifNoneMatch() const
+{
+    return d->m_ifNoneMatch;
+}
+
+TileMetaData HttpJob::metaData() const
+{
+    return d->m_metaData;
+}
+
+int HttpJob::latency() const
+{
+    return d->m_latency;
+}
+
+int HttpJob::transferTime() const
+{
+    return d->m_transferTime;
+}
+
 void HttpJob::execute()
 {
     QNetworkRequest request( d->m_sourceUrl );
     request.setAttribute( QNetworkRequest::HttpPipeliningAllowedAttribute, true );
     request.setRawHeader( "User-Agent", userAgent() );
+    if ( d->m_ifModifiedSince.isValid() ) {
+        // HTTP dates are always in GMT and use English names (RFC 2616, section 3.3.1)
+        const QString date = QLocale::c().toString( d->m_ifModifiedSince.toUTC(),
+                                                    "ddd, dd MMM yyyy hh:mm:ss 'GMT'" );
+        request.setRawHeader( "If-Modified-Since", date.toLatin1() );
+    }
+    if ( !d->m_ifNoneMatch.isEmpty() )
+        request.setRawHeader( "If-None-Match", d->m_ifNoneMatch );
+    d->m_latency = -1;
+    d->m_transferTime = -1;
+    d->m_data.clear();
+    d->m_metaData = TileMetaData();
+    d->m_requestTime.start();
     d->m_networkReply = d->m_networkAccessManager->get( request );
 
     connect( d->m_networkReply, SIGNAL(downloadProgress(qint64,qint64)),
              SLOT(downloadProgress(qint64,qint64)));
     connect( d->m_networkReply, SIGNAL(error(QNetworkReply::NetworkError)),
              SLOT(error(QNetworkReply::NetworkError)));
+    connect( d->m_networkReply, SIGNAL(metaDataChanged()),
+             SLOT(receiveMetaData()));
+    connect( d->m_networkReply, SIGNAL(readyRead()),
+             SLOT(receiveData()));
     connect( d->m_networkReply, SIGNAL(finished()),
              SLOT(finished()));
 }
+
+void HttpJob::abort()
+{
+    if ( !d->m_networkReply )
+        return;
+
+    d->m_networkReply->disconnect( this );
+    d->m_networkReply->abort();
+    d->m_networkReply->deleteLater();
+    d->m_networkReply = 0;
+    d->m_data.clear();
+}
+
 void HttpJob::downloadProgress( qint64 bytesReceived, qint64 bytesTotal )
 {
     Q_UNUSED(bytesReceived);
@@ -156,6 +239,71 @@ void HttpJob::downloadProgress( qint64 bytesReceived, qint64 bytesTotal )
 //              << bytesReceived << '/' << bytesTotal;
 }
 
+void HttpJob::receiveMetaData()
+{
+    if ( d->m_latency < 0 )
+        d->m_latency = d->m_requestTime.elapsed();
+
+    // Allocate the content only once
+    bool ok;
+    const int contentLength = d->m_networkReply->header( QNetworkRequest::ContentLengthHeader ).toInt( &ok );
+    if ( ok && contentLength > d->m_data.capacity() )
+        d->m_data.reserve( contentLength );
+}
+
+void HttpJob::receiveData()
+{
+    // Read the content directly into its final buffer instead of letting the
+    // reply accumulate it and copying it all at once in finished()
+    const qint64 available = d->m_networkReply->bytesAvailable();
+    if ( available <= 0 )
+        return;
+
+    const int size = d->m_data.size();
+    d->m_data.resize( size + available );
+    const qint64 read = d->m_networkReply->read( d->m_data.data() + size, available );
+    d->m_data.resize( size + qMax<qint64>( 0, read ) );
+}
+
+void HttpJob::updateMetaData()
+{
+    const QDateTime now = QDateTime::currentDateTime().toUTC();
+    d->m_metaData = TileMetaData();
+    d->m_metaData.setFetchTime( now );
+
+    // A "not modified" response does not need to repeat the entity tag
+    const QByteArray eTag = d->m_networkReply->rawHeader( "ETag" );
+    d->m_metaData.setETag( eTag.isEmpty() ? d->m_ifNoneMatch : eTag );
+
+    // Cache-Control takes precedence over Expires (RFC 2616, section 14.9.3)
+    const QList<QByteArray> directives = d->m_networkReply->rawHeader( "Cache-Control" ).toLower().split( ',' );
+    foreach ( const QByteArray &directive, directives ) {
+        const QByteArray value = directive.trimmed();
+        if ( value == "no-cache" || value == "no-store" ) {
+            d->m_metaData.setExpiry( now );
+            return;
+        }
+        if ( value.startsWith( "max-age=" ) ) {
+            bool ok;
+            const int maxAge = value.mid( 8 ).toInt( &ok );
+            const int age = d->m_networkReply->rawHeader( "Age" ).trimmed().toInt();
+            if ( ok ) {
+                d->m_metaData.setExpiry( now.addSecs( qMax( 0, maxAge - age ) ) );
+                return;
+            }
+        }
+    }
+
+    const QByteArray expires = d->m_networkReply->rawHeader( "Expires" ).trimmed();
+    if ( !expires.isEmpty() ) {
+        // Invalid dates like "0" mean "already expired"
+        QDateTime expiry = QLocale::c().toDateTime( QString::fromLatin1( expires ),
+                                                    "ddd, dd MMM yyyy hh:mm:ss 'GMT'" );
+        expiry.setTimeSpec( Qt::UTC );
+        d->m_metaData.setExpiry( expiry.isValid() ? expiry : now );
+    }
+}
+
 void HttpJob::error( QNetworkReply::NetworkError code )
 {
     mDebug() << "error" << destinationFileName() << code;
@@ -164,6 +312,9 @@ void HttpJob::error( QNetworkReply::NetworkError code )
 void HttpJob::finished()
 {
     QNetworkReply::NetworkError const error = d->m_networkReply->error();
+    d->m_transferTime = d->m_requestTime.elapsed();
+    if ( d->m_latency < 0 )
+        d->m_latency = d->m_transferTime;
 //     mDebug() << "finished" << destinationFileName()
 //              << "error" << error;
 
@@ -177,12 +328,22 @@ void HttpJob::finished()
         // check if we are redirected
         const QVariant redirectionAttribute =
             d->m_networkReply->attribute( QNetworkRequest::RedirectionTargetAttribute );
+        const int statusCode =
+            d->m_networkReply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
         if ( !redirectionAttribute.isNull() ) {
             emit redirected( this, redirectionAttribute.toUrl() );
         }
+        else if ( statusCode == 304 ) {
+            // the copy we have is still up to date
+            updateMetaData();
+            emit notModified( this );
+        }
         else {
             // no redirection occurred
-            const QByteArray data = d->m_networkReply->readAll();
+            receiveData();
+            updateMetaData();
+            const QByteArray data = d->m_data;
+            d->m_data.clear();
             emit dataReceived( this, data );
         }
     }
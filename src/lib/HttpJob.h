@@ -15,12 +15,14 @@
 #define MARBLE_HTTPJOB_H
 
 #include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
 #include <QtCore/QObject>
 #include <QtCore/QString>
 #include <QtCore/QUrl>
 #include <QtNetwork/QNetworkReply>
 
 #include "MarbleGlobal.h"
+#include "TileMetaData.h"
 
 #include "marble_export.h"
 
@@ -56,6 +58,37 @@ class MARBLE_EXPORT HttpJob: public QObject
 
     QByteArray userAgent() const;
 
+    /**
+     * Makes the request conditional: if the resource has not changed since
+     * @p lastModified, the server only confirms it and notModified() is emitted.
+     */
+    void setIfModifiedSince( const QDateTime &lastModified );
+    QDateTime ifModifiedSince() const;
+
+    /**
+     * Makes the request conditional on the entity tag @p eTag of the stored copy.
+     */
+    void setIfNoneMatch( const QByteArray &eTag );
+    QByteArray ifNoneMatch() const;
+
+    /**
+     * Returns the fetch time, entity tag and expiry time of the response,
+     * valid once the job is done.
+     */
+    TileMetaData metaData() const;
+
+    /**
+     * Returns the time in milliseconds from sending the request until
+     * the response headers arrived, or -1 if they didn't arrive yet.
+     */
+    int latency() const;
+
+    /**
+     * Returns the time in milliseconds from sending the request until
+     * the response was complete, or -1 if it isn't complete yet.
+     */
+    int transferTime() const;
+
  Q_SIGNALS:
     /**
      * errorCode contains 0, if there was no error and 1 otherwise
@@ -69,16 +102,36 @@ class MARBLE_EXPORT HttpJob: public QObject
      */
     void dataReceived( HttpJob * job, QByteArray data );
 
+    /**
+     * This signal is emitted if the server confirmed that the resource
+     * did not change since the time set by setIfModifiedSince() or
+     * setIfNoneMatch().
+     */
+    void notModified( HttpJob * job );
+
  public Q_SLOTS:
     void execute();
 
+    /**
+     * Aborts a running download without emitting any of the job's signals.
+     */
+    void abort();
+
 private Q_SLOTS:
    void downloadProgress( qint64 bytesReceived, qint64 bytesTotal );
+   void receiveMetaData();
+   void receiveData();
    void error( QNetworkReply::NetworkError code );
    void finished();
 
  private:
     Q_DISABLE_COPY( HttpJob )
+
+    /**
+     * Reads the freshness information from the headers of the reply.
+     */
+    void updateMetaData();
+
     HttpJobPrivate *const d;
     friend class HttpJobPrivate;
 };
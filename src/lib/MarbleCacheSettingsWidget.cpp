@@ -12,10 +12,15 @@
 #include "MarbleCacheSettingsWidget.h"
 
 #include <QtGui/QPushButton>
+#include <QtGui/QTreeWidgetItem>
+
+#include "HttpDownloadManager.h"
 
 using namespace Marble;
 
-MarbleCacheSettingsWidget::MarbleCacheSettingsWidget( QWidget *parent ) : QWidget( parent )
+MarbleCacheSettingsWidget::MarbleCacheSettingsWidget( QWidget *parent )
+    : QWidget( parent ),
+      m_downloadManager( 0 )
 {
     setupUi( this );
 
@@ -23,6 +28,46 @@ MarbleCacheSettingsWidget::MarbleCacheSettingsWidget( QWidget *parent ) : QWidge
     connect( button_clearPersistentCache, SIGNAL(clicked()), SIGNAL(clearPersistentCache()) );
     connect( kcfg_proxyAuth, SIGNAL(toggled(bool)), kcfg_proxyUser, SLOT(setEnabled(bool)) );
     connect( kcfg_proxyAuth, SIGNAL(toggled(bool)), kcfg_proxyPass, SLOT(setEnabled(bool)) );
+
+    groupBox_downloads->setVisible( false );
+}
+
+void MarbleCacheSettingsWidget::setDownloadManager( const HttpDownloadManager *downloadManager )
+{
+    m_downloadManager = downloadManager;
+    groupBox_downloads->setVisible( m_downloadManager != 0 );
+    updateHostStatistics();
+}
+
+void MarbleCacheSettingsWidget::updateHostStatistics()
+{
+    treeWidget_hostStatistics->clear();
+    if ( !m_downloadManager )
+        return;
+
+    const QMap<QString, DownloadStatistics> statistics = m_downloadManager->hostStatistics();
+    QMap<QString, DownloadStatistics>::const_iterator pos = statistics.constBegin();
+    QMap<QString, DownloadStatistics>::const_iterator const end = statistics.constEnd();
+    for (; pos != end; ++pos ) {
+        const DownloadStatistics &host = pos.value();
+        QTreeWidgetItem *item = new QTreeWidgetItem( treeWidget_hostStatistics );
+        item->setText( 0, pos.key() );
+        item->setText( 1, QString::number( host.requests() ) );
+        item->setText( 2, QString::number( host.notModified() ) );
+        item->setText( 3, QString::number( host.failures() ) );
+        item->setText( 4, tr( "%1 MB" ).arg( host.bytes() / ( 1024.0 * 1024.0 ), 0, 'f', 1 ) );
+        item->setText( 5, tr( "%1 kB/s" ).arg( host.throughput() / 1024.0, 0, 'f', 1 ) );
+        item->setText( 6, tr( "%1 ms" ).arg( qRound( host.averageLatency() ) ) );
+        for ( int column = 1; column < item->columnCount(); ++column ) {
+            item->setTextAlignment( column, Qt::AlignRight | Qt::AlignVCenter );
+        }
+    }
+}
+
+void MarbleCacheSettingsWidget::showEvent( QShowEvent *event )
+{
+    updateHostStatistics();
+    QWidget::showEvent( event );
 }
 
 #include "MarbleCacheSettingsWidget.moc"
@@ -28,6 +28,8 @@
 namespace Marble
 {
 
+class HttpDownloadManager;
+
 /** 
  * @short A public class that adds methods to the UI Cache Settings Widget.
  *
@@ -40,10 +42,23 @@ class MARBLE_EXPORT MarbleCacheSettingsWidget : public QWidget, public Ui::Marbl
  public:
     explicit MarbleCacheSettingsWidget( QWidget *parent = 0 );
 
+    /**
+     * Sets the download manager whose host statistics are shown.
+     */
+    void setDownloadManager( const HttpDownloadManager *downloadManager );
+
+ public Q_SLOTS:
+    void updateHostStatistics();
 
  Q_SIGNALS:
     void clearVolatileCache();
     void clearPersistentCache();
+
+ protected:
+    void showEvent( QShowEvent *event );
+
+ private:
+    const HttpDownloadManager *m_downloadManager;
 };
 
 }
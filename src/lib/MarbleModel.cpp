@@ -51,7 +51,7 @@
 
 #include "DgmlAuxillaryDictionary.h"
 #include "MarbleClock.h"
-#include "FileStoragePolicy.h"
+#include "PackedStoragePolicy.h"
 #include "FileStorageWatcher.h"
 #include "PositionTracking.h"
 #include "HttpDownloadManager.h"
@@ -60,6 +60,7 @@
 #include "GeoDataTreeModel.h"
 #include "Planet.h"
 #include "PluginManager.h"
+#include "SharedTileCache.h"
 #include "StoragePolicy.h"
 #include "SunLocator.h"
 #include "TileCreator.h"
@@ -126,7 +127,7 @@ class MarbleModelPrivate
     // View and paint stuff
     GeoSceneDocument        *m_mapTheme;
 
-    FileStoragePolicy        m_storagePolicy;
+    PackedStoragePolicy      m_storagePolicy;
     HttpDownloadManager      m_downloadManager;
 
     // Cache related
@@ -178,8 +179,10 @@ MarbleModel::MarbleModel( QObject *parent )
     // connect the StoragePolicy used by the download manager to the FileStorageWatcher
     connect( &d->m_storagePolicy, SIGNAL(cleared()),
              &d->m_storageWatcher, SLOT(resetCurrentSize()) );
-    connect( &d->m_storagePolicy, SIGNAL(sizeChanged(qint64)),
-             &d->m_storageWatcher, SLOT(addToCurrentSize(qint64)) );
+    connect( &d->m_storagePolicy, SIGNAL(fileUpdated(QString,qint64)),
+             &d->m_storageWatcher, SLOT(addFile(QString,qint64)) );
+    connect( &d->m_storagePolicy, SIGNAL(fileAccessed(QString)),
+             &d->m_storageWatcher, SLOT(accessFile(QString)) );
 
     d->m_fileManager = new FileManager( this );
 
@@ -493,6 +496,11 @@ quint64 MarbleModel::persistentTileCacheLimit() const
     return d->m_storageWatcher.cacheLimit() / 1024;
 }
 
+quint64 MarbleModel::sharedTileCacheLimit() const
+{
+    return SharedTileCache::globalLimit() / 1024;
+}
+
 void MarbleModel::clearPersistentTileCache()
 {
     d->m_storagePolicy.clearCache();
@@ -554,6 +562,11 @@ void MarbleModel::setPersistentTileCacheLimit(quint64 kiloBytes)
     // TODO: trigger update
 }
 
+void MarbleModel::setSharedTileCacheLimit( quint64 kiloBytes )
+{
+    SharedTileCache::setGlobalLimit( kiloBytes * 1024 );
+}
+
 void MarbleModel::setTrackedPlacemark( const GeoDataPlacemark *placemark )
 {
     d->m_trackedPlacemark = placemark;
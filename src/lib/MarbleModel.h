@@ -239,6 +239,12 @@ class MARBLE_EXPORT MarbleModel : public QObject
      */
     quint64 persistentTileCacheLimit() const;
 
+    /**
+     * @brief  Returns the limit in kilobytes of the tile cache shared with other Marble processes.
+     * @return the limit of the shared tile cache in kilobytes, 0 if it is disabled.
+     */
+    quint64 sharedTileCacheLimit() const;
+
     /**
      * @brief  Returns the limit of the volatile (in RAM) tile cache.
      * @return the cache limit in kilobytes
@@ -302,6 +308,13 @@ class MARBLE_EXPORT MarbleModel : public QObject
      */
     void setPersistentTileCacheLimit( quint64 kiloBytes );
 
+    /**
+     * @brief  Set the limit of the tile cache shared with other Marble processes.
+     * @param  kiloBytes The limit in kilobytes, 0 disables the shared cache.
+     * The limit only applies if no other process created the cache already.
+     */
+    void setSharedTileCacheLimit( quint64 kiloBytes );
+
     /**
      * @brief Change the placemark tracked by this model
      * @see trackedPlacemark(), trackedPlacemarkChanged()
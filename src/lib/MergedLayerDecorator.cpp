@@ -124,10 +124,12 @@ StackedTile *MergedLayerDecorator::Private::createTile( const QVector<QSharedPoi
         }
         else {
             mDebug() << Q_FUNC_INFO << "no blending defined => copying top over bottom image";
+            // Both share the pixels if the tile has the right format already, e.g.
+            // pre-decoded tiles mapped from disk; painting on them detaches them
             if ( withConversion ) {
                 resultImage = tile->image()->convertToFormat( QImage::Format_ARGB32_Premultiplied );
             } else {
-                resultImage = tile->image()->copy();
+                resultImage = *tile->image();
             }
         }
     }
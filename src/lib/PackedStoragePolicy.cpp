@@ -0,0 +1,94 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "PackedStoragePolicy.h"
+
+#include <QtCore/QFileInfo>
+
+#include "MarbleDebug.h"
+#include "MarbleDirs.h"
+#include "MarbleGlobal.h"
+#include "TilePack.h"
+
+using namespace Marble;
+
+PackedStoragePolicy::PackedStoragePolicy( const QString &dataDirectory, QObject *parent )
+    : FileStoragePolicy( dataDirectory, parent ),
+      m_dataDirectory( dataDirectory )
+{
+    if ( m_dataDirectory.isEmpty() )
+        m_dataDirectory = MarbleDirs::localPath() + "/cache/";
+}
+
+PackedStoragePolicy::~PackedStoragePolicy()
+{
+}
+
+bool PackedStoragePolicy::fileExists( const QString &fileName ) const
+{
+    QString key;
+    TilePack *const pack = TilePack::find( absoluteFileName( fileName ), &key );
+    if ( pack && pack->contains( key ) )
+        return true;
+
+    return FileStoragePolicy::fileExists( fileName );
+}
+
+bool PackedStoragePolicy::updateFile( const QString &fileName, const QByteArray &data )
+{
+    QString key;
+    TilePack *const pack = TilePack::find( absoluteFileName( fileName ), &key );
+    if ( !pack || !pack->isWritable() )
+        return FileStoragePolicy::updateFile( fileName, data );
+
+    // Replaced tiles stay in the pack until it is compacted, so the pack grows by the full size
+    pack->insert( key, data );
+    emit sizeChanged( data.size() );
+    emit fileUpdated( pack->fileName(), pack->size() );
+
+    return true;
+}
+
+QDateTime PackedStoragePolicy::lastModified( const QString &fileName ) const
+{
+    QString key;
+    TilePack *const pack = TilePack::find( absoluteFileName( fileName ), &key );
+    if ( pack && pack->contains( key ) )
+        return pack->lastModified( key );
+
+    return FileStoragePolicy::lastModified( fileName );
+}
+
+QByteArray PackedStoragePolicy::fileData( const QString &fileName ) const
+{
+    QString key;
+    TilePack *const pack = TilePack::find( absoluteFileName( fileName ), &key );
+    if ( pack && pack->contains( key ) )
+        return pack->data( key );
+
+    return FileStoragePolicy::fileData( fileName );
+}
+
+void PackedStoragePolicy::clearCache()
+{
+    FileStoragePolicy::clearCache();
+
+    foreach ( TilePack *pack, TilePack::packs() ) {
+        const qint64 freed = pack->clear( maxBaseTileLevel );
+        mDebug() << "Cleared" << freed << "bytes from the tile pack in" << pack->directory();
+        emit sizeChanged( -freed );
+    }
+}
+
+QString PackedStoragePolicy::absoluteFileName( const QString &fileName ) const
+{
+    QFileInfo const dirInfo( fileName );
+    return dirInfo.isAbsolute() ? fileName : m_dataDirectory + '/' + fileName;
+}
+
+#include "PackedStoragePolicy.moc"
@@ -0,0 +1,60 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_PACKEDSTORAGEPOLICY_H
+#define MARBLE_PACKEDSTORAGEPOLICY_H
+
+#include "FileStoragePolicy.h"
+
+namespace Marble
+{
+
+/**
+ * @short Storage policy writing the tiles of packed map themes into their TilePack.
+ *
+ * Files below the directory of an opened TilePack are stored in the pack,
+ * all other files are handled like by the FileStoragePolicy.
+ */
+class PackedStoragePolicy : public FileStoragePolicy
+{
+    Q_OBJECT
+
+    public:
+        /**
+         * Creates a new packed storage policy.
+         *
+         * @param dataDirectory The directory where the data should go to.
+         */
+        explicit PackedStoragePolicy( const QString &dataDirectory = QString(), QObject *parent = 0 );
+
+        ~PackedStoragePolicy();
+
+        bool fileExists( const QString &fileName ) const;
+
+        bool updateFile( const QString &fileName, const QByteArray &data );
+
+        QDateTime lastModified( const QString &fileName ) const;
+
+        QByteArray fileData( const QString &fileName ) const;
+
+        /**
+         * Clears the cache, both plain files and packs.
+         */
+        void clearCache();
+
+    private:
+        Q_DISABLE_COPY( PackedStoragePolicy )
+
+        QString absoluteFileName( const QString &fileName ) const;
+
+        QString m_dataDirectory;
+};
+
+}
+
+#endif
@@ -128,6 +128,7 @@ QtMarbleConfigDialog::QtMarbleConfigDialog( MarbleWidget *marbleWidget, QWidget
 
     // cache page
     d->w_cacheSettings = new MarbleCacheSettingsWidget( this );
+    d->w_cacheSettings->setDownloadManager( marbleWidget->model()->downloadManager() );
     tabWidget->addTab( d->w_cacheSettings, tr( "Cache and Proxy" ) );
     // Forwarding clear button signals
     connect( d->w_cacheSettings, SIGNAL(clearVolatileCache()),
@@ -477,6 +478,11 @@ int QtMarbleConfigDialog::persistentTileCacheLimit() const
     return d->m_settings.value( "Cache/persistentTileCacheLimit", 0 ).toInt(); // default to unlimited
 }
 
+int QtMarbleConfigDialog::sharedTileCacheLimit() const
+{
+    return d->m_settings.value( "Cache/sharedTileCacheLimit", 0 ).toInt(); // default to not shared
+}
+
 QString QtMarbleConfigDialog::proxyUrl() const
 {
     return d->m_settings.value( "Cache/proxyUrl", "" ).toString();
@@ -0,0 +1,381 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "SharedTileCache.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QSharedMemory>
+#include <QtCore/QVector>
+
+#include <cstring>
+
+#include "MarbleDebug.h"
+
+namespace Marble
+{
+
+namespace
+{
+// The segment starts with this marker ("MTSC")
+const quint32 cacheMagic = 0x4d545343;
+const quint32 cacheVersion = 1;
+
+// Tiles have at least 64 KB, e.g. 256x256 pixels of 8 bit
+const quint32 entriesPerMegabyte = 16;
+const quint32 minimumEntryCount = 64;
+
+// Number of index entries looked at for a tile, starting at its hash
+const int maximumProbes = 8;
+
+// Records start at multiples of this, QImage needs aligned scanlines
+const quint32 recordAlignment = 16;
+
+// Larger tiles would evict too many others
+const int maximumRecordShare = 4;
+
+const quint64 maximumGlobalLimit = 1024 * 1024 * 1024;
+
+// Lives at the start of the segment
+struct Header
+{
+    quint32 magic;
+    quint32 version;
+    // size of the ring buffer, a power of two
+    quint32 capacity;
+    // number of index entries, a power of two
+    quint32 entryCount;
+    // logical position of the next record, wraps around at 2^32
+    QBasicAtomicInt writeHead;
+};
+
+struct Entry
+{
+    // odd while the entry is written
+    QBasicAtomicInt sequence;
+    // zoom level + 1, 0 for unused entries
+    qint32 level;
+    quint32 mapThemeIdHash;
+    qint32 x;
+    qint32 y;
+    // logical position and size of the record in the ring buffer
+    quint32 position;
+    quint32 size;
+    qint32 format;
+    qint32 width;
+    qint32 height;
+    qint32 bytesPerLine;
+    qint32 colorCount;
+};
+
+quint32 aligned( quint32 size )
+{
+    return ( size + recordAlignment - 1 ) / recordAlignment * recordAlignment;
+}
+
+quint32 floorPowerOfTwo( quint32 value )
+{
+    quint32 result = 1;
+    while ( result <= value / 2 ) {
+        result *= 2;
+    }
+    return result;
+}
+
+QMutex s_globalMutex;
+SharedTileCache *s_globalCache = 0;
+quint64 s_globalLimit = 0;
+
+void deleteGlobalCache()
+{
+    QMutexLocker locker( &s_globalMutex );
+    delete s_globalCache;
+    s_globalCache = 0;
+}
+}
+
+class SharedTileCache::Private
+{
+ public:
+    explicit Private( const QString &key );
+
+    bool matches( const Entry &entry, const TileId &id ) const;
+
+    QSharedMemory m_memory;
+    Header *m_header;
+    Entry *m_entries;
+    uchar *m_data;
+};
+
+SharedTileCache::Private::Private( const QString &key )
+    : m_memory( key ),
+      m_header( 0 ),
+      m_entries( 0 ),
+      m_data( 0 )
+{
+}
+
+bool SharedTileCache::Private::matches( const Entry &entry, const TileId &id ) const
+{
+    return entry.level == id.zoomLevel() + 1
+        && entry.mapThemeIdHash == id.mapThemeIdHash()
+        && entry.x == id.x()
+        && entry.y == id.y();
+}
+
+SharedTileCache::SharedTileCache( const QString &key, int size )
+    : d( new Private( key ) )
+{
+    const quint32 capacity = floorPowerOfTwo( qMax( size, 1024 * 1024 ) );
+    const quint32 entryCount = floorPowerOfTwo( qMax( minimumEntryCount,
+                                                      capacity / ( 1024 * 1024 ) * entriesPerMegabyte ) );
+    const int headerSize = aligned( sizeof( Header ) );
+    const int indexSize = aligned( entryCount * sizeof( Entry ) );
+    const int segmentSize = headerSize + indexSize + capacity;
+
+    if ( !d->m_memory.create( segmentSize ) ) {
+        if ( d->m_memory.error() != QSharedMemory::AlreadyExists || !d->m_memory.attach() ) {
+            mDebug() << "Cannot use the shared tile cache" << key << d->m_memory.errorString();
+            return;
+        }
+    }
+
+    if ( !d->m_memory.lock() ) {
+        mDebug() << "Cannot lock the shared tile cache" << key << d->m_memory.errorString();
+        d->m_memory.detach();
+        return;
+    }
+
+    Header *const header = static_cast<Header *>( d->m_memory.data() );
+    if ( header->magic != cacheMagic ) {
+        // The segment has just been created, by this or another process
+        if ( d->m_memory.size() < segmentSize ) {
+            d->m_memory.unlock();
+            d->m_memory.detach();
+            return;
+        }
+
+        std::memset( d->m_memory.data(), 0, headerSize + indexSize );
+        header->magic = cacheMagic;
+        header->version = cacheVersion;
+        header->capacity = capacity;
+        header->entryCount = entryCount;
+    }
+
+    const int usedSize = headerSize + aligned( header->entryCount * sizeof( Entry ) ) + header->capacity;
+    if ( header->version != cacheVersion || usedSize > d->m_memory.size() ) {
+        mDebug() << "Ignoring incompatible shared tile cache" << key;
+        d->m_memory.unlock();
+        d->m_memory.detach();
+        return;
+    }
+
+    d->m_header = header;
+    d->m_entries = reinterpret_cast<Entry *>( static_cast<uchar *>( d->m_memory.data() ) + headerSize );
+    d->m_data = static_cast<uchar *>( d->m_memory.data() ) + headerSize + aligned( header->entryCount * sizeof( Entry ) );
+    d->m_memory.unlock();
+
+    mDebug() << "Attached to the shared tile cache" << key << "with" << header->capacity << "bytes";
+}
+
+SharedTileCache::~SharedTileCache()
+{
+    delete d;
+}
+
+bool SharedTileCache::isAttached() const
+{
+    return d->m_header != 0;
+}
+
+QImage SharedTileCache::image( const TileId &id ) const
+{
+    if ( !d->m_header ) {
+        return QImage();
+    }
+
+    const quint32 capacity = d->m_header->capacity;
+    const quint32 mask = d->m_header->entryCount - 1;
+    const quint32 first = qHash( id );
+
+    for ( int probe = 0; probe < maximumProbes; ++probe ) {
+        Entry &shared = d->m_entries[ ( first + probe ) & mask ];
+
+        // Copy the entry, then check that no insert() changed it meanwhile
+        const int sequence = shared.sequence.fetchAndAddOrdered( 0 );
+        if ( sequence & 1 ) {
+            continue;
+        }
+        if ( shared.level == 0 ) {
+            break;
+        }
+        if ( !d->matches( shared, id ) ) {
+            continue;
+        }
+        const quint32 position = shared.position;
+        const quint32 size = shared.size;
+        const QImage::Format format = QImage::Format( shared.format );
+        const int width = shared.width;
+        const int height = shared.height;
+        const int bytesPerLine = shared.bytesPerLine;
+        const int colorCount = shared.colorCount;
+        if ( shared.sequence.fetchAndAddOrdered( 0 ) != sequence ) {
+            continue;
+        }
+
+        // The entry is written by other processes, so its layout must fit into the record
+        if ( colorCount < 0 || colorCount > 256 || bytesPerLine < 0 || height < 0 ) {
+            continue;
+        }
+
+        // The record is gone once the ring buffer wrapped around it
+        const quint32 distance = quint32( d->m_header->writeHead.fetchAndAddOrdered( 0 ) ) - position;
+        const quint32 colorSize = aligned( 4 * colorCount );
+        if ( distance > capacity || distance < size || size > capacity
+             || colorSize + quint64( bytesPerLine ) * height > size ) {
+            continue;
+        }
+
+        QImage result( width, height, format );
+        if ( result.isNull() ) {
+            continue;
+        }
+
+        const uchar *const record = d->m_data + ( position & ( capacity - 1 ) );
+        if ( colorCount > 0 ) {
+            QVector<QRgb> colors( colorCount );
+            std::memcpy( colors.data(), record, 4 * colorCount );
+            result.setColorTable( colors );
+        }
+        const int lineSize = qMin( bytesPerLine, result.bytesPerLine() );
+        for ( int y = 0; y < height; ++y ) {
+            std::memcpy( result.scanLine( y ), record + colorSize + y * bytesPerLine, lineSize );
+        }
+
+        // Discard the copy if an insert() overwrote the record meanwhile
+        if ( quint32( d->m_header->writeHead.fetchAndAddOrdered( 0 ) ) - position > capacity ) {
+            return QImage();
+        }
+
+        return result;
+    }
+
+    return QImage();
+}
+
+void SharedTileCache::insert( const TileId &id, const QImage &image )
+{
+    if ( !d->m_header || image.isNull() ) {
+        return;
+    }
+
+    const quint32 capacity = d->m_header->capacity;
+    const QVector<QRgb> colors = image.colorTable();
+    const quint32 colorSize = aligned( 4 * colors.size() );
+    const quint32 size = aligned( colorSize + image.byteCount() );
+    if ( size > capacity / maximumRecordShare ) {
+        return;
+    }
+
+    if ( !d->m_memory.lock() ) {
+        return;
+    }
+
+    // Reuse the entry of the tile, an unused one or the one of the oldest record
+    const quint32 mask = d->m_header->entryCount - 1;
+    const quint32 first = qHash( id );
+    quint32 head = d->m_header->writeHead;
+    Entry *entry = 0;
+    quint32 oldestDistance = 0;
+    for ( int probe = 0; probe < maximumProbes; ++probe ) {
+        Entry *const candidate = &d->m_entries[ ( first + probe ) & mask ];
+        if ( candidate->level == 0 || d->matches( *candidate, id ) ) {
+            entry = candidate;
+            break;
+        }
+        const quint32 distance = head - candidate->position;
+        if ( !entry || distance > oldestDistance ) {
+            entry = candidate;
+            oldestDistance = distance;
+        }
+    }
+
+    // Records are contiguous, the rest of the buffer is skipped if needed
+    quint32 offset = head & ( capacity - 1 );
+    if ( offset + size > capacity ) {
+        head += capacity - offset;
+        offset = 0;
+    }
+
+    // Advancing the head first makes readers of overwritten records discard them
+    d->m_header->writeHead.fetchAndStoreOrdered( head + size );
+
+    uchar *const record = d->m_data + offset;
+    std::memcpy( record, colors.constData(), 4 * colors.size() );
+    std::memcpy( record + colorSize, image.bits(), image.byteCount() );
+
+    entry->sequence.fetchAndAddOrdered( 1 );
+    entry->level = id.zoomLevel() + 1;
+    entry->mapThemeIdHash = id.mapThemeIdHash();
+    entry->x = id.x();
+    entry->y = id.y();
+    entry->position = head;
+    entry->size = size;
+    entry->format = image.format();
+    entry->width = image.width();
+    entry->height = image.height();
+    entry->bytesPerLine = image.bytesPerLine();
+    entry->colorCount = colors.size();
+    entry->sequence.fetchAndAddOrdered( 1 );
+
+    d->m_memory.unlock();
+}
+
+SharedTileCache *SharedTileCache::global()
+{
+    QMutexLocker locker( &s_globalMutex );
+    return s_globalCache;
+}
+
+void SharedTileCache::setGlobalLimit( quint64 bytes )
+{
+    QMutexLocker locker( &s_globalMutex );
+    if ( bytes == s_globalLimit ) {
+        return;
+    }
+
+    if ( !s_globalCache && bytes > 0 ) {
+        qAddPostRoutine( deleteGlobalCache );
+    }
+
+    delete s_globalCache;
+    s_globalCache = 0;
+    s_globalLimit = bytes;
+    if ( bytes == 0 ) {
+        return;
+    }
+
+    // One cache per user, processes of other users cannot access it anyway
+    const QString key = QString( "marble-tile-cache-%1" ).arg( qHash( QDir::homePath() ) );
+    s_globalCache = new SharedTileCache( key, int( qMin( bytes, maximumGlobalLimit ) ) );
+    if ( !s_globalCache->isAttached() ) {
+        delete s_globalCache;
+        s_globalCache = 0;
+    }
+}
+
+quint64 SharedTileCache::globalLimit()
+{
+    QMutexLocker locker( &s_globalMutex );
+    return s_globalLimit;
+}
+
+}
@@ -0,0 +1,77 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_SHAREDTILECACHE_H
+#define MARBLE_SHAREDTILECACHE_H
+
+#include <QtCore/QString>
+#include <QtGui/QImage>
+
+#include "TileId.h"
+#include "marble_export.h"
+
+namespace Marble
+{
+
+/**
+ * @short Cache of decoded tiles shared by all Marble processes of a user.
+ *
+ * The tiles are kept in a shared memory segment: a ring buffer of pixels
+ * and a hash index of fixed size. Inserting takes the segment's lock,
+ * looking up does not: index entries carry a sequence number which is
+ * odd while they are written, and a read is discarded if the ring buffer
+ * overwrote the pixels while they were copied.
+ *
+ * The cache is opt-in, see setGlobalLimit().
+ */
+class MARBLE_EXPORT SharedTileCache
+{
+ public:
+    /**
+     * Attaches to the cache called @p key, creating it with room for
+     * @p size bytes if no process created it yet.
+     */
+    SharedTileCache( const QString &key, int size );
+    ~SharedTileCache();
+
+    bool isAttached() const;
+
+    /**
+     * Returns a copy of the tile @p id, or a null image if it is not cached.
+     */
+    QImage image( const TileId &id ) const;
+
+    /**
+     * Stores @p image as tile @p id, replacing the least recently stored tiles if needed.
+     */
+    void insert( const TileId &id, const QImage &image );
+
+    /**
+     * Returns the cache shared by the Marble processes of the current user,
+     * or 0 if it is disabled.
+     */
+    static SharedTileCache *global();
+
+    /**
+     * Enables the shared cache with room for @p bytes, or disables it for
+     * this process if @p bytes is 0. The size only takes effect if no other
+     * process uses the cache already.
+     */
+    static void setGlobalLimit( quint64 bytes );
+    static quint64 globalLimit();
+
+ private:
+    Q_DISABLE_COPY( SharedTileCache )
+
+    class Private;
+    Private *const d;
+};
+
+}
+
+#endif
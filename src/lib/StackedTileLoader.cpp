@@ -35,6 +35,7 @@
 #include <QtCore/QCache>
 #include <QtCore/QHash>
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QSet>
 #include <QtGui/QImage>
 
 
@@ -60,6 +61,8 @@ public:
     QVector<GeoSceneTextureTile const *> m_textureLayers;
     QHash <TileId, StackedTile*>  m_tilesOnDisplay;
     QCache <TileId, StackedTile>  m_tileCache;
+    // displayed tiles whose downloads were canceled
+    QSet<TileId> m_canceledTiles;
     QReadWriteLock m_cacheLock;
 };
 
@@ -142,6 +145,12 @@ void StackedTileLoader::cleanupTilehash()
     while ( it.hasNext() ) {
         it.next();
         if ( !it.value()->used() ) {
+            // A tile without a pending download is reloaded to request it again
+            if ( d->m_canceledTiles.remove( it.key() ) ) {
+                delete it.value();
+                d->m_tilesOnDisplay.remove( it.key() );
+                continue;
+            }
             // If insert call result is false then the cache is too small to store the tile
             // but the item will get deleted nevertheless and the pointer we have
             // doesn't get set to zero (so don't delete it in this case or it will crash!)
@@ -156,10 +165,12 @@ const StackedTile* StackedTileLoader::loadTile( TileId const & stackedTileId )
     // check if the tile is in the hash
     d->m_cacheLock.lockForRead();
     StackedTile * stackedTile = d->m_tilesOnDisplay.value( stackedTileId, 0 );
+    const bool canceled = !d->m_canceledTiles.isEmpty() && d->m_canceledTiles.contains( stackedTileId );
     d->m_cacheLock.unlock();
     if ( stackedTile ) {
         stackedTile->setUsed( true );
-        return stackedTile;
+        if ( !canceled )
+            return stackedTile;
     }
     // here ends the performance critical section of this method
 
@@ -169,6 +180,11 @@ const StackedTile* StackedTileLoader::loadTile( TileId const & stackedTileId )
     stackedTile = d->m_tilesOnDisplay.value( stackedTileId, 0 );
     if ( stackedTile ) {
         Q_ASSERT( stackedTile->used() && "other thread should have marked tile as used" );
+        if ( d->m_canceledTiles.remove( stackedTileId ) ) {
+            // the tile is back in view, so its download is needed again
+            QVector<GeoSceneTextureTile const *> const textureLayers = d->findRelevantTextureLayers( stackedTileId );
+            d->m_layerDecorator->downloadStackedTile( stackedTileId, textureLayers, DownloadBrowse );
+        }
         d->m_cacheLock.unlock();
         return stackedTile;
     }
@@ -260,6 +276,8 @@ void StackedTileLoader::updateTile( TileId const &tileId, QImage const &tileImag
 
     const TileId stackedTileId( 0, tileId.zoomLevel(), tileId.x(), tileId.y() );
 
+    d->m_canceledTiles.remove( stackedTileId );
+
     StackedTile * displayedTile = d->m_tilesOnDisplay.take( stackedTileId );
     if ( displayedTile ) {
         Q_ASSERT( !d->m_tileCache.contains( stackedTileId ) );
@@ -277,12 +295,26 @@ void StackedTileLoader::updateTile( TileId const &tileId, QImage const &tileImag
     }
 }
 
+void StackedTileLoader::cancelTile( TileId const &tileId )
+{
+    const TileId stackedTileId( 0, tileId.zoomLevel(), tileId.x(), tileId.y() );
+
+    QWriteLocker locker( &d->m_cacheLock );
+    if ( d->m_tilesOnDisplay.contains( stackedTileId ) ) {
+        d->m_canceledTiles.insert( stackedTileId );
+    } else {
+        // loading the tile from disk again requests the download
+        d->m_tileCache.remove( stackedTileId );
+    }
+}
+
 void StackedTileLoader::clear()
 {
     mDebug() << Q_FUNC_INFO;
 
     qDeleteAll( d->m_tilesOnDisplay );
     d->m_tilesOnDisplay.clear();
+    d->m_canceledTiles.clear();
     d->m_tileCache.clear(); // clear the tile cache in physical memory
 
     emit cleared();
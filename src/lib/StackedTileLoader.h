@@ -143,6 +143,12 @@ class StackedTileLoader : public QObject
          */
         void updateTile(TileId const & tileId, QImage const &tileImage );
 
+        /**
+         * Marks the tile whose download of @p tileId has been canceled, so the
+         * download is started again when the tile is loaded the next time.
+         */
+        void cancelTile( TileId const &tileId );
+
     Q_SIGNALS:
         void tileLoaded( TileId const &tileId );
         void cleared();
@@ -17,4 +17,36 @@ StoragePolicy::StoragePolicy( QObject *parent )
     : QObject( parent )
 {}
 
+void StoragePolicy::accessFile( const QString &fileName )
+{
+    Q_UNUSED( fileName );
+}
+
+QDateTime StoragePolicy::lastModified( const QString &fileName ) const
+{
+    Q_UNUSED( fileName );
+    return QDateTime();
+}
+
+QByteArray StoragePolicy::fileData( const QString &fileName ) const
+{
+    Q_UNUSED( fileName );
+    return QByteArray();
+}
+
+void StoragePolicy::removeFile( const QString &fileName )
+{
+    Q_UNUSED( fileName );
+}
+
+TileMetaData StoragePolicy::metaData( const QString &fileName ) const
+{
+    return TileMetaData::fromByteArray( fileData( TileMetaData::metaDataFileName( fileName ) ) );
+}
+
+bool StoragePolicy::updateMetaData( const QString &fileName, const TileMetaData &metaData )
+{
+    return updateFile( TileMetaData::metaDataFileName( fileName ), metaData.toByteArray() );
+}
+
 #include "StoragePolicy.moc"
@@ -13,11 +13,12 @@
 #define MARBLE_STORAGEPOLICY_H
 
 
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
 #include <QtCore/QObject>
 #include <QtCore/QString>
 
-
-class QByteArray;
+#include "TileMetaData.h"
 
 namespace Marble
 {
@@ -41,10 +42,46 @@ class StoragePolicy : public QObject
 	virtual void clearCache() = 0;
 
         virtual QString lastErrorMessage() const = 0;
+
+        /**
+         * Notes that @p fileName has been read, so that rarely used files
+         * can be removed first. Does nothing by default.
+         */
+        virtual void accessFile( const QString &fileName );
+
+        /**
+         * Returns when @p fileName was stored, or an invalid time if it
+         * is not stored or the time is not known. The default does not know.
+         */
+        virtual QDateTime lastModified( const QString &fileName ) const;
+
+        /**
+         * Returns the stored content of @p fileName, or an empty array if
+         * it is not stored. The default returns an empty array.
+         */
+        virtual QByteArray fileData( const QString &fileName ) const;
+
+        /**
+         * Removes @p fileName from the storage. Does nothing by default.
+         */
+        virtual void removeFile( const QString &fileName );
+
+        /**
+         * Returns the freshness information stored with @p fileName,
+         * which is invalid if there is none.
+         */
+        TileMetaData metaData( const QString &fileName ) const;
+
+        /**
+         * Stores @p metaData with @p fileName, in a file next to it.
+         */
+        bool updateMetaData( const QString &fileName, const TileMetaData &metaData );
 	
     Q_SIGNALS:
 	void cleared();
 	void sizeChanged( qint64 );
+	void fileUpdated( const QString &fileName, qint64 size );
+	void fileAccessed( const QString &fileName );
 	
     private:
 	Q_DISABLE_COPY( StoragePolicy )
@@ -23,6 +23,7 @@
 #include <QtGui/QImageReader>
 #include <QtGui/QPainter>
 
+#include "DecodedTilePack.h"
 #include "MarbleGlobal.h"
 #include "MarbleDirs.h"
 #include "MarbleDebug.h"
@@ -42,6 +43,7 @@ class TileCreatorPrivate
          m_tileFormat( "jpg" ),
          m_resume( false ),
          m_verify( false ),
+         m_decodedTileLevel( -1 ),
          m_source( source )
      {
         if ( m_dem == "true" ) {
@@ -64,6 +66,7 @@ class TileCreatorPrivate
     int      m_tileQuality;
     bool     m_resume;
     bool     m_verify;
+    int      m_decodedTileLevel;
 
     TileCreatorSource  *m_source;
 };
@@ -572,6 +575,10 @@ void TileCreator::run()
         }
     }
 
+    if ( d->m_decodedTileLevel >= 0 ) {
+        createDecodedTilePack( d->m_targetDir, qMin( d->m_decodedTileLevel, maxTileLevel ) );
+    }
+
     percentCompleted = 100;
     emit progress( percentCompleted );
 
@@ -618,6 +625,21 @@ bool TileCreator::verifyExactResult() const
     return d->m_verify;
 }
 
+void TileCreator::setDecodedTileLevel( int maximumLevel )
+{
+    d->m_decodedTileLevel = maximumLevel;
+}
+
+int TileCreator::decodedTileLevel() const
+{
+    return d->m_decodedTileLevel;
+}
+
+bool TileCreator::createDecodedTilePack( const QString &themeDirectory, int maximumLevel )
+{
+    return DecodedTilePack::write( themeDirectory, maximumLevel );
+}
+
 
 }
 
@@ -81,6 +81,20 @@ class MARBLE_EXPORT TileCreator : public QThread
     bool resume() const;
     bool verifyExactResult() const;
 
+    /**
+     * Additionally stores the tiles of the levels up to @p maximumLevel
+     * pre-decoded in a memory mapped pack, see DecodedTilePack. The
+     * default of -1 creates no pack.
+     */
+    void setDecodedTileLevel( int maximumLevel );
+    int decodedTileLevel() const;
+
+    /**
+     * Creates the pre-decoded pack of the tiles of the levels up to
+     * @p maximumLevel which exist in @p themeDirectory already.
+     */
+    static bool createDecodedTilePack( const QString &themeDirectory, int maximumLevel );
+
  protected:
     virtual void run();
 
@@ -23,6 +23,7 @@
 #include <QtCore/QDateTime>
 #include <QtCore/QFileInfo>
 #include <QtCore/QMetaType>
+#include <QtCore/QtConcurrentRun>
 #include <QtGui/QImage>
 
 #include "MarbleRunnerManager.h"
@@ -30,11 +31,15 @@
 #include "GeoSceneTextureTile.h"
 #include "GeoSceneTiled.h"
 #include "GeoSceneVectorTile.h"
+#include "DecodedTilePack.h"
 #include "GeoDataContainer.h"
 #include "HttpDownloadManager.h"
 #include "MarbleDebug.h"
 #include "MarbleDirs.h"
+#include "SharedTileCache.h"
 #include "TileLoaderHelper.h"
+#include "TileMetaData.h"
+#include "TilePack.h"
 
 Q_DECLARE_METATYPE( Marble::DownloadUsage )
 
@@ -49,15 +54,17 @@ TileLoader::TileLoader(HttpDownloadManager * const downloadManager, const Plugin
              downloadManager, SLOT(addJob(QUrl,QString,QString,DownloadUsage)));
     connect( downloadManager, SIGNAL(downloadComplete(QByteArray,QString)),
              SLOT(updateTile(QByteArray,QString)));
+    connect( downloadManager, SIGNAL(downloadCanceled(QString,QString)),
+             SLOT(cancelTile(QString,QString)));
+    connect( this, SIGNAL(tileAccessed(QString)),
+             downloadManager, SLOT(accessFile(QString)));
 }
 
 // If the tile image file is locally available:
 //     - if not expired: create ImageTile, set state to "uptodate", return it => done
-//     - if expired: create TextureTile, state is set to Expired by default, trigger dl,
+//     - if expired: return it as well, but revalidate it in the background
 QImage TileLoader::loadTileImage( GeoSceneTextureTile const *textureLayer, TileId const & tileId, DownloadUsage const usage )
 {
-    QString const fileName = tileFileName( textureLayer, tileId );
-
     TileStatus status = tileStatus( textureLayer, tileId );
     if ( status != Missing ) {
         // check if an update should be triggered
@@ -67,12 +74,13 @@ QImage TileLoader::loadTileImage( GeoSceneTextureTile const *textureLayer, TileI
         } else {
             Q_ASSERT( status == Expired );
             mDebug() << Q_FUNC_INFO << tileId << "StateExpired";
-            triggerDownload( textureLayer, tileId, usage );
+            revalidateTile( textureLayer, tileId );
         }
 
-        QImage const image( fileName );
+        QImage const image = loadImage( textureLayer, tileId );
         if ( !image.isNull() ) {
             // file is there, so create and return a tile object in any case
+            emit tileAccessed( textureLayer->relativeTileFileName( tileId ) );
             return image;
         }
     }
@@ -103,7 +111,7 @@ GeoDataDocument *TileLoader::loadTileVectorData( GeoSceneVectorTile const *textu
         } else {
             Q_ASSERT( status == Expired );
             mDebug() << Q_FUNC_INFO << tileId << "StateExpired";
-            triggerDownload( textureLayer, tileId, usage );
+            revalidateTile( textureLayer, tileId );
         }
 
         QFile file ( fileName );
@@ -179,7 +187,8 @@ bool TileLoader::baseTilesAvailable( GeoSceneTiled const & texture )
         for ( int row = 0; result && row < levelZeroRows; ++row ) {
             const TileId id( 0, 0, column, row );
             const QString tilepath = tileFileName( &texture, id );
-            result &= QFile::exists( tilepath );
+            TilePack *const pack = tilePack( &texture );
+            result &= ( pack && pack->contains( tileKey( &texture, id ) ) ) || QFile::exists( tilepath );
             if (!result) {
                 mDebug() << "Base tile " << texture.relativeTileFileName( id ) << " is missing for source dir " << texture.sourceDir();
             }
@@ -191,19 +200,39 @@ bool TileLoader::baseTilesAvailable( GeoSceneTiled const & texture )
 
 TileLoader::TileStatus TileLoader::tileStatus( GeoSceneTiled const *textureLayer, const TileId &tileId )
 {
-    QString const fileName = tileFileName( textureLayer, tileId );
-    QFileInfo fileInfo( fileName );
-    if ( !fileInfo.exists() ) {
-        return Missing;
+    QDateTime lastModified;
+    TileMetaData metaData;
+    TilePack *const pack = tilePack( textureLayer );
+    QString const key = tileKey( textureLayer, tileId );
+    if ( pack && pack->contains( key ) ) {
+        lastModified = pack->lastModified( key );
+        metaData = TileMetaData::fromByteArray( pack->data( TileMetaData::metaDataFileName( key ) ) );
+    } else {
+        QString const fileName = tileFileName( textureLayer, tileId );
+        QFileInfo fileInfo( fileName );
+        if ( !fileInfo.exists() ) {
+            return Missing;
+        }
+
+        lastModified = fileInfo.lastModified();
+        QFile metaDataFile( TileMetaData::metaDataFileName( fileName ) );
+        if ( metaDataFile.open( QIODevice::ReadOnly ) ) {
+            metaData = TileMetaData::fromByteArray( metaDataFile.readAll() );
+        }
     }
 
-    const QDateTime lastModified = fileInfo.lastModified();
     const int expireSecs = textureLayer->expire();
+    if ( metaData.isValid() ) {
+        // the server's expiry time, or the theme's expiry time since the last revalidation
+        return metaData.isExpired( expireSecs ) ? Expired : Available;
+    }
+
+    // tiles stored without meta data expire relative to the time they were written
     const bool isExpired = lastModified.secsTo( QDateTime::currentDateTime() ) >= expireSecs;
     return isExpired ? Expired : Available;
 }
 
-void TileLoader::updateTile( QByteArray const & data, QString const & idStr )
+TileId TileLoader::tileIdFromString( QString const & idStr )
 {
     QStringList const components = idStr.split( ':', QString::SkipEmptyParts );
     Q_ASSERT( components.size() == 4 );
@@ -213,15 +242,50 @@ void TileLoader::updateTile( QByteArray const & data, QString const & idStr )
     int const tileX = components[ 2 ].toInt();
     int const tileY = components[ 3 ].toInt();
 
-    TileId const id = TileId( sourceDir, zoomLevel, tileX, tileY );
+    return TileId( sourceDir, zoomLevel, tileX, tileY );
+}
+
+void TileLoader::updateTile( QByteArray const & data, QString const & idStr )
+{
+    TileId const id = tileIdFromString( idStr );
+
+    // The data is shared with the storage policy which writes it, decoding it
+    // needs neither a copy nor reading the file again
+    QFutureWatcher<QImage> *const watcher = new QFutureWatcher<QImage>( this );
+    connect( watcher, SIGNAL(finished()), SLOT(finishDecoding()) );
+    m_decodingTiles.insert( watcher, id );
+    watcher->setFuture( QtConcurrent::run( &TileLoader::decodeImage, data ) );
+}
+
+void TileLoader::cancelTile( QString const & relativeFileName, QString const & idStr )
+{
+    Q_UNUSED( relativeFileName );
+    emit tileCanceled( tileIdFromString( idStr ) );
+}
+
+void TileLoader::finishDecoding()
+{
+    QFutureWatcher<QImage> *const watcher = static_cast<QFutureWatcher<QImage> *>( sender() );
+    TileId const id = m_decodingTiles.take( watcher );
+    QImage const tileImage = watcher->result();
+    watcher->deleteLater();
 
-    QImage const tileImage = QImage::fromData( data );
     if ( tileImage.isNull() )
         return;
 
+    SharedTileCache *const sharedCache = SharedTileCache::global();
+    if ( sharedCache ) {
+        sharedCache->insert( id, tileImage );
+    }
+
     emit tileCompleted( id, tileImage );
 }
 
+QImage TileLoader::decodeImage( QByteArray const & imageData )
+{
+    return QImage::fromData( imageData );
+}
+
 QString TileLoader::tileFileName( GeoSceneTiled const * textureLayer, TileId const & tileId )
 {
     QString const fileName = textureLayer->relativeTileFileName( tileId );
@@ -229,6 +293,100 @@ QString TileLoader::tileFileName( GeoSceneTiled const * textureLayer, TileId con
     return dirInfo.isAbsolute() ? fileName : MarbleDirs::path( fileName );
 }
 
+TilePack *TileLoader::tilePack( GeoSceneTiled const * textureLayer )
+{
+    if ( textureLayer->storageContainer() != GeoSceneTiled::Pack ) {
+        return 0;
+    }
+
+    // Only downloaded tiles are packed, installed themes keep their files
+    QString const themeStr = textureLayer->themeStr();
+    QFileInfo const dirInfo( themeStr );
+    return TilePack::open( dirInfo.isAbsolute() ? themeStr : MarbleDirs::localPath() + '/' + themeStr );
+}
+
+DecodedTilePack *TileLoader::decodedTilePack( GeoSceneTiled const * textureLayer )
+{
+    // Decoded packs are indexed by the tile numbers of Marble's own storage layout
+    if ( textureLayer->storageLayout() != GeoSceneTiled::Marble ) {
+        return 0;
+    }
+
+    QString const themeStr = textureLayer->themeStr();
+    QFileInfo const dirInfo( themeStr );
+    if ( dirInfo.isAbsolute() ) {
+        return DecodedTilePack::open( themeStr );
+    }
+
+    // The local theme directory may exist for downloaded tiles while the
+    // pack of the installed tiles is in the system directory
+    DecodedTilePack *const localPack = DecodedTilePack::open( MarbleDirs::localPath() + '/' + themeStr );
+    return localPack ? localPack : DecodedTilePack::open( MarbleDirs::systemPath() + '/' + themeStr );
+}
+
+QString TileLoader::tileKey( GeoSceneTiled const * textureLayer, TileId const & tileId )
+{
+    return textureLayer->relativeTileFileName( tileId ).mid( textureLayer->themeStr().length() + 1 );
+}
+
+QDateTime TileLoader::downloadTime( GeoSceneTiled const * textureLayer, TileId const & tileId )
+{
+    TilePack *const pack = tilePack( textureLayer );
+    QString const key = tileKey( textureLayer, tileId );
+    if ( pack && pack->contains( key ) ) {
+        return pack->lastModified( key );
+    }
+
+    // Downloads are stored in the local directory, the system one holds installed tiles only
+    QString const fileName = textureLayer->relativeTileFileName( tileId );
+    QFileInfo const dirInfo( fileName );
+    QFileInfo const info( dirInfo.isAbsolute() ? fileName : MarbleDirs::localPath() + '/' + fileName );
+    return info.exists() ? info.lastModified() : QDateTime();
+}
+
+QImage TileLoader::loadImage( GeoSceneTiled const * textureLayer, TileId const & tileId )
+{
+    DecodedTilePack *const decodedPack = decodedTilePack( textureLayer );
+    if ( decodedPack ) {
+        // refers to the mapped pixels, no decoding needed, unless the tile has been downloaded since
+        QImage const image = decodedPack->image( tileId.zoomLevel(), tileId.x(), tileId.y(),
+                                                 downloadTime( textureLayer, tileId ) );
+        if ( !image.isNull() ) {
+            return image;
+        }
+    }
+
+    // Other Marble processes may have decoded the tile already. Elevation
+    // tiles are requested with a hash of 0, so the key is built here.
+    SharedTileCache *const sharedCache = SharedTileCache::global();
+    TileId const sharedId( textureLayer->sourceDir(), tileId.zoomLevel(), tileId.x(), tileId.y() );
+    if ( sharedCache ) {
+        QImage const image = sharedCache->image( sharedId );
+        if ( !image.isNull() ) {
+            return image;
+        }
+    }
+
+    QImage image;
+    TilePack *const pack = tilePack( textureLayer );
+    if ( pack ) {
+        QByteArray const data = pack->data( tileKey( textureLayer, tileId ) );
+        if ( !data.isEmpty() ) {
+            image = QImage::fromData( reinterpret_cast<const uchar *>( data.constData() ), data.size() );
+        }
+    }
+
+    if ( image.isNull() ) {
+        image = QImage( tileFileName( textureLayer, tileId ) );
+    }
+
+    if ( sharedCache && !image.isNull() ) {
+        sharedCache->insert( sharedId, image );
+    }
+
+    return image;
+}
+
 void TileLoader::triggerDownload( GeoSceneTiled const *textureLayer, TileId const &id, DownloadUsage const usage )
 {
     QUrl const sourceUrl = textureLayer->downloadUrl( id );
@@ -237,6 +395,13 @@ void TileLoader::triggerDownload( GeoSceneTiled const *textureLayer, TileId cons
     emit downloadTile( sourceUrl, destFileName, idStr, usage );
 }
 
+void TileLoader::revalidateTile( GeoSceneTiled const *textureLayer, TileId const &id )
+{
+    // The expired tile is shown meanwhile, so the conditional request waits
+    // behind the downloads of missing tiles in the queue of bulk downloads
+    triggerDownload( textureLayer, id, DownloadBulk );
+}
+
 QImage TileLoader::scaledLowerLevelTile( const GeoSceneTextureTile * textureLayer, TileId const & id ) const
 {
     mDebug() << Q_FUNC_INFO << id;
@@ -245,9 +410,8 @@ QImage TileLoader::scaledLowerLevelTile( const GeoSceneTextureTile * textureLaye
         int const deltaLevel = id.zoomLevel() - level;
         TileId const replacementTileId( id.mapThemeIdHash(), level,
                                         id.x() >> deltaLevel, id.y() >> deltaLevel );
-        QString const fileName = tileFileName( textureLayer, replacementTileId );
-        mDebug() << "TileLoader::scaledLowerLevelTile" << "trying" << fileName;
-        QImage toScale( fileName );
+        mDebug() << "TileLoader::scaledLowerLevelTile" << "trying" << replacementTileId;
+        QImage toScale = loadImage( textureLayer, replacementTileId );
 
         if ( level == 0 && toScale.isNull() ) {
             mDebug() << "No level zero tile installed in map theme dir. Falling back to a transparent image for now.";
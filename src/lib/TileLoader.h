@@ -20,6 +20,8 @@
 #ifndef MARBLE_TILELOADER_H
 #define MARBLE_TILELOADER_H
 
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QHash>
 #include <QtCore/QObject>
 #include <QtCore/QString>
 #include <QtGui/QImage>
@@ -30,15 +32,18 @@
 #include "MarbleGlobal.h"
 
 class QByteArray;
+class QDateTime;
 class QImage;
 class QUrl;
 
 namespace Marble
 {
+class DecodedTilePack;
 class HttpDownloadManager;
 class GeoSceneTiled;
 class GeoSceneTextureTile;
 class GeoSceneVectorTile;
+class TilePack;
 
 class TileLoader: public QObject
 {
@@ -68,29 +73,61 @@ class TileLoader: public QObject
     /**
       * Returns the status of the downloaded tile file:
       * - Missing when it has not been downloaded
-      * - Expired when it has been downloaded, but is too old (as per .dgml expiration time)
+      * - Expired when it has been downloaded, but is too old (as per the expiry time sent
+      *   by the server, or else the .dgml expiration time)
       * - Available when it has been downloaded and is not expired
       */
     static TileStatus tileStatus( GeoSceneTiled const *textureLayer, const TileId &tileId );
 
  public Q_SLOTS:
+    /**
+     * Decodes the downloaded @p imageData in a worker thread and
+     * emits tileCompleted() when done.
+     */
     void updateTile( QByteArray const & imageData, QString const & tileId );
 
+    /**
+     * Emits tileCanceled() for the tile whose download has been canceled.
+     */
+    void cancelTile( QString const & relativeFileName, QString const & tileId );
+
  Q_SIGNALS:
     void downloadTile( QUrl const & sourceUrl, QString const & destinationFileName,
                        QString const & id, DownloadUsage );
 
     void tileCompleted( TileId const & tileId, QImage const & tileImage );
 
+    /**
+     * Is emitted when the download of a tile has been canceled before
+     * it completed, so the tile has to be requested again once it is needed.
+     */
+    void tileCanceled( TileId const & tileId );
+
+    void tileAccessed( QString const & relativeFileName );
+
     void tileCompleted( TileId const & tileId, GeoDataDocument * document, QString const & format );
 
+ private Q_SLOTS:
+    void finishDecoding();
+
  private:
+    static TileId tileIdFromString( QString const & idStr );
+    static QImage decodeImage( QByteArray const & imageData );
     static QString tileFileName( GeoSceneTiled const * textureLayer, TileId const & );
+    static TilePack *tilePack( GeoSceneTiled const * textureLayer );
+    static DecodedTilePack *decodedTilePack( GeoSceneTiled const * textureLayer );
+    static QString tileKey( GeoSceneTiled const * textureLayer, TileId const & );
+    static QDateTime downloadTime( GeoSceneTiled const * textureLayer, TileId const & );
+    static QImage loadImage( GeoSceneTiled const * textureLayer, TileId const & );
     void triggerDownload( GeoSceneTiled const *textureLayer, TileId const &, DownloadUsage const );
+    void revalidateTile( GeoSceneTiled const *textureLayer, TileId const & );
     QImage scaledLowerLevelTile( GeoSceneTextureTile const * textureLayer, TileId const & ) const;
 
     // For vectorTile parsing
     const PluginManager * m_pluginManager;
+
+    // Downloaded tiles being decoded
+    QHash<QFutureWatcher<QImage> *, TileId> m_decodingTiles;
 };
 
 }
@@ -0,0 +1,113 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "TileMetaData.h"
+
+#include <QtCore/QList>
+
+namespace Marble
+{
+
+// Times are stored in UTC
+const char dateFormat[] = "yyyy-MM-dd'T'hh:mm:ss";
+
+TileMetaData::TileMetaData()
+    : m_fetchTime(),
+      m_eTag(),
+      m_expiry()
+{
+}
+
+bool TileMetaData::isValid() const
+{
+    return m_fetchTime.isValid();
+}
+
+QDateTime TileMetaData::fetchTime() const
+{
+    return m_fetchTime;
+}
+
+void TileMetaData::setFetchTime( const QDateTime &fetchTime )
+{
+    m_fetchTime = fetchTime;
+}
+
+QByteArray TileMetaData::eTag() const
+{
+    return m_eTag;
+}
+
+void TileMetaData::setETag( const QByteArray &eTag )
+{
+    m_eTag = eTag;
+}
+
+QDateTime TileMetaData::expiry() const
+{
+    return m_expiry;
+}
+
+void TileMetaData::setExpiry( const QDateTime &expiry )
+{
+    m_expiry = expiry;
+}
+
+bool TileMetaData::isExpired( int defaultExpire ) const
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    if ( m_expiry.isValid() )
+        return m_expiry <= now;
+
+    return !m_fetchTime.isValid() || m_fetchTime.secsTo( now ) >= defaultExpire;
+}
+
+QByteArray TileMetaData::toByteArray() const
+{
+    // One "key value" pair per line, readable for debugging
+    QByteArray result;
+    result += "fetched " + m_fetchTime.toUTC().toString( dateFormat ).toLatin1() + '\n';
+    if ( !m_eTag.isEmpty() )
+        result += "etag " + m_eTag + '\n';
+    if ( m_expiry.isValid() )
+        result += "expires " + m_expiry.toUTC().toString( dateFormat ).toLatin1() + '\n';
+    return result;
+}
+
+TileMetaData TileMetaData::fromByteArray( const QByteArray &data )
+{
+    TileMetaData result;
+    foreach ( const QByteArray &line, data.split( '\n' ) ) {
+        const int separator = line.indexOf( ' ' );
+        if ( separator < 0 )
+            continue;
+
+        const QByteArray key = line.left( separator );
+        const QByteArray value = line.mid( separator + 1 ).trimmed();
+        if ( key == "fetched" ) {
+            result.m_fetchTime = QDateTime::fromString( QString::fromLatin1( value ), dateFormat );
+            result.m_fetchTime.setTimeSpec( Qt::UTC );
+        }
+        else if ( key == "etag" ) {
+            result.m_eTag = value;
+        }
+        else if ( key == "expires" ) {
+            result.m_expiry = QDateTime::fromString( QString::fromLatin1( value ), dateFormat );
+            result.m_expiry.setTimeSpec( Qt::UTC );
+        }
+    }
+
+    return result;
+}
+
+QString TileMetaData::metaDataFileName( const QString &fileName )
+{
+    return fileName + ".meta";
+}
+
+}
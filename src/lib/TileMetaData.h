@@ -0,0 +1,73 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_TILEMETADATA_H
+#define MARBLE_TILEMETADATA_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QString>
+
+#include "marble_export.h"
+
+namespace Marble
+{
+
+/**
+ * @short Freshness information of a downloaded tile, stored alongside it.
+ *
+ * Keeps when the tile was fetched, its entity tag and until when the server
+ * allows to use it without asking again (from Cache-Control or Expires).
+ */
+class MARBLE_EXPORT TileMetaData
+{
+ public:
+    TileMetaData();
+
+    /**
+     * Returns whether the fetch time is known.
+     */
+    bool isValid() const;
+
+    QDateTime fetchTime() const;
+    void setFetchTime( const QDateTime &fetchTime );
+
+    QByteArray eTag() const;
+    void setETag( const QByteArray &eTag );
+
+    /**
+     * Returns the time the tile expires according to the server, or an
+     * invalid time if the server did not tell.
+     */
+    QDateTime expiry() const;
+    void setExpiry( const QDateTime &expiry );
+
+    /**
+     * Returns whether the tile has to be revalidated. Without an expiry
+     * time from the server it expires @p defaultExpire seconds after it
+     * has been fetched.
+     */
+    bool isExpired( int defaultExpire ) const;
+
+    QByteArray toByteArray() const;
+    static TileMetaData fromByteArray( const QByteArray &data );
+
+    /**
+     * Returns the name of the file storing the meta data of @p fileName.
+     */
+    static QString metaDataFileName( const QString &fileName );
+
+ private:
+    QDateTime m_fetchTime;
+    QByteArray m_eTag;
+    QDateTime m_expiry;
+};
+
+}
+
+#endif
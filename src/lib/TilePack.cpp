@@ -0,0 +1,865 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "TilePack.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QPair>
+#include <QtCore/QSet>
+#include <QtCore/QSharedMemory>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtCore/QtConcurrentRun>
+
+#include "MarbleDebug.h"
+#include "MarbleGlobal.h"
+#include "TileMetaData.h"
+
+namespace Marble
+{
+
+namespace
+{
+// Every record in the pack starts with this marker ("MTPK")
+const quint32 recordMagic = 0x4d54504b;
+
+const char *const packFileName = "tiles.pack";
+const char *const indexFileName = "tiles.idx";
+// A pack is written to this file first when it is compacted
+const char *const newPackSuffix = ".new";
+// The old pack is moved here until its compacted copy replaced it
+const char *const oldPackSuffix = ".old";
+
+// Buffered tiles are appended once they sum up to this many bytes
+// or the oldest of them has been waiting for this many seconds
+const int maximumPendingSize = 1024 * 1024;
+const int maximumPendingAge = 5;
+
+// Packs are compacted once replaced tiles take up half of them, but at least this many bytes
+const quint64 minimumCompactionSize = 16 * 1024 * 1024;
+
+// Imported tile files are removed in batches of this size
+const int importBatchSize = 1000;
+
+QMutex s_packsMutex;
+QHash<QString, TilePack *> s_packs;
+
+struct IndexEntry
+{
+    quint64 offset;
+    quint32 size;
+    quint32 lastModified;
+};
+
+struct PendingEntry
+{
+    QByteArray data;
+    quint32 lastModified;
+};
+
+struct Mapping
+{
+    quint64 start;
+    quint64 length;
+    uchar *memory;
+};
+
+// Returns the tile level encoded in the first path component of a key, or -1
+int tileLevel( const QString &key )
+{
+    bool ok = false;
+    const int level = key.section( '/', 0, 0 ).toInt( &ok );
+    return ok && key.contains( '/' ) ? level : -1;
+}
+
+// Returns the size of a record in the pack: magic, key, time stamp, size and data
+quint64 recordSize( const QString &key, quint32 size )
+{
+    return 4 + 4 + 2 * key.size() + 4 + 4 + size;
+}
+}
+
+class TilePack::Private
+{
+ public:
+    explicit Private( const QString &directory );
+
+    bool acquireWriterLock();
+    bool openFiles();
+    void readIndex();
+    void recover();
+    void mapRange( quint64 start, quint64 end );
+    const uchar *memory( quint64 offset ) const;
+    QByteArray recordData( const IndexEntry &entry ) const;
+    void writePending();
+    void writeFile( const QString &key, const QByteArray &data ) const;
+    bool isFileNewer( const QString &key ) const;
+    IndexEntry copyRecord( QDataStream &stream, const QString &key, const IndexEntry &entry ) const;
+    qint64 rewrite( const QSet<QString> &removed );
+    void unmapAll();
+
+    const QString m_directory;
+    QFile m_packFile;
+    QFile m_indexFile;
+    // held by the process writing the pack
+    QSharedMemory m_writerLock;
+    bool m_writable;
+    quint64 m_end;
+    // bytes taken by records of replaced tiles
+    quint64 m_garbage;
+    QHash<QString, IndexEntry> m_index;
+    QHash<QString, PendingEntry> m_pending;
+    int m_pendingSize;
+    QDateTime m_pendingSince;
+    QVector<Mapping> m_mappings;
+    QFuture<void> m_import;
+    QFuture<qint64> m_compaction;
+    QAtomicInt m_closing;
+    mutable QMutex m_mutex;
+    // serializes rewrites of the pack, which take m_mutex only briefly
+    QMutex m_rewriteMutex;
+};
+
+TilePack::Private::Private( const QString &directory )
+    : m_directory( directory ),
+      m_packFile( directory + '/' + packFileName ),
+      m_indexFile( directory + '/' + indexFileName ),
+      m_writerLock( QString( "marble-tile-pack-%1" ).arg( qHash( directory ) ) ),
+      m_writable( false ),
+      m_end( 0 ),
+      m_garbage( 0 ),
+      m_pendingSize( 0 ),
+      m_closing( 0 ),
+      m_mutex( QMutex::Recursive )
+{
+}
+
+bool TilePack::Private::acquireWriterLock()
+{
+    if ( m_writerLock.create( 1 ) ) {
+        return true;
+    }
+
+    // A segment left behind by a crashed writer is destroyed when its
+    // last user detaches; a running writer keeps it attached
+    if ( m_writerLock.error() == QSharedMemory::AlreadyExists && m_writerLock.attach() ) {
+        m_writerLock.detach();
+        return m_writerLock.create( 1 );
+    }
+
+    return false;
+}
+
+bool TilePack::Private::openFiles()
+{
+    QDir::root().mkpath( m_directory );
+
+    m_writable = acquireWriterLock();
+    if ( !m_writable ) {
+        mDebug() << "Tile pack" << m_packFile.fileName() << "is written by another process, opening it read-only";
+    }
+
+    const QString newPack = m_packFile.fileName() + newPackSuffix;
+    const QString oldPack = m_packFile.fileName() + oldPackSuffix;
+    if ( m_writable && !m_packFile.exists() ) {
+        if ( QFile::exists( newPack ) ) {
+            // Interrupted while replacing the pack by its compacted copy, the index is rebuilt from the records
+            QFile::rename( newPack, m_packFile.fileName() );
+            QFile::remove( m_indexFile.fileName() );
+        } else {
+            // The compacted copy could not replace the pack, the index still belongs to the old one
+            QFile::rename( oldPack, m_packFile.fileName() );
+        }
+    }
+    if ( m_writable ) {
+        QFile::remove( oldPack );
+    }
+
+    const QIODevice::OpenMode mode = m_writable ? QIODevice::ReadWrite : QIODevice::ReadOnly;
+    if ( !m_packFile.open( mode ) ) {
+        mDebug() << "Cannot open tile pack" << m_packFile.fileName() << m_packFile.errorString();
+        return false;
+    }
+
+    if ( !m_indexFile.open( mode ) ) {
+        mDebug() << "Cannot open tile pack index" << m_indexFile.fileName() << m_indexFile.errorString();
+        m_packFile.close();
+        return false;
+    }
+
+    readIndex();
+    if ( m_writable ) {
+        recover();
+    }
+    mapRange( 0, m_end );
+
+    return true;
+}
+
+void TilePack::Private::readIndex()
+{
+    const qint64 indexSize = m_indexFile.size();
+    if ( indexSize == 0 ) {
+        return;
+    }
+
+    uchar *const memory = m_indexFile.map( 0, indexSize );
+    if ( !memory ) {
+        mDebug() << "Cannot map tile pack index" << m_indexFile.fileName();
+        if ( m_writable ) {
+            m_indexFile.resize( 0 );
+        }
+        return;
+    }
+
+    const QByteArray raw = QByteArray::fromRawData( reinterpret_cast<const char *>( memory ), indexSize );
+    QDataStream stream( raw );
+    stream.setVersion( QDataStream::Qt_4_5 );
+
+    const quint64 packSize = m_packFile.size();
+    qint64 validSize = 0;
+    while ( !stream.atEnd() ) {
+        QString key;
+        IndexEntry entry;
+        stream >> key >> entry.offset >> entry.size >> entry.lastModified;
+        if ( stream.status() != QDataStream::Ok || entry.offset + entry.size > packSize ) {
+            break;
+        }
+
+        QHash<QString, IndexEntry>::const_iterator const replaced = m_index.constFind( key );
+        if ( replaced != m_index.constEnd() ) {
+            m_garbage += recordSize( key, replaced.value().size );
+        }
+        m_index.insert( key, entry );
+        m_end = qMax( m_end, entry.offset + entry.size );
+        validSize = stream.device()->pos();
+    }
+
+    m_indexFile.unmap( memory );
+
+    if ( validSize < indexSize && m_writable ) {
+        mDebug() << "Truncating damaged tile pack index" << m_indexFile.fileName() << "at" << validSize;
+        m_indexFile.resize( validSize );
+    }
+}
+
+void TilePack::Private::recover()
+{
+    // Records appended after the last index update, e.g. before a crash
+    const quint64 packSize = m_packFile.size();
+    if ( m_end >= packSize ) {
+        return;
+    }
+
+    m_packFile.seek( m_end );
+    m_indexFile.seek( m_indexFile.size() );
+    QDataStream packStream( &m_packFile );
+    packStream.setVersion( QDataStream::Qt_4_5 );
+    QDataStream indexStream( &m_indexFile );
+    indexStream.setVersion( QDataStream::Qt_4_5 );
+
+    int recovered = 0;
+    while ( m_end < packSize ) {
+        quint32 magic;
+        QString key;
+        IndexEntry entry;
+        packStream >> magic >> key >> entry.lastModified >> entry.size;
+        entry.offset = m_packFile.pos();
+        if ( packStream.status() != QDataStream::Ok || magic != recordMagic
+             || entry.offset + entry.size > packSize ) {
+            break;
+        }
+
+        indexStream << key << entry.offset << entry.size << entry.lastModified;
+        QHash<QString, IndexEntry>::const_iterator const replaced = m_index.constFind( key );
+        if ( replaced != m_index.constEnd() ) {
+            m_garbage += recordSize( key, replaced.value().size );
+        }
+        m_index.insert( key, entry );
+        m_end = entry.offset + entry.size;
+        m_packFile.seek( m_end );
+        ++recovered;
+    }
+
+    m_indexFile.flush();
+
+    if ( m_end < packSize ) {
+        mDebug() << "Truncating damaged tile pack" << m_packFile.fileName() << "at" << m_end;
+        m_packFile.resize( m_end );
+    }
+
+    mDebug() << "Recovered" << recovered << "tiles in" << m_packFile.fileName();
+}
+
+void TilePack::Private::mapRange( quint64 start, quint64 end )
+{
+    if ( end <= start ) {
+        return;
+    }
+
+    uchar *const memory = m_packFile.map( start, end - start );
+    if ( !memory ) {
+        mDebug() << "Cannot map tile pack" << m_packFile.fileName() << m_packFile.errorString();
+        return;
+    }
+
+    Mapping mapping;
+    mapping.start = start;
+    mapping.length = end - start;
+    mapping.memory = memory;
+    m_mappings.append( mapping );
+}
+
+const uchar *TilePack::Private::memory( quint64 offset ) const
+{
+    // Mappings are sorted and disjoint since they are only ever appended
+    int low = 0;
+    int high = m_mappings.size() - 1;
+    while ( low <= high ) {
+        const int middle = ( low + high ) / 2;
+        const Mapping &mapping = m_mappings.at( middle );
+        if ( offset < mapping.start ) {
+            high = middle - 1;
+        } else if ( offset >= mapping.start + mapping.length ) {
+            low = middle + 1;
+        } else {
+            return mapping.memory + ( offset - mapping.start );
+        }
+    }
+
+    return 0;
+}
+
+QByteArray TilePack::Private::recordData( const IndexEntry &entry ) const
+{
+    // Refers to the mapped pack, only valid while m_mutex is held
+    const uchar *const mapped = memory( entry.offset );
+    if ( mapped ) {
+        return QByteArray::fromRawData( reinterpret_cast<const char *>( mapped ), entry.size );
+    }
+
+    // Mapping failed, e.g. due to exhausted address space
+    QFile &file = const_cast<QFile &>( m_packFile );
+    file.seek( entry.offset );
+    return file.read( entry.size );
+}
+
+void TilePack::Private::writePending()
+{
+    if ( m_pending.isEmpty() || !m_packFile.isOpen() || !m_writable ) {
+        return;
+    }
+
+    QHash<QString, IndexEntry> written;
+    m_packFile.seek( m_end );
+    QDataStream packStream( &m_packFile );
+    packStream.setVersion( QDataStream::Qt_4_5 );
+
+    QHash<QString, PendingEntry>::const_iterator it = m_pending.constBegin();
+    QHash<QString, PendingEntry>::const_iterator const end = m_pending.constEnd();
+    for (; it != end; ++it ) {
+        IndexEntry entry;
+        entry.size = it.value().data.size();
+        entry.lastModified = it.value().lastModified;
+        packStream << recordMagic << it.key() << entry.lastModified << entry.size;
+        entry.offset = m_packFile.pos();
+        packStream.writeRawData( it.value().data.constData(), entry.size );
+        written.insert( it.key(), entry );
+    }
+
+    if ( packStream.status() != QDataStream::Ok || !m_packFile.flush() ) {
+        // The tiles stay buffered and are written with the next batch
+        mDebug() << "Cannot write tile pack" << m_packFile.fileName() << m_packFile.errorString();
+        m_packFile.resize( m_end );
+        return;
+    }
+
+    m_pending.clear();
+    m_pendingSize = 0;
+
+    // The index is only updated once the tiles are on disk
+    const quint64 newEnd = m_packFile.pos();
+    mapRange( m_end, newEnd );
+    m_end = newEnd;
+
+    m_indexFile.seek( m_indexFile.size() );
+    QDataStream indexStream( &m_indexFile );
+    indexStream.setVersion( QDataStream::Qt_4_5 );
+    QHash<QString, IndexEntry>::const_iterator pos = written.constBegin();
+    QHash<QString, IndexEntry>::const_iterator const writtenEnd = written.constEnd();
+    for (; pos != writtenEnd; ++pos ) {
+        indexStream << pos.key() << pos.value().offset << pos.value().size << pos.value().lastModified;
+        QHash<QString, IndexEntry>::const_iterator const replaced = m_index.constFind( pos.key() );
+        if ( replaced != m_index.constEnd() ) {
+            m_garbage += recordSize( pos.key(), replaced.value().size );
+        }
+        m_index.insert( pos.key(), pos.value() );
+    }
+    m_indexFile.flush();
+}
+
+void TilePack::Private::writeFile( const QString &key, const QByteArray &data ) const
+{
+    const QString fileName = m_directory + '/' + key;
+    QDir::root().mkpath( QFileInfo( fileName ).path() );
+
+    QFile file( fileName );
+    if ( !file.open( QIODevice::WriteOnly ) || file.write( data ) != data.size() ) {
+        mDebug() << "Cannot write tile" << fileName << file.errorString();
+    }
+}
+
+bool TilePack::Private::isFileNewer( const QString &key ) const
+{
+    // Only read-only packs store tiles as files, the writing process imports them
+    if ( m_writable ) {
+        return false;
+    }
+
+    const QFileInfo info( m_directory + '/' + key );
+    if ( !info.exists() ) {
+        return false;
+    }
+
+    QHash<QString, IndexEntry>::const_iterator const it = m_index.constFind( key );
+    return it == m_index.constEnd() || info.lastModified().toTime_t() > it.value().lastModified;
+}
+
+IndexEntry TilePack::Private::copyRecord( QDataStream &stream, const QString &key, const IndexEntry &entry ) const
+{
+    const QByteArray data = recordData( entry );
+    stream << recordMagic << key << entry.lastModified << entry.size;
+
+    IndexEntry copy = entry;
+    copy.offset = stream.device()->pos();
+    stream.writeRawData( data.constData(), data.size() );
+    return copy;
+}
+
+qint64 TilePack::Private::rewrite( const QSet<QString> &removed )
+{
+    QMutexLocker rewriteLocker( &m_rewriteMutex );
+    if ( !m_writable || !m_packFile.isOpen() ) {
+        return 0;
+    }
+
+    QFile pack( m_packFile.fileName() + newPackSuffix );
+    if ( !pack.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+        mDebug() << "Cannot rewrite tile pack" << pack.fileName() << pack.errorString();
+        return 0;
+    }
+    QDataStream packStream( &pack );
+    packStream.setVersion( QDataStream::Qt_4_5 );
+
+    // Copy the kept records in the order of the old pack, tiles can be
+    // read and inserted in between
+    QList<QPair<quint64, QString> > order;
+    {
+        QMutexLocker locker( &m_mutex );
+        writePending();
+        QHash<QString, IndexEntry>::const_iterator it = m_index.constBegin();
+        QHash<QString, IndexEntry>::const_iterator const end = m_index.constEnd();
+        for (; it != end; ++it ) {
+            if ( !removed.contains( it.key() ) ) {
+                order.append( qMakePair( it.value().offset, it.key() ) );
+            }
+        }
+    }
+    qSort( order );
+
+    QHash<QString, IndexEntry> copied;
+    QHash<QString, quint64> sources;
+    for ( int i = 0; i < order.size(); ++i ) {
+        QMutexLocker locker( &m_mutex );
+        const QString &key = order.at( i ).second;
+        const IndexEntry entry = m_index.value( key );
+        if ( entry.offset == order.at( i ).first ) {
+            copied.insert( key, copyRecord( packStream, key, entry ) );
+            sources.insert( key, entry.offset );
+        }
+    }
+
+    // Tiles written meanwhile are copied last
+    QMutexLocker locker( &m_mutex );
+    writePending();
+    QHash<QString, IndexEntry>::const_iterator it = m_index.constBegin();
+    QHash<QString, IndexEntry>::const_iterator const end = m_index.constEnd();
+    for (; it != end; ++it ) {
+        if ( !removed.contains( it.key() ) && sources.value( it.key(), quint64( -1 ) ) != it.value().offset ) {
+            copied.insert( it.key(), copyRecord( packStream, it.key(), it.value() ) );
+        }
+    }
+
+    const quint64 newEnd = pack.pos();
+    if ( packStream.status() != QDataStream::Ok || !pack.flush() ) {
+        mDebug() << "Cannot rewrite tile pack" << pack.fileName() << pack.errorString();
+        pack.remove();
+        return 0;
+    }
+    pack.close();
+
+    // Processes reading the old pack keep their mapping of it
+    const QString packPath = m_packFile.fileName();
+    const QString oldPackPath = packPath + oldPackSuffix;
+    unmapAll();
+    m_packFile.close();
+    QFile::remove( oldPackPath );
+    if ( !QFile::rename( packPath, oldPackPath ) ) {
+        mDebug() << "Cannot replace tile pack" << packPath;
+        pack.remove();
+        m_packFile.open( QIODevice::ReadWrite );
+        mapRange( 0, m_end );
+        return 0;
+    }
+    if ( !pack.rename( packPath ) ) {
+        // Keep using the old pack along with its index
+        mDebug() << "Cannot replace tile pack" << packPath << pack.errorString();
+        pack.remove();
+        QFile::rename( oldPackPath, packPath );
+        m_packFile.open( QIODevice::ReadWrite );
+        mapRange( 0, m_end );
+        return 0;
+    }
+    QFile::remove( oldPackPath );
+
+    const quint64 oldEnd = m_end;
+    m_packFile.open( QIODevice::ReadWrite );
+    m_index = copied;
+    m_end = newEnd;
+    m_garbage = 0;
+    mapRange( 0, m_end );
+
+    // Entries are written in pack order: if this is interrupted,
+    // the missing ones are recovered from the records of the pack
+    QList<QPair<quint64, QString> > entries;
+    for ( it = m_index.constBegin(); it != m_index.constEnd(); ++it ) {
+        entries.append( qMakePair( it.value().offset, it.key() ) );
+    }
+    qSort( entries );
+
+    m_indexFile.resize( 0 );
+    m_indexFile.seek( 0 );
+    QDataStream indexStream( &m_indexFile );
+    indexStream.setVersion( QDataStream::Qt_4_5 );
+    for ( int i = 0; i < entries.size(); ++i ) {
+        const IndexEntry &entry = m_index[ entries.at( i ).second ];
+        indexStream << entries.at( i ).second << entry.offset << entry.size << entry.lastModified;
+    }
+    m_indexFile.flush();
+
+    return qint64( oldEnd ) - qint64( newEnd );
+}
+
+void TilePack::Private::unmapAll()
+{
+    foreach ( const Mapping &mapping, m_mappings ) {
+        m_packFile.unmap( mapping.memory );
+    }
+    m_mappings.clear();
+}
+
+TilePack::TilePack( const QString &directory )
+    : d( new Private( directory ) )
+{
+    if ( d->openFiles() && d->m_writable ) {
+        d->m_import = QtConcurrent::run( this, &TilePack::importDirectory );
+    }
+}
+
+TilePack::~TilePack()
+{
+    d->m_closing = 1;
+    d->m_import.waitForFinished();
+    d->m_compaction.waitForFinished();
+    flush();
+    d->unmapAll();
+    delete d;
+}
+
+TilePack *TilePack::open( const QString &directory )
+{
+    const QString path = QDir::cleanPath( directory );
+
+    QMutexLocker locker( &s_packsMutex );
+    TilePack *pack = s_packs.value( path );
+    if ( !pack ) {
+        if ( s_packs.isEmpty() ) {
+            qAddPostRoutine( closeAll );
+        }
+        pack = new TilePack( path );
+        s_packs.insert( path, pack );
+    }
+
+    return pack;
+}
+
+TilePack *TilePack::find( const QString &fileName, QString *key )
+{
+    const QString path = QDir::cleanPath( fileName );
+
+    QMutexLocker locker( &s_packsMutex );
+    QHash<QString, TilePack *>::const_iterator it = s_packs.constBegin();
+    QHash<QString, TilePack *>::const_iterator const end = s_packs.constEnd();
+    for (; it != end; ++it ) {
+        if ( path.startsWith( it.key() + '/' ) ) {
+            if ( key ) {
+                *key = path.mid( it.key().length() + 1 );
+            }
+            return it.value();
+        }
+    }
+
+    return 0;
+}
+
+QList<TilePack *> TilePack::packs()
+{
+    QMutexLocker locker( &s_packsMutex );
+    return s_packs.values();
+}
+
+void TilePack::closeAll()
+{
+    QMutexLocker locker( &s_packsMutex );
+    qDeleteAll( s_packs );
+    s_packs.clear();
+}
+
+QString TilePack::directory() const
+{
+    return d->m_directory;
+}
+
+QString TilePack::fileName() const
+{
+    return d->m_packFile.fileName();
+}
+
+bool TilePack::isWritable() const
+{
+    return d->m_writable;
+}
+
+qint64 TilePack::size() const
+{
+    QMutexLocker locker( &d->m_mutex );
+    return d->m_end + d->m_pendingSize;
+}
+
+bool TilePack::contains( const QString &key ) const
+{
+    QMutexLocker locker( &d->m_mutex );
+    return d->m_pending.contains( key ) || d->m_index.contains( key ) || d->isFileNewer( key );
+}
+
+QDateTime TilePack::lastModified( const QString &key ) const
+{
+    QMutexLocker locker( &d->m_mutex );
+    if ( d->m_pending.contains( key ) ) {
+        return QDateTime::fromTime_t( d->m_pending.value( key ).lastModified );
+    }
+
+    if ( d->isFileNewer( key ) ) {
+        return QFileInfo( d->m_directory + '/' + key ).lastModified();
+    }
+
+    QHash<QString, IndexEntry>::const_iterator const it = d->m_index.constFind( key );
+    if ( it == d->m_index.constEnd() ) {
+        return QDateTime();
+    }
+
+    return QDateTime::fromTime_t( it.value().lastModified );
+}
+
+QByteArray TilePack::data( const QString &key ) const
+{
+    QMutexLocker locker( &d->m_mutex );
+    QHash<QString, PendingEntry>::const_iterator const pending = d->m_pending.constFind( key );
+    if ( pending != d->m_pending.constEnd() ) {
+        return pending.value().data;
+    }
+
+    if ( d->isFileNewer( key ) ) {
+        QFile file( d->m_directory + '/' + key );
+        if ( file.open( QIODevice::ReadOnly ) ) {
+            return file.readAll();
+        }
+    }
+
+    QHash<QString, IndexEntry>::const_iterator const it = d->m_index.constFind( key );
+    if ( it == d->m_index.constEnd() ) {
+        return QByteArray();
+    }
+
+    // Copy the tile while the mapping can't go away
+    QByteArray data = d->recordData( it.value() );
+    data.detach();
+    return data;
+}
+
+void TilePack::insert( const QString &key, const QByteArray &data, const QDateTime &lastModified )
+{
+    if ( !d->m_writable ) {
+        d->writeFile( key, data );
+        return;
+    }
+
+    QMutexLocker locker( &d->m_mutex );
+    if ( d->m_pending.isEmpty() ) {
+        d->m_pendingSince = QDateTime::currentDateTime();
+    }
+
+    PendingEntry entry;
+    entry.data = data;
+    entry.lastModified = lastModified.toTime_t();
+    d->m_pendingSize += data.size() - d->m_pending.value( key ).data.size();
+    d->m_pending.insert( key, entry );
+
+    if ( d->m_pendingSize >= maximumPendingSize
+         || d->m_pendingSince.secsTo( QDateTime::currentDateTime() ) >= maximumPendingAge ) {
+        d->writePending();
+    }
+
+    if ( d->m_garbage >= qMax( minimumCompactionSize, d->m_end / 2 ) && !d->m_compaction.isRunning()
+         && d->m_closing == 0 ) {
+        d->m_compaction = QtConcurrent::run( this, &TilePack::compact );
+    }
+}
+
+void TilePack::flush()
+{
+    QMutexLocker locker( &d->m_mutex );
+    d->writePending();
+}
+
+qint64 TilePack::clear( int maximumKeptLevel )
+{
+    d->m_import.waitForFinished();
+
+    QSet<QString> removed;
+    {
+        QMutexLocker locker( &d->m_mutex );
+        d->writePending();
+        foreach ( const QString &key, d->m_index.keys() ) {
+            if ( tileLevel( key ) > maximumKeptLevel ) {
+                removed.insert( key );
+            }
+        }
+    }
+
+    return d->rewrite( removed );
+}
+
+qint64 TilePack::shrink( qint64 bytes )
+{
+    QSet<QString> removed;
+    {
+        QMutexLocker locker( &d->m_mutex );
+        d->writePending();
+
+        // Meta data is removed along with its tile
+        QList<QPair<quint32, QString> > tiles;
+        QHash<QString, IndexEntry>::const_iterator it = d->m_index.constBegin();
+        QHash<QString, IndexEntry>::const_iterator const end = d->m_index.constEnd();
+        for (; it != end; ++it ) {
+            if ( tileLevel( it.key() ) > maxBaseTileLevel && !it.key().endsWith( QLatin1String( ".meta" ) ) ) {
+                tiles.append( qMakePair( it.value().lastModified, it.key() ) );
+            }
+        }
+        qSort( tiles );
+
+        // The garbage of replaced tiles is freed as well
+        qint64 selected = d->m_garbage;
+        for ( int i = 0; i < tiles.size() && selected < bytes; ++i ) {
+            const QString &key = tiles.at( i ).second;
+            const QString metaDataKey = TileMetaData::metaDataFileName( key );
+            removed << key << metaDataKey;
+            selected += recordSize( key, d->m_index.value( key ).size );
+            if ( d->m_index.contains( metaDataKey ) ) {
+                selected += recordSize( metaDataKey, d->m_index.value( metaDataKey ).size );
+            }
+        }
+    }
+
+    return d->rewrite( removed );
+}
+
+qint64 TilePack::compact()
+{
+    const qint64 freed = d->rewrite( QSet<QString>() );
+    mDebug() << "Compacted" << d->m_packFile.fileName() << "by" << freed << "bytes";
+    return freed;
+}
+
+void TilePack::importDirectory()
+{
+    const QDir directory( d->m_directory );
+    QStringList imported;
+    QSet<QString> directories;
+
+    QDirIterator it( d->m_directory, QDir::Files | QDir::NoSymLinks, QDirIterator::Subdirectories );
+    bool done = false;
+    while ( !done ) {
+        done = !it.hasNext() || d->m_closing == 1;
+        if ( !done ) {
+            it.next();
+            const QString key = directory.relativeFilePath( it.filePath() );
+
+            // Base tiles stay files, they are part of the installed theme. Files written by
+            // read-only users of the pack replace older tiles, files of outdated tiles are removed
+            if ( tileLevel( key ) > maxBaseTileLevel ) {
+                const QDateTime fileModified = it.fileInfo().lastModified();
+                const QDateTime packModified = lastModified( key );
+                if ( !packModified.isValid() || fileModified.toTime_t() > packModified.toTime_t() ) {
+                    QFile file( it.filePath() );
+                    if ( file.open( QIODevice::ReadOnly ) ) {
+                        insert( key, file.readAll(), fileModified );
+                        imported << key;
+                        directories << key.section( '/', 0, -2 );
+                    }
+                } else {
+                    imported << key;
+                    directories << key.section( '/', 0, -2 );
+                }
+            }
+
+            if ( imported.size() < importBatchSize ) {
+                continue;
+            }
+        }
+
+        // Only remove the files whose tiles made it into the pack
+        flush();
+        foreach ( const QString &key, imported ) {
+            if ( contains( key ) ) {
+                QFile::remove( directory.filePath( key ) );
+            }
+        }
+        imported.clear();
+    }
+
+    foreach ( const QString &path, directories ) {
+        directory.rmpath( path );
+    }
+
+    if ( !directories.isEmpty() ) {
+        mDebug() << "Imported tiles of" << directories.size() << "directories into" << d->m_packFile.fileName();
+    }
+}
+
+}
@@ -0,0 +1,132 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_TILEPACK_H
+#define MARBLE_TILEPACK_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include "marble_export.h"
+
+namespace Marble
+{
+
+/**
+ * @short Single-file container for the downloaded tiles of one map theme.
+ *
+ * Tiles are appended to the file tiles.pack in the theme directory, an
+ * append-only journal tiles.idx maps each tile key (the file name relative
+ * to the theme directory, e.g. "12/2176/1421.png") to its position in the
+ * pack. The pack is memory mapped, so reading a tile does not copy it.
+ * Written tiles are buffered and appended in batches.
+ *
+ * Packs are shared: open() returns the same instance for a directory as
+ * long as the application runs. Tiles found as plain files in the
+ * directory are imported in the background when the pack is opened.
+ *
+ * Only one process writes a pack at a time. Packs opened while another
+ * process writes them are read-only; tiles inserted into them are stored
+ * as plain files, which the writing process imports on its next start.
+ * Until then, such files are used in place of older tiles of the pack.
+ * Tiles are never overwritten in place: replaced tiles stay in the pack
+ * until it is compacted, which rewrites it into a new file.
+ */
+class MARBLE_EXPORT TilePack
+{
+ public:
+    /**
+     * Returns the pack of the given theme @p directory, creating it if needed.
+     */
+    static TilePack *open( const QString &directory );
+
+    /**
+     * Returns the opened pack which stores the absolute @p fileName and
+     * sets @p key if given, or 0 if the file does not belong to a pack.
+     */
+    static TilePack *find( const QString &fileName, QString *key = 0 );
+
+    /**
+     * Returns all packs opened so far.
+     */
+    static QList<TilePack *> packs();
+
+    /**
+     * Flushes and closes all packs, which happens on application exit.
+     */
+    static void closeAll();
+
+    QString directory() const;
+
+    /**
+     * Returns the path of the pack file.
+     */
+    QString fileName() const;
+
+    /**
+     * Returns whether tiles are written into this pack, see insert().
+     */
+    bool isWritable() const;
+
+    /**
+     * Returns the size of the pack file including the buffered tiles.
+     */
+    qint64 size() const;
+
+    bool contains( const QString &key ) const;
+
+    QDateTime lastModified( const QString &key ) const;
+
+    /**
+     * Returns a copy of the tile stored under @p key, or an empty array.
+     */
+    QByteArray data( const QString &key ) const;
+
+    void insert( const QString &key, const QByteArray &data,
+                 const QDateTime &lastModified = QDateTime::currentDateTime() );
+
+    /**
+     * Appends all buffered tiles to the pack.
+     */
+    void flush();
+
+    /**
+     * Removes all tiles above @p maximumKeptLevel and returns the number of bytes freed.
+     */
+    qint64 clear( int maximumKeptLevel );
+
+    /**
+     * Removes the least recently written tiles above the base tile level
+     * until at least @p bytes are freed, and returns the number of bytes freed.
+     */
+    qint64 shrink( qint64 bytes );
+
+    /**
+     * Rewrites the pack without the tiles that were replaced, and returns
+     * the number of bytes freed. Runs in the background once replaced
+     * tiles take up much of the pack.
+     */
+    qint64 compact();
+
+ private:
+    Q_DISABLE_COPY( TilePack )
+
+    explicit TilePack( const QString &directory );
+    ~TilePack();
+
+    void importDirectory();
+
+    class Private;
+    Private *const d;
+};
+
+}
+
+#endif
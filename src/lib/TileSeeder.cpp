@@ -0,0 +1,621 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "TileSeeder.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QTextStream>
+#include <QtCore/QTime>
+#include <QtCore/QTimer>
+#include <QtCore/qmath.h>
+#include <QtNetwork/QNetworkAccessManager>
+
+#include "GeoDataLatLonBox.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataLineString.h"
+#include "GeoSceneTiled.h"
+#include "HttpJob.h"
+#include "MarbleDebug.h"
+#include "MarbleDirs.h"
+#include "MarbleGlobal.h"
+#include "MarbleMath.h"
+#include "PackedStoragePolicy.h"
+#include "TileId.h"
+#include "TileMetaData.h"
+#include "TilePack.h"
+
+namespace Marble
+{
+
+// Number of tiles checked for freshness before returning to the event loop
+const int maximumTilesPerBatch = 1000;
+
+// The checkpoint is saved after this many tiles or this many ms, whatever comes first
+const int checkpointTiles = 100;
+const int checkpointInterval = 5000;
+
+// Time before a failed request is tried again in ms
+const int retryDelay = 1000;
+
+// The latitude where the Mercator projection ends
+const qreal maximumMercatorLatitude = 85.0511287798 * DEG2RAD;
+
+class TileSeeder::Private
+{
+ public:
+    Private( const GeoSceneTiled *texture, const QString &cacheDirectory );
+
+    /// A level of one of the pyramids and the index of its first tile
+    struct Level
+    {
+        qint64 firstTile;
+        int level;
+        QRect coords;
+    };
+
+    void updateLevels();
+    TileId tileAt( qint64 index ) const;
+    bool touchesPolygon( const TileId &id ) const;
+    qreal longitude( int level, int x ) const;
+    qreal latitude( int level, int y ) const;
+    QUrl tileUrl( const TileId &id ) const;
+    HttpJob *createJob( const QUrl &url, const QString &fileName, qint64 index );
+    void readCheckpoint();
+    void writeCheckpoint();
+    void finishTile( HttpJob *job );
+
+    TileSeeder *m_parent;
+    const GeoSceneTiled *const m_texture;
+    PackedStoragePolicy m_storage;
+    TilePack *m_pack;
+    QNetworkAccessManager m_networkAccessManager;
+
+    QVector<TileCoordsPyramid> m_region;
+    QVector<Level> m_levels;
+    qint64 m_tileCount;
+    GeoDataLinearRing m_polygon;
+
+    int m_maximumConnections;
+    qreal m_maximumRate;
+    QUrl m_mirror;
+    QString m_checkpointFile;
+
+    bool m_running;
+    qint64 m_nextTile;
+    QHash<HttpJob *, qint64> m_activeJobs;
+    QTime m_lastRequest;
+    QTime m_lastCheckpoint;
+    int m_tilesSinceCheckpoint;
+    bool m_startScheduled;
+
+    qint64 m_processed;
+    int m_downloaded;
+    int m_unchanged;
+    int m_skipped;
+    int m_failed;
+};
+
+TileSeeder::Private::Private( const GeoSceneTiled *texture, const QString &cacheDirectory )
+    : m_parent( 0 ),
+      m_texture( texture ),
+      m_storage( cacheDirectory.isEmpty() ? MarbleDirs::localPath() : cacheDirectory ),
+      m_pack( 0 ),
+      m_tileCount( 0 ),
+      m_maximumConnections( 4 ),
+      m_maximumRate( 0.0 ),
+      m_running( false ),
+      m_nextTile( 0 ),
+      m_tilesSinceCheckpoint( 0 ),
+      m_startScheduled( false ),
+      m_processed( 0 ),
+      m_downloaded( 0 ),
+      m_unchanged( 0 ),
+      m_skipped( 0 ),
+      m_failed( 0 )
+{
+    if ( m_texture->storageContainer() == GeoSceneTiled::Pack ) {
+        const QString directory = cacheDirectory.isEmpty() ? MarbleDirs::localPath() : cacheDirectory;
+        m_pack = TilePack::open( directory + '/' + m_texture->themeStr() );
+    }
+}
+
+void TileSeeder::Private::updateLevels()
+{
+    m_levels.clear();
+    m_tileCount = 0;
+    foreach ( const TileCoordsPyramid &pyramid, m_region ) {
+        for ( int level = pyramid.topLevel(); level <= pyramid.bottomLevel(); ++level ) {
+            Level entry;
+            entry.firstTile = m_tileCount;
+            entry.level = level;
+            entry.coords = pyramid.coords( level );
+            m_levels.append( entry );
+            m_tileCount += qint64( entry.coords.width() ) * entry.coords.height();
+        }
+    }
+}
+
+TileId TileSeeder::Private::tileAt( qint64 index ) const
+{
+    // binary search for the last level starting at or before index
+    int low = 0;
+    int high = m_levels.size() - 1;
+    while ( low < high ) {
+        const int middle = ( low + high + 1 ) / 2;
+        if ( m_levels.at( middle ).firstTile <= index )
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    const Level &level = m_levels.at( low );
+    const qint64 offset = index - level.firstTile;
+    const int x = level.coords.left() + offset % level.coords.width();
+    const int y = level.coords.top() + offset / level.coords.width();
+    return TileId( m_texture->sourceDir(), level.level, x, y );
+}
+
+qreal TileSeeder::Private::longitude( int level, int x ) const
+{
+    const int columns = m_texture->levelZeroColumns() << level;
+    return qreal( x ) / columns * 2 * M_PI - M_PI;
+}
+
+qreal TileSeeder::Private::latitude( int level, int y ) const
+{
+    const int rows = m_texture->levelZeroRows() << level;
+    if ( m_texture->projection() == GeoSceneTiled::Mercator ) {
+        return atan( sinh( M_PI - qreal( y ) / rows * 2 * M_PI ) );
+    }
+
+    return M_PI / 2 - qreal( y ) / rows * M_PI;
+}
+
+bool TileSeeder::Private::touchesPolygon( const TileId &id ) const
+{
+    if ( m_polygon.isEmpty() )
+        return true;
+
+    const qreal west = longitude( id.zoomLevel(), id.x() );
+    const qreal east = longitude( id.zoomLevel(), id.x() + 1 );
+    const qreal north = latitude( id.zoomLevel(), id.y() );
+    const qreal south = latitude( id.zoomLevel(), id.y() + 1 );
+
+    // A corner or the center of the tile is inside the polygon ...
+    const qreal lons[] = { west, east, ( west + east ) / 2 };
+    const qreal lats[] = { north, south, ( north + south ) / 2 };
+    for ( int i = 0; i < 3; ++i ) {
+        for ( int j = 0; j < 3; ++j ) {
+            if ( m_polygon.contains( GeoDataCoordinates( lons[i], lats[j] ) ) )
+                return true;
+        }
+    }
+
+    // ... or a vertex of the polygon is inside the tile
+    const GeoDataLatLonBox tileBox( north, south, east, west );
+    for ( int i = 0; i < m_polygon.size(); ++i ) {
+        if ( tileBox.contains( m_polygon.at( i ) ) )
+            return true;
+    }
+
+    return false;
+}
+
+QUrl TileSeeder::Private::tileUrl( const TileId &id ) const
+{
+    QUrl url = m_texture->downloadUrl( id );
+    if ( m_mirror.isValid() ) {
+        url.setScheme( m_mirror.scheme() );
+        url.setHost( m_mirror.host() );
+        url.setPort( m_mirror.port() );
+    }
+    return url;
+}
+
+HttpJob *TileSeeder::Private::createJob( const QUrl &url, const QString &fileName, qint64 index )
+{
+    HttpJob *const job = new HttpJob( url, fileName, QString(), &m_networkAccessManager );
+    job->setUserAgentPluginId( "TileSeeder" );
+    job->setDownloadUsage( DownloadBulk );
+    job->setIfModifiedSince( m_storage.lastModified( fileName ) );
+    job->setIfNoneMatch( m_storage.metaData( fileName ).eTag() );
+
+    QObject::connect( job, SIGNAL(dataReceived(HttpJob*,QByteArray)),
+                      m_parent, SLOT(storeTile(HttpJob*,QByteArray)) );
+    QObject::connect( job, SIGNAL(notModified(HttpJob*)),
+                      m_parent, SLOT(refreshTile(HttpJob*)) );
+    QObject::connect( job, SIGNAL(redirected(HttpJob*,QUrl)),
+                      m_parent, SLOT(redirectJob(HttpJob*,QUrl)) );
+    QObject::connect( job, SIGNAL(jobDone(HttpJob*,int)),
+                      m_parent, SLOT(retryOrFail(HttpJob*,int)) );
+
+    m_activeJobs.insert( job, index );
+    return job;
+}
+
+void TileSeeder::Private::readCheckpoint()
+{
+    if ( m_checkpointFile.isEmpty() )
+        return;
+
+    QFile file( m_checkpointFile );
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return;
+
+    QTextStream stream( &file );
+    const QString sourceDir = stream.readLine();
+    const qint64 tileCount = stream.readLine().toLongLong();
+    const qint64 nextTile = stream.readLine().toLongLong();
+
+    if ( sourceDir != m_texture->sourceDir() || tileCount != m_tileCount ) {
+        mDebug() << "Ignoring checkpoint" << m_checkpointFile << "of another region";
+        return;
+    }
+
+    mDebug() << "Resuming seeding at tile" << nextTile << "of" << tileCount;
+    m_nextTile = qBound<qint64>( 0, nextTile, m_tileCount );
+    m_processed = m_nextTile;
+}
+
+void TileSeeder::Private::writeCheckpoint()
+{
+    m_tilesSinceCheckpoint = 0;
+    m_lastCheckpoint.start();
+
+    if ( m_checkpointFile.isEmpty() )
+        return;
+
+    // All tiles before the first still running one are done
+    qint64 nextTile = m_nextTile;
+    foreach ( qint64 index, m_activeJobs ) {
+        nextTile = qMin( nextTile, index );
+    }
+
+    // Tiles written to a pack need to be on disk before they count as done
+    if ( m_pack )
+        m_pack->flush();
+
+    const QString temporaryFile = m_checkpointFile + ".new";
+    QFile file( temporaryFile );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+        qWarning() << "Cannot write checkpoint" << temporaryFile << file.errorString();
+        return;
+    }
+
+    QTextStream stream( &file );
+    stream << m_texture->sourceDir() << '\n' << m_tileCount << '\n' << nextTile << '\n';
+    stream.flush();
+    file.close();
+
+    QFile::remove( m_checkpointFile );
+    QFile::rename( temporaryFile, m_checkpointFile );
+}
+
+void TileSeeder::Private::finishTile( HttpJob *job )
+{
+    m_activeJobs.remove( job );
+    job->deleteLater();
+    ++m_processed;
+    ++m_tilesSinceCheckpoint;
+
+    if ( m_tilesSinceCheckpoint >= checkpointTiles || m_lastCheckpoint.elapsed() >= checkpointInterval )
+        writeCheckpoint();
+
+    emit m_parent->progressChanged( m_processed, m_tileCount );
+    m_parent->startJobs();
+}
+
+
+TileSeeder::TileSeeder( const GeoSceneTiled *texture, const QString &cacheDirectory, QObject *parent )
+    : QObject( parent ),
+      d( new Private( texture, cacheDirectory ) )
+{
+    d->m_parent = this;
+}
+
+TileSeeder::~TileSeeder()
+{
+    stop();
+    delete d;
+}
+
+void TileSeeder::setRegion( const QVector<TileCoordsPyramid> &region )
+{
+    Q_ASSERT( !d->m_running );
+    d->m_region = region;
+    d->updateLevels();
+}
+
+QVector<TileCoordsPyramid> TileSeeder::region() const
+{
+    return d->m_region;
+}
+
+QVector<TileCoordsPyramid> TileSeeder::boxRegion( const GeoSceneTiled *texture, const GeoDataLatLonBox &box,
+                                                  int topLevel, int bottomLevel )
+{
+    QVector<TileCoordsPyramid> result;
+    if ( box.crossesDateLine() ) {
+        result += boxRegion( texture, GeoDataLatLonBox( box.north(), box.south(), M_PI, box.west() ),
+                             topLevel, bottomLevel );
+        result += boxRegion( texture, GeoDataLatLonBox( box.north(), box.south(), box.east(), -M_PI ),
+                             topLevel, bottomLevel );
+        return result;
+    }
+
+    const int columns = texture->levelZeroColumns() << bottomLevel;
+    const int rows = texture->levelZeroRows() << bottomLevel;
+
+    const int x1 = qBound( 0, qFloor( ( box.west() + M_PI ) / ( 2 * M_PI ) * columns ), columns - 1 );
+    const int x2 = qBound( 0, qFloor( ( box.east() + M_PI ) / ( 2 * M_PI ) * columns ), columns - 1 );
+
+    int y1, y2;
+    if ( texture->projection() == GeoSceneTiled::Mercator ) {
+        const qreal north = qBound( -maximumMercatorLatitude, box.north(), maximumMercatorLatitude );
+        const qreal south = qBound( -maximumMercatorLatitude, box.south(), maximumMercatorLatitude );
+        y1 = qFloor( ( 0.5 - gdInv( north ) / ( 2 * M_PI ) ) * rows );
+        y2 = qFloor( ( 0.5 - gdInv( south ) / ( 2 * M_PI ) ) * rows );
+    }
+    else {
+        y1 = qFloor( ( 0.5 - box.north() / M_PI ) * rows );
+        y2 = qFloor( ( 0.5 - box.south() / M_PI ) * rows );
+    }
+    y1 = qBound( 0, y1, rows - 1 );
+    y2 = qBound( 0, y2, rows - 1 );
+
+    TileCoordsPyramid pyramid( topLevel, bottomLevel );
+    QRect coords;
+    coords.setCoords( qMin( x1, x2 ), qMin( y1, y2 ), qMax( x1, x2 ), qMax( y1, y2 ) );
+    pyramid.setBottomLevelCoords( coords );
+    result << pyramid;
+    return result;
+}
+
+QVector<TileCoordsPyramid> TileSeeder::pathRegion( const GeoSceneTiled *texture, const GeoDataLineString &path,
+                                                   qreal offset, int topLevel, int bottomLevel )
+{
+    QVector<TileCoordsPyramid> result;
+    const qreal radianOffset = offset / EARTH_RADIUS;
+
+    // one box around each segment of the path, like DownloadRegion::routeRegion()
+    for ( int i = 0; i < path.size(); ++i ) {
+        const GeoDataCoordinates &current = path.at( i );
+        const GeoDataCoordinates &previous = path.at( qMax( 0, i - 1 ) );
+        if ( i > 0 && current == previous )
+            continue;
+
+        const qreal north = qMax( current.latitude(), previous.latitude() ) + radianOffset;
+        const qreal south = qMin( current.latitude(), previous.latitude() ) - radianOffset;
+        const qreal maxLatitude = qMin( M_PI / 2 - radianOffset, qMax( qAbs( north ), qAbs( south ) ) );
+        const qreal lonOffset = radianOffset / qMax( 0.01, cos( maxLatitude ) );
+        const qreal east = qMin( M_PI, qMax( current.longitude(), previous.longitude() ) + lonOffset );
+        const qreal west = qMax( -M_PI, qMin( current.longitude(), previous.longitude() ) - lonOffset );
+
+        const GeoDataLatLonBox box( qMin( M_PI / 2, north ), qMax( -M_PI / 2, south ), east, west );
+        result += boxRegion( texture, box, topLevel, bottomLevel );
+    }
+
+    return result;
+}
+
+void TileSeeder::setPolygon( const GeoDataLinearRing &polygon )
+{
+    d->m_polygon = polygon;
+}
+
+void TileSeeder::setMaximumConnections( int connections )
+{
+    d->m_maximumConnections = qMax( 1, connections );
+}
+
+void TileSeeder::setMaximumRate( qreal requestsPerSecond )
+{
+    d->m_maximumRate = qMax<qreal>( 0.0, requestsPerSecond );
+}
+
+void TileSeeder::setMirror( const QUrl &mirror )
+{
+    d->m_mirror = mirror;
+}
+
+void TileSeeder::setCheckpointFile( const QString &fileName )
+{
+    d->m_checkpointFile = fileName;
+}
+
+qint64 TileSeeder::tileCount() const
+{
+    return d->m_tileCount;
+}
+
+TileId TileSeeder::tileAt( qint64 index ) const
+{
+    Q_ASSERT( 0 <= index && index < d->m_tileCount );
+    return d->tileAt( index );
+}
+
+qint64 TileSeeder::processedCount() const
+{
+    return d->m_processed;
+}
+
+int TileSeeder::downloadedCount() const
+{
+    return d->m_downloaded;
+}
+
+int TileSeeder::unchangedCount() const
+{
+    return d->m_unchanged;
+}
+
+int TileSeeder::skippedCount() const
+{
+    return d->m_skipped;
+}
+
+int TileSeeder::failedCount() const
+{
+    return d->m_failed;
+}
+
+bool TileSeeder::isRunning() const
+{
+    return d->m_running;
+}
+
+void TileSeeder::start()
+{
+    if ( d->m_running )
+        return;
+
+    d->m_running = true;
+    d->m_nextTile = 0;
+    d->m_processed = 0;
+    d->m_downloaded = 0;
+    d->m_unchanged = 0;
+    d->m_skipped = 0;
+    d->m_failed = 0;
+    d->readCheckpoint();
+    d->m_lastCheckpoint.start();
+
+    emit progressChanged( d->m_processed, d->m_tileCount );
+    startJobs();
+}
+
+void TileSeeder::stop()
+{
+    if ( !d->m_running )
+        return;
+
+    d->writeCheckpoint();
+    d->m_running = false;
+
+    // the jobs abort their requests when destroyed
+    qDeleteAll( d->m_activeJobs.keys() );
+    d->m_activeJobs.clear();
+}
+
+void TileSeeder::startJobs()
+{
+    d->m_startScheduled = false;
+    if ( !d->m_running )
+        return;
+
+    const QDateTime now = QDateTime::currentDateTime();
+    int checkedTiles = 0;
+
+    while ( d->m_activeJobs.count() < d->m_maximumConnections && d->m_nextTile < d->m_tileCount ) {
+        if ( checkedTiles >= maximumTilesPerBatch ) {
+            // let the event loop handle finished downloads before checking more tiles
+            emit progressChanged( d->m_processed, d->m_tileCount );
+            d->m_startScheduled = true;
+            QTimer::singleShot( 0, this, SLOT(startJobs()) );
+            return;
+        }
+
+        const TileId id = d->tileAt( d->m_nextTile );
+        const QString fileName = d->m_texture->relativeTileFileName( id );
+        ++checkedTiles;
+
+        const TileMetaData metaData = d->m_storage.metaData( fileName );
+        const QDateTime lastModified = d->m_storage.lastModified( fileName );
+        const bool fresh = metaData.isValid() ? !metaData.isExpired( d->m_texture->expire() )
+                                              : lastModified.isValid() && lastModified.secsTo( now ) < d->m_texture->expire();
+        if ( fresh || !d->touchesPolygon( id ) ) {
+            ++d->m_nextTile;
+            ++d->m_processed;
+            ++d->m_skipped;
+            continue;
+        }
+
+        if ( d->m_maximumRate > 0 && !d->m_lastRequest.isNull() ) {
+            const int wait = qRound( 1000 / d->m_maximumRate ) - d->m_lastRequest.elapsed();
+            if ( wait > 0 ) {
+                if ( !d->m_startScheduled ) {
+                    d->m_startScheduled = true;
+                    QTimer::singleShot( wait, this, SLOT(startJobs()) );
+                }
+                return;
+            }
+        }
+        d->m_lastRequest.start();
+
+        HttpJob *const job = d->createJob( d->tileUrl( id ), fileName, d->m_nextTile );
+        ++d->m_nextTile;
+        job->execute();
+    }
+
+    if ( d->m_nextTile >= d->m_tileCount && d->m_activeJobs.isEmpty() ) {
+        d->m_running = false;
+        if ( d->m_pack )
+            d->m_pack->flush();
+        if ( !d->m_checkpointFile.isEmpty() )
+            QFile::remove( d->m_checkpointFile );
+
+        mDebug() << "Seeding finished:" << d->m_downloaded << "downloaded," << d->m_unchanged << "unchanged,"
+                 << d->m_skipped << "skipped," << d->m_failed << "failed";
+        emit progressChanged( d->m_processed, d->m_tileCount );
+        emit finished();
+    }
+}
+
+void TileSeeder::storeTile( HttpJob *job, const QByteArray &data )
+{
+    if ( d->m_storage.updateFile( job->destinationFileName(), data )
+         && d->m_storage.updateMetaData( job->destinationFileName(), job->metaData() ) ) {
+        ++d->m_downloaded;
+    }
+    else {
+        qWarning() << "Could not save" << job->destinationFileName() << d->m_storage.lastErrorMessage();
+        ++d->m_failed;
+    }
+
+    d->finishTile( job );
+}
+
+void TileSeeder::refreshTile( HttpJob *job )
+{
+    // the new expiry time marks the stored tile as fresh
+    if ( d->m_storage.updateMetaData( job->destinationFileName(), job->metaData() ) ) {
+        ++d->m_unchanged;
+    }
+    else {
+        ++d->m_failed;
+    }
+
+    d->finishTile( job );
+}
+
+void TileSeeder::redirectJob( HttpJob *job, const QUrl &redirectionTarget )
+{
+    const qint64 index = d->m_activeJobs.take( job );
+    job->deleteLater();
+
+    HttpJob *const redirectedJob = d->createJob( redirectionTarget, job->destinationFileName(), index );
+    redirectedJob->execute();
+}
+
+void TileSeeder::retryOrFail( HttpJob *job, int errorCode )
+{
+    if ( job->tryAgain() ) {
+        mDebug() << "Download of" << job->sourceUrl() << "failed with" << errorCode << ", trying again";
+        QTimer::singleShot( retryDelay, job, SLOT(execute()) );
+        return;
+    }
+
+    qWarning() << "Download of" << job->sourceUrl() << "failed";
+    ++d->m_failed;
+    d->finishTile( job );
+}
+
+}
+
+#include "TileSeeder.moc"
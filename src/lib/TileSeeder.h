@@ -0,0 +1,155 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_TILESEEDER_H
+#define MARBLE_TILESEEDER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QUrl>
+#include <QtCore/QVector>
+
+#include "TileCoordsPyramid.h"
+#include "marble_export.h"
+
+namespace Marble
+{
+
+class GeoDataLatLonBox;
+class GeoDataLinearRing;
+class GeoDataLineString;
+class GeoSceneTiled;
+class HttpJob;
+class TileId;
+
+/**
+ * @short Downloads all tiles of a region into the local tile store without user interface.
+ *
+ * The seeder walks the tiles of the region level by level, skips tiles which
+ * are stored and not expired yet, revalidates expired ones with conditional
+ * requests and writes the downloaded tiles into the store directly. The
+ * number of concurrent requests and the request rate are bounded.
+ *
+ * If a checkpoint file is set, the progress is saved there regularly and a
+ * later run of the same region continues where the previous one stopped.
+ */
+class MARBLE_EXPORT TileSeeder : public QObject
+{
+    Q_OBJECT
+
+ public:
+    /**
+     * Creates a seeder for the tiles of @p texture, which are stored below
+     * @p cacheDirectory, the local data directory of Marble by default.
+     */
+    explicit TileSeeder( const GeoSceneTiled *texture, const QString &cacheDirectory = QString(),
+                         QObject *parent = 0 );
+    ~TileSeeder();
+
+    /**
+     * Sets the tiles to download, e.g. as computed by DownloadRegion.
+     */
+    void setRegion( const QVector<TileCoordsPyramid> &region );
+    QVector<TileCoordsPyramid> region() const;
+
+    /**
+     * Returns the tiles of @p texture covering @p box on the levels @p topLevel to @p bottomLevel.
+     */
+    static QVector<TileCoordsPyramid> boxRegion( const GeoSceneTiled *texture, const GeoDataLatLonBox &box,
+                                                 int topLevel, int bottomLevel );
+
+    /**
+     * Returns the tiles of @p texture covering the corridor of @p offset meters
+     * around @p path on the levels @p topLevel to @p bottomLevel.
+     */
+    static QVector<TileCoordsPyramid> pathRegion( const GeoSceneTiled *texture, const GeoDataLineString &path,
+                                                  qreal offset, int topLevel, int bottomLevel );
+
+    /**
+     * Restricts the region to the tiles touching @p polygon.
+     */
+    void setPolygon( const GeoDataLinearRing &polygon );
+
+    /**
+     * Sets the maximum number of concurrent requests, 4 by default.
+     */
+    void setMaximumConnections( int connections );
+
+    /**
+     * Sets the maximum number of requests started per second, 0 (the default) means unlimited.
+     */
+    void setMaximumRate( qreal requestsPerSecond );
+
+    /**
+     * Downloads from the server of @p mirror instead of the servers of the map theme.
+     * Only scheme, host and port are taken from @p mirror.
+     */
+    void setMirror( const QUrl &mirror );
+
+    void setCheckpointFile( const QString &fileName );
+
+    /**
+     * Returns the number of tiles in the region.
+     */
+    qint64 tileCount() const;
+
+    /**
+     * Returns the tile number @p index of the region, counting level by
+     * level and row by row, which is the order the tiles are seeded in.
+     */
+    TileId tileAt( qint64 index ) const;
+
+    /**
+     * Returns the number of tiles which have been handled, including
+     * the ones handled by a previous run according to the checkpoint.
+     */
+    qint64 processedCount() const;
+
+    int downloadedCount() const;
+    int unchangedCount() const;
+    int skippedCount() const;
+    int failedCount() const;
+
+    bool isRunning() const;
+
+ public Q_SLOTS:
+    /**
+     * Starts or resumes seeding.
+     */
+    void start();
+
+    /**
+     * Cancels all running downloads and saves the checkpoint.
+     */
+    void stop();
+
+ Q_SIGNALS:
+    void progressChanged( qint64 processed, qint64 total );
+
+    /**
+     * Emitted when all tiles of the region have been handled.
+     */
+    void finished();
+
+ private Q_SLOTS:
+    void startJobs();
+    void storeTile( HttpJob *job, const QByteArray &data );
+    void refreshTile( HttpJob *job );
+    void redirectJob( HttpJob *job, const QUrl &redirectionTarget );
+    void retryOrFail( HttpJob *job, int errorCode );
+
+ private:
+    Q_DISABLE_COPY( TileSeeder )
+
+    class Private;
+    Private *const d;
+};
+
+}
+
+#endif
@@ -20,6 +20,7 @@
 // Marble
 #include "MarbleDebug.h"
 #include "GeoDataFeature.h"
+#include "GeoDataDocument.h"
 #include "GeoDataFolder.h"
 #include "GeoDataPlacemark.h"
 
@@ -270,19 +271,24 @@ void GeoDataContainer::unpack( QDataStream& stream )
         stream >> featureId;
         switch( featureId ) {
             case GeoDataDocumentId:
-                /* not usable!!!! */ break;
+                {
+                GeoDataDocument *document = new GeoDataDocument;
+                document->unpack( stream );
+                append( document );
+                }
+                break;
             case GeoDataFolderId:
                 {
                 GeoDataFolder *folder = new GeoDataFolder;
                 folder->unpack( stream );
-                p()->m_vector.append( folder );
+                append( folder );
                 }
                 break;
             case GeoDataPlacemarkId:
                 {
                 GeoDataPlacemark *placemark = new GeoDataPlacemark;
                 placemark->unpack( stream );
-                p()->m_vector.append( placemark );
+                append( placemark );
                 }
                 break;
             case GeoDataNetworkLinkId:
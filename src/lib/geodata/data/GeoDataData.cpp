@@ -86,6 +86,7 @@ void GeoDataData::pack( QDataStream& stream ) const
 {
     GeoDataObject::pack( stream );
 
+    stream << d->m_name;
     stream << d->m_value;
     stream << d->m_displayName;
 }
@@ -94,6 +95,7 @@ void GeoDataData::unpack( QDataStream& stream )
 {
     GeoDataObject::unpack( stream );
 
+    stream >> d->m_name;
     stream >> d->m_value;
     stream >> d->m_displayName;
 }
@@ -170,6 +170,12 @@ void GeoDataDocument::pack( QDataStream& stream ) const
         ++iterator ) {
         iterator.value().pack( stream );
     }
+
+    stream << p()->m_styleMapHash.size();
+    QMap<QString, GeoDataStyleMap>::const_iterator mapIterator = p()->m_styleMapHash.constBegin();
+    for ( ; mapIterator != p()->m_styleMapHash.constEnd(); ++mapIterator ) {
+        mapIterator.value().pack( stream );
+    }
 }
 
 
@@ -184,7 +190,14 @@ void GeoDataDocument::unpack( QDataStream& stream )
     for( int i = 0; i < size; i++ ) {
         GeoDataStyle style;
         style.unpack( stream );
-        p()->m_styleHash.insert( style.styleId(), style );
+        addStyle( style );
+    }
+
+    stream >> size;
+    for ( int i = 0; i < size; ++i ) {
+        GeoDataStyleMap map;
+        map.unpack( stream );
+        addStyleMap( map );
     }
 }
 
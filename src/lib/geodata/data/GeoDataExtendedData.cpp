@@ -100,11 +100,25 @@ GeoDataSimpleArrayData* GeoDataExtendedData::simpleArrayData( const QString& key
 void GeoDataExtendedData::pack( QDataStream& stream ) const
 {
     GeoDataObject::pack( stream );
+
+    stream << d->hash.size();
+    QHash< QString, GeoDataData >::const_iterator iterator = d->hash.constBegin();
+    for ( ; iterator != d->hash.constEnd(); ++iterator ) {
+        iterator.value().pack( stream );
+    }
 }
 
 void GeoDataExtendedData::unpack( QDataStream& stream )
 {
     GeoDataObject::unpack( stream );
+
+    int size = 0;
+    stream >> size;
+    for ( int i = 0; i < size; ++i ) {
+        GeoDataData data;
+        data.unpack( stream );
+        d->hash.insert( data.name(), data );
+    }
 }
 
 }
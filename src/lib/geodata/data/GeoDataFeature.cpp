@@ -772,10 +772,22 @@ void GeoDataFeature::pack( QDataStream& stream ) const
     stream << d->m_phoneNumber;
     stream << d->m_description;
     stream << d->m_visible;
-//    stream << d->m_visualCategory;
+    stream << (int)d->m_visualCategory;
     stream << d->m_role;
     stream << d->m_popularity;
     stream << d->m_zoomLevel;
+    stream << d->m_styleUrl;
+    stream << d->m_descriptionCDATA;
+    d->m_extendedData.pack( stream );
+    d->m_timeSpan.pack( stream );
+    d->m_timeStamp.pack( stream );
+
+    // styles of the document are referenced by the style url, inline styles are owned
+    const bool hasInlineStyle = d->m_style && d->m_style->parent() == this;
+    stream << hasInlineStyle;
+    if ( hasInlineStyle ) {
+        d->m_style->pack( stream );
+    }
 }
 
 void GeoDataFeature::unpack( QDataStream& stream )
@@ -788,10 +800,26 @@ void GeoDataFeature::unpack( QDataStream& stream )
     stream >> d->m_phoneNumber;
     stream >> d->m_description;
     stream >> d->m_visible;
-//    stream >> (int)d->m_visualCategory;
+    int visualCategory;
+    stream >> visualCategory;
+    d->m_visualCategory = (GeoDataVisualCategory)visualCategory;
     stream >> d->m_role;
     stream >> d->m_popularity;
     stream >> d->m_zoomLevel;
+    // the style itself is resolved once the feature is part of its document
+    stream >> d->m_styleUrl;
+    stream >> d->m_descriptionCDATA;
+    d->m_extendedData.unpack( stream );
+    d->m_timeSpan.unpack( stream );
+    d->m_timeStamp.unpack( stream );
+
+    bool hasInlineStyle;
+    stream >> hasInlineStyle;
+    if ( hasInlineStyle ) {
+        GeoDataStyle *style = new GeoDataStyle;
+        style->unpack( stream );
+        setStyle( style );
+    }
 }
 
 GeoDataFeature::GeoDataVisualCategory GeoDataFeature::OsmVisualCategory(const QString &keyValue )
@@ -179,8 +179,11 @@ void GeoDataIconStyle::pack( QDataStream& stream ) const
     GeoDataColorStyle::pack( stream );
 
     stream << d->m_scale;
-    stream << d->m_icon;
+    stream << d->m_iconPath;
+    // The icon is loaded from its path on demand, only icons without one are stored
+    stream << ( d->m_iconPath.isEmpty() ? d->m_icon : QImage() );
     d->m_hotSpot.pack( stream );
+    stream << d->m_heading;
 }
 
 void GeoDataIconStyle::unpack( QDataStream& stream )
@@ -188,8 +191,10 @@ void GeoDataIconStyle::unpack( QDataStream& stream )
     GeoDataColorStyle::unpack( stream );
 
     stream >> d->m_scale;
+    stream >> d->m_iconPath;
     stream >> d->m_icon;
     d->m_hotSpot.unpack( stream );
+    stream >> d->m_heading;
 }
 
 }
@@ -18,9 +18,30 @@
 #include "Quaternion.h"
 #include "MarbleDebug.h"
 
+#include <QtCore/QDataStream>
+
 
 namespace Marble
 {
+
+namespace
+{
+
+/**
+ * Returns whether the coordinates can be copied from and to @p stream as
+ * one block, i.e. whether the stream writes qreals as native doubles.
+ */
+bool isNativeCoordinateStream( const QDataStream &stream )
+{
+    const QDataStream::ByteOrder hostOrder = QSysInfo::ByteOrder == QSysInfo::BigEndian
+                                             ? QDataStream::BigEndian : QDataStream::LittleEndian;
+    return sizeof( qreal ) == sizeof( double )
+           && stream.byteOrder() == hostOrder
+           && stream.floatingPointPrecision() == QDataStream::DoublePrecision;
+}
+
+}
+
 GeoDataLineString::GeoDataLineString( TessellationFlags f )
   : GeoDataGeometry( new GeoDataLineStringPrivate( f ) )
 {
@@ -250,6 +271,12 @@ GeoDataLineString& GeoDataLineString::operator << ( const GeoDataLineString& val
     return *this;
 }
 
+void GeoDataLineString::reserve( int size )
+{
+    GeoDataGeometry::detach();
+    p()->m_vector.reserve( size );
+}
+
 void GeoDataLineString::clear()
 {
     GeoDataGeometry::detach();
@@ -600,15 +627,29 @@ void GeoDataLineString::pack( QDataStream& stream ) const
     stream << size();
     stream << (qint32)(p()->m_tessellationFlags);
 
+    if ( !isNativeCoordinateStream( stream ) ) {
+        for( QVector<GeoDataCoordinates>::const_iterator iterator
+              = p()->m_vector.constBegin();
+             iterator != p()->m_vector.constEnd();
+             ++iterator ) {
+            iterator->pack( stream );
+        }
+        return;
+    }
+
+    // Same layout as above, but written as one block of lon, lat, altitude triples
+    QVector<double> block( 3 * size() );
+    double *value = block.data();
     for( QVector<GeoDataCoordinates>::const_iterator iterator
           = p()->m_vector.constBegin();
          iterator != p()->m_vector.constEnd();
          ++iterator ) {
-        mDebug() << "innerRing: size" << p()->m_vector.size();
-        GeoDataCoordinates coord = ( *iterator );
-        coord.pack( stream );
+        value[0] = iterator->longitude();
+        value[1] = iterator->latitude();
+        value[2] = iterator->altitude();
+        value += 3;
     }
-
+    stream.writeRawData( reinterpret_cast<const char *>( block.constData() ), block.size() * sizeof( double ) );
 }
 
 void GeoDataLineString::unpack( QDataStream& stream )
@@ -622,11 +663,25 @@ void GeoDataLineString::unpack( QDataStream& stream )
     stream >> tessellationFlags;
 
     p()->m_tessellationFlags = (TessellationFlags)(tessellationFlags);
+    p()->m_vector.reserve( size );
 
-    for(qint32 i = 0; i < size; i++ ) {
-        GeoDataCoordinates coord;
-        coord.unpack( stream );
-        p()->m_vector.append( coord );
+    if ( !isNativeCoordinateStream( stream ) ) {
+        for(qint32 i = 0; i < size; i++ ) {
+            GeoDataCoordinates coord;
+            coord.unpack( stream );
+            p()->m_vector.append( coord );
+        }
+        return;
+    }
+
+    QVector<double> block( 3 * size );
+    const int blockSize = block.size() * sizeof( double );
+    if ( stream.readRawData( reinterpret_cast<char *>( block.data() ), blockSize ) != blockSize ) {
+        stream.setStatus( QDataStream::ReadPastEnd );
+        return;
+    }
+    for( const double *value = block.constData(); value != block.constData() + block.size(); value += 3 ) {
+        p()->m_vector.append( GeoDataCoordinates( value[0], value[1], value[2] ) );
     }
 }
 
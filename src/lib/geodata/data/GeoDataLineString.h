@@ -291,6 +291,13 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
     GeoDataLineString& operator << ( const GeoDataLineString& lineString );
 
 
+/*!
+    \brief Allocates memory for at least @p size nodes.
+    Appending that many nodes does not reallocate the LineString then.
+*/
+    void reserve( int size );
+
+
 /*!
     \brief Returns an iterator that points to the begin of the LineString.
 */
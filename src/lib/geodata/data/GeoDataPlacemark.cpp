@@ -194,6 +194,11 @@ void GeoDataPlacemark::pack( QDataStream& stream ) const
     stream << p()->m_countrycode;
     stream << p()->m_area;
     stream << p()->m_population;
+    stream << ( p()->m_lookAt != 0 );
+    if ( p()->m_lookAt ) {
+        p()->m_lookAt->coordinates().pack( stream );
+        stream << p()->m_lookAt->range();
+    }
     if ( p()->m_geometry )
     {
         stream << p()->m_geometry->geometryId();
@@ -227,6 +232,19 @@ void GeoDataPlacemark::unpack( QDataStream& stream )
     stream >> p()->m_countrycode;
     stream >> p()->m_area;
     stream >> p()->m_population;
+    bool hasLookAt;
+    stream >> hasLookAt;
+    if ( hasLookAt ) {
+        GeoDataCoordinates coordinates;
+        coordinates.unpack( stream );
+        qreal range;
+        stream >> range;
+        GeoDataLookAt *lookAt = new GeoDataLookAt;
+        lookAt->setCoordinates( coordinates );
+        lookAt->setRange( range );
+        delete p()->m_lookAt;
+        p()->m_lookAt = lookAt;
+    }
     int geometryId;
     stream >> geometryId;
     switch( geometryId ) {
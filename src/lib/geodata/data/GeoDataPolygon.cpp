@@ -127,9 +127,7 @@ void GeoDataPolygon::pack( QDataStream& stream ) const
           = p()->inner.constBegin(); 
          iterator != p()->inner.constEnd();
          ++iterator ) {
-        mDebug() << "innerRing: size" << p()->inner.size();
-        GeoDataLinearRing linearRing = ( *iterator );
-        linearRing.pack( stream );
+        iterator->pack( stream );
     }
 }
 
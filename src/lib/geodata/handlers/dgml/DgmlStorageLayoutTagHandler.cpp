@@ -96,6 +96,14 @@ GeoNode* DgmlStorageLayoutTagHandler::parse(GeoParser& parser) const
         texture->setMaximumTileLevel( maximumTileLevel );
         texture->setStorageLayout( storageLayout );
         texture->setServerLayout( serverLayout );
+
+        // Attribute container, only texture tiles can be read from a pack
+        const QString containerStr = parser.attribute( dgmlAttr_container ).trimmed();
+        if ( containerStr == "Pack" && parentItem.represents( dgmlTag_Texture ) ) {
+            texture->setStorageContainer( GeoSceneTiled::Pack );
+        } else if ( !containerStr.isEmpty() && containerStr != "Directory" ) {
+            mDebug() << "Unknown storage container " << containerStr << ", falling back to default.";
+        }
     }
 
     return 0;
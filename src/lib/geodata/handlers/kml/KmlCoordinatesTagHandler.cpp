@@ -21,8 +21,7 @@
 
 #include "KmlCoordinatesTagHandler.h"
 
-#include <QtCore/QStringList>
-#include <QtCore/QRegExp>
+#include <algorithm>
 
 #include "MarbleDebug.h"
 #include "KmlElementDictionary.h"
@@ -45,6 +44,149 @@ KML_DEFINE_TAG_HANDLER( coordinates )
 
 static const bool kmlStrictSpecs = false;
 
+namespace
+{
+// Powers of ten which doubles represent exactly
+const double s_powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Up to this many significant digits the mantissa is an exact double
+const int maximumExactDigits = 15;
+
+inline bool isSpace( ushort c )
+{
+    return c == ' ' || ( c >= '\t' && c <= '\r' ) || ( c > 127 && QChar( c ).isSpace() );
+}
+
+/**
+ * Converts the number in [begin, end) like QString::toDouble() does, 0 if it
+ * is invalid. Decimals with few digits, i.e. all usual coordinates, are
+ * converted without creating a string: both the mantissa and the power of
+ * ten are exact doubles, so their product or quotient is rounded correctly.
+ */
+qreal toDouble( const ushort *begin, const ushort *end )
+{
+    const ushort *pos = begin;
+    bool const negative = pos != end && *pos == '-';
+    if ( pos != end && ( *pos == '-' || *pos == '+' ) ) {
+        ++pos;
+    }
+
+    quint64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    for ( ; pos != end && *pos >= '0' && *pos <= '9'; ++pos ) {
+        hasDigits = true;
+        mantissa = 10 * mantissa + ( *pos - '0' );
+        digits += mantissa > 0 ? 1 : 0;
+    }
+    if ( pos != end && *pos == '.' ) {
+        for ( ++pos; pos != end && *pos >= '0' && *pos <= '9'; ++pos ) {
+            hasDigits = true;
+            mantissa = 10 * mantissa + ( *pos - '0' );
+            digits += mantissa > 0 ? 1 : 0;
+            --exponent;
+        }
+    }
+    if ( hasDigits && pos != end && ( *pos == 'e' || *pos == 'E' ) ) {
+        ++pos;
+        bool const negativeExponent = pos != end && *pos == '-';
+        if ( pos != end && ( *pos == '-' || *pos == '+' ) ) {
+            ++pos;
+        }
+        int value = 0;
+        bool hasExponentDigits = false;
+        for ( ; pos != end && *pos >= '0' && *pos <= '9' && value < 1000; ++pos ) {
+            hasExponentDigits = true;
+            value = 10 * value + ( *pos - '0' );
+        }
+        hasDigits = hasExponentDigits;
+        exponent += negativeExponent ? -value : value;
+    }
+
+    if ( !hasDigits || pos != end || digits > maximumExactDigits || qAbs( exponent ) > 22 ) {
+        return QString::fromRawData( reinterpret_cast<const QChar *>( begin ), end - begin ).toDouble();
+    }
+
+    double const value = exponent < 0 ? mantissa / s_powersOfTen[-exponent]
+                                      : mantissa * s_powersOfTen[exponent];
+    return negative ? -value : value;
+}
+
+/**
+ * Splits the text of a coordinates element into tuples of comma separated
+ * numbers in a single pass over its characters. Tuples are separated by
+ * white space. Unless the KML specification is enforced, white space next
+ * to commas is allowed as well.
+ */
+class CoordinatesTokenizer
+{
+ public:
+    explicit CoordinatesTokenizer( const QString &text )
+        : m_pos( text.utf16() ),
+          m_end( text.utf16() + text.size() )
+    {
+    }
+
+    /**
+     * Reads the next tuple and returns the number of its fields, or -1 at the
+     * end of the text. Only the first three fields are stored in @p values.
+     */
+    int readTuple( qreal *values )
+    {
+        skipSpace();
+        if ( m_pos == m_end ) {
+            return -1;
+        }
+
+        int fieldCount = 0;
+        forever {
+            const ushort *const fieldBegin = m_pos;
+            while ( m_pos != m_end && *m_pos != ',' && !isSpace( *m_pos ) ) {
+                ++m_pos;
+            }
+            if ( fieldCount < 3 ) {
+                values[fieldCount] = toDouble( fieldBegin, m_pos );
+            }
+            ++fieldCount;
+
+            if ( !kmlStrictSpecs ) {
+                skipSpace();
+            }
+            if ( m_pos == m_end || *m_pos != ',' ) {
+                return fieldCount;
+            }
+            ++m_pos;
+            if ( !kmlStrictSpecs ) {
+                skipSpace();
+            }
+        }
+    }
+
+    /**
+     * Returns the number of commas in the text not read yet.
+     */
+    int commaCount() const
+    {
+        return std::count( m_pos, m_end, ushort( ',' ) );
+    }
+
+ private:
+    void skipSpace()
+    {
+        while ( m_pos != m_end && isSpace( *m_pos ) ) {
+            ++m_pos;
+        }
+    }
+
+    const ushort *m_pos;
+    const ushort *const m_end;
+};
+}
+
 // We can't use KML_DEFINE_TAG_HANDLER_GX22 because the name of the tag ("coord")
 // and the TagHandler ("KmlcoordinatesTagHandler") don't match
 static GeoTagHandlerRegistrar s_handlercoordkmlTag_nameSpaceGx22(GeoParser::QualifiedName(kmlTag_coord, kmlTag_nameSpaceGx22 ),
@@ -63,77 +205,52 @@ GeoNode* KmlcoordinatesTagHandler::parse( GeoParser& parser ) const
      || parentItem.represents( kmlTag_MultiGeometry )
      || parentItem.represents( kmlTag_LinearRing )
      || parentItem.represents( kmlTag_LatLonQuad ) ) {
-        QStringList  coordinatesLines;// = parser.readElementText().trimmed().split( QRegExp("\\s"), QString::SkipEmptyParts );
-        // Splitting using the "\\s" regexp is slow, split manually instead.
-        QString text = parser.readElementText().trimmed();
-
-        if ( !kmlStrictSpecs ) {
-            // Removing spaces before and after commas
-            for ( int i = 1; i < text.size() - 1; ++i ) {
-                if ( text[i] == ',' ) {
-                    // Before
-                    int l = i - 1;
-                    while ( l > 0 && text[l].isSpace() ) {
-                        --l;
-                    }
+        QString const text = parser.readElementText();
+        CoordinatesTokenizer tokenizer( text );
 
-                    // After
-                    int r = i + 1;
-                    while ( r < text.size() && text[r].isSpace() ) {
-                        ++r;
-                    }
+        // Line strings make up almost all coordinates, append to them directly
+        GeoDataLineString *lineString = 0;
+        if ( parentItem.represents( kmlTag_LineString ) ) {
+            lineString = parentItem.nodeAs<GeoDataLineString>();
+        } else if ( parentItem.represents( kmlTag_LinearRing ) ) {
+            lineString = parentItem.nodeAs<GeoDataLinearRing>();
+        }
 
-                    text.remove( l + 1, r - l - 1 ).insert( l + 1, ',' );
+        qreal values[3];
+        int fieldCount;
+        int coordinatesIndex = 0;
+        while ( ( fieldCount = tokenizer.readTuple( values ) ) >= 0 ) {
+            if ( lineString ) {
+                if ( coordinatesIndex == 0 ) {
+                    // All tuples have as many fields as the first one, usually
+                    int const remaining = tokenizer.commaCount() / qMax( 1, fieldCount - 1 );
+                    lineString->reserve( lineString->size() + 1 + remaining );
                 }
-            }
-        }
 
-        int index = 0;
-        bool inside = true;
-        int const size = text.size();
-        for ( int i=0; i<size; ++i ) {
-            if ( text[i].isSpace() ) {
-                if ( inside ) {
-                    coordinatesLines.append( text.mid( index, i-index ) );
-                    inside = false;
+                GeoDataCoordinates coord;
+                if ( fieldCount == 2 ) {
+                    coord.set( DEG2RAD * values[0], DEG2RAD * values[1] );
+                } else if ( fieldCount == 3 ) {
+                    coord.set( DEG2RAD * values[0], DEG2RAD * values[1], values[2] );
                 }
-                index = i+1;
-            } else {
-                inside = true;
-            }
-        }
-        coordinatesLines.append( text.mid( index ) );
-        int coordinatesIndex = 0;
-        Q_FOREACH( const QString& line, coordinatesLines ) {
-            QStringList coordinates = line.trimmed().split( ',' );
-            if ( parentItem.represents( kmlTag_Point ) && parentItem.is<GeoDataFeature>() ) {
+                lineString->append( coord );
+            } else if ( parentItem.represents( kmlTag_Point ) && parentItem.is<GeoDataFeature>() ) {
                 GeoDataCoordinates coord;
-                if ( coordinates.size() == 2 ) {
-                    coord.set( coordinates.at( 0 ).toDouble(),
-                              coordinates.at( 1 ).toDouble(), 0.0, GeoDataCoordinates::Degree );
-                } else if( coordinates.size() == 3 ) {
-                    coord.set( coordinates.at( 0 ).toDouble(),
-                               coordinates.at( 1 ).toDouble(),
-                               coordinates.at( 2 ).toDouble(),
-                               GeoDataCoordinates::Degree );
+                if ( fieldCount == 2 ) {
+                    coord.set( values[0], values[1], 0.0, GeoDataCoordinates::Degree );
+                } else if( fieldCount == 3 ) {
+                    coord.set( values[0], values[1], values[2], GeoDataCoordinates::Degree );
                 }
                 parentItem.nodeAs<GeoDataPlacemark>()->setCoordinate( coord );
             } else {
                 GeoDataCoordinates coord;
-                if ( coordinates.size() == 2 ) {
-                    coord.set( DEG2RAD * coordinates.at( 0 ).toDouble(),
-                              DEG2RAD * coordinates.at( 1 ).toDouble() );
-                } else if( coordinates.size() == 3 ) {
-                    coord.set( DEG2RAD * coordinates.at( 0 ).toDouble(),
-                              DEG2RAD * coordinates.at( 1 ).toDouble(),
-                              coordinates.at( 2 ).toDouble() );
+                if ( fieldCount == 2 ) {
+                    coord.set( DEG2RAD * values[0], DEG2RAD * values[1] );
+                } else if( fieldCount == 3 ) {
+                    coord.set( DEG2RAD * values[0], DEG2RAD * values[1], values[2] );
                 }
 
-                if ( parentItem.represents( kmlTag_LineString ) ) {
-                    parentItem.nodeAs<GeoDataLineString>()->append( coord );
-                } else if ( parentItem.represents( kmlTag_LinearRing ) ) {
-                    parentItem.nodeAs<GeoDataLinearRing>()->append( coord );
-                } else if ( parentItem.represents( kmlTag_MultiGeometry ) ) {
+                if ( parentItem.represents( kmlTag_MultiGeometry ) ) {
                     GeoDataPoint *point = new GeoDataPoint( coord );
                     parentItem.nodeAs<GeoDataMultiGeometry>()->append( point );
                 } else if ( parentItem.represents( kmlTag_Point ) ) {
@@ -170,20 +287,25 @@ GeoNode* KmlcoordinatesTagHandler::parse( GeoParser& parser ) const
     }
 
     if( parentItem.represents( kmlTag_Track ) ) {
-        QString input = parser.readElementText().trimmed();
-        if ( !kmlStrictSpecs ) {
-            input = input.replace( QRegExp( "\\s*,\\s*" ), "," );
+        QString const text = parser.readElementText();
+        CoordinatesTokenizer tokenizer( text );
+
+        // gx:coord separates the fields by spaces, so each one reads as a tuple
+        qreal values[3];
+        qreal tuple[3];
+        int fieldCount = 0;
+        while ( tokenizer.readTuple( tuple ) >= 0 ) {
+            if ( fieldCount < 3 ) {
+                values[fieldCount] = tuple[0];
+            }
+            ++fieldCount;
         }
-        QStringList coordinates = input.split( ' ' );
 
         GeoDataCoordinates coord;
-        if ( coordinates.size() == 2 ) {
-            coord.set( DEG2RAD * coordinates.at( 0 ).toDouble(),
-                       DEG2RAD * coordinates.at( 1 ).toDouble() );
-        } else if( coordinates.size() == 3 ) {
-            coord.set( DEG2RAD * coordinates.at( 0 ).toDouble(),
-                       DEG2RAD * coordinates.at( 1 ).toDouble(),
-                       coordinates.at( 2 ).toDouble() );
+        if ( fieldCount == 2 ) {
+            coord.set( DEG2RAD * values[0], DEG2RAD * values[1] );
+        } else if( fieldCount == 3 ) {
+            coord.set( DEG2RAD * values[0], DEG2RAD * values[1], values[2] );
         }
         parentItem.nodeAs<GeoDataTrack>()->appendCoordinates( coord );
     }
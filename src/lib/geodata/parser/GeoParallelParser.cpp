@@ -0,0 +1,491 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "GeoParallelParser.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QIODevice>
+#include <QtCore/QList>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+#include <climits>
+#include <cstring>
+
+#include "MarbleDebug.h"
+#include "GeoDataContainer.h"
+#include "GeoDataDocument.h"
+#include "GeoDataFeature.h"
+#include "GeoDataStyle.h"
+#include "GeoDataStyleMap.h"
+#include "GeoDataTypes.h"
+#include "GeoParser.h"
+
+namespace Marble
+{
+
+namespace
+{
+// Smaller documents are not split, nor are chunks made smaller than this
+const qint64 minimumChunkSize = 4 * 1024 * 1024;
+
+// More chunks than threads even out the different parsing times of chunks
+const int chunksPerThread = 4;
+
+struct Range
+{
+    Range( const char *data = 0, qint64 size = 0 ) : data( data ), size( size ) {}
+
+    const char *data;
+    qint64 size;
+};
+
+// Reads the concatenation of three ranges without copying them first
+class ChunkDevice : public QIODevice
+{
+ public:
+    ChunkDevice( const Range &prefix, const Range &body, const Range &suffix )
+        : m_index( 0 ),
+          m_offset( 0 )
+    {
+        m_ranges[0] = prefix;
+        m_ranges[1] = body;
+        m_ranges[2] = suffix;
+        open( QIODevice::ReadOnly );
+    }
+
+    virtual bool isSequential() const
+    {
+        return true;
+    }
+
+    virtual qint64 bytesAvailable() const
+    {
+        qint64 remaining = -m_offset;
+        for ( int i = m_index; i < 3; ++i ) {
+            remaining += m_ranges[i].size;
+        }
+        return qMax<qint64>( 0, remaining ) + QIODevice::bytesAvailable();
+    }
+
+ protected:
+    virtual qint64 readData( char *data, qint64 maxSize )
+    {
+        qint64 result = 0;
+        while ( result < maxSize && m_index < 3 ) {
+            const Range &range = m_ranges[m_index];
+            const qint64 size = qMin( maxSize - result, range.size - m_offset );
+            std::memcpy( data + result, range.data + m_offset, size );
+            result += size;
+            m_offset += size;
+            if ( m_offset == range.size ) {
+                ++m_index;
+                m_offset = 0;
+            }
+        }
+        return result;
+    }
+
+    virtual qint64 writeData( const char *, qint64 )
+    {
+        return -1;
+    }
+
+ private:
+    Range m_ranges[3];
+    int m_index;
+    qint64 m_offset;
+};
+
+class ChunkParser : public QRunnable
+{
+ public:
+    ChunkParser( GeoParallelParser::ParserFactory factory, const Range &prefix, const Range &body, const Range &suffix )
+        : m_factory( factory ),
+          m_prefix( prefix ),
+          m_body( body ),
+          m_suffix( suffix ),
+          m_document( 0 )
+    {
+        setAutoDelete( false );
+    }
+
+    virtual void run()
+    {
+        ChunkDevice device( m_prefix, m_body, m_suffix );
+        GeoParser *const parser = m_factory();
+        if ( parser->read( &device ) ) {
+            m_document = static_cast<GeoDataDocument *>( parser->releaseDocument() );
+        }
+        delete parser;
+    }
+
+    GeoParallelParser::ParserFactory const m_factory;
+    Range const m_prefix;
+    Range const m_body;
+    Range const m_suffix;
+    GeoDataDocument *m_document;
+};
+
+// Positions found by scan()
+struct Structure
+{
+    Structure() : contentBegin( -1 ), contentEnd( -1 ) {}
+
+    // behind the start tag of the container
+    int contentBegin;
+    // at the end tag of the container
+    int contentEnd;
+    // at the start tags of the children which begin a new chunk
+    QVector<int> boundaries;
+};
+
+bool startsWith( const QByteArray &data, int pos, const char *literal )
+{
+    const int length = qstrlen( literal );
+    return data.size() - pos >= length && std::memcmp( data.constData() + pos, literal, length ) == 0;
+}
+
+QByteArray localName( const QByteArray &data, int pos )
+{
+    int end = pos;
+    while ( end < data.size() && !strchr( " \t\r\n/>", data.at( end ) ) ) {
+        ++end;
+    }
+    const int colon = data.lastIndexOf( ':', end - 1 );
+    const int begin = colon >= pos ? colon + 1 : pos;
+    return data.mid( begin, end - begin );
+}
+
+/**
+ * Finds the container and the starts of its children in steps of at least
+ * @p chunkSize bytes, without a full XML parser: only the markup which may
+ * hide tags, i.e. comments, CDATA sections and attribute values, is looked
+ * at. Returns false if the document does not suit splitting.
+ */
+bool scan( const QByteArray &data, const QByteArray &containerName, int containerDepth, int chunkSize,
+           Structure &structure )
+{
+    int depth = 0;
+    int pos = 0;
+    int nextBoundary = INT_MAX;
+    forever {
+        const int open = data.indexOf( '<', pos );
+        if ( open < 0 || open + 1 >= data.size() ) {
+            break;
+        }
+
+        const char next = data.at( open + 1 );
+        if ( next == '!' ) {
+            int end;
+            if ( startsWith( data, open, "<!--" ) ) {
+                end = data.indexOf( "-->", open + 4 );
+                pos = end + 3;
+            } else if ( startsWith( data, open, "<![CDATA[" ) ) {
+                end = data.indexOf( "]]>", open + 9 );
+                pos = end + 3;
+            } else {
+                // DOCTYPE, entities declared in it might expand to markup
+                end = data.indexOf( '>', open );
+                if ( depth > 0 || data.mid( open, end - open ).contains( '[' ) ) {
+                    return false;
+                }
+                pos = end + 1;
+            }
+            if ( end < 0 ) {
+                return false;
+            }
+            continue;
+        }
+
+        if ( next == '?' ) {
+            const int end = data.indexOf( "?>", open + 2 );
+            if ( end < 0 ) {
+                return false;
+            }
+            pos = end + 2;
+            continue;
+        }
+
+        if ( next == '/' ) {
+            const int end = data.indexOf( '>', open );
+            if ( end < 0 ) {
+                return false;
+            }
+            if ( depth == containerDepth && structure.contentBegin >= 0 && structure.contentEnd < 0 ) {
+                structure.contentEnd = open;
+            }
+            --depth;
+            pos = end + 1;
+            continue;
+        }
+
+        // A start tag, its attribute values may contain '>'
+        int end = open + 1;
+        char quote = 0;
+        for ( ; end < data.size(); ++end ) {
+            const char c = data.at( end );
+            if ( quote ) {
+                if ( c == quote ) {
+                    quote = 0;
+                }
+            } else if ( c == '"' || c == '\'' ) {
+                quote = c;
+            } else if ( c == '>' ) {
+                break;
+            }
+        }
+        if ( end == data.size() ) {
+            return false;
+        }
+
+        // Elements behind the container would be parsed along with every chunk
+        if ( structure.contentEnd >= 0 ) {
+            return false;
+        }
+
+        const bool isEmpty = data.at( end - 1 ) == '/';
+        ++depth;
+        if ( structure.contentBegin < 0 ) {
+            if ( depth == containerDepth && localName( data, open + 1 ) == containerName ) {
+                if ( isEmpty ) {
+                    return false;
+                }
+                structure.contentBegin = end + 1;
+                nextBoundary = structure.contentBegin + chunkSize;
+            }
+        } else if ( depth == containerDepth + 1 && open >= nextBoundary ) {
+            structure.boundaries.append( open );
+            nextBoundary = qMin<qint64>( INT_MAX, qint64( open ) + chunkSize );
+        }
+        if ( isEmpty ) {
+            --depth;
+        }
+        pos = end + 1;
+    }
+
+    return structure.contentBegin >= 0 && structure.contentEnd >= structure.contentBegin;
+}
+
+// Points the styles of @p feature and its children to the styles of @p document
+void resolveStyles( GeoDataDocument *document, GeoDataFeature *feature,
+                    const QHash<const GeoDataStyle *, QString> &sharedStyles )
+{
+    if ( !feature->styleUrl().isEmpty() ) {
+        feature->setStyleUrl( feature->styleUrl() );
+    } else if ( sharedStyles.contains( feature->style() ) ) {
+        feature->setStyle( &document->style( sharedStyles.value( feature->style() ) ) );
+    }
+
+    if ( feature->nodeType() == GeoDataTypes::GeoDataFolderType
+         || feature->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        GeoDataContainer *const container = static_cast<GeoDataContainer *>( feature );
+        QVector<GeoDataFeature *>::Iterator i = container->begin();
+        QVector<GeoDataFeature *>::Iterator const end = container->end();
+        for ( ; i != end; ++i ) {
+            resolveStyles( document, *i, sharedStyles );
+        }
+    }
+}
+}
+
+class GeoParallelParser::Private
+{
+ public:
+    Private( ParserFactory factory, const QString &containerName, int containerDepth );
+
+    bool readSequentially( const Range &data );
+    bool readChunks( const QByteArray &data, const Structure &structure );
+    static void merge( GeoDataDocument *document, GeoDataDocument *chunk );
+
+    ParserFactory const m_factory;
+    QByteArray const m_containerName;
+    int const m_containerDepth;
+    GeoDataDocument *m_document;
+    QString m_errorString;
+    int m_chunkCount;
+};
+
+GeoParallelParser::Private::Private( ParserFactory factory, const QString &containerName, int containerDepth )
+    : m_factory( factory ),
+      m_containerName( containerName.toUtf8() ),
+      m_containerDepth( containerDepth ),
+      m_document( 0 ),
+      m_errorString(),
+      m_chunkCount( 0 )
+{
+}
+
+bool GeoParallelParser::Private::readSequentially( const Range &data )
+{
+    m_chunkCount = 1;
+
+    ChunkDevice device( Range(), data, Range() );
+    GeoParser *const parser = m_factory();
+    const bool result = parser->read( &device );
+    if ( result ) {
+        m_document = static_cast<GeoDataDocument *>( parser->releaseDocument() );
+    } else {
+        m_errorString = parser->errorString();
+    }
+    delete parser;
+
+    return result;
+}
+
+bool GeoParallelParser::Private::readChunks( const QByteArray &data, const Structure &structure )
+{
+    const Range prefix( data.constData(), structure.contentBegin );
+    const Range suffix( data.constData() + structure.contentEnd, data.size() - structure.contentEnd );
+
+    QList<ChunkParser *> chunks;
+    int begin = structure.contentBegin;
+    for ( int i = 0; i <= structure.boundaries.size(); ++i ) {
+        const int end = i < structure.boundaries.size() ? structure.boundaries.at( i ) : structure.contentEnd;
+        chunks.append( new ChunkParser( m_factory, prefix, Range( data.constData() + begin, end - begin ), suffix ) );
+        begin = end;
+    }
+
+    // The default styles are created on first use, which is not thread-safe
+    GeoDataFeature().style();
+
+    // A pool of its own cannot be exhausted by the runners waiting for it
+    QThreadPool pool;
+    foreach ( ChunkParser *chunk, chunks ) {
+        pool.start( chunk );
+    }
+    pool.waitForDone();
+
+    bool result = true;
+    foreach ( const ChunkParser *chunk, chunks ) {
+        result = result && chunk->m_document;
+    }
+
+    if ( result ) {
+        m_chunkCount = chunks.size();
+        m_document = chunks.first()->m_document;
+        for ( int i = 1; i < chunks.size(); ++i ) {
+            merge( m_document, chunks.at( i )->m_document );
+        }
+    } else {
+        foreach ( const ChunkParser *chunk, chunks ) {
+            delete chunk->m_document;
+        }
+    }
+
+    qDeleteAll( chunks );
+    return result;
+}
+
+void GeoParallelParser::Private::merge( GeoDataDocument *document, GeoDataDocument *chunk )
+{
+    // Later definitions replace earlier ones, as when parsing sequentially.
+    // Placeholders which style lookups created have no id.
+    QHash<const GeoDataStyle *, QString> sharedStyles;
+    foreach ( const GeoDataStyle &style, chunk->styles() ) {
+        if ( !style.styleId().isEmpty() ) {
+            document->addStyle( style );
+            sharedStyles.insert( &chunk->style( style.styleId() ), style.styleId() );
+        }
+    }
+    foreach ( const GeoDataStyleMap &styleMap, chunk->styleMaps() ) {
+        if ( !styleMap.styleId().isEmpty() ) {
+            document->addStyleMap( styleMap );
+        }
+    }
+
+    const QVector<GeoDataFeature *> features = chunk->featureList();
+    for ( int i = features.size() - 1; i >= 0; --i ) {
+        chunk->remove( i );
+    }
+    foreach ( GeoDataFeature *feature, features ) {
+        document->append( feature );
+        resolveStyles( document, feature, sharedStyles );
+    }
+
+    delete chunk;
+}
+
+GeoParallelParser::GeoParallelParser( ParserFactory factory, const QString &containerName, int containerDepth )
+    : d( new Private( factory, containerName, containerDepth ) )
+{
+}
+
+GeoParallelParser::~GeoParallelParser()
+{
+    delete d->m_document;
+    delete d;
+}
+
+bool GeoParallelParser::read( QIODevice *device )
+{
+    Q_ASSERT( !d->m_document );
+    d->m_errorString.clear();
+
+    QByteArray buffer;
+    Range data;
+    QFile *const file = qobject_cast<QFile *>( device );
+    uchar *const mapped = file && file->size() > 0 ? file->map( 0, file->size() ) : 0;
+    if ( mapped ) {
+        data = Range( reinterpret_cast<const char *>( mapped ), file->size() );
+    } else {
+        buffer = device->readAll();
+        data = Range( buffer.constData(), buffer.size() );
+    }
+
+    const int threadCount = QThread::idealThreadCount();
+    const qint64 chunkSize = qMax( minimumChunkSize, data.size / qMax( 1, threadCount * chunksPerThread ) );
+
+    // Chunks are wrapped into the prefix and suffix as they are, which needs an ASCII compatible encoding
+    const bool isAsciiCompatible = data.size >= 4 && data.data[0] && data.data[1] && data.data[2] && data.data[3];
+    bool result = false;
+    if ( threadCount > 1 && data.size >= 2 * minimumChunkSize && data.size < INT_MAX && isAsciiCompatible ) {
+        const QByteArray rawData = QByteArray::fromRawData( data.data, data.size );
+        Structure structure;
+        if ( scan( rawData, d->m_containerName, d->m_containerDepth, chunkSize, structure )
+             && !structure.boundaries.isEmpty() ) {
+            result = d->readChunks( rawData, structure );
+            if ( !result ) {
+                mDebug() << "Parsing in chunks failed, parsing sequentially to locate the error";
+            }
+        }
+    }
+
+    if ( !result ) {
+        result = d->readSequentially( data );
+    }
+
+    if ( mapped ) {
+        file->unmap( mapped );
+    }
+
+    return result;
+}
+
+GeoDataDocument *GeoParallelParser::releaseDocument()
+{
+    GeoDataDocument *const document = d->m_document;
+    d->m_document = 0;
+    return document;
+}
+
+QString GeoParallelParser::errorString() const
+{
+    return d->m_errorString;
+}
+
+int GeoParallelParser::chunkCount() const
+{
+    return d->m_chunkCount;
+}
+
+}
@@ -0,0 +1,82 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_GEOPARALLELPARSER_H
+#define MARBLE_GEOPARALLELPARSER_H
+
+#include <QtCore/QString>
+
+#include "geodata_export.h"
+
+class QIODevice;
+
+namespace Marble
+{
+
+class GeoDataDocument;
+class GeoParser;
+
+/**
+ * @short Parses large documents on all cores.
+ *
+ * The document is scanned for the children of its top level container,
+ * e.g. the Document element of KML files or the root element of GPX files.
+ * Runs of these children are parsed concurrently by separate parsers,
+ * each one wrapped into the part of the document before and after the
+ * container, so that every parser sees a complete, small document. The
+ * partial documents are merged into the first one afterwards: features
+ * are moved over, shared styles and style maps are copied and the styles
+ * of the moved features are resolved again in the merged document.
+ *
+ * Small documents, documents whose structure the scanner does not
+ * understand and documents with errors are parsed by a single parser as
+ * before, so errors are reported the same way.
+ */
+class GEODATA_EXPORT GeoParallelParser
+{
+ public:
+    typedef GeoParser *(*ParserFactory)();
+
+    /**
+     * Creates a parser which creates the parsers of the chunks with @p factory.
+     * The children of the element @p containerName at @p containerDepth, 1
+     * being the root element, are split into chunks. The container must be
+     * the element the parsers map to the document itself.
+     */
+    GeoParallelParser( ParserFactory factory, const QString &containerName, int containerDepth );
+    ~GeoParallelParser();
+
+    /**
+     * Reads the document from @p device. Files are memory mapped, other
+     * devices are read completely first.
+     */
+    bool read( QIODevice *device );
+
+    /**
+     * Returns the parsed document, which belongs to the caller then.
+     */
+    GeoDataDocument *releaseDocument();
+
+    QString errorString() const;
+
+    /**
+     * Returns the number of chunks the last document was parsed in, 1 if it
+     * was parsed sequentially.
+     */
+    int chunkCount() const;
+
+ private:
+    Q_DISABLE_COPY( GeoParallelParser )
+
+    class Private;
+    Private *const d;
+};
+
+}
+
+#endif
@@ -31,6 +31,7 @@ GeoSceneTiled::GeoSceneTiled( const QString& name )
       m_sourceDir(),
       m_installMap(),
       m_storageLayoutMode(Marble),
+      m_storageContainer( Directory ),
       m_serverLayout( new MarbleServerLayout( this ) ),
       m_levelZeroColumns( defaultLevelZeroColumns ),
       m_levelZeroRows( defaultLevelZeroRows ),
@@ -83,6 +84,16 @@ void GeoSceneTiled::setStorageLayout( const StorageLayout layout )
     m_storageLayoutMode = layout;
 }
 
+GeoSceneTiled::StorageContainer GeoSceneTiled::storageContainer() const
+{
+    return m_storageContainer;
+}
+
+void GeoSceneTiled::setStorageContainer( const StorageContainer container )
+{
+    m_storageContainer = container;
+}
+
 void GeoSceneTiled::setServerLayout( const ServerLayout *layout )
 {
     delete m_serverLayout;
@@ -44,6 +44,7 @@ class GEODATA_EXPORT GeoSceneTiled : public GeoSceneAbstractDataset
 {
  public:
     enum StorageLayout { Marble, OpenStreetMap, TileMapService };
+    enum StorageContainer { Directory, Pack };
     enum Projection { Equirectangular, Mercator };
 
     explicit GeoSceneTiled( const QString& name );
@@ -59,6 +60,13 @@ class GEODATA_EXPORT GeoSceneTiled : public GeoSceneAbstractDataset
     StorageLayout storageLayout() const;
     void setStorageLayout( const StorageLayout );
 
+    /**
+     * Returns whether downloaded tiles are kept as one file per tile
+     * or in a single TilePack in the local theme directory.
+     */
+    StorageContainer storageContainer() const;
+    void setStorageContainer( const StorageContainer );
+
     void setServerLayout( const ServerLayout * );
     const ServerLayout *serverLayout() const;
 
@@ -106,6 +114,7 @@ class GEODATA_EXPORT GeoSceneTiled : public GeoSceneAbstractDataset
     QString m_sourceDir;
     QString m_installMap;
     StorageLayout m_storageLayoutMode;
+    StorageContainer m_storageContainer;
     const ServerLayout *m_serverLayout;
     int m_levelZeroColumns;
     int m_levelZeroRows;
@@ -47,6 +47,9 @@ bool DgmlTextureTagWriter::write(const GeoNode *node, GeoWriter& writer) const
         writer.writeAttribute( "levelZeroRows", QString::number( texture->levelZeroRows() ) );
         writer.writeAttribute( "mode", texture->serverLayout()->name() );
     }
+    if ( texture->storageContainer() == GeoSceneTiled::Pack ) {
+        writer.writeAttribute( "container", "Pack" );
+    }
     writer.writeEndElement();
     
     if ( texture->downloadUrls().size() > 0 )
@@ -10,6 +10,14 @@
 
 #include "KmlLineStringTagWriter.h"
 
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+#include <cmath>
+#include <limits>
+
 #include "GeoDataLineString.h"
 #include "GeoDataTypes.h"
 #include "GeoWriter.h"
@@ -18,6 +26,65 @@
 namespace Marble
 {
 
+namespace
+{
+// Line strings with at least this many points are formatted concurrently
+const int concurrentFormattingSize = 50000;
+
+// Integers up to 2^53 are exact in a double, which bounds the scaled values formatted here
+const qreal maximumScaledNumber = 9007199254740992.0;
+
+const qint64 powersOfTen[] = { 1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL,
+                               10000000LL, 100000000LL, 1000000000LL, 10000000000LL };
+
+QByteArray formatRange( const GeoDataLineString *lineString, int begin, int end, bool hasAltitude )
+{
+    QByteArray result;
+    result.reserve( ( end - begin ) * ( hasAltitude ? 40 : 30 ) );
+    for ( int i = begin; i < end; ++i ) {
+        const GeoDataCoordinates &coordinates = lineString->at( i );
+        if ( i > 0 ) {
+            result.append( ' ' );
+        }
+
+        KmlLineStringTagWriter::appendNumber( result, coordinates.longitude( GeoDataCoordinates::Degree ), 10 );
+        result.append( ',' );
+        KmlLineStringTagWriter::appendNumber( result, coordinates.latitude( GeoDataCoordinates::Degree ), 10 );
+
+        if ( hasAltitude ) {
+            result.append( ',' );
+            KmlLineStringTagWriter::appendNumber( result, coordinates.altitude(), 2 );
+        }
+    }
+    return result;
+}
+
+class RangeFormatter : public QRunnable
+{
+public:
+    RangeFormatter( const GeoDataLineString *lineString, int begin, int end, bool hasAltitude, QByteArray *result )
+        : m_lineString( lineString ),
+          m_begin( begin ),
+          m_end( end ),
+          m_hasAltitude( hasAltitude ),
+          m_result( result )
+    {
+    }
+
+    virtual void run()
+    {
+        *m_result = formatRange( m_lineString, m_begin, m_end, m_hasAltitude );
+    }
+
+private:
+    const GeoDataLineString *const m_lineString;
+    const int m_begin;
+    const int m_end;
+    const bool m_hasAltitude;
+    QByteArray *const m_result;
+};
+}
+
 static GeoTagWriterRegistrar s_writerLookAt(
     GeoTagWriter::QualifiedName( GeoDataTypes::GeoDataLineStringType,
                                  kml::kmlTag_nameSpace22 ),
@@ -32,43 +99,103 @@ bool KmlLineStringTagWriter::write( const GeoNode *node, GeoWriter& writer ) con
         writer.writeStartElement( kml::kmlTag_LineString );
         writer.writeStartElement( "coordinates" );
 
-        // Write altitude for *all* elements, if *any* element
-        // has altitude information (!= 0.0)
-        bool hasAltitude = false;
+        writer.writeCharacters( formatCoordinates( lineString ) );
+
+        writer.writeEndElement();
+        writer.writeEndElement();
+
+        return true;
+    }
+
+    return false;
+}
+
+QString KmlLineStringTagWriter::formatCoordinates( const GeoDataLineString *lineString )
+{
+    // Write altitude for *all* elements, if *any* element
+    // has altitude information (!= 0.0)
+    bool hasAltitude = false;
+    if ( lineString->nodeType() != GeoDataTypes::GeoDataLinearRingType ) {
         for ( int i = 0; i < lineString->size(); ++i ) {
             if ( lineString->at( i ).altitude() ) {
                 hasAltitude = true;
                 break;
             }
         }
+    }
 
-        for ( int i = 0; i < lineString->size(); ++i ) {
-            GeoDataCoordinates coordinates = lineString->at( i );
-            if ( i > 0 )
-            {
-                writer.writeCharacters( " " );
-            }
+    const int size = lineString->size();
+    if ( size < concurrentFormattingSize ) {
+        const QByteArray result = formatRange( lineString, 0, size, hasAltitude );
+        return QString::fromLatin1( result.constData(), result.size() );
+    }
 
-            qreal lon = coordinates.longitude( GeoDataCoordinates::Degree );
-            writer.writeCharacters( QString::number( lon, 'f', 10 ) );
-            writer.writeCharacters( "," );
-            qreal lat = coordinates.latitude( GeoDataCoordinates::Degree );
-            writer.writeCharacters( QString::number( lat, 'f', 10 ) );
+    // Format consecutive ranges in separate buffers and join them in order
+    const int rangeCount = qMax( 1, QThread::idealThreadCount() );
+    QVector<QByteArray> ranges( rangeCount );
+    QThreadPool pool;
+    for ( int i = 0; i < rangeCount; ++i ) {
+        const int begin = qint64( size ) * i / rangeCount;
+        const int end = qint64( size ) * ( i + 1 ) / rangeCount;
+        pool.start( new RangeFormatter( lineString, begin, end, hasAltitude, &ranges[i] ) );
+    }
+    pool.waitForDone();
 
-            if ( hasAltitude ) {
-                qreal alt = coordinates.altitude();
-                writer.writeCharacters( "," );
-                writer.writeCharacters( QString::number( alt, 'f', 2 ) );
-            }
-        }
+    int length = 0;
+    foreach ( const QByteArray &range, ranges ) {
+        length += range.size();
+    }
+    QByteArray result;
+    result.reserve( length );
+    foreach ( const QByteArray &range, ranges ) {
+        result.append( range );
+    }
+    return QString::fromLatin1( result.constData(), result.size() );
+}
 
-        writer.writeEndElement();
-        writer.writeEndElement();
+void KmlLineStringTagWriter::appendNumber( QByteArray &buffer, qreal value, int decimals )
+{
+    Q_ASSERT( decimals >= 0 && decimals <= 10 );
 
-        return true;
+    // The scaled value is off by at most half an ulp, so it rounds like the exact
+    // value unless it is about halfway between two integers. Those values are
+    // left to Qt, like huge values, infinity, NaN and values rounding to zero
+    // apart from a positive zero, as Qt decides about their sign.
+    const qreal absolute = qAbs( value ) * powersOfTen[decimals];
+    const qreal integral = std::floor( absolute );
+    const qreal fraction = absolute - integral;
+    const bool positiveZero = value == 0 && 1 / value > 0;
+    if ( !( absolute < maximumScaledNumber )
+         || qAbs( fraction - 0.5 ) <= absolute * std::numeric_limits<qreal>::epsilon()
+         || ( absolute < 0.5 && !positiveZero ) ) {
+        buffer.append( QByteArray::number( value, 'f', decimals ) );
+        return;
     }
 
-    return false;
+    qint64 scaled = qint64( integral ) + ( fraction > 0.5 ? 1 : 0 );
+    const bool negative = value < 0;
+
+    // digits are produced from the last one
+    char digits[32];
+    int count = 0;
+    for ( int i = 0; i < decimals; ++i ) {
+        digits[count++] = char( '0' + scaled % 10 );
+        scaled /= 10;
+    }
+    if ( decimals > 0 ) {
+        digits[count++] = '.';
+    }
+    do {
+        digits[count++] = char( '0' + scaled % 10 );
+        scaled /= 10;
+    } while ( scaled > 0 );
+    if ( negative ) {
+        digits[count++] = '-';
+    }
+
+    for ( int i = count - 1; i >= 0; --i ) {
+        buffer.append( digits[i] );
+    }
 }
 
 }
@@ -11,15 +11,35 @@
 #ifndef MARBLE_KMLLINESTRINGTAGWRITER_H
 #define MARBLE_KMLLINESTRINGTAGWRITER_H
 
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
 #include "GeoTagWriter.h"
+#include "geodata_export.h"
 
 namespace Marble
 {
 
-class KmlLineStringTagWriter : public GeoTagWriter
+class GeoDataLineString;
+
+class GEODATA_EXPORT KmlLineStringTagWriter : public GeoTagWriter
 {
 public:
     virtual bool write( const GeoNode *node, GeoWriter& writer ) const;
+
+    /**
+     * Returns the content of the coordinates element of @p lineString.
+     * Altitudes are written for all points if any point has one, linear
+     * rings are written without altitudes. Long line strings are formatted
+     * in parts concurrently.
+     */
+    static QString formatCoordinates( const GeoDataLineString *lineString );
+
+    /**
+     * Appends @p value with @p decimals (at most 10) fractional digits to
+     * @p buffer, like QString::number( value, 'f', decimals ) does.
+     */
+    static void appendNumber( QByteArray &buffer, qreal value, int decimals );
 };
 
 }
@@ -14,6 +14,7 @@
 #include "GeoDataTypes.h"
 #include "GeoWriter.h"
 #include "KmlElementDictionary.h"
+#include "KmlLineStringTagWriter.h"
 
 using namespace Marble;
 
@@ -27,16 +28,23 @@ bool KmlTrackWriter::write( const GeoNode *node, GeoWriter &writer ) const
 
     writer.writeStartElement( "gx:Track" );
 
+    const QList<QDateTime> when = track->whenList();
+    const QList<GeoDataCoordinates> coordinatesList = track->coordinatesList();
     int points = track->size();
+    QByteArray coord;
     for ( int i = 0; i < points; i++ ) {
-        writer.writeElement( "when", track->whenList().at( i ).toString( Qt::ISODate ) );
+        writer.writeElement( "when", when.at( i ).toString( Qt::ISODate ) );
 
         qreal lon, lat, alt;
-        track->coordinatesList().at( i ).geoCoordinates( lon, lat, alt, GeoDataCoordinates::Degree );
-        QString coord = QString::number( lon, 'f', 10 ) + ' '
-                        + QString::number( lat, 'f', 10 ) + ' ' + QString::number( alt, 'f', 10 );
-
-        writer.writeElement( "gx:coord", coord );
+        coordinatesList.at( i ).geoCoordinates( lon, lat, alt, GeoDataCoordinates::Degree );
+        coord.clear();
+        KmlLineStringTagWriter::appendNumber( coord, lon, 10 );
+        coord.append( ' ' );
+        KmlLineStringTagWriter::appendNumber( coord, lat, 10 );
+        coord.append( ' ' );
+        KmlLineStringTagWriter::appendNumber( coord, alt, 10 );
+
+        writer.writeElement( "gx:coord", QString::fromLatin1( coord.constData(), coord.size() ) );
     }
     writer.writeEndElement();
 
@@ -13,6 +13,7 @@
 #include "TextureLayer.h"
 
 #include <QtCore/qmath.h>
+#include <QtCore/QPointF>
 #include <QtCore/QTimer>
 
 #include "SphericalScanlineTextureMapper.h"
@@ -22,9 +23,11 @@
 #include "GeoPainter.h"
 #include "GeoSceneGroup.h"
 #include "GeoSceneTypes.h"
+#include "HttpDownloadManager.h"
 #include "MergedLayerDecorator.h"
 #include "MarbleDebug.h"
 #include "MarbleDirs.h"
+#include "MarbleMath.h"
 #include "StackedTile.h"
 #include "StackedTileLoader.h"
 #include "SunLocator.h"
@@ -50,9 +53,12 @@ public:
     void mapChanged();
     void updateTextureLayers();
     void updateTile( const TileId &tileId, const QImage &tileImage );
+    void cancelTile( const TileId &tileId );
+    void updateDownloadFocus( const ViewportParams *viewport );
 
 public:
     TextureLayer  *const m_parent;
+    HttpDownloadManager *const m_downloadManager;
     const SunLocator *const m_sunLocator;
     VectorComposer *const m_veccomposer;
     TileLoader m_loader;
@@ -66,6 +72,10 @@ public:
     QString m_runtimeTrace;
     // For scheduling repaints
     QTimer           m_repaintTimer;
+    // Last focus passed to the download manager, in tiles of m_downloadFocusLevel
+    int     m_downloadFocusLevel;
+    QPointF m_downloadFocus;
+    qreal   m_downloadFocusRadius;
 
 };
 
@@ -75,6 +85,7 @@ TextureLayer::Private::Private( HttpDownloadManager *downloadManager,
                                 const PluginManager *pluginManager,
                                 TextureLayer *parent )
     : m_parent( parent )
+    , m_downloadManager( downloadManager )
     , m_sunLocator( sunLocator )
     , m_veccomposer( veccomposer )
     , m_loader( downloadManager, pluginManager )
@@ -85,6 +96,9 @@ TextureLayer::Private::Private( HttpDownloadManager *downloadManager,
     , m_texcolorizer( 0 )
     , m_textureLayerSettings( 0 )
     , m_repaintTimer()
+    , m_downloadFocusLevel( -1 )
+    , m_downloadFocus()
+    , m_downloadFocusRadius( 0.0 )
 {
 }
 
@@ -135,6 +149,56 @@ void TextureLayer::Private::updateTile( const TileId &tileId, const QImage &tile
     mapChanged();
 }
 
+void TextureLayer::Private::cancelTile( const TileId &tileId )
+{
+    m_tileLoader.cancelTile( tileId );
+}
+
+void TextureLayer::Private::updateDownloadFocus( const ViewportParams *viewport )
+{
+    if ( !m_downloadManager )
+        return;
+
+    // Tiles near the focus point (the zoom center) are downloaded first,
+    // tiles which scrolled far out of view are not downloaded at all.
+    const int tileLevel = m_tileZoomLevel;
+    const int columns = m_tileLoader.tileColumnCount( tileLevel );
+    const int rows = m_tileLoader.tileRowCount( tileLevel );
+
+    qreal lon;
+    qreal lat;
+    viewport->focusPoint().geoCoordinates( lon, lat );
+
+    const qreal x = ( lon + M_PI ) / ( 2 * M_PI ) * columns;
+    qreal y;
+    if ( m_tileLoader.tileProjection() == GeoSceneTiled::Mercator ) {
+        const qreal maxLat = atan( sinh( M_PI ) );
+        y = ( 0.5 - gdInv( qBound( -maxLat, lat, maxLat ) ) / ( 2 * M_PI ) ) * rows;
+    }
+    else {
+        y = ( 0.5 - lat / M_PI ) * rows;
+    }
+
+    const qreal tileWidth = 2 * M_PI * viewport->radius() / columns;
+    const qreal radius = 0.5 * sqrt( qreal( viewport->width() ) * viewport->width()
+                                     + qreal( viewport->height() ) * viewport->height() ) / tileWidth;
+
+    // reprioritizing the queues is not for free, so skip small movements
+    if ( tileLevel == m_downloadFocusLevel
+         && qAbs( x - m_downloadFocus.x() ) < 0.5
+         && qAbs( y - m_downloadFocus.y() ) < 0.5
+         && qAbs( radius - m_downloadFocusRadius ) < 0.5 )
+        return;
+
+    m_downloadFocusLevel = tileLevel;
+    m_downloadFocus = QPointF( x, y );
+    m_downloadFocusRadius = radius;
+
+    foreach ( const GeoSceneTextureTile *texture, m_textures ) {
+        m_downloadManager->setTileFocus( texture->sourceDir(), tileLevel, columns, x, y, radius );
+    }
+}
+
 
 
 TextureLayer::TextureLayer( HttpDownloadManager *downloadManager,
@@ -146,6 +210,8 @@ TextureLayer::TextureLayer( HttpDownloadManager *downloadManager,
 {
     connect( &d->m_loader, SIGNAL(tileCompleted(TileId,QImage)),
              this, SLOT(updateTile(TileId,QImage)) );
+    connect( &d->m_loader, SIGNAL(tileCanceled(TileId)),
+             this, SLOT(cancelTile(TileId)) );
 
     // Repaint timer
     d->m_repaintTimer.setSingleShot( true );
@@ -234,6 +300,8 @@ bool TextureLayer::render( GeoPainter *painter, ViewportParams *viewport,
         emit tileLevelChanged( d->m_tileZoomLevel );
     }
 
+    d->updateDownloadFocus( viewport );
+
     const QRect dirtyRect = QRect( QPoint( 0, 0), viewport->size() );
     d->m_texmapper->mapTexture( painter, viewport, d->m_tileZoomLevel, dirtyRect, d->m_texcolorizer );
     d->m_runtimeTrace = QString("Cache: %1 ").arg(d->m_tileLoader.tileCount());
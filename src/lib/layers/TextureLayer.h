@@ -114,6 +114,7 @@ public Q_SLOTS:
     Q_PRIVATE_SLOT( d, void mapChanged() )
     Q_PRIVATE_SLOT( d, void updateTextureLayers() )
     Q_PRIVATE_SLOT( d, void updateTile( const TileId &tileId, const QImage &tileImage ) )
+    Q_PRIVATE_SLOT( d, void cancelTile( const TileId &tileId ) )
 
  private:
     class Private;
@@ -1371,6 +1371,7 @@ void MarblePart::editSettings()
     // cache page
     MarbleCacheSettingsWidget *w_cacheSettings = new MarbleCacheSettingsWidget();
     w_cacheSettings->setObjectName( "cache_page" );
+    w_cacheSettings->setDownloadManager( m_controlView->marbleModel()->downloadManager() );
     m_configDialog->addPage( w_cacheSettings, i18n( "Cache & Proxy" ),
                              "preferences-web-browser-cache" );
     connect( w_cacheSettings,               SIGNAL(clearVolatileCache()),
@@ -1479,6 +1480,8 @@ void MarblePart::updateSettings()
     // Cache
     m_controlView->marbleModel()->
         setPersistentTileCacheLimit( MarbleSettings::persistentTileCacheLimit() * 1024 );
+    m_controlView->marbleModel()->
+        setSharedTileCacheLimit( MarbleSettings::sharedTileCacheLimit() * 1024 );
     m_controlView->marbleWidget()->
         setVolatileTileCacheLimit( MarbleSettings::volatileTileCacheLimit() * 1024 );
 
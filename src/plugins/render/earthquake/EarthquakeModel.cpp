@@ -33,7 +33,7 @@ EarthquakeModel::EarthquakeModel( const MarbleModel *marbleModel, QObject *paren
       m_startDate( QDateTime::fromString( "2006-02-04", "yyyy-MM-dd" ) ),
       m_endDate( QDateTime::currentDateTime() )
 {
-    // nothing to do
+    setRecordParser( &EarthquakeModel::parseRecords );
 }
 
 EarthquakeModel::~EarthquakeModel()
@@ -72,7 +72,7 @@ void EarthquakeModel::getAdditionalItems( const GeoDataLatLonAltBox& box, qint32
     downloadDescriptionFile( QUrl( geonamesUrl ) );
 }
 
-void EarthquakeModel::parseFile( const QByteArray& file )
+QVariantList EarthquakeModel::parseRecords( const QByteArray& file )
 {
     QScriptValue data;
     QScriptEngine engine;
@@ -80,42 +80,60 @@ void EarthquakeModel::parseFile( const QByteArray& file )
     // Qt requires parentheses around json code
     data = engine.evaluate( '(' + QString( file ) + ')' );
 
+    QVariantList records;
+
     // Parse if any result exists
     if ( data.property( "earthquakes" ).isArray() ) {
         QScriptValueIterator iterator( data.property( "earthquakes" ) );
-        // Add items to the list
-        QList<AbstractDataPluginItem*> items;
         while ( iterator.hasNext() ) {
             iterator.next();
             // Converting earthquake's properties from QScriptValue to appropriate types
-            QString eqid = iterator.value().property( "eqid" ).toString(); // Earthquake's ID
-            double longitude = iterator.value().property( "lng" ).toNumber();
-            double latitude = iterator.value().property( "lat" ).toNumber();
-            double magnitude = iterator.value().property( "magnitude" ).toNumber();
+            QVariantHash record;
+            record["eqid"] = iterator.value().property( "eqid" ).toString(); // Earthquake's ID
+            record["lng"] = iterator.value().property( "lng" ).toNumber();
+            record["lat"] = iterator.value().property( "lat" ).toNumber();
+            record["magnitude"] = iterator.value().property( "magnitude" ).toNumber();
             QString data = iterator.value().property( "datetime" ).toString();
-            QDateTime date = QDateTime::fromString( data, "yyyy-MM-dd hh:mm:ss" );
-            double depth = iterator.value().property( "depth" ).toNumber();
-
-            if( date <= m_endDate && date >= m_startDate && magnitude >= m_minMagnitude ) {
-                if( !itemExists( eqid ) ) {
-                    // If it does not exists, create it
-                    GeoDataCoordinates coordinates( longitude, latitude, 0.0, GeoDataCoordinates::Degree );
-                    EarthquakeItem *item = new EarthquakeItem( this );
-                    item->setId( eqid );
-                    item->setCoordinate( coordinates );
-                    item->setTarget( "earth" );
-                    item->setMagnitude( magnitude );
-                    item->setDateTime( date );
-                    item->setDepth( depth );
-                    items << item;
-                }
-            }
+            record["datetime"] = QDateTime::fromString( data, "yyyy-MM-dd hh:mm:ss" );
+            record["depth"] = iterator.value().property( "depth" ).toNumber();
+            records << record;
         }
-
-        addItemsToList( items );
     }
+
+    return records;
 }
 
+void EarthquakeModel::addRecords( const QVariantList& records )
+{
+    // Add items to the list
+    QList<AbstractDataPluginItem*> items;
+    foreach ( const QVariant &value, records ) {
+        const QVariantHash record = value.toHash();
+        QString eqid = record["eqid"].toString();
+        double longitude = record["lng"].toDouble();
+        double latitude = record["lat"].toDouble();
+        double magnitude = record["magnitude"].toDouble();
+        QDateTime date = record["datetime"].toDateTime();
+        double depth = record["depth"].toDouble();
+
+        if( date <= m_endDate && date >= m_startDate && magnitude >= m_minMagnitude ) {
+            if( !itemExists( eqid ) ) {
+                // If it does not exists, create it
+                GeoDataCoordinates coordinates( longitude, latitude, 0.0, GeoDataCoordinates::Degree );
+                EarthquakeItem *item = new EarthquakeItem( this );
+                item->setId( eqid );
+                item->setCoordinate( coordinates );
+                item->setTarget( "earth" );
+                item->setMagnitude( magnitude );
+                item->setDateTime( date );
+                item->setDepth( depth );
+                items << item;
+            }
+        }
+    }
+
+    addItemsToList( items );
+}
 
 }
 
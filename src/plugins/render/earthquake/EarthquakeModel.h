@@ -38,12 +38,17 @@ protected:
                                      qint32 number = 10 );
 
     /**
-     * Parses the @p file which getAdditionalItems downloads and
-     * prepares the data for usage.
+     * Creates earthquake items from the @p records of a description file.
      **/
-    void parseFile( const QByteArray& file );
+    void addRecords( const QVariantList& records );
 
 private:
+    /**
+     * Parses the @p file which getAdditionalItems downloads into records.
+     * Runs in a worker thread.
+     **/
+    static QVariantList parseRecords( const QByteArray& file );
+
     double m_minMagnitude;
     QDateTime m_startDate;
     QDateTime m_endDate;
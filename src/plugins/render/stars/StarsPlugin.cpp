@@ -19,6 +19,7 @@
 #include <QtGui/QContextMenuEvent>
 #include <QtGui/QMenu>
 #include <QtGui/QColorDialog>
+#include <QtGui/QPainter>
 
 #include "MarbleClock.h"
 #include "MarbleDebug.h"
@@ -34,6 +35,45 @@
 namespace Marble
 {
 
+// The sky is divided into cells of cellSize x cellSize radians in right ascension and declination
+const int raCellCount = 24;
+const int declCellCount = 12;
+const qreal cellSize = M_PI / declCellCount;
+
+// Angular radius of the largest cell around its center (half the diagonal of an equatorial cell)
+const qreal cellRadius = 11.0 * DEG2RAD;
+
+namespace
+{
+
+struct CatalogStar
+{
+    int cell;
+    StarPoint star;
+
+    bool operator<( const CatalogStar &other ) const
+    {
+        if ( cell != other.cell ) {
+            return cell < other.cell;
+        }
+        return star.magnitude() < other.star.magnitude();
+    }
+};
+
+int skyCell( qreal ra, qreal decl )
+{
+    ra = fmod( ra, 2 * M_PI );
+    if ( ra < 0 ) {
+        ra += 2 * M_PI;
+    }
+    const int raCell = qBound( 0, int( ra / cellSize ), raCellCount - 1 );
+    const int declCell = qBound( 0, int( ( decl + M_PI / 2 ) / cellSize ), declCellCount - 1 );
+
+    return declCell * raCellCount + raCell;
+}
+
+}
+
 StarsPlugin::StarsPlugin( const MarbleModel *marbleModel )
     : RenderPlugin( marbleModel ),
       m_nameIndex( 0 ),
@@ -52,6 +92,8 @@ StarsPlugin::StarsPlugin( const MarbleModel *marbleModel )
       m_constellationsLoaded( false ),
       m_dsosLoaded( false ),
       m_magnitudeLimit( 100 ),
+      m_starFieldRadius( 0 ),
+      m_starFieldMagnitudeLimit( 0 ),
       m_constellationBrush( Marble::Oxygen::aluminumGray5 ),
       m_constellationLabelBrush( Marble::Oxygen::aluminumGray5 ),
       m_dsoLabelBrush( Marble::Oxygen::aluminumGray5 ),
@@ -753,6 +795,8 @@ void StarsPlugin::loadStars()
     //mDebug() << Q_FUNC_INFO;
     // Load star data
     m_stars.clear();
+    m_idHash.clear();
+    m_starField = QPixmap();
 
     QFile starFile( MarbleDirs::path( "stars/stars.dat" ) );
     starFile.open( QIODevice::ReadOnly );
@@ -780,7 +824,6 @@ void StarsPlugin::loadStars()
 
     int maxid = 0;
     int id = 0;
-    int starIndex = 0;
     double ra;
     double de;
     double mag;
@@ -788,6 +831,7 @@ void StarsPlugin::loadStars()
 
     mDebug() << "Star Catalog Version " << version;
 
+    QVector<CatalogStar> catalog;
     while ( !in.atEnd() ) {
         if ( version >= 2 ) {
             in >> id;
@@ -803,14 +847,49 @@ void StarsPlugin::loadStars()
             in >> colorId;
         }
 
-        StarPoint star( id, ( qreal )( ra ), ( qreal )( de ), ( qreal )( mag ), colorId );
+        CatalogStar entry;
+        entry.cell = skyCell( ra, de );
+        entry.star = StarPoint( id, ( qreal )( ra ), ( qreal )( de ), ( qreal )( mag ), colorId );
+        catalog << entry;
+    }
+
+    // Group the stars by sky cell, brightest first within each cell
+    qStableSort( catalog.begin(), catalog.end() );
+
+    const int starCount = catalog.size();
+    m_stars.reserve( starCount );
+    m_starX.resize( starCount );
+    m_starY.resize( starCount );
+    m_starZ.resize( starCount );
+    m_starMagnitude.resize( starCount );
+    m_cellStart.fill( starCount, raCellCount * declCellCount + 1 );
+    for ( int starIndex = starCount - 1; starIndex >= 0; --starIndex ) {
+        m_cellStart[catalog.at( starIndex ).cell] = starIndex;
+    }
+    for ( int cell = raCellCount * declCellCount - 1; cell >= 0; --cell ) {
+        // Empty cells start where the next one does
+        m_cellStart[cell] = qMin( m_cellStart[cell], m_cellStart[cell + 1] );
+    }
+
+    for ( int starIndex = 0; starIndex < starCount; ++starIndex ) {
+        const StarPoint &star = catalog.at( starIndex ).star;
         // Create entry in stars database
         m_stars << star;
+        m_starX[starIndex] = star.quaternion().v[Q_X];
+        m_starY[starIndex] = star.quaternion().v[Q_Y];
+        m_starZ[starIndex] = star.quaternion().v[Q_Z];
+        m_starMagnitude[starIndex] = star.magnitude();
         // Create key,value pair in idHash table to map from star id to
         // index in star database vector
-        m_idHash[id] = starIndex;
-        // Increment Index for use in hash
-        ++starIndex;
+        m_idHash[star.id()] = starIndex;
+    }
+
+    m_cellCenters.clear();
+    for ( int declCell = 0; declCell < declCellCount; ++declCell ) {
+        for ( int raCell = 0; raCell < raCellCount; ++raCell ) {
+            m_cellCenters << Quaternion::fromSpherical( ( raCell + 0.5 ) * cellSize,
+                                                        ( declCell + 0.5 ) * cellSize - M_PI / 2 );
+        }
     }
 
     // load the Sun pixmap
@@ -1266,78 +1345,28 @@ bool StarsPlugin::render( GeoPainter *painter, ViewportParams *viewport,
         }
 
         // Render Stars
-
-        for ( int s = 0; s < m_stars.size(); ++s  ) {
-            Quaternion  qpos = m_stars.at(s).quaternion();
-
-            qpos.rotateAroundAxis( skyAxisMatrix );
-
-            if ( qpos.v[Q_Z] > 0 ) {
-                continue;
-            }
-
-            qreal  earthCenteredX = qpos.v[Q_X] * skyRadius - viewport->pan().x();
-            qreal  earthCenteredY = qpos.v[Q_Y] * skyRadius + viewport->pan().y();
-
-            // Don't draw high placemarks (e.g. satellites) that aren't visible.
-            if ( qpos.v[Q_Z] < 0
-                    && ( ( earthCenteredX * earthCenteredX
-                           + earthCenteredY * earthCenteredY )
-                         < earthRadius * earthRadius ) ) {
-                continue;
-            }
-
-            // Let (x, y) be the position on the screen of the placemark..
-            const int x = ( int )( viewport->width()  / 2 + skyRadius * qpos.v[Q_X] );
-            const int y = ( int )( viewport->height() / 2 - skyRadius * qpos.v[Q_Y] );
-
-            // Skip placemarks that are outside the screen area
-            if ( x < 0 || x >= viewport->virtualWidth()
-                    || y < 0 || y >= viewport->virtualHeight() )
-                continue;
-
-            // Show star if it is brighter than magnitude threshold
-            if ( m_stars.at(s).magnitude() < m_magnitudeLimit ) {
-
-                // colorId is used to select which pixmap in vector to display
-                int colorId = m_stars.at(s).colorId();
-                QPixmap s_pixmap;
-
-                // Magnitude is used to select which pixmap vector (size) to use
-                if ( m_stars.at(s).magnitude() < -1 ) {
-                    s_pixmap = m_pixN1Stars.at(colorId);
-                }
-                else if ( m_stars.at(s).magnitude() < 0 ) {
-                    s_pixmap = m_pixP0Stars.at(colorId);
-                }
-                else if ( m_stars.at(s).magnitude() < 1 ) {
-                    s_pixmap = m_pixP1Stars.at(colorId);
-                }
-                else if ( m_stars.at(s).magnitude() < 2 ) {
-                    s_pixmap = m_pixP2Stars.at(colorId);
-                }
-                else if ( m_stars.at(s).magnitude() < 3 ) {
-                    s_pixmap = m_pixP3Stars.at(colorId);
-                }
-                else if ( m_stars.at(s).magnitude() < 4 ) {
-                    s_pixmap = m_pixP4Stars.at(colorId);
-                }
-                else if ( m_stars.at(s).magnitude() < 5 ) {
-                    s_pixmap = m_pixP5Stars.at(colorId);
-                }
-                else if ( m_stars.at(s).magnitude() < 6 ) {
-                    s_pixmap = m_pixP6Stars.at(colorId);
-                }
-                else {
-                    s_pixmap = m_pixP7Stars.at(colorId);
-                }
-
-                int sizeX = s_pixmap.width();
-                int sizeY = s_pixmap.height();
-                painter->drawPixmap( x-sizeX/2, y-sizeY/2 ,s_pixmap );
-            }
+        const QSize starFieldSize( viewport->virtualWidth(), viewport->virtualHeight() );
+        if ( m_starField.isNull()
+             || !( m_starFieldSkyAxis == skyAxis )
+             || m_starFieldSize != starFieldSize
+             || m_starFieldRadius != viewport->radius()
+             || m_starFieldPan != viewport->pan()
+             || m_starFieldMagnitudeLimit != m_magnitudeLimit ) {
+            // The sky orientation changed, paint the star field again
+            m_starField = QPixmap( starFieldSize );
+            m_starField.fill( Qt::transparent );
+            QPainter starFieldPainter( &m_starField );
+            renderStarField( &starFieldPainter, viewport, skyAxisMatrix, skyRadius );
+
+            m_starFieldSkyAxis = skyAxis;
+            m_starFieldSize = starFieldSize;
+            m_starFieldRadius = viewport->radius();
+            m_starFieldPan = viewport->pan();
+            m_starFieldMagnitudeLimit = m_magnitudeLimit;
         }
 
+        painter->drawPixmap( 0, 0, m_starField );
+
 
         if ( m_renderSun ) {
             // sun
@@ -1362,6 +1391,99 @@ bool StarsPlugin::render( GeoPainter *painter, ViewportParams *viewport,
     return true;
 }
 
+void StarsPlugin::renderStarField( QPainter *painter, const ViewportParams *viewport,
+                                   const matrix &skyAxisMatrix, qreal skyRadius )
+{
+    const qreal earthRadius = viewport->radius();
+    const qreal minimumCellZ = sin( cellRadius );
+
+    for ( int cell = 0; cell < m_cellCenters.size(); ++cell ) {
+        // Skip cells which are completely on the far side of the sky
+        Quaternion center = m_cellCenters.at( cell );
+        center.rotateAroundAxis( skyAxisMatrix );
+        if ( center.v[Q_Z] > minimumCellZ ) {
+            continue;
+        }
+
+        const int end = m_cellStart.at( cell + 1 );
+        for ( int s = m_cellStart.at( cell ); s < end; ++s ) {
+            // Stars are sorted by magnitude within the cell, the remaining ones are too faint
+            if ( m_starMagnitude[s] >= m_magnitudeLimit ) {
+                break;
+            }
+
+            const qreal starX = m_starX[s];
+            const qreal starY = m_starY[s];
+            const qreal starZ = m_starZ[s];
+
+            const qreal z = skyAxisMatrix[0][2] * starX + skyAxisMatrix[1][2] * starY + skyAxisMatrix[2][2] * starZ;
+            if ( z > 0 ) {
+                continue;
+            }
+
+            const qreal x = skyAxisMatrix[0][0] * starX + skyAxisMatrix[1][0] * starY + skyAxisMatrix[2][0] * starZ;
+            const qreal y = skyAxisMatrix[0][1] * starX + skyAxisMatrix[1][1] * starY + skyAxisMatrix[2][1] * starZ;
+
+            qreal  earthCenteredX = x * skyRadius - viewport->pan().x();
+            qreal  earthCenteredY = y * skyRadius + viewport->pan().y();
+
+            // Don't draw high placemarks (e.g. satellites) that aren't visible.
+            if ( z < 0
+                    && ( ( earthCenteredX * earthCenteredX
+                           + earthCenteredY * earthCenteredY )
+                         < earthRadius * earthRadius ) ) {
+                continue;
+            }
+
+            // Let (x, y) be the position on the screen of the placemark..
+            const int screenX = ( int )( viewport->width()  / 2 + skyRadius * x );
+            const int screenY = ( int )( viewport->height() / 2 - skyRadius * y );
+
+            // Skip placemarks that are outside the screen area
+            if ( screenX < 0 || screenX >= viewport->virtualWidth()
+                    || screenY < 0 || screenY >= viewport->virtualHeight() )
+                continue;
+
+            const QPixmap &s_pixmap = starPixmap( m_starMagnitude[s], m_stars.at(s).colorId() );
+            int sizeX = s_pixmap.width();
+            int sizeY = s_pixmap.height();
+            painter->drawPixmap( screenX-sizeX/2, screenY-sizeY/2 ,s_pixmap );
+        }
+    }
+}
+
+const QPixmap &StarsPlugin::starPixmap( qreal magnitude, int colorId ) const
+{
+    // Magnitude is used to select which pixmap vector (size) to use,
+    // colorId is used to select which pixmap in vector to display
+    if ( magnitude < -1 ) {
+        return m_pixN1Stars.at(colorId);
+    }
+    else if ( magnitude < 0 ) {
+        return m_pixP0Stars.at(colorId);
+    }
+    else if ( magnitude < 1 ) {
+        return m_pixP1Stars.at(colorId);
+    }
+    else if ( magnitude < 2 ) {
+        return m_pixP2Stars.at(colorId);
+    }
+    else if ( magnitude < 3 ) {
+        return m_pixP3Stars.at(colorId);
+    }
+    else if ( magnitude < 4 ) {
+        return m_pixP4Stars.at(colorId);
+    }
+    else if ( magnitude < 5 ) {
+        return m_pixP5Stars.at(colorId);
+    }
+    else if ( magnitude < 6 ) {
+        return m_pixP6Stars.at(colorId);
+    }
+
+    return m_pixP7Stars.at(colorId);
+}
+
 qreal StarsPlugin::siderealTime( const QDateTime& localDateTime )
 {
     QDateTime utcDateTime = localDateTime.toTimeSpec( Qt::UTC );
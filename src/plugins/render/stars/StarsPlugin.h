@@ -26,6 +26,7 @@
 #include "DialogConfigurationInterface.h"
 
 class QDateTime;
+class QPainter;
 
 namespace Ui
 {
@@ -198,6 +199,15 @@ private:
     }
 
     void prepareNames();
+
+    /**
+     * Paints the stars brighter than the magnitude limit onto @p painter, skipping all sky
+     * cells on the far side of the sky.
+     */
+    void renderStarField( QPainter *painter, const ViewportParams *viewport,
+                          const matrix &skyAxisMatrix, qreal skyRadius );
+
+    const QPixmap &starPixmap( qreal magnitude, int colorId ) const;
     QHash<QString, QString> m_abbrHash;
     QHash<QString, QString> m_nativeHash;
     int m_nameIndex;
@@ -221,7 +231,26 @@ private:
     bool m_starsLoaded;
     bool m_constellationsLoaded;
     bool m_dsosLoaded;
+    /**
+     * The stars, ordered by sky cell and by magnitude within each cell.
+     * m_starX, m_starY and m_starZ hold the components of their unit vectors.
+     */
     QVector<StarPoint> m_stars;
+    QVector<qreal> m_starX;
+    QVector<qreal> m_starY;
+    QVector<qreal> m_starZ;
+    QVector<qreal> m_starMagnitude;
+    /** Index of the first star of each sky cell in m_stars, followed by m_stars.size() */
+    QVector<int> m_cellStart;
+    /** Unit vectors of the sky cell centers */
+    QVector<Quaternion> m_cellCenters;
+    /** The stars painted last time, with the parameters they were painted for */
+    QPixmap m_starField;
+    Quaternion m_starFieldSkyAxis;
+    QSize m_starFieldSize;
+    int m_starFieldRadius;
+    QPoint m_starFieldPan;
+    int m_starFieldMagnitudeLimit;
     QPixmap m_pixmapSun;
     QVector<Constellation> m_constellations;
     QVector<DsoPoint> m_dsos;
@@ -10,6 +10,7 @@
 #include "GpxRunner.h"
 
 #include "GeoDataDocument.h"
+#include "GeoParallelParser.h"
 #include "GpxParser.h"
 
 #include <QtCore/QFile>
@@ -17,6 +18,11 @@
 namespace Marble
 {
 
+static GeoParser *createParser()
+{
+    return new GpxParser;
+}
+
 GpxRunner::GpxRunner(QObject *parent) :
     ParsingRunner(parent)
 {
@@ -38,7 +44,8 @@ void GpxRunner::parseFile( const QString &fileName, DocumentRole role = UnknownD
     // Open file in right mode
     file.open( QIODevice::ReadOnly );
 
-    GpxParser parser;
+    // Large documents are split at the waypoints, routes and tracks
+    GeoParallelParser parser( createParser, "gpx", 1 );
 
     if ( !parser.read( &file ) ) {
         emit parsingFinished( 0, parser.errorString() );
@@ -10,6 +10,7 @@
 #include "KmlRunner.h"
 
 #include "GeoDataDocument.h"
+#include "GeoParallelParser.h"
 #include "KmlParser.h"
 #include "KmlDocument.h"
 #include "MarbleDebug.h"
@@ -24,6 +25,11 @@
 namespace Marble
 {
 
+static GeoParser *createParser()
+{
+    return new KmlParser;
+}
+
 KmlRunner::KmlRunner(QObject *parent) :
     ParsingRunner(parent)
 {
@@ -65,7 +71,8 @@ void KmlRunner::parseFile( const QString &fileName, DocumentRole role = UnknownD
     // Open file in right mode
     file.open( QIODevice::ReadOnly );
 
-    KmlParser parser;
+    // Large documents are split at the children of their Document element
+    GeoParallelParser parser( createParser, "Document", 2 );
 
     if ( !parser.read( &file ) ) {
         emit parsingFinished( 0, parser.errorString() );
@@ -20,16 +20,22 @@
 #include "PositionTracking.h"
 
 #include <QtCore/QFile>
+#include <QtCore/QHash>
 #include <QtCore/QDataStream>
 #include <QtCore/QStringList>
 #include <QtCore/QRegExp>
 #include <QtCore/QVariant>
 #include <QtCore/QTime>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QtConcurrentRun>
 
 #include <QtSql/QSqlDatabase>
 #include <QtSql/QSqlQuery>
 #include <QtSql/QSqlError>
 
+#include <algorithm>
+
 namespace Marble {
 
 namespace {
@@ -69,6 +75,116 @@ private:
     const DatabaseQuery *const m_currentQuery;
 };
 
+const int maximumResults = 50;
+
+/**
+  * Long-lived database connections and prepared statements of one thread.
+  * QSqlDatabase connections must only be used by the thread that created them,
+  * so every thread running searches keeps its own set, one per database file.
+  * They are closed when the thread finishes.
+  */
+class ThreadConnections
+{
+public:
+    ~ThreadConnections();
+
+    /** Opens the connection to the given database file unless already done. */
+    bool open( const QString &databaseFile );
+
+    /** Returns a prepared statement for the given query, preparing it on first use. */
+    QSqlQuery &query( const QString &databaseFile, const QString &queryString );
+
+    /** Whether the database file has a placemarksRtree spatial index (SQLite rtree module). */
+    bool hasSpatialIndex( const QString &databaseFile ) const;
+
+private:
+    struct Connection
+    {
+        Connection() : hasSpatialIndex( false ) {}
+
+        QString name;
+        QSqlDatabase database;
+        QHash<QString, QSqlQuery> queries;
+        bool hasSpatialIndex;
+    };
+
+    QHash<QString, Connection> m_connections;
+};
+
+ThreadConnections::~ThreadConnections()
+{
+    QStringList names;
+    foreach( const Connection &connection, m_connections ) {
+        names << connection.name;
+    }
+    // Statements and database handles must be gone before removing the connections
+    m_connections.clear();
+    foreach( const QString &name, names ) {
+        QSqlDatabase::removeDatabase( name );
+    }
+}
+
+bool ThreadConnections::open( const QString &databaseFile )
+{
+    if ( m_connections.contains( databaseFile ) ) {
+        return true;
+    }
+
+    Connection connection;
+    connection.name = QString( "marble/local-osm-search-%1-%2" )
+            .arg( reinterpret_cast<size_t>( QThread::currentThread() ) )
+            .arg( databaseFile );
+    connection.database = QSqlDatabase::addDatabase( "QSQLITE", connection.name );
+    connection.database.setDatabaseName( databaseFile );
+    connection.database.setConnectOptions( "QSQLITE_OPEN_READONLY" );
+    if ( !connection.database.open() ) {
+        connection.database = QSqlDatabase();
+        QSqlDatabase::removeDatabase( connection.name );
+        return false;
+    }
+
+    QSqlQuery tableQuery( "SELECT name FROM sqlite_master WHERE type='table' AND name='placemarksRtree';",
+                          connection.database );
+    connection.hasSpatialIndex = tableQuery.next();
+
+    m_connections.insert( databaseFile, connection );
+    return true;
+}
+
+QSqlQuery &ThreadConnections::query( const QString &databaseFile, const QString &queryString )
+{
+    Q_ASSERT( m_connections.contains( databaseFile ) );
+    Connection &connection = m_connections[databaseFile];
+
+    QHash<QString, QSqlQuery>::iterator iter = connection.queries.find( queryString );
+    if ( iter == connection.queries.end() ) {
+        QSqlQuery query( connection.database );
+        query.setForwardOnly( true );
+        if ( !query.prepare( queryString ) ) {
+            qWarning() << query.lastError() << "in" << databaseFile << "when preparing" << queryString;
+        }
+        iter = connection.queries.insert( queryString, query );
+    }
+
+    return iter.value();
+}
+
+bool ThreadConnections::hasSpatialIndex( const QString &databaseFile ) const
+{
+    return m_connections.value( databaseFile ).hasSpatialIndex;
+}
+
+QThreadStorage<ThreadConnections *> s_threadConnections;
+
+ThreadConnections *threadConnections()
+{
+    if ( !s_threadConnections.hasLocalData() ) {
+        s_threadConnections.setLocalData( new ThreadConnections );
+    }
+
+    return s_threadConnections.localData();
+}
+
 }
 
 OsmDatabase::OsmDatabase( const QStringList &databaseFiles ) :
@@ -82,143 +198,255 @@ QVector<OsmPlacemark> OsmDatabase::find( const DatabaseQuery &userQuery )
         return QVector<OsmPlacemark>();
     }
 
-    QSqlDatabase database = QSqlDatabase::addDatabase( "QSQLITE", QString( "marble/local-osm-search-%1" ).arg( reinterpret_cast<size_t>( this ) ) );
-
-    QVector<OsmPlacemark> result;
     QTime timer;
     timer.start();
-    foreach( const QString &databaseFile, m_databaseFiles ) {
-        database.setDatabaseName( databaseFile );
-        if ( !database.open() ) {
-            qWarning() << "Failed to connect to database" << databaseFile;
-        }
 
-        QString regionRestriction;
-        if ( !userQuery.region().isEmpty() ) {
-            QTime regionTimer;
-            regionTimer.start();
-            // Nested set model to support region hierarchies, see http://en.wikipedia.org/wiki/Nested_set_model
-            const QString regionsQueryString = "SELECT lft, rgt FROM regions WHERE name LIKE '%" + userQuery.region() + "%';";
-            QSqlQuery regionsQuery( regionsQueryString, database );
-            if ( regionsQuery.lastError().isValid() ) {
-                qWarning() << regionsQuery.lastError() << "in" << databaseFile << "with query" << regionsQuery.lastQuery();
-            }
-            regionRestriction = " AND (";
-            int regionCount = 0;
-            while ( regionsQuery.next() ) {
-                if ( regionCount > 0 ) {
-                    regionRestriction += " OR ";
-                }
-                regionRestriction += " (regions.lft >= " + regionsQuery.value( 0 ).toString();
-                regionRestriction += " AND regions.lft <= " + regionsQuery.value( 1 ).toString() + ')';
-                regionCount++;
-            }
-            regionRestriction += ')';
+    // Query all database files concurrently. The last one is handled by the calling thread.
+    QList<QFuture<QVector<OsmPlacemark> > > futures;
+    for ( int i = 0; i < m_databaseFiles.size() - 1; ++i ) {
+        futures << QtConcurrent::run( this, &OsmDatabase::findInDatabase, m_databaseFiles.at( i ), userQuery );
+    }
+
+    QVector<OsmPlacemark> result = findInDatabase( m_databaseFiles.last(), userQuery );
+    foreach( const QFuture<QVector<OsmPlacemark> > &future, futures ) {
+        result += future.result();
+    }
+
+    mDebug() << "Offline OSM search query took" << timer.elapsed() << "ms for" << result.count() << "results.";
+
+    qSort( result.begin(), result.end() );
+    unique( result );
+
+    // Each database contributes at most maximumResults placemarks, merge them into the overall top ones
+    const int resultCount = qMin( result.size(), maximumResults );
+    if ( userQuery.position().isValid() ) {
+        const PlacemarkSmallerDistance placemarkSmallerDistance( userQuery.position() );
+        std::partial_sort( result.begin(), result.begin() + resultCount, result.end(), placemarkSmallerDistance );
+    } else {
+        const PlacemarkHigherScore placemarkHigherScore( &userQuery );
+        std::partial_sort( result.begin(), result.begin() + resultCount, result.end(), placemarkHigherScore );
+    }
+
+    result.resize( resultCount );
+
+    return result;
+}
+
+QVector<OsmPlacemark> OsmDatabase::findInDatabase( const QString &databaseFile, const DatabaseQuery &userQuery ) const
+{
+    ThreadConnections *const connections = threadConnections();
+
+    if ( !connections->open( databaseFile ) ) {
+        qWarning() << "Failed to connect to database" << databaseFile;
+        return QVector<OsmPlacemark>();
+    }
+
+    QString categoryRestriction;
+    QVariantList categoryValues;
+    if ( userQuery.category() == OsmPlacemark::UnknownCategory ) {
+        // search for all pois which are not street nor address
+        categoryRestriction = " AND places.category <> 0 AND places.category <> 6";
+    } else {
+        // search for specific category
+        categoryRestriction = " AND places.category = ?";
+        categoryValues << (qint32) userQuery.category();
+    }
 
-            mDebug() << Q_FUNC_INFO << "region query in" << databaseFile << "with query" << regionsQueryString
-                     << "took" << regionTimer.elapsed() << "ms for" << regionCount << "results";
+    if ( userQuery.queryType() == DatabaseQuery::CategorySearch
+         && userQuery.position().isValid() && userQuery.region().isEmpty()
+         && connections->hasSpatialIndex( databaseFile ) ) {
+        return findNearest( databaseFile, userQuery, categoryRestriction, categoryValues );
+    }
 
-            if ( regionCount == 0 ) {
-                continue;
+    QString regionRestriction;
+    QVariantList regionValues;
+    if ( !userQuery.region().isEmpty() ) {
+        QTime regionTimer;
+        regionTimer.start();
+        // Nested set model to support region hierarchies, see http://en.wikipedia.org/wiki/Nested_set_model
+        QSqlQuery &regionsQuery = connections->query( databaseFile, "SELECT lft, rgt FROM regions WHERE name LIKE ?;" );
+        if ( !exec( regionsQuery, QVariantList() << '%' + userQuery.region() + '%' ) ) {
+            qWarning() << regionsQuery.lastError() << "in" << databaseFile << "with query" << regionsQuery.lastQuery();
+        }
+        regionRestriction = " AND (";
+        int regionCount = 0;
+        while ( regionsQuery.next() ) {
+            if ( regionCount > 0 ) {
+                regionRestriction += " OR ";
             }
+            regionRestriction += " (regions.lft >= ? AND regions.lft <= ?)";
+            regionValues << regionsQuery.value( 0 ) << regionsQuery.value( 1 );
+            regionCount++;
         }
+        regionRestriction += ')';
+        regionsQuery.finish();
 
-        QString queryString;
-
-        queryString = " SELECT regions.name,"
-                " places.name, places.number,"
-                " places.category, places.lon, places.lat"
-                " FROM regions, places";
-
-        if ( userQuery.queryType() == DatabaseQuery::CategorySearch ) {
-            queryString += " WHERE regions.id = places.region";
-            if( userQuery.category() == OsmPlacemark::UnknownCategory ) {
-                // search for all pois which are not street nor address
-                queryString += " AND places.category <> 0 AND places.category <> 6";
-            } else {
-                // search for specific category
-                queryString += " AND places.category = %1";
-                queryString = queryString.arg( (qint32) userQuery.category() );
-            }
-            if ( userQuery.position().isValid() && userQuery.region().isEmpty() ) {
-                // sort by distance
-                queryString += " ORDER BY ((places.lat-%1)*(places.lat-%1)+(places.lon-%2)*(places.lon-%2))";
-                GeoDataCoordinates position = userQuery.position();
-                queryString = queryString.arg( position.latitude( GeoDataCoordinates::Degree ), 0, 'f', 8 )
-                        .arg( position.longitude( GeoDataCoordinates::Degree ), 0, 'f', 8 );
-            } else {
-                queryString += regionRestriction;
-            }
-        } else if ( userQuery.queryType() == DatabaseQuery::BroadSearch ) {
-            queryString += " WHERE regions.id = places.region"
-                    " AND places.name " + wildcardQuery( userQuery.searchTerm() );
+        mDebug() << Q_FUNC_INFO << "region query in" << databaseFile << "with query" << regionsQuery.lastQuery()
+                 << "took" << regionTimer.elapsed() << "ms for" << regionCount << "results";
+
+        if ( regionCount == 0 ) {
+            return QVector<OsmPlacemark>();
+        }
+    }
+
+    QString queryString;
+    QVariantList values;
+
+    queryString = " SELECT regions.name,"
+            " places.name, places.number,"
+            " places.category, places.lon, places.lat"
+            " FROM regions, places";
+
+    if ( userQuery.queryType() == DatabaseQuery::CategorySearch ) {
+        queryString += " WHERE regions.id = places.region";
+        queryString += categoryRestriction;
+        values << categoryValues;
+        if ( userQuery.position().isValid() && userQuery.region().isEmpty() ) {
+            // sort by distance
+            queryString += " ORDER BY ((places.lat-?)*(places.lat-?)+(places.lon-?)*(places.lon-?))";
+            const GeoDataCoordinates position = userQuery.position();
+            const qreal lat = position.latitude( GeoDataCoordinates::Degree );
+            const qreal lon = position.longitude( GeoDataCoordinates::Degree );
+            values << lat << lat << lon << lon;
         } else {
-            queryString += " WHERE regions.id = places.region"
-                    "   AND places.name " + wildcardQuery( userQuery.street() );
-            if ( !userQuery.houseNumber().isEmpty() ) {
-                queryString += " AND places.number " + wildcardQuery( userQuery.houseNumber() );
-            } else {
-                queryString += " AND places.number IS NULL";
-            }
             queryString += regionRestriction;
+            values << regionValues;
         }
+    } else if ( userQuery.queryType() == DatabaseQuery::BroadSearch ) {
+        queryString += " WHERE regions.id = places.region"
+                " AND places.name" + wildcardQuery( userQuery.searchTerm(), values );
+    } else {
+        queryString += " WHERE regions.id = places.region"
+                "   AND places.name" + wildcardQuery( userQuery.street(), values );
+        if ( !userQuery.houseNumber().isEmpty() ) {
+            queryString += " AND places.number" + wildcardQuery( userQuery.houseNumber(), values );
+        } else {
+            queryString += " AND places.number IS NULL";
+        }
+        queryString += regionRestriction;
+        values << regionValues;
+    }
 
-        queryString += " LIMIT 50;";
+    queryString += QString( " LIMIT %1;" ).arg( maximumResults );
 
-        /** @todo: sort/filter results from several databases */
+    QSqlQuery &query = connections->query( databaseFile, queryString );
+    QTime queryTimer;
+    queryTimer.start();
+    if ( !exec( query, values ) ) {
+        qWarning() << query.lastError() << "in" << databaseFile << "with query" << query.lastQuery();
+        return QVector<OsmPlacemark>();
+    }
 
-        QSqlQuery query( database );
-        query.setForwardOnly( true );
-        QTime queryTimer;
-        queryTimer.start();
-        if ( !query.exec( queryString ) ) {
-            qWarning() << query.lastError() << "in" << databaseFile << "with query" << query.lastQuery();
-            continue;
+    QVector<OsmPlacemark> result;
+    readPlacemarks( query, userQuery, result );
+
+    mDebug() << Q_FUNC_INFO << "query in" << databaseFile << "with query" << queryString
+             << "took" << queryTimer.elapsed() << "ms for" << result.size() << "results";
+
+    return result;
+}
+
+QVector<OsmPlacemark> OsmDatabase::findNearest( const QString &databaseFile,
+                                                const DatabaseQuery &userQuery,
+                                                const QString &categoryRestriction,
+                                                const QVariantList &categoryValues ) const
+{
+    ThreadConnections *const connections = threadConnections();
+
+    // Same columns as the places view, but driven by the spatial index
+    QString queryString = " SELECT regions.name,"
+            " names.name, places.number,"
+            " places.category, places.lon, places.lat"
+            " FROM placemarksRtree"
+            " INNER JOIN placemarks AS places ON places.id = placemarksRtree.id"
+            " INNER JOIN names ON names.id = places.nameId"
+            " INNER JOIN regions ON regions.id = places.regionId"
+            " WHERE placemarksRtree.minLon >= ? AND placemarksRtree.maxLon <= ?"
+            " AND placemarksRtree.minLat >= ? AND placemarksRtree.maxLat <= ?";
+    queryString += categoryRestriction;
+
+    const qreal lat = userQuery.position().latitude( GeoDataCoordinates::Degree );
+    const qreal lon = userQuery.position().longitude( GeoDataCoordinates::Degree );
+
+    QTime queryTimer;
+    queryTimer.start();
+
+    // Grow a box around the position until it holds enough hits
+    QSqlQuery &countQuery = connections->query( databaseFile, queryString + QString( " LIMIT %1;" ).arg( maximumResults ) );
+    qreal radius = 0.05;
+    for ( ; radius < 360.0; radius *= 2 ) {
+        QVariantList values;
+        values << lon - radius << lon + radius << lat - radius << lat + radius << categoryValues;
+        if ( !exec( countQuery, values ) ) {
+            qWarning() << countQuery.lastError() << "in" << databaseFile << "with query" << countQuery.lastQuery();
+            return QVector<OsmPlacemark>();
         }
 
-        int resultCount = 0;
-        while ( query.next() ) {
-            OsmPlacemark placemark;
-            if ( userQuery.resultFormat() == DatabaseQuery::DistanceFormat ) {
-                GeoDataCoordinates coordinates( query.value(4).toFloat(), query.value(5).toFloat(), 0.0, GeoDataCoordinates::Degree );
-                placemark.setAdditionalInformation( formatDistance( coordinates, userQuery.position() ) );
-            } else {
-                placemark.setAdditionalInformation( query.value( 0 ).toString() );
-            }
-            placemark.setName( query.value(1).toString() );
-            placemark.setHouseNumber( query.value(2).toString() );
-            placemark.setCategory( (OsmPlacemark::OsmCategory) query.value(3).toInt() );
-            placemark.setLongitude( query.value(4).toFloat() );
-            placemark.setLatitude( query.value(5).toFloat() );
-
-            result.push_back( placemark );
-            resultCount++;
+        int count = 0;
+        while ( countQuery.next() ) {
+            ++count;
         }
+        countQuery.finish();
 
-        mDebug() << Q_FUNC_INFO << "query in" << databaseFile << "with query" << queryString
-                 << "took" << queryTimer.elapsed() << "ms for" << resultCount << "results";
+        if ( count >= maximumResults ) {
+            break;
+        }
     }
 
-    mDebug() << "Offline OSM search query took" << timer.elapsed() << "ms for" << result.count() << "results.";
-
-    qSort( result.begin(), result.end() );
-    unique( result );
+    // The nearest hits in a box of half size r are all contained in the circle of radius r * sqrt(2)
+    radius *= M_SQRT2;
+    QVariantList values;
+    values << lon - radius << lon + radius << lat - radius << lat + radius << categoryValues;
 
-    if ( userQuery.position().isValid() ) {
-        const PlacemarkSmallerDistance placemarkSmallerDistance( userQuery.position() );
-        qSort( result.begin(), result.end(), placemarkSmallerDistance );
-    } else {
-        const PlacemarkHigherScore placemarkHigherScore( &userQuery );
-        qSort( result.begin(), result.end(), placemarkHigherScore );
+    QSqlQuery &query = connections->query( databaseFile, queryString + ';' );
+    if ( !exec( query, values ) ) {
+        qWarning() << query.lastError() << "in" << databaseFile << "with query" << query.lastQuery();
+        return QVector<OsmPlacemark>();
     }
 
-    if ( result.size() > 50 ) {
-        result.remove( 50, result.size()-50 );
-    }
+    QVector<OsmPlacemark> result;
+    readPlacemarks( query, userQuery, result );
+
+    const int resultCount = qMin( result.size(), maximumResults );
+    const PlacemarkSmallerDistance placemarkSmallerDistance( userQuery.position() );
+    std::partial_sort( result.begin(), result.begin() + resultCount, result.end(), placemarkSmallerDistance );
+    result.resize( resultCount );
+
+    mDebug() << Q_FUNC_INFO << "spatial query in" << databaseFile << "with radius" << radius
+             << "took" << queryTimer.elapsed() << "ms for" << resultCount << "results";
 
     return result;
 }
 
+void OsmDatabase::readPlacemarks( QSqlQuery &query, const DatabaseQuery &userQuery, QVector<OsmPlacemark> &result ) const
+{
+    while ( query.next() ) {
+        OsmPlacemark placemark;
+        if ( userQuery.resultFormat() == DatabaseQuery::DistanceFormat ) {
+            GeoDataCoordinates coordinates( query.value(4).toFloat(), query.value(5).toFloat(), 0.0, GeoDataCoordinates::Degree );
+            placemark.setAdditionalInformation( formatDistance( coordinates, userQuery.position() ) );
+        } else {
+            placemark.setAdditionalInformation( query.value( 0 ).toString() );
+        }
+        placemark.setName( query.value(1).toString() );
+        placemark.setHouseNumber( query.value(2).toString() );
+        placemark.setCategory( (OsmPlacemark::OsmCategory) query.value(3).toInt() );
+        placemark.setLongitude( query.value(4).toFloat() );
+        placemark.setLatitude( query.value(5).toFloat() );
+
+        result.push_back( placemark );
+    }
+    query.finish();
+}
+
+bool OsmDatabase::exec( QSqlQuery &query, const QVariantList &values ) const
+{
+    for ( int i = 0; i < values.size(); ++i ) {
+        query.bindValue( i, values.at( i ) );
+    }
+    return query.exec();
+}
+
 void OsmDatabase::unique( QVector<OsmPlacemark> &placemarks ) const
 {
     for ( int i=1; i<placemarks.size(); ++i ) {
@@ -290,13 +518,15 @@ qreal OsmDatabase::bearing( const GeoDataCoordinates &a, const GeoDataCoordinate
                        cos( lat1 ) * sin( lat2 ) - sin( lat1 ) * cos( lat2 ) * cos ( delta ) ), 2 * M_PI );
 }
 
-QString OsmDatabase::wildcardQuery( const QString &term ) const
+QString OsmDatabase::wildcardQuery( const QString &term, QVariantList &values ) const
 {
     QString result = term;
     if ( term.contains( '*' ) ) {
-        return " LIKE '" + result.replace( '*', '%' ) + '\'';
+        values << result.replace( '*', '%' );
+        return " LIKE ?";
     } else {
-        return " = '" + result + '\'';
+        values << result;
+        return " = ?";
     }
 }
 
@@ -16,6 +16,9 @@
 
 #include <QtCore/QString>
 #include <QtCore/QStringList>
+#include <QtCore/QVariant>
+
+class QSqlQuery;
 
 namespace Marble {
 
@@ -29,11 +32,25 @@ public:
 
     // Methods for read access
 
-    /** Search the database for matching regions and placemarks */
+    /**
+     * Search the database for matching regions and placemarks. All database files are
+     * queried concurrently and their results merged into the best matches.
+     */
     QVector<OsmPlacemark> find( const DatabaseQuery &userQuery );
 
 private:
-    QString wildcardQuery( const QString &term ) const;
+    QVector<OsmPlacemark> findInDatabase( const QString &databaseFile, const DatabaseQuery &userQuery ) const;
+
+    /** Nearest placemarks of a category search, using the spatial index of the database file */
+    QVector<OsmPlacemark> findNearest( const QString &databaseFile, const DatabaseQuery &userQuery,
+                                       const QString &categoryRestriction,
+                                       const QVariantList &categoryValues ) const;
+
+    void readPlacemarks( QSqlQuery &query, const DatabaseQuery &userQuery, QVector<OsmPlacemark> &result ) const;
+
+    bool exec( QSqlQuery &query, const QVariantList &values ) const;
+
+    QString wildcardQuery( const QString &term, QVariantList &values ) const;
 
     void unique( QVector<OsmPlacemark> &placemarks ) const;
 
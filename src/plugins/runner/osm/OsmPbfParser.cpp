@@ -0,0 +1,844 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "OsmPbfParser.h"
+
+#include <QtCore/QIODevice>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+#include <QtCore/QtEndian>
+
+#include "GeoDataDocument.h"
+#include "GeoDataLineString.h"
+#include "GeoDataPoint.h"
+#include "GeoDataPolygon.h"
+#include "MarbleDebug.h"
+#include "OsmElementDictionary.h"
+#include "OsmGlobals.h"
+#include "OsmMemberTagHandler.h"
+#include "OsmNodeFactory.h"
+#include "OsmOsmTagHandler.h"
+#include "OsmRelationFactory.h"
+#include "OsmRelationTagHandler.h"
+#include "OsmTagTagHandler.h"
+#include "OsmWayFactory.h"
+#include "OsmWayTagHandler.h"
+
+namespace Marble
+{
+
+namespace
+{
+// Limits of the format, larger sizes indicate a damaged file
+const quint32 maximumHeaderSize = 64 * 1024;
+const quint64 maximumBlobSize = 32 * 1024 * 1024;
+
+// Coordinates are stored in units of this many degrees times the granularity of the block
+const qreal coordinateUnit = 1e-9;
+
+const char *const memberTypes[] = { "node", "way", "relation" };
+
+/**
+ * Reads the fields of a protocol buffer message, see
+ * https://developers.google.com/protocol-buffers/docs/encoding
+ */
+class ProtobufReader
+{
+public:
+    ProtobufReader( const char *data = 0, int size = 0 )
+        : m_position( reinterpret_cast<const uchar *>( data ) ),
+          m_end( m_position + size ),
+          m_field( 0 ),
+          m_wireType( 0 ),
+          m_error( false )
+    {
+    }
+
+    // Moves to the next field, returns false at the end of the message and on errors
+    bool next()
+    {
+        if ( m_error || m_position >= m_end ) {
+            return false;
+        }
+        const quint64 key = varint();
+        m_field = int( key >> 3 );
+        m_wireType = int( key & 7 );
+        return !m_error;
+    }
+
+    int field() const { return m_field; }
+    bool hasError() const { return m_error; }
+    bool atEnd() const { return m_position >= m_end; }
+    const char *data() const { return reinterpret_cast<const char *>( m_position ); }
+    int size() const { return int( m_end - m_position ); }
+
+    quint64 varint()
+    {
+        quint64 result = 0;
+        for ( int shift = 0; shift < 64 && m_position < m_end; shift += 7 ) {
+            const uchar byte = *m_position++;
+            result |= quint64( byte & 0x7f ) << shift;
+            if ( !( byte & 0x80 ) ) {
+                return result;
+            }
+        }
+        m_error = true;
+        return 0;
+    }
+
+    static qint64 zigzag( quint64 value )
+    {
+        return qint64( value >> 1 ) ^ -qint64( value & 1 );
+    }
+
+    // Returns a reader of the length delimited value of the current field
+    ProtobufReader message()
+    {
+        const quint64 size = varint();
+        if ( m_error || m_wireType != 2 || size > quint64( m_end - m_position ) ) {
+            m_error = true;
+            return ProtobufReader();
+        }
+        const ProtobufReader result( data(), int( size ) );
+        m_position += size;
+        return result;
+    }
+
+    QString string()
+    {
+        const ProtobufReader value = message();
+        return QString::fromUtf8( value.data(), value.size() );
+    }
+
+    // Appends the values of a repeated varint field, which may be packed or not
+    void appendVarints( QVector<quint64> &values )
+    {
+        if ( m_wireType == 0 ) {
+            values.append( varint() );
+            return;
+        }
+
+        ProtobufReader packed = message();
+        while ( !packed.atEnd() && !packed.hasError() ) {
+            values.append( packed.varint() );
+        }
+        m_error = m_error || packed.hasError();
+    }
+
+    void skip()
+    {
+        switch ( m_wireType ) {
+        case 0:
+            varint();
+            break;
+        case 1:
+            advance( 8 );
+            break;
+        case 2:
+            message();
+            break;
+        case 5:
+            advance( 4 );
+            break;
+        default:
+            m_error = true;
+        }
+    }
+
+private:
+    void advance( int size )
+    {
+        if ( m_end - m_position < size ) {
+            m_error = true;
+        } else {
+            m_position += size;
+        }
+    }
+
+    const uchar *m_position;
+    const uchar *m_end;
+    int m_field;
+    int m_wireType;
+    bool m_error;
+};
+
+struct PbfNode
+{
+    quint64 id;
+    qreal lon;
+    qreal lat;
+    int tagBegin;
+    int tagEnd;
+};
+
+struct PbfWay
+{
+    quint64 id;
+    int refBegin;
+    int refEnd;
+    int tagBegin;
+    int tagEnd;
+};
+
+struct PbfMember
+{
+    quint64 id;
+    int type;
+    int role;
+};
+
+struct PbfRelation
+{
+    quint64 id;
+    int memberBegin;
+    int memberEnd;
+    int tagBegin;
+    int tagEnd;
+};
+
+// The decoded content of one blob of the file
+struct PbfBlock
+{
+    QByteArray blob;
+    QString error;
+
+    QVector<QString> strings;
+    QVector<PbfNode> nodes;
+    QVector<PbfWay> ways;
+    QVector<PbfRelation> relations;
+
+    // string indices of the keys and values of the tags
+    QVector<int> tags;
+    QVector<quint64> refs;
+    QVector<PbfMember> members;
+};
+
+QByteArray inflateBlob( const QByteArray &blob, QString *error )
+{
+    ProtobufReader reader( blob.constData(), blob.size() );
+    QByteArray raw;
+    quint64 rawSize = 0;
+    ProtobufReader zlibData;
+    bool hasZlibData = false;
+    bool hasOtherData = false;
+
+    while ( reader.next() ) {
+        switch ( reader.field() ) {
+        case 1: {
+            const ProtobufReader data = reader.message();
+            raw = QByteArray( data.data(), data.size() );
+            break;
+        }
+        case 2:
+            rawSize = reader.varint();
+            break;
+        case 3:
+            zlibData = reader.message();
+            hasZlibData = true;
+            break;
+        default:
+            // lzma and other compressions
+            hasOtherData = true;
+            reader.skip();
+        }
+    }
+
+    if ( reader.hasError() ) {
+        *error = QString( "Damaged blob" );
+        return QByteArray();
+    }
+
+    if ( hasZlibData ) {
+        if ( rawSize > maximumBlobSize ) {
+            *error = QString( "Blob of %1 bytes is too large" ).arg( rawSize );
+            return QByteArray();
+        }
+
+        // qUncompress expects the size of the uncompressed data in front of the zlib stream
+        QByteArray compressed;
+        compressed.reserve( 4 + zlibData.size() );
+        compressed.resize( 4 );
+        qToBigEndian<quint32>( rawSize, reinterpret_cast<uchar *>( compressed.data() ) );
+        compressed.append( zlibData.data(), zlibData.size() );
+        raw = qUncompress( compressed );
+        if ( quint64( raw.size() ) != rawSize ) {
+            *error = QString( "Failed to inflate blob" );
+            return QByteArray();
+        }
+    } else if ( raw.isEmpty() && hasOtherData ) {
+        *error = QString( "Unsupported blob compression" );
+    }
+
+    return raw;
+}
+
+bool checkHeader( const QByteArray &data, QString *error )
+{
+    ProtobufReader reader( data.constData(), data.size() );
+    while ( reader.next() ) {
+        if ( reader.field() == 4 ) {
+            const QString feature = reader.string();
+            if ( feature != "OsmSchema-V0.6" && feature != "DenseNodes" ) {
+                *error = QString( "Unsupported feature %1" ).arg( feature );
+                return false;
+            }
+        } else {
+            reader.skip();
+        }
+    }
+
+    if ( reader.hasError() ) {
+        *error = QString( "Damaged header block" );
+        return false;
+    }
+    return true;
+}
+
+bool appendTags( PbfBlock *block, const QVector<quint64> &keys, const QVector<quint64> &values, int *begin, int *end )
+{
+    if ( keys.size() != values.size() ) {
+        return false;
+    }
+
+    *begin = block->tags.size();
+    for ( int i = 0; i < keys.size(); ++i ) {
+        if ( keys.at( i ) >= quint64( block->strings.size() ) || values.at( i ) >= quint64( block->strings.size() ) ) {
+            return false;
+        }
+        block->tags.append( int( keys.at( i ) ) );
+        block->tags.append( int( values.at( i ) ) );
+    }
+    *end = block->tags.size();
+    return true;
+}
+
+class BlockDecoder : public QRunnable
+{
+public:
+    explicit BlockDecoder( PbfBlock *block )
+        : m_block( block ),
+          m_granularity( 100 ),
+          m_latOffset( 0 ),
+          m_lonOffset( 0 )
+    {
+    }
+
+    virtual void run()
+    {
+        const QByteArray data = inflateBlob( m_block->blob, &m_block->error );
+        m_block->blob.clear();
+        if ( m_block->error.isEmpty() && !decodeBlock( data ) ) {
+            m_block->error = QString( "Damaged data block" );
+        }
+    }
+
+private:
+    qreal coordinate( qint64 offset, qint64 value ) const
+    {
+        return ( offset + m_granularity * value ) * coordinateUnit;
+    }
+
+    bool decodeBlock( const QByteArray &data );
+    bool decodeGroup( ProtobufReader group );
+    bool decodeNode( ProtobufReader reader );
+    bool decodeDenseNodes( ProtobufReader reader );
+    bool decodeWay( ProtobufReader reader );
+    bool decodeRelation( ProtobufReader reader );
+
+    PbfBlock *const m_block;
+    qint64 m_granularity;
+    qint64 m_latOffset;
+    qint64 m_lonOffset;
+};
+
+bool BlockDecoder::decodeBlock( const QByteArray &data )
+{
+    ProtobufReader reader( data.constData(), data.size() );
+
+    // The groups come before the granularity and offsets they depend on
+    QVector<ProtobufReader> groups;
+    while ( reader.next() ) {
+        switch ( reader.field() ) {
+        case 1: {
+            ProtobufReader table = reader.message();
+            while ( table.next() ) {
+                if ( table.field() == 1 ) {
+                    m_block->strings.append( table.string() );
+                } else {
+                    table.skip();
+                }
+            }
+            if ( table.hasError() ) {
+                return false;
+            }
+            break;
+        }
+        case 2:
+            groups.append( reader.message() );
+            break;
+        case 17:
+            m_granularity = qint64( reader.varint() );
+            break;
+        case 19:
+            m_latOffset = qint64( reader.varint() );
+            break;
+        case 20:
+            m_lonOffset = qint64( reader.varint() );
+            break;
+        default:
+            reader.skip();
+        }
+    }
+
+    if ( reader.hasError() ) {
+        return false;
+    }
+
+    foreach ( const ProtobufReader &group, groups ) {
+        if ( !decodeGroup( group ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BlockDecoder::decodeGroup( ProtobufReader group )
+{
+    bool result = true;
+    while ( result && group.next() ) {
+        switch ( group.field() ) {
+        case 1:
+            result = decodeNode( group.message() );
+            break;
+        case 2:
+            result = decodeDenseNodes( group.message() );
+            break;
+        case 3:
+            result = decodeWay( group.message() );
+            break;
+        case 4:
+            result = decodeRelation( group.message() );
+            break;
+        default:
+            // changesets
+            group.skip();
+        }
+    }
+    return result && !group.hasError();
+}
+
+bool BlockDecoder::decodeNode( ProtobufReader reader )
+{
+    PbfNode node;
+    node.id = 0;
+    qint64 lat = 0;
+    qint64 lon = 0;
+    QVector<quint64> keys;
+    QVector<quint64> values;
+
+    while ( reader.next() ) {
+        switch ( reader.field() ) {
+        case 1:
+            node.id = quint64( ProtobufReader::zigzag( reader.varint() ) );
+            break;
+        case 2:
+            reader.appendVarints( keys );
+            break;
+        case 3:
+            reader.appendVarints( values );
+            break;
+        case 8:
+            lat = ProtobufReader::zigzag( reader.varint() );
+            break;
+        case 9:
+            lon = ProtobufReader::zigzag( reader.varint() );
+            break;
+        default:
+            reader.skip();
+        }
+    }
+
+    if ( reader.hasError() || !appendTags( m_block, keys, values, &node.tagBegin, &node.tagEnd ) ) {
+        return false;
+    }
+
+    node.lon = coordinate( m_lonOffset, lon );
+    node.lat = coordinate( m_latOffset, lat );
+    m_block->nodes.append( node );
+    return true;
+}
+
+bool BlockDecoder::decodeDenseNodes( ProtobufReader reader )
+{
+    QVector<quint64> ids;
+    QVector<quint64> lats;
+    QVector<quint64> lons;
+    QVector<quint64> keysValues;
+
+    while ( reader.next() ) {
+        switch ( reader.field() ) {
+        case 1:
+            reader.appendVarints( ids );
+            break;
+        case 8:
+            reader.appendVarints( lats );
+            break;
+        case 9:
+            reader.appendVarints( lons );
+            break;
+        case 10:
+            reader.appendVarints( keysValues );
+            break;
+        default:
+            reader.skip();
+        }
+    }
+
+    if ( reader.hasError() || lats.size() != ids.size() || lons.size() != ids.size() ) {
+        return false;
+    }
+
+    // Ids and coordinates are delta coded, the tags of all nodes are
+    // one list of key and value pairs, each node's tags end with a 0
+    m_block->nodes.reserve( m_block->nodes.size() + ids.size() );
+    qint64 id = 0;
+    qint64 lat = 0;
+    qint64 lon = 0;
+    int keyValue = 0;
+    const quint64 stringCount = m_block->strings.size();
+    for ( int i = 0; i < ids.size(); ++i ) {
+        id += ProtobufReader::zigzag( ids.at( i ) );
+        lat += ProtobufReader::zigzag( lats.at( i ) );
+        lon += ProtobufReader::zigzag( lons.at( i ) );
+
+        PbfNode node;
+        node.id = quint64( id );
+        node.lon = coordinate( m_lonOffset, lon );
+        node.lat = coordinate( m_latOffset, lat );
+        node.tagBegin = m_block->tags.size();
+        while ( keyValue < keysValues.size() && keysValues.at( keyValue ) != 0 ) {
+            if ( keyValue + 1 >= keysValues.size()
+                 || keysValues.at( keyValue ) >= stringCount || keysValues.at( keyValue + 1 ) >= stringCount ) {
+                return false;
+            }
+            m_block->tags.append( int( keysValues.at( keyValue ) ) );
+            m_block->tags.append( int( keysValues.at( keyValue + 1 ) ) );
+            keyValue += 2;
+        }
+        ++keyValue;
+        node.tagEnd = m_block->tags.size();
+        m_block->nodes.append( node );
+    }
+
+    return true;
+}
+
+bool BlockDecoder::decodeWay( ProtobufReader reader )
+{
+    PbfWay way;
+    way.id = 0;
+    QVector<quint64> keys;
+    QVector<quint64> values;
+    QVector<quint64> refs;
+
+    while ( reader.next() ) {
+        switch ( reader.field() ) {
+        case 1:
+            way.id = reader.varint();
+            break;
+        case 2:
+            reader.appendVarints( keys );
+            break;
+        case 3:
+            reader.appendVarints( values );
+            break;
+        case 8:
+            reader.appendVarints( refs );
+            break;
+        default:
+            reader.skip();
+        }
+    }
+
+    if ( reader.hasError() || !appendTags( m_block, keys, values, &way.tagBegin, &way.tagEnd ) ) {
+        return false;
+    }
+
+    way.refBegin = m_block->refs.size();
+    qint64 ref = 0;
+    foreach ( quint64 delta, refs ) {
+        ref += ProtobufReader::zigzag( delta );
+        m_block->refs.append( quint64( ref ) );
+    }
+    way.refEnd = m_block->refs.size();
+    m_block->ways.append( way );
+    return true;
+}
+
+bool BlockDecoder::decodeRelation( ProtobufReader reader )
+{
+    PbfRelation relation;
+    relation.id = 0;
+    QVector<quint64> keys;
+    QVector<quint64> values;
+    QVector<quint64> roles;
+    QVector<quint64> ids;
+    QVector<quint64> types;
+
+    while ( reader.next() ) {
+        switch ( reader.field() ) {
+        case 1:
+            relation.id = reader.varint();
+            break;
+        case 2:
+            reader.appendVarints( keys );
+            break;
+        case 3:
+            reader.appendVarints( values );
+            break;
+        case 8:
+            reader.appendVarints( roles );
+            break;
+        case 9:
+            reader.appendVarints( ids );
+            break;
+        case 10:
+            reader.appendVarints( types );
+            break;
+        default:
+            reader.skip();
+        }
+    }
+
+    if ( reader.hasError() || roles.size() != ids.size() || types.size() != ids.size()
+         || !appendTags( m_block, keys, values, &relation.tagBegin, &relation.tagEnd ) ) {
+        return false;
+    }
+
+    relation.memberBegin = m_block->members.size();
+    qint64 id = 0;
+    for ( int i = 0; i < ids.size(); ++i ) {
+        id += ProtobufReader::zigzag( ids.at( i ) );
+        if ( roles.at( i ) >= quint64( m_block->strings.size() ) ) {
+            return false;
+        }
+        PbfMember member;
+        member.id = quint64( id );
+        member.type = int( types.at( i ) );
+        member.role = int( roles.at( i ) );
+        m_block->members.append( member );
+    }
+    relation.memberEnd = m_block->members.size();
+    m_block->relations.append( relation );
+    return true;
+}
+
+}
+
+class OsmPbfParser::Private
+{
+public:
+    Private();
+
+    bool readBlob( QIODevice *device, QString *type, QByteArray *blob );
+    void assemble( const PbfBlock &block );
+
+    GeoDataDocument *m_document;
+    QString m_errorString;
+};
+
+OsmPbfParser::Private::Private()
+    : m_document( 0 )
+{
+}
+
+bool OsmPbfParser::Private::readBlob( QIODevice *device, QString *type, QByteArray *blob )
+{
+    const QByteArray size = device->read( 4 );
+    if ( size.isEmpty() && device->atEnd() ) {
+        return false;
+    }
+
+    const quint32 headerSize = size.size() == 4 ? qFromBigEndian<quint32>( reinterpret_cast<const uchar *>( size.constData() ) ) : 0;
+    const QByteArray header = headerSize <= maximumHeaderSize ? device->read( headerSize ) : QByteArray();
+    if ( headerSize == 0 || quint32( header.size() ) != headerSize ) {
+        m_errorString = QString( "Damaged blob header" );
+        return false;
+    }
+
+    ProtobufReader reader( header.constData(), header.size() );
+    quint64 dataSize = 0;
+    while ( reader.next() ) {
+        switch ( reader.field() ) {
+        case 1:
+            *type = reader.string();
+            break;
+        case 3:
+            dataSize = reader.varint();
+            break;
+        default:
+            reader.skip();
+        }
+    }
+
+    if ( reader.hasError() || dataSize > maximumBlobSize ) {
+        m_errorString = QString( "Damaged blob header" );
+        return false;
+    }
+
+    *blob = device->read( dataSize );
+    if ( quint64( blob->size() ) != dataSize ) {
+        m_errorString = QString( "Unexpected end of file" );
+        return false;
+    }
+    return true;
+}
+
+void OsmPbfParser::Private::assemble( const PbfBlock &block )
+{
+    // Same order as the tag handlers see the elements of XML files
+    foreach ( const PbfNode &node, block.nodes ) {
+        osm::OsmNodeFactory::appendNode( node.id, node.lon, node.lat );
+        if ( node.tagBegin == node.tagEnd ) {
+            continue;
+        }
+        GeoDataPoint *const point = osm::OsmNodeFactory::currentPoint( node.lon, node.lat );
+        for ( int i = node.tagBegin; i < node.tagEnd; i += 2 ) {
+            osm::OsmTagTagHandler::addTag( m_document, point, osm::osmTag_node,
+                                           block.strings.at( block.tags.at( i ) ), block.strings.at( block.tags.at( i + 1 ) ) );
+        }
+    }
+
+    foreach ( const PbfWay &way, block.ways ) {
+        GeoDataLineString *const lineString = osm::OsmWayTagHandler::createWay( m_document, way.id );
+        lineString->reserve( way.refEnd - way.refBegin );
+        GeoDataCoordinates coordinates;
+        for ( int i = way.refBegin; i < way.refEnd; ++i ) {
+            if ( osm::OsmNodeFactory::coordinates( block.refs.at( i ), coordinates ) ) {
+                lineString->append( coordinates );
+            }
+        }
+        for ( int i = way.tagBegin; i < way.tagEnd; i += 2 ) {
+            osm::OsmTagTagHandler::addTag( m_document, lineString, osm::osmTag_way,
+                                           block.strings.at( block.tags.at( i ) ), block.strings.at( block.tags.at( i + 1 ) ) );
+        }
+    }
+
+    foreach ( const PbfRelation &relation, block.relations ) {
+        GeoDataPolygon *const polygon = osm::OsmRelationTagHandler::createRelation( m_document, relation.id );
+        for ( int i = relation.memberBegin; i < relation.memberEnd; ++i ) {
+            const PbfMember &member = block.members.at( i );
+            if ( member.type >= 0 && member.type < 3 ) {
+                osm::OsmMemberTagHandler::addMember( polygon, memberTypes[member.type], block.strings.at( member.role ), member.id );
+            }
+        }
+        for ( int i = relation.tagBegin; i < relation.tagEnd; i += 2 ) {
+            osm::OsmTagTagHandler::addTag( m_document, polygon, osm::osmTag_relation,
+                                           block.strings.at( block.tags.at( i ) ), block.strings.at( block.tags.at( i + 1 ) ) );
+        }
+    }
+}
+
+OsmPbfParser::OsmPbfParser()
+    : d( new Private )
+{
+}
+
+OsmPbfParser::~OsmPbfParser()
+{
+    osm::OsmRelationFactory::clear();
+    osm::OsmWayFactory::clear();
+    osm::OsmNodeFactory::clear();
+    osm::OsmGlobals::cleanUpDummyPlacemarks();
+
+    delete d->m_document;
+    delete d;
+}
+
+bool OsmPbfParser::read( QIODevice *device )
+{
+    delete d->m_document;
+    d->m_document = 0;
+    d->m_errorString.clear();
+
+    QString type;
+    QByteArray blob;
+    if ( !d->readBlob( device, &type, &blob ) || type != "OSMHeader" ) {
+        if ( d->m_errorString.isEmpty() ) {
+            d->m_errorString = QString( "Not an OSM PBF file" );
+        }
+        return false;
+    }
+
+    const QByteArray header = inflateBlob( blob, &d->m_errorString );
+    if ( !d->m_errorString.isEmpty() || !checkHeader( header, &d->m_errorString ) ) {
+        return false;
+    }
+
+    d->m_document = new GeoDataDocument;
+    osm::OsmOsmTagHandler::addStyles( d->m_document );
+
+    // A pool of its own cannot be exhausted by the runners waiting for it
+    QThreadPool pool;
+    const int batchSize = 2 * qMax( 1, QThread::idealThreadCount() );
+
+    bool atEnd = false;
+    while ( !atEnd ) {
+        // Inflate and decode a batch of blobs concurrently, then assemble them in order
+        QVector<PbfBlock *> blocks;
+        while ( blocks.size() < batchSize ) {
+            if ( !d->readBlob( device, &type, &blob ) ) {
+                atEnd = true;
+                break;
+            }
+            if ( type != "OSMData" ) {
+                mDebug() << "Skipping unknown blob type" << type;
+                continue;
+            }
+            PbfBlock *const block = new PbfBlock;
+            block->blob = blob;
+            blocks.append( block );
+            pool.start( new BlockDecoder( block ) );
+        }
+        pool.waitForDone();
+
+        foreach ( const PbfBlock *block, blocks ) {
+            if ( d->m_errorString.isEmpty() && !block->error.isEmpty() ) {
+                d->m_errorString = block->error;
+            }
+            if ( d->m_errorString.isEmpty() ) {
+                d->assemble( *block );
+            }
+        }
+        qDeleteAll( blocks );
+
+        if ( !d->m_errorString.isEmpty() ) {
+            delete d->m_document;
+            d->m_document = 0;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+GeoDataDocument *OsmPbfParser::releaseDocument()
+{
+    GeoDataDocument *const document = d->m_document;
+    d->m_document = 0;
+    return document;
+}
+
+QString OsmPbfParser::errorString() const
+{
+    return d->m_errorString;
+}
+
+}
@@ -0,0 +1,54 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_OSMPBFPARSER_H
+#define MARBLE_OSMPBFPARSER_H
+
+#include <QtCore/QString>
+
+class QIODevice;
+
+namespace Marble
+{
+
+class GeoDataDocument;
+
+/**
+ * @short Parser of OpenStreetMap files in the binary PBF format.
+ *
+ * The file is a sequence of zlib compressed blobs of nodes, ways and
+ * relations encoded as protocol buffers, see
+ * http://wiki.openstreetmap.org/wiki/PBF_Format. Batches of blobs are
+ * inflated and decoded concurrently, the decoded elements are then
+ * assembled in file order by the same code the XML tag handlers use.
+ */
+class OsmPbfParser
+{
+public:
+    OsmPbfParser();
+    ~OsmPbfParser();
+
+    bool read( QIODevice *device );
+
+    /**
+     * Returns the parsed document, which belongs to the caller then.
+     */
+    GeoDataDocument *releaseDocument();
+
+    QString errorString() const;
+
+private:
+    Q_DISABLE_COPY( OsmPbfParser )
+
+    class Private;
+    Private *const d;
+};
+
+}
+
+#endif // MARBLE_OSMPBFPARSER_H
@@ -56,7 +56,7 @@ QString OsmPlugin::fileFormatDescription() const
 
 QStringList OsmPlugin::fileExtensions() const
 {
-    return QStringList() << "osm";
+    return QStringList() << "osm" << "pbf";
 }
 
 ParsingRunner* OsmPlugin::newRunner() const
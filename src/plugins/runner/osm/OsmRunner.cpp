@@ -11,8 +11,10 @@
 
 #include "GeoDataDocument.h"
 #include "OsmParser.h"
+#include "OsmPbfParser.h"
 
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
 
 namespace Marble
 {
@@ -38,6 +40,21 @@ void OsmRunner::parseFile( const QString &fileName, DocumentRole role = UnknownD
     // Open file in right mode
     file.open( QIODevice::ReadOnly );
 
+    if ( QFileInfo( fileName ).suffix().toLower() == "pbf" ) {
+        OsmPbfParser parser;
+        if ( !parser.read( &file ) ) {
+            emit parsingFinished( 0, parser.errorString() );
+            return;
+        }
+        GeoDataDocument* doc = parser.releaseDocument();
+        doc->setDocumentRole( role );
+        doc->setFileName( fileName );
+
+        file.close();
+        emit parsingFinished( doc );
+        return;
+    }
+
     OsmParser parser;
 
     if ( !parser.read( &file ) ) {
@@ -42,146 +42,140 @@ GeoNode* OsmMemberTagHandler::parse( GeoParser& parser ) const
 
     if ( parentItem.represents( osmTag_relation ) )
     {
-        // Never heard of a type different from "way" but
-        // maybe it should be checked
+        GeoDataPolygon *polygon = parentItem.nodeAs<GeoDataPolygon>();
+        Q_ASSERT( polygon );
+        addMember( polygon, parser.attribute( "type" ), parser.attribute( "role" ),
+                   parser.attribute( "ref" ).toULongLong() );
+        return 0;
+    }
+
+    return 0;
+}
 
-        if (parser.attribute( "type" ) == "way")
+void OsmMemberTagHandler::addMember( GeoDataPolygon *polygon, const QString &type, const QString &role, quint64 id )
+{
+    // Never heard of a type different from "way" but
+    // maybe it should be checked
+
+    if (type == "way")
+    {
+        // Outer poligons (sometimes the role is empty)
+        if (role == "outer" || role == "")
         {
-            // Outer poligons (sometimes the role is empty)
-            if (parser.attribute( "role" ) == "outer" || parser.attribute( "role" ) == "")
+            // With the id we get the way geometry
+            if ( GeoDataLineString *line =  osm::OsmWayFactory::line( id )  )
             {
+                // Some of the ways that build the relation
+                // might be in opposite directions
+                // so the final linearRing would be wrong.
+                // It is needed to seek in the linearRing
+                // to know if the new way should be added
+                // at the beginning or end and in which order.
+                // Also the shared node (which will be in both
+                // geometries) has to be removed to avoid having
+                // it repeated.
+
+                GeoDataLinearRing envelope = polygon->outerBoundary();
+
+                // Case 0: envelope is empty
+                if ( envelope.isEmpty() )
+                {
+                    envelope = *line;
+                }
 
-                GeoDataPolygon *polygon = parentItem.nodeAs<GeoDataPolygon>();
-                Q_ASSERT( polygon );
-                quint64 id = parser.attribute( "ref" ).toULongLong();
-
-                // With the id we get the way geometry
-                if ( GeoDataLineString *line =  osm::OsmWayFactory::line( id )  )
+                // Case 1: line.first = envelope.first
+                else if ( line->first() == envelope.first() )
                 {
-                    // Some of the ways that build the relation
-                    // might be in opposite directions
-                    // so the final linearRing would be wrong.
-                    // It is needed to seek in the linearRing
-                    // to know if the new way should be added
-                    // at the beginning or end and in which order.
-                    // Also the shared node (which will be in both
-                    // geometries) has to be removed to avoid having
-                    // it repeated.
-
-                    GeoDataLinearRing envelope = polygon->outerBoundary();
-
-                    // Case 0: envelope is empty
-                    if ( envelope.isEmpty() )
-                    {
-                        envelope = *line;
-                    }
+                    GeoDataLinearRing temp = GeoDataLinearRing( envelope.tessellationFlags() );
 
-                    // Case 1: line.first = envelope.first
-                    else if ( line->first() == envelope.first() )
+                    // Invert envelopes direction
+                    for (int x = envelope.size()-1; x > -1; x--)
                     {
-                        GeoDataLinearRing temp = GeoDataLinearRing( envelope.tessellationFlags() );
-
-                        // Invert envelopes direction
-                        for (int x = envelope.size()-1; x > -1; x--)
-                        {
-                            temp.append( GeoDataCoordinates ( envelope.at(x) ) );
-                        }
-                        envelope = temp;
-
-                        // Now its the same as case 2
-                        // envelope-last not to repeat the shared node
-                        envelope.remove( envelope.size() - 1 );
-                        envelope << *line;
+                        temp.append( GeoDataCoordinates ( envelope.at(x) ) );
                     }
+                    envelope = temp;
 
-                    // Case 2: line.first = envelope.last
-                    else if (line->first() == envelope.last() )
-                    {
-                        // envelope-last not to repeat the shared node
-                        envelope.remove( envelope.size() - 1 );
-                        envelope << *line;
-                    }
+                    // Now its the same as case 2
+                    // envelope-last not to repeat the shared node
+                    envelope.remove( envelope.size() - 1 );
+                    envelope << *line;
+                }
+
+                // Case 2: line.first = envelope.last
+                else if (line->first() == envelope.last() )
+                {
+                    // envelope-last not to repeat the shared node
+                    envelope.remove( envelope.size() - 1 );
+                    envelope << *line;
+                }
+
+                // Case 3: line.last = envelope.first
+                else if (line->last() == envelope.first() )
+                {
+                    GeoDataLinearRing temp = GeoDataLinearRing( envelope.tessellationFlags() );
 
-                    // Case 3: line.last = envelope.first
-                    else if (line->last() == envelope.first() )
+                    // Invert envelopes direction
+                    for (int x = envelope.size()-1; x > -1; x--)
                     {
-                        GeoDataLinearRing temp = GeoDataLinearRing( envelope.tessellationFlags() );
-
-                        // Invert envelopes direction
-                        for (int x = envelope.size()-1; x > -1; x--)
-                        {
-                            temp.append( GeoDataCoordinates ( envelope.at(x) ) );
-                        }
-                        envelope = temp;
-
-                        // Now its the same as case 4
-                        // size-2 not to repeat the shared node
-                        for (int x = line->size()-2; x > -1; x--)
-                        {
-                            envelope.append( GeoDataCoordinates ( line->at(x) ) );
-                        }
+                        temp.append( GeoDataCoordinates ( envelope.at(x) ) );
                     }
+                    envelope = temp;
 
-                    // Case 4: line.last = envelope.last
-                    else if (line->last() == envelope.last() )
+                    // Now its the same as case 4
+                    // size-2 not to repeat the shared node
+                    for (int x = line->size()-2; x > -1; x--)
                     {
-                        // size-2 not to repeat the shared node
-                        for (int x = line->size()-2; x > -1; x--)
-                        {
-                            envelope.append( GeoDataCoordinates ( line->at(x) ) );
-                        }
+                        envelope.append( GeoDataCoordinates ( line->at(x) ) );
                     }
-
-                    // Update the outer boundary
-                    polygon->setOuterBoundary( envelope );
                 }
-            }
-
-            // Inner poligons
-            if (parser.attribute( "role" ) == "inner")
-            {
-                GeoDataPolygon *polygon = parentItem.nodeAs<GeoDataPolygon>();
-                Q_ASSERT( polygon );
-                quint64 id = parser.attribute( "ref" ).toULongLong();
 
-                // With the id we get the way geometry
-                if ( GeoDataLineString *line = osm::OsmWayFactory::line( id ) )
+                // Case 4: line.last = envelope.last
+                else if (line->last() == envelope.last() )
                 {
-                    polygon->appendInnerBoundary( GeoDataLinearRing( *line ) );
+                    // size-2 not to repeat the shared node
+                    for (int x = line->size()-2; x > -1; x--)
+                    {
+                        envelope.append( GeoDataCoordinates ( line->at(x) ) );
+                    }
                 }
+
+                // Update the outer boundary
+                polygon->setOuterBoundary( envelope );
             }
         }
 
-        else if (parser.attribute( "type" ) == "relation")
+        // Inner poligons
+        if (role == "inner")
         {
-            // Never seen this case
-            if ( parser.attribute( "role" ) == "outer" )
+            // With the id we get the way geometry
+            if ( GeoDataLineString *line = osm::OsmWayFactory::line( id ) )
             {
-                mDebug() << "Parsed relation with a relation outer member";
+                polygon->appendInnerBoundary( GeoDataLinearRing( *line ) );
             }
+        }
+    }
 
-            // It only can be an inner relation or subarea
-            // Subarea is mainly used for administrative boundaries
-            else if (parser.attribute( "role" ) == "inner"
-                     || parser.attribute( "role" ) == "subarea"
-                     || parser.attribute( "role" ) == "")
-            {
-                GeoDataPolygon *polygon = parentItem.nodeAs<GeoDataPolygon>();
-                Q_ASSERT( polygon );
-                quint64 id = parser.attribute( "ref" ).toULongLong();
+    else if (type == "relation")
+    {
+        // Never seen this case
+        if ( role == "outer" )
+        {
+            mDebug() << "Parsed relation with a relation outer member";
+        }
 
-                // With the id we get the relation geometry
-                if ( GeoDataPolygon *p =  osm::OsmRelationFactory::polygon( id ) )
-                {
-                    polygon->appendInnerBoundary( p->outerBoundary() );
-                }
+        // It only can be an inner relation or subarea
+        // Subarea is mainly used for administrative boundaries
+        else if (role == "inner"
+                 || role == "subarea"
+                 || role == "")
+        {
+            // With the id we get the relation geometry
+            if ( GeoDataPolygon *p =  osm::OsmRelationFactory::polygon( id ) )
+            {
+                polygon->appendInnerBoundary( p->outerBoundary() );
             }
         }
-
-        return 0;
     }
-
-    return 0;
 }
 
 }
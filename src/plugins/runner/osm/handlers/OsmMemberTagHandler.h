@@ -13,11 +13,15 @@
 #ifndef MARBLE_OSMMEMBERTAGHANDLER_H
 #define MARBLE_OSMMEMBERTAGHANDLER_H
 
+#include <QtCore/QString>
+
 #include "GeoTagHandler.h"
 #include "marble_export.h"
 
 namespace Marble
 {
+class GeoDataPolygon;
+
 namespace osm
 {
 
@@ -25,6 +29,12 @@ class OsmMemberTagHandler : public GeoTagHandler
 {
 public:
     virtual GeoNode* parse( GeoParser& ) const;
+
+    /**
+     * Adds the member @p id of the given @p type and @p role to the
+     * relation represented by @p polygon.
+     */
+    static void addMember( GeoDataPolygon *polygon, const QString &type, const QString &role, quint64 id );
 };
 
 }
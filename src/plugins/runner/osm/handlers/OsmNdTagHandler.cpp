@@ -39,9 +39,10 @@ GeoNode* OsmNdTagHandler::parse( GeoParser& parser ) const
         GeoDataLineString *s = parentItem.nodeAs<GeoDataLineString>();
         Q_ASSERT( s );
         quint64 id = parser.attribute( "ref" ).toULongLong();
-        if ( GeoDataPoint *p = osm::OsmNodeFactory::getPoint( id ) )
+        GeoDataCoordinates coordinates;
+        if ( osm::OsmNodeFactory::coordinates( id, coordinates ) )
         {
-            s->append( GeoDataCoordinates( p->coordinates().longitude(), p->coordinates().latitude() ) );
+            s->append( coordinates );
         }
 
         return 0;
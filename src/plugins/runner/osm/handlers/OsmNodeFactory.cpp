@@ -9,35 +9,108 @@
 //
 
 #include "OsmNodeFactory.h"
+
+#include <QtCore/QtAlgorithms>
+
 #include "GeoDataPoint.h"
 
+#include <cmath>
+
 namespace Marble
 {
 namespace osm
 {
-QMap<quint64, GeoDataPoint *> OsmNodeFactory::m_points;
+QVector<OsmNodeFactory::Node> OsmNodeFactory::m_nodes;
+bool OsmNodeFactory::m_sorted = true;
+GeoDataPoint *OsmNodeFactory::m_currentPoint = 0;
 
-// This is a class for keeping all the nodes accessible
-// for when needed by ways. Ways have only the ids of
-// nodes so with that id the GeoDataPoint is returned
+namespace
+{
+// Resolution of coordinates in OSM files
+const qreal nodeResolution = 1e7;
+}
 
-void OsmNodeFactory::appendPoint( quint64 id, GeoDataPoint* p )
+void OsmNodeFactory::appendNode( quint64 id, qreal lon, qreal lat )
 {
-    m_points[id] = p;
+    // OSM files list the nodes in ascending order, only others need to be sorted
+    if ( !m_nodes.isEmpty() && id <= m_nodes.last().id ) {
+        m_sorted = false;
+    }
+
+    const Node node = { id, qint32( floor( lon * nodeResolution + 0.5 ) ), qint32( floor( lat * nodeResolution + 0.5 ) ) };
+    m_nodes.append( node );
 }
 
-GeoDataPoint* OsmNodeFactory::getPoint( quint64 id )
+bool OsmNodeFactory::coordinates( quint64 id, GeoDataCoordinates &coordinates )
 {
-    return m_points.value( id );
+    if ( !m_sorted ) {
+        sortNodes();
+    }
+    if ( m_nodes.isEmpty() ) {
+        return false;
+    }
+
+    const Node *node = 0;
+
+    // Extracts often have contiguous ids, then the offset from the first one is the index
+    const quint64 offset = id - m_nodes.first().id;
+    if ( id >= m_nodes.first().id && offset < quint64( m_nodes.size() ) && m_nodes.at( int( offset ) ).id == id ) {
+        node = &m_nodes.at( int( offset ) );
+    } else {
+        QVector<Node>::const_iterator const found = qLowerBound( m_nodes.constBegin(), m_nodes.constEnd(), id, lessThan );
+        if ( found == m_nodes.constEnd() || found->id != id ) {
+            return false;
+        }
+        node = found;
+    }
+
+    coordinates.set( node->lon / nodeResolution, node->lat / nodeResolution, 0, GeoDataCoordinates::Degree );
+    return true;
 }
 
-void OsmNodeFactory::clear()
+GeoDataPoint *OsmNodeFactory::currentPoint( qreal lon, qreal lat )
+{
+    if ( !m_currentPoint ) {
+        m_currentPoint = new GeoDataPoint;
+    }
+
+    m_currentPoint->setParent( 0 );
+    m_currentPoint->setCoordinates( GeoDataCoordinates( lon, lat, 0, GeoDataCoordinates::Degree ) );
+    return m_currentPoint;
+}
+
+bool OsmNodeFactory::lessThan( const Node &node, quint64 id )
 {
-    foreach( GeoDataPoint *p, m_points )
-    {
-        delete p;
+    return node.id < id;
+}
+
+bool OsmNodeFactory::nodeLessThan( const Node &left, const Node &right )
+{
+    return left.id < right.id;
+}
+
+void OsmNodeFactory::sortNodes()
+{
+    qStableSort( m_nodes.begin(), m_nodes.end(), nodeLessThan );
+
+    // A node listed twice keeps its last coordinates
+    int last = 0;
+    for ( int i = 1; i < m_nodes.size(); ++i ) {
+        if ( m_nodes.at( i ).id != m_nodes.at( last ).id ) {
+            ++last;
+        }
+        m_nodes[last] = m_nodes.at( i );
     }
-    m_points.clear();
+    m_nodes.resize( qMin( last + 1, m_nodes.size() ) );
+    m_sorted = true;
+}
+
+void OsmNodeFactory::clear()
+{
+    m_nodes.clear();
+    m_sorted = true;
+    delete m_currentPoint;
+    m_currentPoint = 0;
 }
 
 }
@@ -11,11 +11,12 @@
 #ifndef MARBLE_OSMNODEFACTORY_H
 #define MARBLE_OSMNODEFACTORY_H
 
-#include <QMap>
+#include <QtCore/QVector>
 
 namespace Marble
 {
 
+class GeoDataCoordinates;
 class GeoDataPoint;
 
 namespace osm
@@ -23,13 +24,30 @@ namespace osm
 
 // This is a class for keeping all the nodes accessible
 // for when needed by ways. Ways have only the ids of
-// nodes so with that id the GeoDataPoint is returned
+// nodes so with that id the coordinates are returned.
+//
+// Nodes are kept as packed records of their id and their
+// coordinates in the 1e-7 degree resolution of OSM, sorted by
+// id. Only tagged nodes which turn out to be POIs get their
+// own GeoDataPoint, see OsmTagTagHandler::createPOI().
 
 class OsmNodeFactory
 {
 public:
-    static void appendPoint( quint64 id, GeoDataPoint *p );
-    static GeoDataPoint *getPoint( quint64 id );
+    static void appendNode( quint64 id, qreal lon, qreal lat );
+
+    /**
+     * @brief Returns the coordinates of the node @p id in @p coordinates
+     * Returns false if the node is not known.
+     */
+    static bool coordinates( quint64 id, GeoDataCoordinates &coordinates );
+
+    /**
+     * @brief The point representing the node being parsed
+     * The point is reused for every node, tags of the node see it
+     * as their parent geometry while the node is being parsed.
+     */
+    static GeoDataPoint *currentPoint( qreal lon, qreal lat );
 
     /**
      * @brief Clean up nodes
@@ -39,7 +57,20 @@ public:
     static void clear();
 
 private:
-    static QMap<quint64, GeoDataPoint *> m_points;
+    struct Node
+    {
+        quint64 id;
+        qint32 lon;
+        qint32 lat;
+    };
+
+    static bool lessThan( const Node &node, quint64 id );
+    static bool nodeLessThan( const Node &left, const Node &right );
+    static void sortNodes();
+
+    static QVector<Node> m_nodes;
+    static bool m_sorted;
+    static GeoDataPoint *m_currentPoint;
 };
 
 }
@@ -37,9 +37,8 @@ GeoNode* OsmNodeTagHandler::parse( GeoParser& parser ) const
     qreal lon = parser.attribute( "lon" ).toDouble();
     qreal lat = parser.attribute( "lat" ).toDouble();
 
-    GeoDataPoint *point = new GeoDataPoint( GeoDataCoordinates( lon, lat, 0, GeoDataCoordinates::Degree ) );
-    osm::OsmNodeFactory::appendPoint( parser.attribute( "id" ).toULongLong(), point );
-    return point;
+    osm::OsmNodeFactory::appendNode( parser.attribute( "id" ).toULongLong(), lon, lat );
+    return osm::OsmNodeFactory::currentPoint( lon, lat );
 }
 
 }
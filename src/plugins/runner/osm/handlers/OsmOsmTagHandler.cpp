@@ -34,7 +34,13 @@ GeoNode* OsmOsmTagHandler::parse( GeoParser& parser ) const
     // Osm Node http://wiki.openstreetmap.org/wiki/Data_Primitives#Node
 
     GeoDataDocument* doc = geoDataDoc( parser );
+    addStyles( doc );
 
+    return doc;
+}
+
+void OsmOsmTagHandler::addStyles( GeoDataDocument *doc )
+{
     GeoDataPolyStyle backgroundPolyStyle;
     backgroundPolyStyle.setFill( true );
     backgroundPolyStyle.setOutline( false );
@@ -43,8 +49,6 @@ GeoNode* OsmOsmTagHandler::parse( GeoParser& parser ) const
     backgroundStyle.setPolyStyle( backgroundPolyStyle );
     backgroundStyle.setStyleId( "background" );
     doc->addStyle( backgroundStyle );
-
-    return doc;
 }
 
 }
@@ -8,14 +8,16 @@
 // Copyright 2011      Konstantin Oblaukhov <oblaukhov.konstantin@gmail.com>
 //
 
-#ifndef MARBLE_OSMNODETAGHANDLER_H
-#define MARBLE_OSMNODETAGHANDLER_H
+#ifndef MARBLE_OSMOSMTAGHANDLER_H
+#define MARBLE_OSMOSMTAGHANDLER_H
 
 #include "GeoTagHandler.h"
 #include "marble_export.h"
 
 namespace Marble
 {
+class GeoDataDocument;
+
 namespace osm
 {
 
@@ -23,10 +25,15 @@ class OsmOsmTagHandler : public GeoTagHandler
 {
 public:
     virtual GeoNode* parse( GeoParser& ) const;
+
+    /**
+     * Adds the styles shared by all OSM documents to @p doc.
+     */
+    static void addStyles( GeoDataDocument *doc );
 };
 
 }
 
 }
 
-#endif // MARBLE_OSMNODETAGHANDLER_H
+#endif // MARBLE_OSMOSMTAGHANDLER_H
@@ -39,6 +39,11 @@ GeoNode* OsmRelationTagHandler::parse( GeoParser& parser ) const
     GeoDataDocument* doc = geoDataDoc( parser );
     Q_ASSERT( doc );
 
+    return createRelation( doc, parser.attribute( "id" ).toULongLong() );
+}
+
+GeoDataPolygon *OsmRelationTagHandler::createRelation( GeoDataDocument *doc, quint64 id )
+{
     GeoDataPolygon *polygon = new GeoDataPolygon();
     GeoDataPlacemark *placemark = new GeoDataPlacemark();
     placemark->setGeometry( polygon );
@@ -48,7 +53,7 @@ GeoNode* OsmRelationTagHandler::parse( GeoParser& parser ) const
     placemark->setVisible( false );
     doc->append( placemark );
 
-    osm::OsmRelationFactory::appendPolygon( parser.attribute( "id" ).toULongLong(), polygon );
+    osm::OsmRelationFactory::appendPolygon( id, polygon );
 
     return polygon;
 }
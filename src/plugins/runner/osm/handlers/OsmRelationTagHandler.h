@@ -18,6 +18,9 @@
 
 namespace Marble
 {
+class GeoDataDocument;
+class GeoDataPolygon;
+
 namespace osm
 {
 
@@ -25,6 +28,11 @@ class OsmRelationTagHandler : public GeoTagHandler
 {
 public:
     virtual GeoNode* parse( GeoParser& ) const;
+
+    /**
+     * Appends the placemark of the relation @p id to @p doc and returns its polygon.
+     */
+    static GeoDataPolygon *createRelation( GeoDataDocument *doc, quint64 id );
 };
 
 }
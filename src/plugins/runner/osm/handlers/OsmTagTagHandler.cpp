@@ -36,16 +36,28 @@ GeoNode* OsmTagTagHandler::parse( GeoParser& parser ) const
     Q_ASSERT( parser.isStartElement() );
 
     GeoStackItem parentItem = parser.parentElement();
-    GeoDataDocument* doc = geoDataDoc( parser );
-    QString key = parser.attribute( "k" );
-    QString value = parser.attribute( "v" );
 
+    const char *element = 0;
+    if ( parentItem.represents( osmTag_node ) )
+        element = osmTag_node;
+    else if ( parentItem.represents( osmTag_way ) )
+        element = osmTag_way;
+    else if ( parentItem.represents( osmTag_relation ) )
+        element = osmTag_relation;
+
+    addTag( geoDataDoc( parser ), parentItem.nodeAs<GeoDataGeometry>(), element,
+            parser.attribute( "k" ), parser.attribute( "v" ) );
+    return 0;
+}
+
+void OsmTagTagHandler::addTag( GeoDataDocument *doc, GeoDataGeometry *geometry, const char *element,
+                               const QString &key, const QString &value )
+{
     if ( tagBlackList.contains( key ) )
-        return 0;
+        return;
 
-    GeoDataGeometry * geometry = parentItem.nodeAs<GeoDataGeometry>();
     if ( !geometry )
-        return 0;
+        return;
     
     GeoDataGeometry *placemarkGeometry = geometry;
     
@@ -59,17 +71,17 @@ GeoNode* OsmTagTagHandler::parse( GeoParser& parser ) const
     {
         if ( !placemark )
         {
-            if ( parentItem.represents( osmTag_node ) )
+            if ( element == osmTag_node )
                 placemark = createPOI( doc, geometry );
             else
-                return 0;
+                return;
         }
         placemark->setName( value );
-        return 0;
+        return;
     }
 
     // Ways or relations can represent closed areas such as buildings
-    if ( parentItem.represents( osmTag_way ) || parentItem.represents( osmTag_relation ) )
+    if ( element == osmTag_way || element == osmTag_relation )
     {
         Q_ASSERT( placemark );
 
@@ -84,7 +96,7 @@ GeoNode* OsmTagTagHandler::parse( GeoParser& parser ) const
             placemark->setVisible( true );
         }
     }
-    else if ( parentItem.represents( osmTag_node ) ) //POI
+    else if ( element == osmTag_node ) //POI
     {
         GeoDataFeature::GeoDataVisualCategory poiCategory = GeoDataFeature::OsmVisualCategory( key + '=' + value );
 
@@ -140,11 +152,9 @@ GeoNode* OsmTagTagHandler::parse( GeoParser& parser ) const
             }
         }
     }
-
-    return 0;
 }
 
-GeoDataPlacemark* OsmTagTagHandler::createPOI( GeoDataDocument* doc, GeoDataGeometry* geometry ) const
+GeoDataPlacemark* OsmTagTagHandler::createPOI( GeoDataDocument* doc, GeoDataGeometry* geometry )
 {
     GeoDataPoint *point = dynamic_cast<GeoDataPoint *>( geometry );
     Q_ASSERT( point );
@@ -157,7 +167,7 @@ GeoDataPlacemark* OsmTagTagHandler::createPOI( GeoDataDocument* doc, GeoDataGeom
     return placemark;
 }
 
-GeoDataPlacemark *OsmTagTagHandler::convertWayToPolygon( GeoDataDocument *doc, GeoDataPlacemark *placemark, GeoDataGeometry *geometry ) const
+GeoDataPlacemark *OsmTagTagHandler::convertWayToPolygon( GeoDataDocument *doc, GeoDataPlacemark *placemark, GeoDataGeometry *geometry )
 {
     GeoDataLineString *polyline = dynamic_cast<GeoDataLineString *>( geometry );
     Q_ASSERT( polyline );
@@ -11,7 +11,10 @@
 #ifndef MARBLE_OSMTAGTAGHANDLER_H
 #define MARBLE_OSMTAGTAGHANDLER_H
 
+#include <QtCore/QString>
+
 #include "GeoTagHandler.h"
+
 namespace Marble
 {
 class GeoDataGeometry;
@@ -26,9 +29,16 @@ class OsmTagTagHandler : public GeoTagHandler
 public:
     virtual GeoNode* parse( GeoParser& ) const;
 
+    /**
+     * Applies the tag @p key = @p value of the @p element (osmTag_node,
+     * osmTag_way or osmTag_relation) represented by @p geometry.
+     */
+    static void addTag( GeoDataDocument *doc, GeoDataGeometry *geometry, const char *element,
+                        const QString &key, const QString &value );
+
 private:
-    GeoDataPlacemark *convertWayToPolygon( GeoDataDocument *doc, GeoDataPlacemark *placemark, GeoDataGeometry *geometry ) const;
-    GeoDataPlacemark *createPOI( GeoDataDocument *doc, GeoDataGeometry *geometry ) const;
+    static GeoDataPlacemark *convertWayToPolygon( GeoDataDocument *doc, GeoDataPlacemark *placemark, GeoDataGeometry *geometry );
+    static GeoDataPlacemark *createPOI( GeoDataDocument *doc, GeoDataGeometry *geometry );
 };
 
 }
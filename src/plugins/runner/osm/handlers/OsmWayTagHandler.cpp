@@ -36,6 +36,11 @@ GeoNode* OsmWayTagHandler::parse( GeoParser& parser ) const
     GeoDataDocument* doc = geoDataDoc( parser );
     Q_ASSERT( doc );
 
+    return createWay( doc, parser.attribute( "id" ).toULongLong() );
+}
+
+GeoDataLineString *OsmWayTagHandler::createWay( GeoDataDocument *doc, quint64 id )
+{
     GeoDataLineString *polyline = new GeoDataLineString();
     GeoDataPlacemark *placemark = new GeoDataPlacemark();
     placemark->setGeometry( polyline );
@@ -45,7 +50,7 @@ GeoNode* OsmWayTagHandler::parse( GeoParser& parser ) const
     placemark->setVisible( false );
     doc->append( placemark );
 
-    osm::OsmWayFactory::appendLine( parser.attribute( "id" ).toULongLong(), polyline );
+    osm::OsmWayFactory::appendLine( id, polyline );
 
     return polyline;
 }
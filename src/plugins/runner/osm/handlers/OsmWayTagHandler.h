@@ -16,6 +16,9 @@
 
 namespace Marble
 {
+class GeoDataDocument;
+class GeoDataLineString;
+
 namespace osm
 {
 
@@ -23,6 +26,11 @@ class OsmWayTagHandler : public GeoTagHandler
 {
 public:
     virtual GeoNode* parse( GeoParser& ) const;
+
+    /**
+     * Appends the placemark of the way @p id to @p doc and returns its line string.
+     */
+    static GeoDataLineString *createWay( GeoDataDocument *doc, quint64 id );
 };
 
 }
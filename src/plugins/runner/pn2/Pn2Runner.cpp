@@ -28,6 +28,11 @@
 //
 // The parser has to convert these relative coordinates to absolute coordinates.
 //
+// Version 2 of the format stores the same polygons, but the file header is followed by an index that holds
+// for each polygon its bounding box (west, south, east and north in the units of the absolute nodes), its
+// total number of nodes and the byte offset of its Polygon Header in the file. This way polygons can be
+// located without reading the ones in front of them, so the parser decodes them concurrently.
+//
 // Copyright 2012 Torsten Rahn <rahn@kde.org>
 // Copyright 2012 Cezar Mocan <mocancezar@gmail.com>
 //
@@ -40,6 +45,11 @@
 
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+#include <QtCore/QtEndian>
 
 namespace Marble
 {
@@ -47,6 +57,90 @@ namespace Marble
 // Polygon header flags, representing the type of polygon
 enum polygonFlagType { LINESTRING = 0, LINEARRING = 1, OUTERBOUNDARY = 2, INNERBOUNDARY = 3, MULTIGEOMETRY = 4 };
 
+namespace
+{
+// quint8 version, quint32 polygons
+const int fileHeaderSize = 5;
+// quint32 ID, quint32 absolute nodes, quint8 flag
+const int polygonHeaderSize = 9;
+// qint16 west, south, east, north, quint32 nodes, quint32 offset
+const int indexEntrySize = 16;
+// qint16 lat, lon, relative nodes
+const int absoluteNodeSize = 6;
+// qint8 lat, lon
+const int relativeNodeSize = 2;
+
+// Nodes are given in units of 1/120 degree
+const qreal nodeToRadian = M_PI / ( 120.0 * 180.0 );
+
+struct Pn2Polygon
+{
+    qint64 offset;
+    quint32 nodes;
+    quint8 flag;
+    GeoDataLineString *lineString;
+    bool error;
+};
+
+qint16 readInt16( const uchar *data )
+{
+    return qint16( qFromBigEndian<quint16>( data ) );
+}
+
+/**
+ * Decodes the polygon starting at @p offset and moves @p offset behind it.
+ */
+void readPolygon( const uchar *data, qint64 size, qint64 &offset, Pn2Polygon &polygon )
+{
+    polygon.lineString = 0;
+    polygon.error = offset < 0 || offset + polygonHeaderSize > size;
+    if ( polygon.error ) {
+        return;
+    }
+
+    const quint32 nrAbsoluteNodes = qFromBigEndian<quint32>( data + offset + 4 );
+    polygon.flag = data[offset + 8];
+    offset += polygonHeaderSize;
+
+    polygon.lineString = polygon.flag == LINESTRING ? new GeoDataLineString : new GeoDataLinearRing;
+    polygon.lineString->reserve( polygon.nodes ? int( polygon.nodes ) : int( nrAbsoluteNodes ) );
+    polygon.error = Pn2Runner::importPolygon( data, size, offset, polygon.lineString, nrAbsoluteNodes );
+}
+
+class PolygonDecoder : public QRunnable
+{
+public:
+    PolygonDecoder( const uchar *data, qint64 size, Pn2Polygon *begin, Pn2Polygon *end )
+        : m_data( data ),
+          m_size( size ),
+          m_begin( begin ),
+          m_end( end )
+    {
+    }
+
+    virtual void run()
+    {
+        for ( Pn2Polygon *polygon = m_begin; polygon != m_end; ++polygon ) {
+            qint64 offset = polygon->offset;
+            readPolygon( m_data, m_size, offset, *polygon );
+        }
+    }
+
+private:
+    const uchar *const m_data;
+    const qint64 m_size;
+    Pn2Polygon *const m_begin;
+    Pn2Polygon *const m_end;
+};
+
+void appendPlacemark( GeoDataDocument *document, GeoDataGeometry *geometry )
+{
+    GeoDataPlacemark *placemark = new GeoDataPlacemark;
+    placemark->setGeometry( geometry );
+    document->append( placemark );
+}
+}
+
 
 Pn2Runner::Pn2Runner(QObject *parent) :
     ParsingRunner(parent)
@@ -73,39 +167,34 @@ bool Pn2Runner::errorCheckLon( qint16 lon )
         return true;
 }
 
-bool Pn2Runner::importPolygon( QDataStream &stream, GeoDataLineString* linestring, quint32 nrAbsoluteNodes ) 
+bool Pn2Runner::importPolygon( const uchar *data, qint64 size, qint64 &offset, GeoDataLineString* linestring, quint32 nrAbsoluteNodes )
 {
-    qint16 lat, lon, nrRelativeNodes;
-    qint8 relativeLat, relativeLon;
     bool error = false;
 
-
     for ( quint32 absoluteNode = 1; absoluteNode <= nrAbsoluteNodes; absoluteNode++ ) {
-        stream >> lat >> lon >> nrRelativeNodes;
+        if ( offset + absoluteNodeSize > size ) {
+            return true;
+        }
 
-        error = error | errorCheckLat( lat ) | errorCheckLon( lon );
+        const qint16 lat = readInt16( data + offset );
+        const qint16 lon = readInt16( data + offset + 2 );
+        const qint16 nrRelativeNodes = readInt16( data + offset + 4 );
+        offset += absoluteNodeSize;
 
-        qreal degLat = ( 1.0 * lat / 120.0 );
-        qreal degLon = ( 1.0 * lon / 120.0 );
+        if ( nrRelativeNodes < 0 || offset + relativeNodeSize * qint64( nrRelativeNodes ) > size ) {
+            return true;
+        }
 
-        GeoDataCoordinates *coord = new GeoDataCoordinates( degLon / 180 * M_PI, degLat / 180 * M_PI );
-        linestring->append( *coord );
+        error = error | errorCheckLat( lat ) | errorCheckLon( lon );
+        linestring->append( GeoDataCoordinates( lon * nodeToRadian, lat * nodeToRadian ) );
 
         for ( qint16 relativeNode = 1; relativeNode <= nrRelativeNodes; ++relativeNode ) {
-            stream >> relativeLat >> relativeLon;
-
-            qint16 currLat = relativeLat + lat; 
-            qint16 currLon = relativeLon + lon;
-
+            const qint16 currLat = qint8( data[offset] ) + lat;
+            const qint16 currLon = qint8( data[offset + 1] ) + lon;
+            offset += relativeNodeSize;
 
             error = error | errorCheckLat( currLat ) | errorCheckLon( currLon );
-
-            qreal currDegLat = ( 1.0 * currLat / 120.0 );
-            qreal currDegLon = ( 1.0 * currLon / 120.0 );
-
-
-            GeoDataCoordinates *currCoord = new GeoDataCoordinates( currDegLon / 180 * M_PI, currDegLat / 180 * M_PI );
-            linestring->append( *currCoord );
+            linestring->append( GeoDataCoordinates( currLon * nodeToRadian, currLat * nodeToRadian ) );
         }
     }
 
@@ -128,84 +217,112 @@ void Pn2Runner::parseFile( const QString &fileName, DocumentRole role = UnknownD
     }
 
     file.open( QIODevice::ReadOnly );
-    QDataStream stream( &file );  // read the data serialized from the file
-
-    GeoDataDocument *document = new GeoDataDocument();
-    document->setDocumentRole( role );
+    qint64 size = file.size();
+    const uchar *data = file.map( 0, size );
+    QByteArray buffer;
+    if ( !data ) {
+        buffer = file.readAll();
+        data = reinterpret_cast<const uchar *>( buffer.constData() );
+        size = buffer.size();
+    }
 
-    quint8 fileHeaderVersion;
-    quint32 fileHeaderPolygons;
+    if ( size < fileHeaderSize ) {
+        emit parsingFinished( 0, "Errors occurred while parsing the .pn2 file!" );
+        return;
+    }
 
-    stream >> fileHeaderVersion >> fileHeaderPolygons;
+    const quint8 fileHeaderVersion = data[0];
+    const quint32 fileHeaderPolygons = qFromBigEndian<quint32>( data + 1 );
 
+    QVector<Pn2Polygon> polygons;
     bool error = false;
 
-    quint32 ID, nrAbsoluteNodes;
-    quint8 flag, prevFlag = -1;
-
-    GeoDataPolygon *polygon = new GeoDataPolygon;
-
-    for ( quint32 currentPoly = 1; ( currentPoly <= fileHeaderPolygons ) && ( !error ) && ( !stream.atEnd() ); currentPoly++ ) {
+    if ( fileHeaderVersion == 1 ) {
+        // Polygons have to be read in sequence
+        qint64 offset = fileHeaderSize;
+        for ( quint32 currentPoly = 1; ( currentPoly <= fileHeaderPolygons ) && ( !error ) && ( offset < size ); currentPoly++ ) {
+            Pn2Polygon polygon;
+            polygon.nodes = 0;
+            readPolygon( data, size, offset, polygon );
+            error = polygon.error;
+            polygons.append( polygon );
+        }
+    }
+    else if ( fileHeaderVersion == 2 && fileHeaderSize + qint64( fileHeaderPolygons ) * indexEntrySize <= size ) {
+        polygons.resize( fileHeaderPolygons );
+        for ( int i = 0; i < polygons.size(); ++i ) {
+            const uchar *const entry = data + fileHeaderSize + qint64( i ) * indexEntrySize;
+            polygons[i].nodes = qFromBigEndian<quint32>( entry + 8 );
+            polygons[i].offset = qFromBigEndian<quint32>( entry + 12 );
+        }
 
-        stream >> ID >> nrAbsoluteNodes >> flag;
+        const int rangeCount = 4 * qMax( 1, QThread::idealThreadCount() );
+        const int rangeSize = ( polygons.size() + rangeCount - 1 ) / rangeCount;
+        QThreadPool pool;
+        for ( int begin = 0; begin < polygons.size(); begin += rangeSize ) {
+            const int end = qMin( begin + rangeSize, polygons.size() );
+            pool.start( new PolygonDecoder( data, size, polygons.data() + begin, polygons.data() + end ) );
+        }
+        pool.waitForDone();
 
-        if ( flag != INNERBOUNDARY && ( prevFlag == INNERBOUNDARY || prevFlag == OUTERBOUNDARY ) ) {
+        for ( int i = 0; i < polygons.size() && !error; ++i ) {
+            error = polygons.at( i ).error;
+        }
+    }
+    else {
+        mDebug() << "Unsupported version" << fileHeaderVersion << "of" << fileName;
+        error = true;
+    }
 
-            GeoDataPlacemark *placemark = new GeoDataPlacemark;
-            placemark->setGeometry( polygon );
-            document->append( placemark );
+    if ( error ) {
+        foreach ( const Pn2Polygon &polygon, polygons ) {
+            delete polygon.lineString;
         }
+        emit parsingFinished( 0, "Errors occurred while parsing the .pn2 file!" );
+        return;
+    }
 
-        if ( flag == LINESTRING ) {
-            GeoDataLineString *linestring = new GeoDataLineString;
-            error = error | importPolygon( stream, linestring, nrAbsoluteNodes );
+    GeoDataDocument *document = new GeoDataDocument();
+    document->setDocumentRole( role );
 
-            GeoDataPlacemark *placemark = new GeoDataPlacemark;
-            placemark->setGeometry( linestring );
-            document->append( placemark );
-        }
+    quint8 prevFlag = MULTIGEOMETRY;
+    GeoDataPolygon *polygon = 0;
 
-        if ( ( flag == LINEARRING ) || ( flag == OUTERBOUNDARY ) || ( flag == INNERBOUNDARY ) ) {
-            GeoDataLinearRing* linearring = new GeoDataLinearRing;
-            error = error | importPolygon( stream, linearring, nrAbsoluteNodes );
+    foreach ( const Pn2Polygon &current, polygons ) {
+        const quint8 flag = current.flag;
 
-            if ( flag == LINEARRING ) {
-                GeoDataPlacemark *placemark = new GeoDataPlacemark;
-                placemark->setGeometry( linearring );
-                document->append( placemark );
-            }
+        if ( flag != INNERBOUNDARY && ( prevFlag == INNERBOUNDARY || prevFlag == OUTERBOUNDARY ) ) {
+            appendPlacemark( document, polygon );
+            polygon = 0;
+        }
 
-            if ( flag == OUTERBOUNDARY ) {
+        if ( flag == LINESTRING || flag == LINEARRING ) {
+            appendPlacemark( document, current.lineString );
+        }
+        else if ( flag == OUTERBOUNDARY ) {
+            polygon = new GeoDataPolygon;
+            polygon->setOuterBoundary( *static_cast<GeoDataLinearRing *>( current.lineString ) );
+            delete current.lineString;
+        }
+        else if ( flag == INNERBOUNDARY ) {
+            if ( !polygon ) {
                 polygon = new GeoDataPolygon;
-                polygon->setOuterBoundary( *linearring );
-            }
-
-            if ( flag == INNERBOUNDARY ) {
-                polygon->appendInnerBoundary( *linearring );
             }
+            polygon->appendInnerBoundary( *static_cast<GeoDataLinearRing *>( current.lineString ) );
+            delete current.lineString;
         }
-
-        
-
-        if ( flag == MULTIGEOMETRY ) {
-            // not implemented yet, for now elements inside a multigeometry are separated as individual geometries
+        else {
+            // multigeometries are not implemented yet, for now elements inside a multigeometry are separated as individual geometries
+            delete current.lineString;
         }
 
         prevFlag = flag;
     }
 
     if ( prevFlag == INNERBOUNDARY || prevFlag == OUTERBOUNDARY ) {
-        GeoDataPlacemark *placemark = new GeoDataPlacemark;
-        placemark->setGeometry( polygon );
-        document->append( placemark );
+        appendPlacemark( document, polygon );
     }
 
-    if ( error ) {
-        delete document;
-        document = 0;
-        emit parsingFinished( 0, "Errors occurred while parsing the .pn2 file!" );
-        return;
-    }
     document->setFileName( fileName );
 
     emit parsingFinished( document );
@@ -23,9 +23,13 @@ class Pn2Runner : public ParsingRunner
 public:
     explicit Pn2Runner(QObject *parent = 0);
     ~Pn2Runner();
-    bool errorCheckLat( qint16 lat );
-    bool errorCheckLon( qint16 lon );
-    bool importPolygon( QDataStream &stream, GeoDataLineString* linestring, quint32 nrAbsoluteNodes );
+    static bool errorCheckLat( qint16 lat );
+    static bool errorCheckLon( qint16 lon );
+    /**
+     * Appends the nodes of the polygon at @p offset of the file @p data to
+     * @p linestring and moves @p offset behind them. Returns true on errors.
+     */
+    static bool importPolygon( const uchar *data, qint64 size, qint64 &offset, GeoDataLineString* linestring, quint32 nrAbsoluteNodes );
     virtual void parseFile( const QString &fileName, DocumentRole role );
 
 signals:
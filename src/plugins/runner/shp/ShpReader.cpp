@@ -0,0 +1,315 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "ShpReader.h"
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QtEndian>
+
+#include <cstring>
+
+#include "GeoDataLineString.h"
+#include "GeoDataMultiGeometry.h"
+#include "GeoDataPoint.h"
+#include "GeoDataPolygon.h"
+#include "MarbleDebug.h"
+
+namespace Marble
+{
+
+namespace
+{
+// see http://www.esri.com/library/whitepapers/pdfs/shapefile.pdf
+const quint32 shpFileCode = 9994;
+const int shpHeaderSize = 100;
+const int shpRecordHeaderSize = 8;
+const int shxEntrySize = 8;
+const int dbfFieldSize = 32;
+const uchar dbfHeaderTerminator = 0x0d;
+
+quint32 bigEndian32( const uchar *data )
+{
+    return qFromBigEndian<quint32>( data );
+}
+
+qint32 littleEndian32( const uchar *data )
+{
+    return qint32( qFromLittleEndian<quint32>( data ) );
+}
+
+double littleEndianDouble( const uchar *data )
+{
+    const quint64 bits = qFromLittleEndian<quint64>( data );
+    double value;
+    std::memcpy( &value, &bits, sizeof( value ) );
+    return value;
+}
+
+GeoDataCoordinates coordinates( const uchar *point )
+{
+    return GeoDataCoordinates( littleEndianDouble( point ), littleEndianDouble( point + 8 ),
+                               0, GeoDataCoordinates::Degree );
+}
+
+void appendPoints( GeoDataLineString *line, const uchar *points, int begin, int end )
+{
+    line->reserve( end - begin );
+    for ( int i = begin; i < end; ++i ) {
+        line->append( coordinates( points + 16 * i ) );
+    }
+}
+}
+
+ShpReader::ShpReader()
+    : m_shapeType( NullShape ),
+      m_tableOffset( 0 ),
+      m_tableRecordLength( 0 ),
+      m_tableRecordCount( 0 )
+{
+    m_shp.data = m_shx.data = m_dbf.data = 0;
+    m_shp.size = m_shx.size = m_dbf.size = 0;
+}
+
+bool ShpReader::map( MappedFile &mapped, const QString &fileName )
+{
+    mapped.file.setFileName( fileName );
+    if ( !mapped.file.open( QIODevice::ReadOnly ) ) {
+        return false;
+    }
+
+    mapped.size = mapped.file.size();
+    mapped.data = mapped.file.map( 0, mapped.size );
+    if ( !mapped.data ) {
+        mapped.buffer = mapped.file.readAll();
+        mapped.data = reinterpret_cast<const uchar *>( mapped.buffer.constData() );
+        mapped.size = mapped.buffer.size();
+    }
+    return true;
+}
+
+bool ShpReader::open( const QString &fileName )
+{
+    if ( !map( m_shp, fileName ) ) {
+        m_errorString = QString( "Can't open %1" ).arg( fileName );
+        return false;
+    }
+
+    if ( m_shp.size < shpHeaderSize || bigEndian32( m_shp.data ) != shpFileCode ) {
+        m_errorString = QString( "%1 is not a shapefile" ).arg( fileName );
+        return false;
+    }
+    m_shapeType = littleEndian32( m_shp.data + 32 );
+
+    // The index and the attribute table have the same name and suffix case
+    const QFileInfo info( fileName );
+    const bool upperCase = info.suffix() == info.suffix().toUpper();
+    const QString baseName = info.path() + '/' + info.completeBaseName() + '.';
+
+    if ( !map( m_shx, baseName + ( upperCase ? "SHX" : "shx" ) ) ) {
+        mDebug() << "No index for" << fileName << ", scanning the records";
+    }
+    if ( !readIndex() ) {
+        m_errorString = QString( "Damaged shapefile %1" ).arg( fileName );
+        return false;
+    }
+
+    if ( map( m_dbf, baseName + ( upperCase ? "DBF" : "dbf" ) ) && !readTable() ) {
+        m_errorString = QString( "Damaged attribute table of %1" ).arg( fileName );
+        return false;
+    }
+
+    return true;
+}
+
+bool ShpReader::readIndex()
+{
+    if ( m_shx.size >= shpHeaderSize ) {
+        const qint64 count = ( m_shx.size - shpHeaderSize ) / shxEntrySize;
+        m_offsets.reserve( int( count ) );
+        for ( qint64 i = 0; i < count; ++i ) {
+            // offsets are given in 16 bit words
+            const qint64 offset = 2 * qint64( bigEndian32( m_shx.data + shpHeaderSize + i * shxEntrySize ) );
+            if ( offset < shpHeaderSize || offset + shpRecordHeaderSize > m_shp.size ) {
+                return false;
+            }
+            m_offsets.append( offset );
+        }
+        return true;
+    }
+
+    // Without an index the records are read in sequence
+    const qint64 end = qMin( m_shp.size, 2 * qint64( bigEndian32( m_shp.data + 24 ) ) );
+    qint64 offset = shpHeaderSize;
+    while ( offset + shpRecordHeaderSize <= end ) {
+        m_offsets.append( offset );
+        offset += shpRecordHeaderSize + 2 * qint64( bigEndian32( m_shp.data + offset + 4 ) );
+    }
+    return true;
+}
+
+bool ShpReader::readTable()
+{
+    if ( m_dbf.size < dbfFieldSize ) {
+        return false;
+    }
+
+    const qint64 recordCount = qFromLittleEndian<quint32>( m_dbf.data + 4 );
+    m_tableOffset = qFromLittleEndian<quint16>( m_dbf.data + 8 );
+    m_tableRecordLength = qFromLittleEndian<quint16>( m_dbf.data + 10 );
+    if ( m_tableOffset > m_dbf.size || m_tableRecordLength == 0 ) {
+        return false;
+    }
+
+    // Records start with the deletion flag, followed by the fixed width columns
+    int offset = 1;
+    for ( qint64 position = dbfFieldSize;
+          position + dbfFieldSize <= m_tableOffset && m_dbf.data[position] != dbfHeaderTerminator;
+          position += dbfFieldSize ) {
+        const char *const name = reinterpret_cast<const char *>( m_dbf.data + position );
+        Field field;
+        field.name = QString::fromLatin1( name, qstrnlen( name, 11 ) );
+        field.offset = offset;
+        field.length = m_dbf.data[position + 16];
+        offset += field.length;
+        if ( offset > m_tableRecordLength ) {
+            return false;
+        }
+        m_fields.append( field );
+    }
+
+    m_tableRecordCount = int( qMin( recordCount, ( m_dbf.size - m_tableOffset ) / m_tableRecordLength ) );
+    return true;
+}
+
+QString ShpReader::errorString() const
+{
+    return m_errorString;
+}
+
+int ShpReader::shapeType() const
+{
+    return m_shapeType;
+}
+
+int ShpReader::recordCount() const
+{
+    return m_offsets.size();
+}
+
+GeoDataGeometry *ShpReader::geometry( int record ) const
+{
+    if ( record < 0 || record >= m_offsets.size() ) {
+        return 0;
+    }
+
+    const qint64 offset = m_offsets.at( record );
+    const qint64 length = 2 * qint64( bigEndian32( m_shp.data + offset + 4 ) );
+    if ( length < 4 || offset + shpRecordHeaderSize + length > m_shp.size ) {
+        return 0;
+    }
+    const uchar *const content = m_shp.data + offset + shpRecordHeaderSize;
+
+    switch ( littleEndian32( content ) ) {
+    case Point: {
+        if ( length < 20 ) {
+            return 0;
+        }
+        return new GeoDataPoint( coordinates( content + 4 ) );
+    }
+
+    case MultiPoint: {
+        const qint32 numPoints = length < 40 ? -1 : littleEndian32( content + 36 );
+        if ( numPoints < 0 || 40 + 16 * qint64( numPoints ) > length ) {
+            return 0;
+        }
+        GeoDataMultiGeometry *geom = new GeoDataMultiGeometry;
+        for ( int i = 0; i < numPoints; ++i ) {
+            geom->append( new GeoDataPoint( coordinates( content + 40 + 16 * i ) ) );
+        }
+        return geom;
+    }
+
+    case PolyLine:
+    case Polygon: {
+        const qint32 numParts = length < 44 ? -1 : littleEndian32( content + 36 );
+        const qint32 numPoints = length < 44 ? -1 : littleEndian32( content + 40 );
+        if ( numParts <= 0 || numPoints < 0 || 44 + 4 * qint64( numParts ) + 16 * qint64( numPoints ) > length ) {
+            return 0;
+        }
+
+        // Each part ends where the next one begins
+        QVector<int> parts;
+        parts.reserve( numParts + 1 );
+        for ( int i = 0; i < numParts; ++i ) {
+            const qint32 start = littleEndian32( content + 44 + 4 * i );
+            if ( start < ( i ? parts.last() : 0 ) || start > numPoints ) {
+                return 0;
+            }
+            parts.append( start );
+        }
+        parts.append( numPoints );
+        const uchar *const points = content + 44 + 4 * numParts;
+
+        if ( littleEndian32( content ) == PolyLine ) {
+            if ( numParts == 1 ) {
+                GeoDataLineString *line = new GeoDataLineString;
+                appendPoints( line, points, parts.at( 0 ), parts.at( 1 ) );
+                return line;
+            }
+
+            GeoDataMultiGeometry *geom = new GeoDataMultiGeometry;
+            for ( int i = 0; i < numParts; ++i ) {
+                GeoDataLineString *line = new GeoDataLineString;
+                appendPoints( line, points, parts.at( i ), parts.at( i + 1 ) );
+                geom->append( line );
+            }
+            return geom;
+        }
+
+        GeoDataPolygon *poly = new GeoDataPolygon;
+        for ( int i = 0; i < numParts; ++i ) {
+            GeoDataLinearRing ring;
+            appendPoints( &ring, points, parts.at( i ), parts.at( i + 1 ) );
+            // TODO: outer boundary per SHP spec is for the clockwise ring
+            // and inner holes are anticlockwise
+            if ( i == 0 ) {
+                poly->setOuterBoundary( ring );
+            } else {
+                poly->appendInnerBoundary( ring );
+            }
+        }
+        return poly;
+    }
+    }
+
+    return 0;
+}
+
+int ShpReader::fieldIndex( const QString &name ) const
+{
+    for ( int i = 0; i < m_fields.size(); ++i ) {
+        if ( m_fields.at( i ).name.compare( name, Qt::CaseInsensitive ) == 0 ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QString ShpReader::attribute( int record, int field ) const
+{
+    if ( record < 0 || record >= m_tableRecordCount || field < 0 || field >= m_fields.size() ) {
+        return QString();
+    }
+
+    const Field &column = m_fields.at( field );
+    const char *const value = reinterpret_cast<const char *>( m_dbf.data + m_tableOffset
+                                                              + qint64( record ) * m_tableRecordLength + column.offset );
+    return QString::fromLatin1( value, qstrnlen( value, column.length ) ).trimmed();
+}
+
+}
@@ -0,0 +1,112 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_SHPREADER_H
+#define MARBLE_SHPREADER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+namespace Marble
+{
+
+class GeoDataGeometry;
+
+/**
+ * @short Reader of the records of ESRI shapefiles.
+ *
+ * The .shp file and its .shx index and .dbf attribute table are memory
+ * mapped, records are decoded only when asked for: geometries are built
+ * directly from the mapped shape record and attributes are read from the
+ * fixed width columns of the table, so large files are never copied into
+ * memory as a whole.
+ */
+class ShpReader
+{
+public:
+    enum ShapeType {
+        NullShape = 0,
+        Point = 1,
+        PolyLine = 3,
+        Polygon = 5,
+        MultiPoint = 8
+    };
+
+    ShpReader();
+
+    bool open( const QString &fileName );
+
+    QString errorString() const;
+
+    /**
+     * Returns the shape type given in the header of the file.
+     */
+    int shapeType() const;
+
+    int recordCount() const;
+
+    /**
+     * Returns the geometry of @p record, which belongs to the caller then,
+     * or 0 for null shapes and damaged records.
+     */
+    GeoDataGeometry *geometry( int record ) const;
+
+    /**
+     * Returns the column named @p name of the attribute table, or -1.
+     */
+    int fieldIndex( const QString &name ) const;
+
+    /**
+     * Returns the value of column @p field of @p record with surrounding
+     * spaces removed.
+     */
+    QString attribute( int record, int field ) const;
+
+private:
+    Q_DISABLE_COPY( ShpReader )
+
+    struct MappedFile
+    {
+        QFile file;
+        // holds the content if the file can't be mapped
+        QByteArray buffer;
+        const uchar *data;
+        qint64 size;
+    };
+
+    struct Field
+    {
+        QString name;
+        int offset;
+        int length;
+    };
+
+    static bool map( MappedFile &mapped, const QString &fileName );
+    bool readIndex();
+    bool readTable();
+
+    MappedFile m_shp;
+    MappedFile m_shx;
+    MappedFile m_dbf;
+    QString m_errorString;
+
+    int m_shapeType;
+    // offsets of the records in the .shp file
+    QVector<qint64> m_offsets;
+
+    QVector<Field> m_fields;
+    qint64 m_tableOffset;
+    int m_tableRecordLength;
+    int m_tableRecordCount;
+};
+
+}
+
+#endif // MARBLE_SHPREADER_H
@@ -18,6 +18,8 @@ TCCoreApplication::TCCoreApplication( int & argc, char ** argv ) : QCoreApplicat
     if( !(argc < 5) )
     {
         m_tilecreator = new TileCreator( argv [1], argv[2], argv[3], argv[4] );
+        if ( argc > 5 )
+            m_tilecreator->setDecodedTileLevel( QString( argv[5] ).toInt() );
         connect(m_tilecreator, SIGNAL(finished()), this, SLOT(quit()));
         m_tilecreator->start();
     }
@@ -48,12 +48,22 @@ public:
         AbstractDataPluginModel( "test", marbleModel, parent )
     {}
 
+    using AbstractDataPluginModel::downloadDescriptionFile;
+
+Q_SIGNALS:
+    void fileParsed( const QByteArray &file );
+
 protected:
     void getAdditionalItems(const GeoDataLatLonAltBox &box, qint32 number)
     {
         Q_UNUSED( box )
         Q_UNUSED( number )
     }
+
+    void parseFile( const QByteArray &file )
+    {
+        emit fileParsed( file );
+    }
 };
 
 class AbstractDataPluginModelTest : public QObject
@@ -73,9 +83,13 @@ class AbstractDataPluginModelTest : public QObject
     void addItemToList_keepExisting_data();
     void addItemToList_keepExisting();
 
+    void addItemsToList_evictOldItems();
+
     void setFavoriteItemsOnly_data();
     void setFavoriteItemsOnly();
 
+    void downloadDescriptionFile_reuse();
+
  private:
     const MarbleModel m_marbleModel;
     static const ViewportParams fullViewport;
@@ -202,6 +216,49 @@ void AbstractDataPluginModelTest::addItemToList_keepExisting()
     QCOMPARE( itemsUpdatedSpy.count(), 0 );
 }
 
+void AbstractDataPluginModelTest::addItemsToList_evictOldItems()
+{
+    TestDataPluginModel model( &m_marbleModel );
+
+    // the model holds up to 1000 items
+    QList<AbstractDataPluginItem *> oldItems;
+    for ( int i = 0; i < 1000; ++i ) {
+        TestDataPluginItem *item = new TestDataPluginItem;
+        item->setId( QString( "old%1" ).arg( i ) );
+        item->setInitialized( true );
+        oldItems << item;
+    }
+    model.addItemsToList( oldItems );
+    QVERIFY( model.itemExists( "old0" ) );
+    QVERIFY( model.itemExists( "old999" ) );
+
+    // none of the items is displayed, neither before nor after adding the new ones
+    model.items( &fullViewport, 0 );
+
+    QList<AbstractDataPluginItem *> newItems;
+    for ( int i = 0; i < 10; ++i ) {
+        TestDataPluginItem *item = new TestDataPluginItem;
+        item->setId( QString( "new%1" ).arg( i ) );
+        item->setInitialized( true );
+        newItems << item;
+    }
+    model.addItemsToList( newItems );
+
+    // the new items have not been displayed yet and must not be evicted in their place
+    for ( int i = 0; i < 10; ++i ) {
+        QVERIFY( model.findItem( QString( "new%1" ).arg( i ) ) == newItems.at( i ) );
+    }
+
+    // more old items than necessary are removed, so that not every new item evicts another one
+    int oldCount = 0;
+    for ( int i = 0; i < 1000; ++i ) {
+        if ( model.itemExists( QString( "old%1" ).arg( i ) ) ) {
+            ++oldCount;
+        }
+    }
+    QVERIFY( oldCount < 1000 - 10 );
+}
+
 void AbstractDataPluginModelTest::setFavoriteItemsOnly_data()
 {
     QTest::addColumn<bool>( "itemIsFavorite" );
@@ -235,6 +292,44 @@ void AbstractDataPluginModelTest::setFavoriteItemsOnly()
     QCOMPARE( static_cast<bool>( model.items( &fullViewport, 1 ).contains( item ) ), visible );
 }
 
+void AbstractDataPluginModelTest::downloadDescriptionFile_reuse()
+{
+    // A local file stands in for the web service
+    QTemporaryFile file;
+    QVERIFY( file.open() );
+    file.write( "foo" );
+    file.close();
+    const QUrl url = QUrl::fromLocalFile( file.fileName() );
+
+    TestDataPluginModel model( &m_marbleModel );
+    QSignalSpy fileParsedSpy( &model, SIGNAL(fileParsed(QByteArray)) );
+
+    QEventLoop loop;
+    connect( &model, SIGNAL(fileParsed(QByteArray)), &loop, SLOT(quit()) );
+
+    // Requests for the same url are merged while in flight
+    model.downloadDescriptionFile( url );
+    model.downloadDescriptionFile( url );
+
+    QTimer::singleShot( 5000, &loop, SLOT(quit()) ); // watchdog timer
+    loop.exec();
+
+    // a second download of the same file would be parsed shortly after the first one
+    QTest::qWait( 500 );
+    QCOMPARE( fileParsedSpy.count(), 1 );
+
+    // A recent download is reused without accessing the url again
+    QVERIFY( file.remove() );
+    model.downloadDescriptionFile( url );
+
+    QTimer::singleShot( 5000, &loop, SLOT(quit()) ); // watchdog timer
+    loop.exec();
+
+    QTest::qWait( 500 );
+    QCOMPARE( fileParsedSpy.count(), 2 );
+    QCOMPARE( fileParsedSpy.at( 1 ).at( 0 ).toByteArray(), QByteArray( "foo" ) );
+}
+
 QTEST_MAIN( AbstractDataPluginModelTest )
 
 #include "AbstractDataPluginModelTest.moc"
@@ -0,0 +1,89 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtTest/QtTest>
+
+#include "CacheStoragePolicy.h"
+#include "TileMetaData.h"
+
+namespace Marble
+{
+
+class CacheStoragePolicyTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void init();
+    void cleanup();
+    void testMetaData();
+    void testRemoveFile();
+
+ private:
+    static TileMetaData testMetaData( const QByteArray &eTag );
+
+    QString m_directory;
+};
+
+TileMetaData CacheStoragePolicyTest::testMetaData( const QByteArray &eTag )
+{
+    TileMetaData metaData;
+    metaData.setFetchTime( QDateTime::fromTime_t( 1300000000 ) );
+    metaData.setETag( eTag );
+    return metaData;
+}
+
+void CacheStoragePolicyTest::init()
+{
+    m_directory = QDir::tempPath() + QString( "/marble-cache-storage-policy-test-%1/" ).arg( QCoreApplication::applicationPid() );
+}
+
+void CacheStoragePolicyTest::cleanup()
+{
+    // the index of the cache is written when the policy is destroyed
+    QDirIterator it( m_directory, QDir::Files );
+    while ( it.hasNext() ) {
+        QFile::remove( it.next() );
+    }
+    QDir().rmdir( m_directory );
+}
+
+void CacheStoragePolicyTest::testMetaData()
+{
+    CacheStoragePolicy policy( m_directory );
+    QVERIFY( policy.updateFile( "description", "foo" ) );
+    QVERIFY( !policy.metaData( "description" ).isValid() );
+
+    // the meta data written along with downloads is read back
+    QVERIFY( policy.updateMetaData( "description", testMetaData( "tag-1" ) ) );
+    QCOMPARE( policy.metaData( "description" ).eTag(), QByteArray( "tag-1" ) );
+    QCOMPARE( policy.fileData( "description" ), QByteArray( "foo" ) );
+}
+
+void CacheStoragePolicyTest::testRemoveFile()
+{
+    CacheStoragePolicy policy( m_directory );
+    QVERIFY( policy.updateFile( "description", "foo" ) );
+    QVERIFY( policy.updateMetaData( "description", testMetaData( "tag-1" ) ) );
+
+    // no meta data is left behind
+    policy.removeFile( "description" );
+    QVERIFY( !policy.fileExists( "description" ) );
+    QVERIFY( !policy.fileExists( TileMetaData::metaDataFileName( "description" ) ) );
+    QVERIFY( !policy.metaData( "description" ).isValid() );
+}
+
+}
+
+QTEST_MAIN( Marble::CacheStoragePolicyTest )
+
+#include "CacheStoragePolicyTest.moc"
@@ -0,0 +1,148 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtGui/QImage>
+#include <QtTest/QtTest>
+
+#include "DecodedTilePack.h"
+
+namespace Marble
+{
+
+class DecodedTilePackTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void testTiles();
+    void testIndexedTile();
+    void testDownloadedTile();
+    void testSamePack();
+
+ private:
+    void storeTile( int level, int x, int y, const QImage &image );
+
+    QString m_directory;
+    DecodedTilePack *m_pack;
+};
+
+void DecodedTilePackTest::storeTile( int level, int x, int y, const QImage &image )
+{
+    // Marble's storage layout as written by GeoSceneTiled::relativeTileFileName()
+    const QString fileName = QString( "%1/%2/%3/%3_%4.png" ).arg( m_directory ).arg( level )
+                             .arg( y, 6, 10, QChar( '0' ) ).arg( x, 6, 10, QChar( '0' ) );
+    QDir().mkpath( QFileInfo( fileName ).path() );
+    QVERIFY( image.save( fileName ) );
+}
+
+void DecodedTilePackTest::initTestCase()
+{
+    m_directory = QDir::tempPath() + QString( "/marble-decoded-tile-pack-test-%1" ).arg( QCoreApplication::applicationPid() );
+
+    QImage red( 16, 8, QImage::Format_ARGB32 );
+    red.fill( qRgba( 255, 0, 0, 128 ) );
+    storeTile( 0, 0, 0, red );
+
+    QImage blue( 16, 8, QImage::Format_RGB32 );
+    blue.fill( qRgb( 0, 0, 255 ) );
+    storeTile( 0, 1, 0, blue );
+
+    QImage indexed( 8, 8, QImage::Format_Indexed8 );
+    indexed.setColorCount( 2 );
+    indexed.setColor( 0, qRgb( 0, 0, 0 ) );
+    indexed.setColor( 1, qRgb( 10, 20, 30 ) );
+    indexed.fill( 1 );
+    storeTile( 1, 3, 1, indexed );
+
+    // not part of the pack, it is below the maximum level
+    storeTile( 2, 0, 0, blue );
+
+    QVERIFY( DecodedTilePack::write( m_directory, 1 ) );
+    m_pack = DecodedTilePack::open( m_directory );
+    QVERIFY( m_pack );
+}
+
+void DecodedTilePackTest::cleanupTestCase()
+{
+    // The pack stays mapped, removing its file is fine nevertheless
+    QDirIterator it( m_directory, QDir::Files, QDirIterator::Subdirectories );
+    while ( it.hasNext() ) {
+        QFile::remove( it.next() );
+    }
+    QDirIterator dirs( m_directory, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories );
+    QStringList directories;
+    while ( dirs.hasNext() ) {
+        directories.prepend( dirs.next() );
+    }
+    foreach ( const QString &directory, directories ) {
+        QDir().rmdir( directory );
+    }
+    QDir().rmdir( m_directory );
+}
+
+void DecodedTilePackTest::testTiles()
+{
+    QCOMPARE( m_pack->tileCount(), 3 );
+
+    const QImage red = m_pack->image( 0, 0, 0 );
+    QCOMPARE( red.format(), QImage::Format_ARGB32_Premultiplied );
+    QCOMPARE( red.size(), QSize( 16, 8 ) );
+    QCOMPARE( red.pixel( 15, 7 ), qRgba( 255, 0, 0, 128 ) );
+
+    const QImage blue = m_pack->image( 0, 1, 0 );
+    QCOMPARE( blue.format(), QImage::Format_ARGB32_Premultiplied );
+    QCOMPARE( blue.pixel( 0, 0 ), qRgb( 0, 0, 255 ) );
+
+    QVERIFY( m_pack->image( 2, 0, 0 ).isNull() );
+    QVERIFY( m_pack->image( 0, 0, 1 ).isNull() );
+}
+
+void DecodedTilePackTest::testIndexedTile()
+{
+    // the shading needs the color table of the relief tiles
+    const QImage indexed = m_pack->image( 1, 3, 1 );
+    QCOMPARE( indexed.format(), QImage::Format_Indexed8 );
+    QCOMPARE( indexed.colorCount(), 2 );
+    QCOMPARE( indexed.pixelIndex( 7, 7 ), 1 );
+    QCOMPARE( indexed.pixel( 7, 7 ), qRgb( 10, 20, 30 ) );
+}
+
+void DecodedTilePackTest::testDownloadedTile()
+{
+    const QDateTime written = m_pack->lastModified();
+    QVERIFY( written.isValid() );
+
+    // tiles downloaded before the pack was written are decoded already
+    QVERIFY( !m_pack->image( 0, 0, 0, written ).isNull() );
+    QVERIFY( !m_pack->image( 0, 0, 0, written.addSecs( -60 ) ).isNull() );
+
+    // newer downloads are loaded from their files instead
+    QVERIFY( m_pack->image( 0, 0, 0, written.addSecs( 1 ) ).isNull() );
+}
+
+void DecodedTilePackTest::testSamePack()
+{
+    const QImage before = m_pack->image( 0, 1, 0 );
+    QCOMPARE( DecodedTilePack::open( m_directory + '/' ), m_pack );
+
+    // the pack is never unmapped, so images taken from it stay valid
+    QCOMPARE( before.pixel( 3, 3 ), qRgb( 0, 0, 255 ) );
+    QCOMPARE( m_pack->image( 0, 1, 0 ), before );
+}
+
+}
+
+QTEST_MAIN( Marble::DecodedTilePackTest )
+
+#include "DecodedTilePackTest.moc"
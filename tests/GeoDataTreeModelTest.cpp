@@ -0,0 +1,119 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtTest/QtTest>
+
+#include "GeoDataDocument.h"
+#include "GeoDataFolder.h"
+#include "GeoDataLineString.h"
+#include "GeoDataMultiGeometry.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataTreeModel.h"
+
+namespace Marble
+{
+
+class GeoDataTreeModelTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void objectIndex();
+    void changedRows();
+    void changesOutsideModel();
+
+ private:
+    static void verifyIndex( GeoDataTreeModel &model, GeoDataObject *object, int row );
+};
+
+void GeoDataTreeModelTest::verifyIndex( GeoDataTreeModel &model, GeoDataObject *object, int row )
+{
+    const QModelIndex index = model.index( object );
+    QVERIFY( index.isValid() );
+    QCOMPARE( index.row(), row );
+    QCOMPARE( static_cast<GeoDataObject*>( index.internalPointer() ), object );
+    QCOMPARE( model.index( row, 0, model.parent( index ) ), index );
+}
+
+void GeoDataTreeModelTest::objectIndex()
+{
+    GeoDataTreeModel model;
+    GeoDataDocument *document = new GeoDataDocument;
+    GeoDataFolder *folder = new GeoDataFolder;
+    document->append( folder );
+    for ( int i = 0; i < 10; ++i ) {
+        folder->append( new GeoDataPlacemark );
+    }
+
+    GeoDataPlacemark *placemark = new GeoDataPlacemark;
+    GeoDataMultiGeometry *multiGeometry = new GeoDataMultiGeometry;
+    GeoDataLineString *lineString = new GeoDataLineString;
+    multiGeometry->append( new GeoDataLineString );
+    multiGeometry->append( lineString );
+    placemark->setGeometry( multiGeometry );
+    document->append( placemark );
+    model.addDocument( document );
+
+    verifyIndex( model, document, 0 );
+    verifyIndex( model, folder, 0 );
+    verifyIndex( model, folder->child( 7 ), 7 );
+    verifyIndex( model, placemark, 1 );
+    verifyIndex( model, multiGeometry, 0 );
+    verifyIndex( model, lineString, 1 );
+
+    QVERIFY( !model.index( model.rootDocument() ).isValid() );
+
+    GeoDataPlacemark outside;
+    QVERIFY( !model.index( &outside ).isValid() );
+}
+
+void GeoDataTreeModelTest::changedRows()
+{
+    GeoDataTreeModel model;
+    GeoDataDocument *document = new GeoDataDocument;
+    model.addDocument( document );
+
+    QList<GeoDataPlacemark*> placemarks;
+    for ( int i = 0; i < 5; ++i ) {
+        placemarks << new GeoDataPlacemark;
+        model.addFeature( document, placemarks.last() );
+    }
+    verifyIndex( model, placemarks.at( 4 ), 4 );
+
+    GeoDataPlacemark *first = new GeoDataPlacemark;
+    QCOMPARE( model.addFeature( document, first, 0 ), 0 );
+    verifyIndex( model, first, 0 );
+    verifyIndex( model, placemarks.at( 4 ), 5 );
+
+    QCOMPARE( model.removeFeature( placemarks.at( 1 ) ), 2 );
+    delete placemarks.takeAt( 1 );
+    verifyIndex( model, placemarks.at( 3 ), 4 );
+    QCOMPARE( model.removeFeature( placemarks.at( 3 ) ), 4 );
+    delete placemarks.takeAt( 3 );
+    QCOMPARE( model.rowCount( model.index( document ) ), 4 );
+}
+
+void GeoDataTreeModelTest::changesOutsideModel()
+{
+    GeoDataTreeModel model;
+    GeoDataDocument *document = new GeoDataDocument;
+    GeoDataPlacemark *placemark = new GeoDataPlacemark;
+    document->append( placemark );
+    model.addDocument( document );
+    verifyIndex( model, placemark, 0 );
+
+    document->insert( new GeoDataPlacemark, 0 );
+    model.update();
+    verifyIndex( model, placemark, 1 );
+}
+
+}
+
+QTEST_MAIN( Marble::GeoDataTreeModelTest )
+
+#include "GeoDataTreeModelTest.moc"
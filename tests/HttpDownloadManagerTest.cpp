@@ -0,0 +1,91 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QUrl>
+#include <QtNetwork/QTcpServer>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QtTest>
+
+#include "HttpDownloadManager.h"
+
+namespace Marble
+{
+
+class HttpDownloadManagerTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+    void testTileFocus_data();
+    void testTileFocus();
+
+ private:
+    QUrl tileUrl( int x, int y ) const;
+
+    // accepts the connections but never answers, so the downloads stay active
+    QTcpServer m_server;
+};
+
+QUrl HttpDownloadManagerTest::tileUrl( int x, int y ) const
+{
+    return QUrl( QString( "http://127.0.0.1:%1/3/%2/%3.png" ).arg( m_server.serverPort() ).arg( x ).arg( y ) );
+}
+
+void HttpDownloadManagerTest::initTestCase()
+{
+    QVERIFY( m_server.listen( QHostAddress::LocalHost ) );
+}
+
+void HttpDownloadManagerTest::testTileFocus_data()
+{
+    QTest::addColumn<qreal>( "focusX" );
+    QTest::addColumn<int>( "tileX" );
+    QTest::addColumn<bool>( "canceled" );
+
+    // level 3 has 8 columns, tiles are visible up to one tile away from the focus
+    QTest::newRow( "near" ) << qreal( 4.0 ) << 4 << false;
+    QTest::newRow( "far" ) << qreal( 4.0 ) << 0 << true;
+    // the tiles next to the date line are neighbors
+    QTest::newRow( "east of the date line" ) << qreal( 7.9 ) << 0 << false;
+    QTest::newRow( "west of the date line" ) << qreal( 0.1 ) << 7 << false;
+    QTest::newRow( "far from the date line" ) << qreal( 7.9 ) << 3 << true;
+}
+
+void HttpDownloadManagerTest::testTileFocus()
+{
+    QFETCH( qreal, focusX );
+    QFETCH( int, tileX );
+    QFETCH( bool, canceled );
+
+    HttpDownloadManager manager( 0 );
+    QSignalSpy canceledSpy( &manager, SIGNAL(downloadCanceled(QString,QString)) );
+
+    const QString id = QString( "test:3:%1:2" ).arg( tileX );
+    manager.addJob( tileUrl( tileX, 2 ), QString( "3/%1/2.png" ).arg( tileX ), id, DownloadBrowse );
+    QTest::qWait( 100 );
+
+    manager.setTileFocus( "test", 3, 8, focusX, 2.0, 1.0 );
+    QTest::qWait( 100 );
+
+    QCOMPARE( canceledSpy.count(), canceled ? 1 : 0 );
+    if ( canceled ) {
+        QCOMPARE( canceledSpy.first().at( 1 ).toString(), id );
+    }
+
+    // the focus moving next to the tile does not cancel it either
+    manager.setTileFocus( "test", 3, 8, tileX + 0.5, 2.5, 1.0 );
+    QTest::qWait( 100 );
+    QCOMPARE( canceledSpy.count(), canceled ? 1 : 0 );
+}
+
+}
+
+QTEST_MAIN( Marble::HttpDownloadManagerTest )
+
+#include "HttpDownloadManagerTest.moc"
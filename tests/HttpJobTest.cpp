@@ -0,0 +1,181 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtTest/QtTest>
+#include <QtTest/QSignalSpy>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+
+#include "HttpJob.h"
+
+namespace Marble
+{
+
+/**
+ * Stand-in for a tile server: answers every request with a fixed tile
+ * which may be cached for an hour, or with "304 Not Modified" if the
+ * request is conditional.
+ */
+class TileServer : public QObject
+{
+    Q_OBJECT
+
+ public:
+    TileServer()
+    {
+        connect( &m_server, SIGNAL(newConnection()), SLOT(acceptConnection()) );
+        m_server.listen( QHostAddress::LocalHost );
+    }
+
+    QUrl url( const QString &path ) const
+    {
+        return QUrl( QString( "http://127.0.0.1:%1/%2" ).arg( m_server.serverPort() ).arg( path ) );
+    }
+
+    static QByteArray tile() { return QByteArray( "not really a png" ); }
+    static QByteArray eTag() { return QByteArray( "tile-1" ); }
+
+    QList<QByteArray> requests;
+
+ private Q_SLOTS:
+    void acceptConnection()
+    {
+        while ( m_server.hasPendingConnections() ) {
+            QTcpSocket *socket = m_server.nextPendingConnection();
+            connect( socket, SIGNAL(readyRead()), SLOT(answer()) );
+            connect( socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()) );
+        }
+    }
+
+    void answer()
+    {
+        QTcpSocket *socket = qobject_cast<QTcpSocket *>( sender() );
+        QByteArray &buffer = m_buffers[ socket ];
+        buffer += socket->readAll();
+
+        int end;
+        while ( ( end = buffer.indexOf( "\r\n\r\n" ) ) >= 0 ) {
+            const QByteArray request = buffer.left( end );
+            buffer.remove( 0, end + 4 );
+            requests.append( request );
+
+            if ( request.contains( "If-Modified-Since:" ) || request.contains( "If-None-Match:" ) ) {
+                socket->write( "HTTP/1.1 304 Not Modified\r\nContent-Length: 0\r\n\r\n" );
+            }
+            else {
+                socket->write( "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\n" );
+                socket->write( "ETag: \"" + eTag() + "\"\r\nCache-Control: public, max-age=3600\r\nContent-Length: " );
+                socket->write( QByteArray::number( tile().size() ) + "\r\n\r\n" + tile() );
+            }
+        }
+    }
+
+ private:
+    QTcpServer m_server;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+};
+
+class HttpJobTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void testDownload();
+    void testNotModified();
+    void testIfNoneMatch();
+
+ private:
+    static void waitFor( HttpJob *job );
+};
+
+void HttpJobTest::waitFor( HttpJob *job )
+{
+    QEventLoop loop;
+    connect( job, SIGNAL(dataReceived(HttpJob*,QByteArray)), &loop, SLOT(quit()) );
+    connect( job, SIGNAL(notModified(HttpJob*)), &loop, SLOT(quit()) );
+    connect( job, SIGNAL(jobDone(HttpJob*,int)), &loop, SLOT(quit()) );
+    QTimer::singleShot( 5000, &loop, SLOT(quit()) ); // watchdog timer
+    job->execute();
+    loop.exec();
+}
+
+void HttpJobTest::testDownload()
+{
+    TileServer server;
+    QNetworkAccessManager networkAccessManager;
+    HttpJob job( server.url( "0/0/0.png" ), "0/0/0.png", "test:0:0:0", &networkAccessManager );
+
+    QSignalSpy dataSpy( &job, SIGNAL(dataReceived(HttpJob*,QByteArray)) );
+    QSignalSpy notModifiedSpy( &job, SIGNAL(notModified(HttpJob*)) );
+
+    waitFor( &job );
+
+    QCOMPARE( dataSpy.count(), 1 );
+    QCOMPARE( dataSpy.first().at( 1 ).toByteArray(), TileServer::tile() );
+    QCOMPARE( notModifiedSpy.count(), 0 );
+    QCOMPARE( server.requests.count(), 1 );
+    QVERIFY( !server.requests.first().contains( "If-Modified-Since:" ) );
+    QVERIFY( job.latency() >= 0 );
+    QVERIFY( job.transferTime() >= job.latency() );
+
+    const TileMetaData metaData = job.metaData();
+    QVERIFY( metaData.isValid() );
+    QCOMPARE( metaData.eTag(), QByteArray( "\"" + TileServer::eTag() + "\"" ) );
+    QCOMPARE( metaData.fetchTime().secsTo( metaData.expiry() ), 3600 );
+    QVERIFY( !metaData.isExpired( 0 ) );
+
+    const TileMetaData stored = TileMetaData::fromByteArray( metaData.toByteArray() );
+    QCOMPARE( stored.eTag(), metaData.eTag() );
+    QCOMPARE( stored.fetchTime().secsTo( metaData.fetchTime() ), 0 );
+    QCOMPARE( stored.expiry().secsTo( metaData.expiry() ), 0 );
+}
+
+void HttpJobTest::testNotModified()
+{
+    TileServer server;
+    QNetworkAccessManager networkAccessManager;
+    HttpJob job( server.url( "0/0/0.png" ), "0/0/0.png", "test:0:0:0", &networkAccessManager );
+    job.setIfModifiedSince( QDateTime( QDate( 2012, 1, 2 ), QTime( 3, 4, 5 ), Qt::UTC ) );
+
+    QSignalSpy dataSpy( &job, SIGNAL(dataReceived(HttpJob*,QByteArray)) );
+    QSignalSpy notModifiedSpy( &job, SIGNAL(notModified(HttpJob*)) );
+
+    waitFor( &job );
+
+    QCOMPARE( notModifiedSpy.count(), 1 );
+    QCOMPARE( dataSpy.count(), 0 );
+    QCOMPARE( server.requests.count(), 1 );
+    QVERIFY( server.requests.first().contains( "If-Modified-Since: Mon, 02 Jan 2012 03:04:05 GMT" ) );
+}
+
+void HttpJobTest::testIfNoneMatch()
+{
+    TileServer server;
+    QNetworkAccessManager networkAccessManager;
+    HttpJob job( server.url( "0/0/0.png" ), "0/0/0.png", "test:0:0:0", &networkAccessManager );
+    job.setIfNoneMatch( "\"" + TileServer::eTag() + "\"" );
+
+    QSignalSpy notModifiedSpy( &job, SIGNAL(notModified(HttpJob*)) );
+
+    waitFor( &job );
+
+    QCOMPARE( notModifiedSpy.count(), 1 );
+    QCOMPARE( server.requests.count(), 1 );
+    QVERIFY( server.requests.first().contains( "If-None-Match: \"tile-1\"" ) );
+
+    // the entity tag is kept although the response does not repeat it
+    QCOMPARE( job.metaData().eTag(), job.ifNoneMatch() );
+    QVERIFY( job.metaData().isValid() );
+}
+
+}
+
+QTEST_MAIN( Marble::HttpJobTest )
+
+#include "HttpJobTest.moc"
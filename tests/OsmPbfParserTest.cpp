@@ -0,0 +1,183 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QtTest>
+
+#include "GeoDataDocument.h"
+#include "GeoDataLineString.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPoint.h"
+#include "GeoDataPolygon.h"
+#include "MarbleDirs.h"
+#include "MarbleRunnerManager.h"
+#include "PluginManager.h"
+#include "TestUtils.h"
+
+namespace Marble
+{
+
+class OsmPbfParserTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void testNodes();
+    void testWays();
+    void testRelations();
+    void testTruncatedFile();
+    void testLzmaBlob();
+
+ private:
+    static QString dataPath( const QString &fileName );
+    static const GeoDataPlacemark *placemark( const GeoDataDocument *document, const QString &name );
+    QString parseError( const QString &fileName );
+
+    PluginManager m_pluginManager;
+    GeoDataDocument *m_document;
+};
+
+QString OsmPbfParserTest::dataPath( const QString &fileName )
+{
+    return QDir( TESTSRCDIR ).filePath( "data/" + fileName );
+}
+
+const GeoDataPlacemark *OsmPbfParserTest::placemark( const GeoDataDocument *document, const QString &name )
+{
+    foreach ( const GeoDataPlacemark *placemark, document->placemarkList() ) {
+        if ( placemark->name() == name ) {
+            return placemark;
+        }
+    }
+    return 0;
+}
+
+QString OsmPbfParserTest::parseError( const QString &fileName )
+{
+    MarbleRunnerManager runnerManager( &m_pluginManager );
+    QSignalSpy resultSpy( &runnerManager, SIGNAL(parsingFinished(GeoDataDocument*,QString)) );
+
+    QEventLoop loop;
+    connect( &runnerManager, SIGNAL(parsingFinished()),
+             &loop, SLOT(quit()), Qt::QueuedConnection );
+    runnerManager.parseFile( fileName );
+    loop.exec();
+    QThreadPool::globalInstance()->waitForDone();
+
+    if ( resultSpy.count() != 1 ) {
+        return QString();
+    }
+    const QList<QVariant> arguments = resultSpy.first();
+    delete arguments.at( 0 ).value<GeoDataDocument *>();
+    return arguments.at( 1 ).toString();
+}
+
+void OsmPbfParserTest::initTestCase()
+{
+    MarbleDirs::setMarblePluginPath( PLUGIN_PATH );
+
+    MarbleRunnerManager runnerManager( &m_pluginManager );
+    m_document = runnerManager.openFile( dataPath( "small.osm.pbf" ) );
+    QVERIFY( m_document );
+}
+
+void OsmPbfParserTest::cleanupTestCase()
+{
+    delete m_document;
+}
+
+void OsmPbfParserTest::testNodes()
+{
+    // A dense node and a plain one; coordinates are stored as
+    // offset + granularity * value in units of 1e-9 degrees
+    const GeoDataPlacemark *const corner = placemark( m_document, "Corner" );
+    QVERIFY( corner );
+    const GeoDataPoint *point = dynamic_cast<const GeoDataPoint *>( corner->geometry() );
+    QVERIFY( point );
+    QFUZZYCOMPARE( point->coordinates().longitude( GeoDataCoordinates::Degree ), 13.4, 0.0000001 );
+    QFUZZYCOMPARE( point->coordinates().latitude( GeoDataCoordinates::Degree ), 52.5, 0.0000001 );
+
+    const GeoDataPlacemark *const single = placemark( m_document, "Single" );
+    QVERIFY( single );
+    point = dynamic_cast<const GeoDataPoint *>( single->geometry() );
+    QVERIFY( point );
+    QFUZZYCOMPARE( point->coordinates().longitude( GeoDataCoordinates::Degree ), -151.2, 0.0000001 );
+    QFUZZYCOMPARE( point->coordinates().latitude( GeoDataCoordinates::Degree ), -33.9, 0.0000001 );
+
+    // nodes with blacklisted tags only don't become placemarks
+    foreach ( const GeoDataPlacemark *placemark, m_document->placemarkList() ) {
+        QVERIFY( !dynamic_cast<const GeoDataPoint *>( placemark->geometry() )
+                 || placemark == corner || placemark == single );
+    }
+}
+
+void OsmPbfParserTest::testWays()
+{
+    // refs 10, 11, 12, 13, 10 are stored as deltas 10, 1, 1, 1, -3
+    const GeoDataPlacemark *const street = placemark( m_document, "Street" );
+    QVERIFY( street );
+    QCOMPARE( street->visualCategory(), GeoDataFeature::HighwayRoad );
+    const GeoDataLineString *const lineString = dynamic_cast<const GeoDataLineString *>( street->geometry() );
+    QVERIFY( lineString );
+    QCOMPARE( lineString->size(), 5 );
+    QFUZZYCOMPARE( lineString->at( 1 ).longitude( GeoDataCoordinates::Degree ), 13.41, 0.0000001 );
+    QFUZZYCOMPARE( lineString->at( 1 ).latitude( GeoDataCoordinates::Degree ), 52.5, 0.0000001 );
+    QFUZZYCOMPARE( lineString->at( 2 ).latitude( GeoDataCoordinates::Degree ), 52.51, 0.0000001 );
+    QFUZZYCOMPARE( lineString->at( 3 ).longitude( GeoDataCoordinates::Degree ), 13.4, 0.0000001 );
+    QVERIFY( lineString->at( 4 ) == lineString->at( 0 ) );
+}
+
+void OsmPbfParserTest::testRelations()
+{
+    // members are way 20 as outer and way 21 as inner boundary, ids stored as deltas 20, 1
+    const GeoDataPlacemark *const lake = placemark( m_document, "Lake" );
+    QVERIFY( lake );
+    QCOMPARE( lake->visualCategory(), GeoDataFeature::NaturalWater );
+    const GeoDataPolygon *const polygon = dynamic_cast<const GeoDataPolygon *>( lake->geometry() );
+    QVERIFY( polygon );
+    QCOMPARE( polygon->outerBoundary().size(), 5 );
+    QCOMPARE( polygon->innerBoundaries().size(), 1 );
+
+    const GeoDataLinearRing &inner = polygon->innerBoundaries().first();
+    QCOMPARE( inner.size(), 4 );
+    QFUZZYCOMPARE( inner.at( 0 ).longitude( GeoDataCoordinates::Degree ), 13.405, 0.0000001 );
+    QFUZZYCOMPARE( inner.at( 0 ).latitude( GeoDataCoordinates::Degree ), 52.505, 0.0000001 );
+    QFUZZYCOMPARE( inner.at( 2 ).latitude( GeoDataCoordinates::Degree ), 52.51, 0.0000001 );
+}
+
+void OsmPbfParserTest::testTruncatedFile()
+{
+    QFile source( dataPath( "small.osm.pbf" ) );
+    QVERIFY( source.open( QIODevice::ReadOnly ) );
+    const QByteArray data = source.readAll();
+
+    const QString fileName = QDir::tempPath() + QString( "/marble-truncated-%1.osm.pbf" ).arg( QCoreApplication::applicationPid() );
+    QFile truncated( fileName );
+    QVERIFY( truncated.open( QIODevice::WriteOnly ) );
+    truncated.write( data.left( data.size() - 10 ) );
+    truncated.close();
+
+    QCOMPARE( parseError( fileName ), QString( "Unexpected end of file" ) );
+    QFile::remove( fileName );
+}
+
+void OsmPbfParserTest::testLzmaBlob()
+{
+    QCOMPARE( parseError( dataPath( "lzma.osm.pbf" ) ), QString( "Unsupported blob compression" ) );
+}
+
+}
+
+QTEST_MAIN( Marble::OsmPbfParserTest )
+
+#include "OsmPbfParserTest.moc"
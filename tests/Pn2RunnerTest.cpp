@@ -0,0 +1,289 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QPoint>
+#include <QtCore/QRect>
+#include <QtCore/QVector>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QtTest>
+
+#include "GeoDataDocument.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPolygon.h"
+#include "MarbleDirs.h"
+#include "MarbleRunnerManager.h"
+#include "PluginManager.h"
+#include "TestUtils.h"
+
+namespace Marble
+{
+
+namespace
+{
+// Polygon header flags as used by the runner
+enum polygonFlagType { LINESTRING = 0, LINEARRING = 1, OUTERBOUNDARY = 2, INNERBOUNDARY = 3 };
+
+// Nodes are given as x = longitude and y = latitude in units of 1/120 degree
+struct TestPolygon
+{
+    quint8 flag;
+    QVector<QPoint> nodes;
+};
+}
+
+class Pn2RunnerTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+    void cleanup();
+    void testRoundTrip_data();
+    void testRoundTrip();
+    void testBadOffset_data();
+    void testBadOffset();
+
+ private:
+    static QVector<TestPolygon> testPolygons();
+    static QByteArray encodePolygon( quint32 id, const TestPolygon &polygon );
+    static QByteArray encodeFile( int version, const QVector<TestPolygon> &polygons );
+    static void compareNodes( const GeoDataLineString &lineString, const QVector<QPoint> &nodes );
+    GeoDataDocument *parse( const QByteArray &data, QString *error );
+
+    PluginManager m_pluginManager;
+    QString m_fileName;
+};
+
+QVector<TestPolygon> Pn2RunnerTest::testPolygons()
+{
+    QVector<TestPolygon> polygons;
+
+    // the last node is more than a degree away, so it starts a new absolute node
+    TestPolygon lineString;
+    lineString.flag = LINESTRING;
+    lineString.nodes << QPoint( 1200, 600 ) << QPoint( 1230, 610 ) << QPoint( 1100, 490 ) << QPoint( -3000, 6000 );
+    polygons << lineString;
+
+    TestPolygon outer;
+    outer.flag = OUTERBOUNDARY;
+    outer.nodes << QPoint( 0, 0 ) << QPoint( 100, 0 ) << QPoint( 100, 100 ) << QPoint( 0, 100 );
+    polygons << outer;
+
+    TestPolygon inner;
+    inner.flag = INNERBOUNDARY;
+    inner.nodes << QPoint( 10, 10 ) << QPoint( 20, 10 ) << QPoint( 20, 20 );
+    polygons << inner;
+
+    TestPolygon ring;
+    ring.flag = LINEARRING;
+    ring.nodes << QPoint( -21600, -10800 ) << QPoint( -21500, -10790 ) << QPoint( 21600, 10800 );
+    polygons << ring;
+
+    return polygons;
+}
+
+QByteArray Pn2RunnerTest::encodePolygon( quint32 id, const TestPolygon &polygon )
+{
+    // each absolute node is followed by the nodes within a degree of it
+    QVector<int> absoluteNodes;
+    for ( int i = 0; i < polygon.nodes.size(); ++i ) {
+        const QPoint diff = polygon.nodes.at( i ) - polygon.nodes.at( absoluteNodes.isEmpty() ? 0 : absoluteNodes.last() );
+        if ( absoluteNodes.isEmpty() || qAbs( diff.x() ) > 120 || qAbs( diff.y() ) > 120 ) {
+            absoluteNodes << i;
+        }
+    }
+    absoluteNodes << polygon.nodes.size();
+
+    QByteArray data;
+    QDataStream stream( &data, QIODevice::WriteOnly );
+    stream << id << quint32( absoluteNodes.size() - 1 ) << polygon.flag;
+    for ( int i = 0; i + 1 < absoluteNodes.size(); ++i ) {
+        const QPoint absolute = polygon.nodes.at( absoluteNodes.at( i ) );
+        stream << qint16( absolute.y() ) << qint16( absolute.x() )
+               << qint16( absoluteNodes.at( i + 1 ) - absoluteNodes.at( i ) - 1 );
+        for ( int j = absoluteNodes.at( i ) + 1; j < absoluteNodes.at( i + 1 ); ++j ) {
+            const QPoint relative = polygon.nodes.at( j ) - absolute;
+            stream << qint8( relative.y() ) << qint8( relative.x() );
+        }
+    }
+
+    return data;
+}
+
+QByteArray Pn2RunnerTest::encodeFile( int version, const QVector<TestPolygon> &polygons )
+{
+    QByteArray data;
+    QDataStream stream( &data, QIODevice::WriteOnly );
+    stream << quint8( version ) << quint32( polygons.size() );
+
+    QVector<QByteArray> encoded;
+    for ( int i = 0; i < polygons.size(); ++i ) {
+        encoded << encodePolygon( i + 1, polygons.at( i ) );
+    }
+
+    if ( version == 2 ) {
+        quint32 offset = 5 + 16 * polygons.size();
+        for ( int i = 0; i < polygons.size(); ++i ) {
+            const QVector<QPoint> &nodes = polygons.at( i ).nodes;
+            QRect box( nodes.first(), QSize( 1, 1 ) );
+            foreach ( const QPoint &node, nodes ) {
+                box |= QRect( node, QSize( 1, 1 ) );
+            }
+            stream << qint16( box.left() ) << qint16( box.top() ) << qint16( box.right() ) << qint16( box.bottom() )
+                   << quint32( nodes.size() ) << offset;
+            offset += encoded.at( i ).size();
+        }
+    }
+
+    foreach ( const QByteArray &polygon, encoded ) {
+        stream.writeRawData( polygon.constData(), polygon.size() );
+    }
+
+    return data;
+}
+
+void Pn2RunnerTest::compareNodes( const GeoDataLineString &lineString, const QVector<QPoint> &nodes )
+{
+    QCOMPARE( lineString.size(), nodes.size() );
+    for ( int i = 0; i < nodes.size(); ++i ) {
+        QFUZZYCOMPARE( lineString.at( i ).longitude( GeoDataCoordinates::Degree ), nodes.at( i ).x() / 120.0, 0.0000001 );
+        QFUZZYCOMPARE( lineString.at( i ).latitude( GeoDataCoordinates::Degree ), nodes.at( i ).y() / 120.0, 0.0000001 );
+    }
+}
+
+GeoDataDocument *Pn2RunnerTest::parse( const QByteArray &data, QString *error )
+{
+    QFile file( m_fileName );
+    file.open( QIODevice::WriteOnly );
+    file.write( data );
+    file.close();
+
+    MarbleRunnerManager runnerManager( &m_pluginManager );
+    QSignalSpy resultSpy( &runnerManager, SIGNAL(parsingFinished(GeoDataDocument*,QString)) );
+
+    QEventLoop loop;
+    connect( &runnerManager, SIGNAL(parsingFinished()),
+             &loop, SLOT(quit()), Qt::QueuedConnection );
+    runnerManager.parseFile( m_fileName );
+    loop.exec();
+    QThreadPool::globalInstance()->waitForDone();
+
+    if ( resultSpy.count() != 1 ) {
+        return 0;
+    }
+    const QList<QVariant> arguments = resultSpy.first();
+    *error = arguments.at( 1 ).toString();
+    return arguments.at( 0 ).value<GeoDataDocument *>();
+}
+
+void Pn2RunnerTest::initTestCase()
+{
+    MarbleDirs::setMarblePluginPath( PLUGIN_PATH );
+    m_fileName = QDir::tempPath() + QString( "/marble-pn2-runner-test-%1.pn2" ).arg( QCoreApplication::applicationPid() );
+}
+
+void Pn2RunnerTest::cleanup()
+{
+    QFile::remove( m_fileName );
+}
+
+void Pn2RunnerTest::testRoundTrip_data()
+{
+    QTest::addColumn<int>( "version" );
+
+    QTest::newRow( "sequential" ) << 1;
+    QTest::newRow( "indexed" ) << 2;
+}
+
+void Pn2RunnerTest::testRoundTrip()
+{
+    QFETCH( int, version );
+
+    const QVector<TestPolygon> polygons = testPolygons();
+    QString error;
+    GeoDataDocument *const document = parse( encodeFile( version, polygons ), &error );
+    QVERIFY( document );
+    QVERIFY( error.isEmpty() );
+
+    // the inner boundary is merged into the polygon of the outer one
+    const QVector<GeoDataPlacemark *> placemarks = document->placemarkList();
+    QCOMPARE( placemarks.size(), 3 );
+
+    const GeoDataLineString *const lineString = dynamic_cast<const GeoDataLineString *>( placemarks.at( 0 )->geometry() );
+    QVERIFY( lineString );
+    QVERIFY( !dynamic_cast<const GeoDataLinearRing *>( lineString ) );
+    compareNodes( *lineString, polygons.at( 0 ).nodes );
+
+    const GeoDataPolygon *const polygon = dynamic_cast<const GeoDataPolygon *>( placemarks.at( 1 )->geometry() );
+    QVERIFY( polygon );
+    compareNodes( polygon->outerBoundary(), polygons.at( 1 ).nodes );
+    QCOMPARE( polygon->innerBoundaries().size(), 1 );
+    compareNodes( polygon->innerBoundaries().first(), polygons.at( 2 ).nodes );
+
+    const GeoDataLinearRing *const ring = dynamic_cast<const GeoDataLinearRing *>( placemarks.at( 2 )->geometry() );
+    QVERIFY( ring );
+    compareNodes( *ring, polygons.at( 3 ).nodes );
+
+    delete document;
+}
+
+void Pn2RunnerTest::testBadOffset_data()
+{
+    QTest::addColumn<QByteArray>( "data" );
+
+    const QByteArray valid = encodeFile( 2, testPolygons() );
+
+    // the offset of the second polygon is in the last 4 bytes of its index entry
+    QByteArray pastEnd = valid;
+    {
+        QDataStream stream( &pastEnd, QIODevice::ReadWrite );
+        stream.device()->seek( 5 + 16 + 12 );
+        stream << quint32( valid.size() - 4 );
+    }
+    QTest::newRow( "past end" ) << pastEnd;
+
+    QByteArray maximum = valid;
+    {
+        QDataStream stream( &maximum, QIODevice::ReadWrite );
+        stream.device()->seek( 5 + 16 + 12 );
+        stream << quint32( 0xffffffff );
+    }
+    QTest::newRow( "maximum" ) << maximum;
+
+    // more polygons than index entries fit into the file
+    QByteArray truncatedIndex = valid.left( 5 + 16 * 2 );
+    {
+        QDataStream stream( &truncatedIndex, QIODevice::ReadWrite );
+        stream.device()->seek( 1 );
+        stream << quint32( 0x7fffffff );
+    }
+    QTest::newRow( "truncated index" ) << truncatedIndex;
+
+    QTest::newRow( "truncated polygon" ) << valid.left( valid.size() - 1 );
+}
+
+void Pn2RunnerTest::testBadOffset()
+{
+    QFETCH( QByteArray, data );
+
+    QString error;
+    GeoDataDocument *const document = parse( data, &error );
+    QVERIFY( !document );
+    QCOMPARE( error, QString( "Errors occurred while parsing the .pn2 file!" ) );
+}
+
+}
+
+QTEST_MAIN( Marble::Pn2RunnerTest )
+
+#include "Pn2RunnerTest.moc"
@@ -0,0 +1,118 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QCoreApplication>
+#include <QtTest/QtTest>
+
+#include "SharedTileCache.h"
+
+namespace Marble
+{
+
+class SharedTileCacheTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void testInsert();
+    void testIndexed();
+    void testSharing();
+    void testEviction();
+
+ private:
+    static QString cacheKey( const char *name );
+    static QImage tileImage( QRgb color );
+};
+
+QString SharedTileCacheTest::cacheKey( const char *name )
+{
+    return QString( "marble-tile-cache-test-%1-%2" ).arg( QCoreApplication::applicationPid() ).arg( name );
+}
+
+QImage SharedTileCacheTest::tileImage( QRgb color )
+{
+    QImage image( 256, 256, QImage::Format_ARGB32_Premultiplied );
+    image.fill( color );
+    return image;
+}
+
+void SharedTileCacheTest::testInsert()
+{
+    SharedTileCache cache( cacheKey( "insert" ), 1024 * 1024 );
+    QVERIFY( cache.isAttached() );
+
+    const TileId id( "earth/bluemarble", 2, 1, 3 );
+    QVERIFY( cache.image( id ).isNull() );
+
+    cache.insert( id, tileImage( qRgb( 255, 0, 0 ) ) );
+    const QImage image = cache.image( id );
+    QCOMPARE( image.size(), QSize( 256, 256 ) );
+    QCOMPARE( image.pixel( 17, 42 ), qRgb( 255, 0, 0 ) );
+
+    QVERIFY( cache.image( TileId( "earth/bluemarble", 2, 3, 1 ) ).isNull() );
+    QVERIFY( cache.image( TileId( "earth/srtm", 2, 1, 3 ) ).isNull() );
+
+    // a newer tile replaces the cached one
+    cache.insert( id, tileImage( qRgb( 0, 0, 255 ) ) );
+    QCOMPARE( cache.image( id ).pixel( 17, 42 ), qRgb( 0, 0, 255 ) );
+}
+
+void SharedTileCacheTest::testIndexed()
+{
+    SharedTileCache cache( cacheKey( "indexed" ), 1024 * 1024 );
+    QVERIFY( cache.isAttached() );
+
+    QImage tile( 256, 256, QImage::Format_Indexed8 );
+    QVector<QRgb> colors;
+    for ( int i = 0; i < 256; ++i ) {
+        colors.append( qRgb( i, i, i ) );
+    }
+    tile.setColorTable( colors );
+    tile.fill( 200 );
+
+    const TileId id( "earth/srtm", 0, 0, 0 );
+    cache.insert( id, tile );
+    const QImage image = cache.image( id );
+    QCOMPARE( image.format(), QImage::Format_Indexed8 );
+    QCOMPARE( image.colorTable(), colors );
+    QCOMPARE( image.pixelIndex( 100, 100 ), 200 );
+}
+
+void SharedTileCacheTest::testSharing()
+{
+    SharedTileCache first( cacheKey( "sharing" ), 1024 * 1024 );
+    SharedTileCache second( cacheKey( "sharing" ), 4 * 1024 * 1024 );
+    QVERIFY( first.isAttached() );
+    QVERIFY( second.isAttached() );
+
+    const TileId id( "earth/openstreetmap", 5, 10, 12 );
+    first.insert( id, tileImage( qRgb( 0, 255, 0 ) ) );
+    QCOMPARE( second.image( id ).pixel( 0, 0 ), qRgb( 0, 255, 0 ) );
+}
+
+void SharedTileCacheTest::testEviction()
+{
+    // room for four tiles of 256 KB
+    SharedTileCache cache( cacheKey( "eviction" ), 1024 * 1024 );
+    QVERIFY( cache.isAttached() );
+
+    for ( int x = 0; x < 8; ++x ) {
+        cache.insert( TileId( "earth/bluemarble", 3, x, 0 ), tileImage( qRgb( x, 0, 0 ) ) );
+    }
+
+    QVERIFY( cache.image( TileId( "earth/bluemarble", 3, 0, 0 ) ).isNull() );
+    QVERIFY( cache.image( TileId( "earth/bluemarble", 3, 3, 0 ) ).isNull() );
+    QCOMPARE( cache.image( TileId( "earth/bluemarble", 3, 4, 0 ) ).pixel( 0, 0 ), qRgb( 4, 0, 0 ) );
+    QCOMPARE( cache.image( TileId( "earth/bluemarble", 3, 7, 0 ) ).pixel( 0, 0 ), qRgb( 7, 0, 0 ) );
+}
+
+}
+
+QTEST_MAIN( Marble::SharedTileCacheTest )
+
+#include "SharedTileCacheTest.moc"
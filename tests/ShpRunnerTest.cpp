@@ -0,0 +1,192 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QDir>
+#include <QtTest/QtTest>
+
+#include "GeoDataDocument.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataMultiGeometry.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPoint.h"
+#include "GeoDataPolygon.h"
+#include "MarbleDirs.h"
+#include "MarbleRunnerManager.h"
+#include "PluginManager.h"
+#include "TestUtils.h"
+
+namespace Marble
+{
+
+class ShpRunnerTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+    void testPoints();
+    void testMultiPoint();
+    void testPolyLine_data();
+    void testPolyLine();
+    void testPolygon();
+    void testMissingNameColumn();
+
+ private:
+    GeoDataDocument *openFile( const QString &fileName );
+    static void compareCoordinates( const GeoDataCoordinates &coordinates, qreal lon, qreal lat );
+
+    PluginManager m_pluginManager;
+};
+
+GeoDataDocument *ShpRunnerTest::openFile( const QString &fileName )
+{
+    MarbleRunnerManager runnerManager( &m_pluginManager );
+    return runnerManager.openFile( QDir( TESTSRCDIR ).filePath( "data/" + fileName ) );
+}
+
+void ShpRunnerTest::compareCoordinates( const GeoDataCoordinates &coordinates, qreal lon, qreal lat )
+{
+    QFUZZYCOMPARE( coordinates.longitude( GeoDataCoordinates::Degree ), lon, 0.0000001 );
+    QFUZZYCOMPARE( coordinates.latitude( GeoDataCoordinates::Degree ), lat, 0.0000001 );
+}
+
+void ShpRunnerTest::initTestCase()
+{
+    MarbleDirs::setMarblePluginPath( PLUGIN_PATH );
+}
+
+void ShpRunnerTest::testPoints()
+{
+    GeoDataDocument *const document = openFile( "shp-points.shp" );
+    QVERIFY( document );
+    const QVector<GeoDataPlacemark *> placemarks = document->placemarkList();
+    QCOMPARE( placemarks.size(), 2 );
+
+    QCOMPARE( placemarks.at( 0 )->name(), QString( "Berlin" ) );
+    QCOMPARE( placemarks.at( 0 )->description(), QString( "Capital" ) );
+    const GeoDataPoint *point = dynamic_cast<const GeoDataPoint *>( placemarks.at( 0 )->geometry() );
+    QVERIFY( point );
+    compareCoordinates( point->coordinates(), 13.4, 52.5 );
+
+    QCOMPARE( placemarks.at( 1 )->name(), QString( "Sydney" ) );
+    QVERIFY( placemarks.at( 1 )->description().isEmpty() );
+    point = dynamic_cast<const GeoDataPoint *>( placemarks.at( 1 )->geometry() );
+    QVERIFY( point );
+    compareCoordinates( point->coordinates(), -151.2, -33.9 );
+
+    delete document;
+}
+
+void ShpRunnerTest::testMultiPoint()
+{
+    GeoDataDocument *const document = openFile( "shp-multipoint.shp" );
+    QVERIFY( document );
+    QCOMPARE( document->placemarkList().size(), 1 );
+
+    const GeoDataPlacemark *const placemark = document->placemarkList().first();
+    QCOMPARE( placemark->name(), QString( "Stops" ) );
+    const GeoDataMultiGeometry *const multiGeometry = dynamic_cast<const GeoDataMultiGeometry *>( placemark->geometry() );
+    QVERIFY( multiGeometry );
+    QCOMPARE( multiGeometry->size(), 3 );
+
+    const GeoDataPoint *const last = dynamic_cast<const GeoDataPoint *>( multiGeometry->child( 2 ) );
+    QVERIFY( last );
+    compareCoordinates( last->coordinates(), -5.0, -6.0 );
+
+    delete document;
+}
+
+void ShpRunnerTest::testPolyLine_data()
+{
+    QTest::addColumn<QString>( "fileName" );
+
+    QTest::newRow( "index" ) << "shp-polyline.shp";
+    // the records are found by scanning the .shp file
+    QTest::newRow( "no index" ) << "shp-noindex.shp";
+}
+
+void ShpRunnerTest::testPolyLine()
+{
+    QFETCH( QString, fileName );
+
+    GeoDataDocument *const document = openFile( fileName );
+    QVERIFY( document );
+    const QVector<GeoDataPlacemark *> placemarks = document->placemarkList();
+    QCOMPARE( placemarks.size(), 2 );
+
+    QCOMPARE( placemarks.at( 0 )->name(), QString( "Road" ) );
+    const GeoDataLineString *const road = dynamic_cast<const GeoDataLineString *>( placemarks.at( 0 )->geometry() );
+    QVERIFY( road );
+    QCOMPARE( road->size(), 3 );
+    compareCoordinates( road->at( 2 ), 2.0, 0.0 );
+
+    // the last part ends with the record, not at the start of another part
+    QCOMPARE( placemarks.at( 1 )->name(), QString( "River" ) );
+    QCOMPARE( placemarks.at( 1 )->description(), QString( "Three parts" ) );
+    const GeoDataMultiGeometry *const river = dynamic_cast<const GeoDataMultiGeometry *>( placemarks.at( 1 )->geometry() );
+    QVERIFY( river );
+    QCOMPARE( river->size(), 3 );
+
+    const int sizes[] = { 2, 3, 2 };
+    for ( int i = 0; i < 3; ++i ) {
+        const GeoDataLineString *const part = dynamic_cast<const GeoDataLineString *>( river->child( i ) );
+        QVERIFY( part );
+        QCOMPARE( part->size(), sizes[i] );
+    }
+    const GeoDataLineString *const lastPart = static_cast<const GeoDataLineString *>( river->child( 2 ) );
+    compareCoordinates( lastPart->at( 0 ), 20.0, 20.0 );
+    compareCoordinates( lastPart->at( 1 ), 21.0, 21.0 );
+
+    delete document;
+}
+
+void ShpRunnerTest::testPolygon()
+{
+    GeoDataDocument *const document = openFile( "shp-polygon.shp" );
+    QVERIFY( document );
+    QCOMPARE( document->placemarkList().size(), 1 );
+
+    const GeoDataPlacemark *const placemark = document->placemarkList().first();
+    QCOMPARE( placemark->name(), QString( "Lake" ) );
+    const GeoDataPolygon *const polygon = dynamic_cast<const GeoDataPolygon *>( placemark->geometry() );
+    QVERIFY( polygon );
+    QCOMPARE( polygon->outerBoundary().size(), 5 );
+    compareCoordinates( polygon->outerBoundary().at( 2 ), 10.0, 10.0 );
+
+    // the first ring is the outer boundary, all others are holes
+    QCOMPARE( polygon->innerBoundaries().size(), 2 );
+    QCOMPARE( polygon->innerBoundaries().at( 0 ).size(), 4 );
+    compareCoordinates( polygon->innerBoundaries().at( 0 ).at( 1 ), 2.0, 1.0 );
+    QCOMPARE( polygon->innerBoundaries().at( 1 ).size(), 5 );
+    compareCoordinates( polygon->innerBoundaries().at( 1 ).at( 3 ), 5.0, 7.0 );
+
+    delete document;
+}
+
+void ShpRunnerTest::testMissingNameColumn()
+{
+    // the first column is Id, which must not be taken for the name
+    GeoDataDocument *const document = openFile( "shp-noname.shp" );
+    QVERIFY( document );
+    const QVector<GeoDataPlacemark *> placemarks = document->placemarkList();
+    QCOMPARE( placemarks.size(), 2 );
+
+    QVERIFY( placemarks.at( 0 )->name().isEmpty() );
+    QCOMPARE( placemarks.at( 0 )->description(), QString( "First" ) );
+    QVERIFY( placemarks.at( 1 )->name().isEmpty() );
+    QCOMPARE( placemarks.at( 1 )->description(), QString( "Second" ) );
+    QVERIFY( dynamic_cast<const GeoDataPoint *>( placemarks.at( 1 )->geometry() ) );
+
+    delete document;
+}
+
+}
+
+QTEST_MAIN( Marble::ShpRunnerTest )
+
+#include "ShpRunnerTest.moc"
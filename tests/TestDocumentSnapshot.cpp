@@ -0,0 +1,209 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+
+#include "TestUtils.h"
+#include <DocumentSnapshot.h>
+#include <GeoDataDocument.h>
+#include <GeoDataExtendedData.h>
+#include <GeoDataFolder.h>
+#include <GeoDataIconStyle.h>
+#include <GeoDataLineStyle.h>
+#include <GeoDataNetworkLink.h>
+#include <GeoDataPlacemark.h>
+#include <GeoDataPolygon.h>
+#include <GeoDataStyle.h>
+
+using namespace Marble;
+
+class TestDocumentSnapshot : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void init();
+    void cleanup();
+    void loadSnapshot();
+    void staleSnapshot();
+    void touchedSource();
+    void removedSource();
+    void unsupportedContent();
+
+ private:
+    void writeSource( const QString &content );
+
+    QString m_sourceFileName;
+};
+
+namespace
+{
+const char *const content =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+    "<kml xmlns=\"http://www.opengis.net/kml/2.2\"><Document>"
+    "<name>Snapshot</name>"
+    "<Style id=\"red\"><LineStyle><color>ff0000ff</color></LineStyle>"
+    "<IconStyle><Icon><href>icons/lake.png</href></Icon>"
+    "<hotSpot x=\"0.5\" y=\"4\" xunits=\"fraction\" yunits=\"pixels\"/></IconStyle></Style>"
+    "<StyleMap id=\"map\"><Pair><key>normal</key><styleUrl>#red</styleUrl></Pair></StyleMap>"
+    "<Folder><name>Lakes</name>"
+    "<Placemark><name>Lake</name><styleUrl>#map</styleUrl>"
+    "<ExtendedData><Data name=\"depth\"><value>42</value></Data></ExtendedData>"
+    "<Polygon><outerBoundaryIs><LinearRing><coordinates>"
+    "8.1,49.1 8.2,49.1 8.2,49.2 8.1,49.1"
+    "</coordinates></LinearRing></outerBoundaryIs>"
+    "<innerBoundaryIs><LinearRing><coordinates>"
+    "8.15,49.12 8.16,49.12 8.16,49.13 8.15,49.12"
+    "</coordinates></LinearRing></innerBoundaryIs></Polygon>"
+    "</Placemark>"
+    "</Folder>"
+    "<Placemark><name>Inline</name>"
+    "<Style><LineStyle><color>ff00ff00</color></LineStyle></Style>"
+    "<LineString><coordinates>8.4,49.0,100 8.5,49.1,200</coordinates></LineString>"
+    "</Placemark>"
+    "</Document></kml>";
+}
+
+void TestDocumentSnapshot::init()
+{
+    m_sourceFileName = QDir::tempPath() + QString( "/marble-snapshot-test-%1.kml" ).arg( QCoreApplication::applicationPid() );
+    QFile::remove( DocumentSnapshot::fileName( m_sourceFileName ) );
+}
+
+void TestDocumentSnapshot::cleanup()
+{
+    QFile::remove( DocumentSnapshot::fileName( m_sourceFileName ) );
+    QFile::remove( m_sourceFileName );
+}
+
+void TestDocumentSnapshot::writeSource( const QString &content )
+{
+    QFile file( m_sourceFileName );
+    QVERIFY( file.open( QIODevice::WriteOnly ) );
+    file.write( content.toUtf8() );
+}
+
+void TestDocumentSnapshot::loadSnapshot()
+{
+    writeSource( content );
+    QVERIFY( !DocumentSnapshot::load( m_sourceFileName ) );
+
+    GeoDataDocument *const parsed = parseKml( content );
+    QVERIFY( DocumentSnapshot::save( parsed, m_sourceFileName ) );
+    delete parsed;
+
+    GeoDataDocument *const document = DocumentSnapshot::load( m_sourceFileName );
+    QVERIFY( document );
+    QCOMPARE( document->name(), QString( "Snapshot" ) );
+    QCOMPARE( document->size(), 2 );
+    QCOMPARE( document->folderList().size(), 1 );
+
+    const GeoDataFolder *const folder = document->folderList().first();
+    QCOMPARE( folder->name(), QString( "Lakes" ) );
+    QCOMPARE( folder->parent(), static_cast<GeoDataObject *>( document ) );
+
+    // the style map of the document resolves the style of the lake
+    GeoDataPlacemark *const lake = folder->placemarkList().first();
+    QCOMPARE( lake->styleUrl(), QString( "#map" ) );
+    QCOMPARE( lake->style(), &document->style( "red" ) );
+    QCOMPARE( lake->style()->lineStyle().color(), QColor( Qt::red ) );
+    // the icon is stored by its path, it has not been loaded when the snapshot was written
+    QCOMPARE( lake->style()->iconStyle().iconPath(), QString( "icons/lake.png" ) );
+    GeoDataHotSpot::Units xunits;
+    GeoDataHotSpot::Units yunits;
+    QCOMPARE( lake->style()->iconStyle().hotSpot( xunits, yunits ), QPointF( 0.5, 4 ) );
+    QCOMPARE( xunits, GeoDataHotSpot::Fraction );
+    QCOMPARE( yunits, GeoDataHotSpot::Pixels );
+    QCOMPARE( lake->extendedData().value( "depth" ).value().toString(), QString( "42" ) );
+
+    const GeoDataPolygon *const polygon = dynamic_cast<const GeoDataPolygon *>( lake->geometry() );
+    QVERIFY( polygon );
+    QCOMPARE( polygon->outerBoundary().size(), 4 );
+    QCOMPARE( polygon->innerBoundaries().size(), 1 );
+    QFUZZYCOMPARE( polygon->innerBoundaries().first().at( 1 ).longitude( GeoDataCoordinates::Degree ), 8.16, 0.0000001 );
+
+    GeoDataPlacemark *const inlineStyled = document->placemarkList().first();
+    QCOMPARE( inlineStyled->style()->lineStyle().color(), QColor( Qt::green ) );
+    const GeoDataLineString *const lineString = dynamic_cast<const GeoDataLineString *>( inlineStyled->geometry() );
+    QVERIFY( lineString );
+    QCOMPARE( lineString->size(), 2 );
+    QFUZZYCOMPARE( lineString->last().latitude( GeoDataCoordinates::Degree ), 49.1, 0.0000001 );
+    QCOMPARE( lineString->last().altitude(), 200.0 );
+
+    delete document;
+}
+
+void TestDocumentSnapshot::staleSnapshot()
+{
+    writeSource( content );
+    GeoDataDocument *const parsed = parseKml( content );
+    QVERIFY( DocumentSnapshot::save( parsed, m_sourceFileName ) );
+    delete parsed;
+
+    // same size, different content
+    writeSource( QString( content ).replace( "Lakes", "Ponds" ) );
+    QVERIFY( !DocumentSnapshot::load( m_sourceFileName ) );
+    QVERIFY( !QFile::exists( DocumentSnapshot::fileName( m_sourceFileName ) ) );
+}
+
+void TestDocumentSnapshot::touchedSource()
+{
+    writeSource( content );
+    GeoDataDocument *const parsed = parseKml( content );
+    QVERIFY( DocumentSnapshot::save( parsed, m_sourceFileName ) );
+    delete parsed;
+
+    // a newer modification time with the same content keeps the snapshot
+    QTest::qSleep( 1100 );
+    writeSource( content );
+    GeoDataDocument *document = DocumentSnapshot::load( m_sourceFileName );
+    QVERIFY( document );
+    delete document;
+
+    document = DocumentSnapshot::load( m_sourceFileName );
+    QVERIFY( document );
+    delete document;
+}
+
+void TestDocumentSnapshot::removedSource()
+{
+    const QString removedFileName = m_sourceFileName + ".removed.kml";
+    QFile removed( removedFileName );
+    QVERIFY( removed.open( QIODevice::WriteOnly ) );
+    removed.write( content );
+    removed.close();
+
+    GeoDataDocument *const parsed = parseKml( content );
+    QVERIFY( DocumentSnapshot::save( parsed, removedFileName ) );
+    QVERIFY( QFile::exists( DocumentSnapshot::fileName( removedFileName ) ) );
+    QVERIFY( removed.remove() );
+
+    // writing another snapshot deletes the one of the removed source
+    writeSource( content );
+    QVERIFY( DocumentSnapshot::save( parsed, m_sourceFileName ) );
+    delete parsed;
+    QVERIFY( !QFile::exists( DocumentSnapshot::fileName( removedFileName ) ) );
+    QVERIFY( QFile::exists( DocumentSnapshot::fileName( m_sourceFileName ) ) );
+}
+
+void TestDocumentSnapshot::unsupportedContent()
+{
+    GeoDataDocument document;
+    document.append( new GeoDataPlacemark );
+    QVERIFY( DocumentSnapshot::isSupported( &document ) );
+
+    document.append( new GeoDataNetworkLink );
+    QVERIFY( !DocumentSnapshot::isSupported( &document ) );
+}
+
+QTEST_MAIN( TestDocumentSnapshot )
+
+#include "TestDocumentSnapshot.moc"
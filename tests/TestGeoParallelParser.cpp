@@ -0,0 +1,127 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QBuffer>
+#include <QtCore/QObject>
+#include <QtCore/QThread>
+#include <QtTest/QtTest>
+
+#include <GeoDataDocument.h>
+#include <GeoDataFolder.h>
+#include <GeoDataParser.h>
+#include <GeoDataPlacemark.h>
+#include <GeoDataStyle.h>
+#include <GeoParallelParser.h>
+
+using namespace Marble;
+
+class TestGeoParallelParser : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void parseLargeDocument();
+    void parseSmallDocument();
+    void parseBrokenDocument();
+
+ private:
+    static GeoParser *createParser();
+    static QByteArray kml( int placemarkCount );
+};
+
+GeoParser *TestGeoParallelParser::createParser()
+{
+    return new GeoDataParser( GeoData_KML );
+}
+
+QByteArray TestGeoParallelParser::kml( int placemarkCount )
+{
+    QByteArray result = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                        "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n"
+                        "<Document>\n"
+                        "<name>Export</name>\n"
+                        "<Style id=\"red\"><LineStyle><color>ff0000ff</color></LineStyle></Style>\n"
+                        "<!-- <Placemark> in a comment -->\n";
+    const QByteArray description( 100, 'x' );
+    for ( int i = 0; i < placemarkCount; ++i ) {
+        if ( i == placemarkCount / 2 ) {
+            result += "<Folder><name>Middle</name><Placemark><name>Nested</name></Placemark></Folder>\n";
+        }
+        result += "<Placemark><name>P" + QByteArray::number( i ) + "</name>"
+                  "<description><![CDATA[<b>" + description + "</b>]]></description>"
+                  "<styleUrl>#red</styleUrl>"
+                  "<LineString><coordinates>8.4,49.0 8.5,49.1 8.6,49.2</coordinates></LineString>"
+                  "</Placemark>\n";
+    }
+    result += "</Document>\n</kml>\n";
+    return result;
+}
+
+void TestGeoParallelParser::parseLargeDocument()
+{
+    const int count = 50000;
+    QByteArray data = kml( count );
+    QBuffer buffer( &data );
+    buffer.open( QIODevice::ReadOnly );
+
+    GeoParallelParser parser( createParser, "Document", 2 );
+    QVERIFY( parser.read( &buffer ) );
+    if ( QThread::idealThreadCount() > 1 ) {
+        QVERIFY( parser.chunkCount() > 1 );
+    }
+
+    GeoDataDocument *const document = parser.releaseDocument();
+    QVERIFY( document );
+    QCOMPARE( document->name(), QString( "Export" ) );
+    QCOMPARE( document->size(), count + 1 );
+    QCOMPARE( document->folderList().size(), 1 );
+    QCOMPARE( document->folderList().first()->size(), 1 );
+
+    // The order of the features is kept and shared styles refer to the merged document
+    const QVector<GeoDataPlacemark *> placemarks = document->placemarkList();
+    QCOMPARE( placemarks.size(), count );
+    const GeoDataStyle *const red = &document->style( "red" );
+    for ( int i = 0; i < count; ++i ) {
+        QCOMPARE( placemarks.at( i )->name(), QString( "P%1" ).arg( i ) );
+        QCOMPARE( placemarks.at( i )->style(), red );
+    }
+
+    delete document;
+}
+
+void TestGeoParallelParser::parseSmallDocument()
+{
+    QByteArray data = kml( 10 );
+    QBuffer buffer( &data );
+    buffer.open( QIODevice::ReadOnly );
+
+    GeoParallelParser parser( createParser, "Document", 2 );
+    QVERIFY( parser.read( &buffer ) );
+    QCOMPARE( parser.chunkCount(), 1 );
+
+    GeoDataDocument *const document = parser.releaseDocument();
+    QCOMPARE( document->placemarkList().size(), 10 );
+    delete document;
+}
+
+void TestGeoParallelParser::parseBrokenDocument()
+{
+    QByteArray data = kml( 50000 );
+    data.insert( data.indexOf( "\n<Placemark>", data.size() / 2 ), "</Placemark>" );
+    QBuffer buffer( &data );
+    buffer.open( QIODevice::ReadOnly );
+
+    GeoParallelParser parser( createParser, "Document", 2 );
+    QVERIFY( !parser.read( &buffer ) );
+    QVERIFY( !parser.errorString().isEmpty() );
+    QVERIFY( !parser.releaseDocument() );
+}
+
+QTEST_MAIN( TestGeoParallelParser )
+
+#include "TestGeoParallelParser.moc"
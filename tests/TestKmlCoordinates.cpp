@@ -0,0 +1,158 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+
+#include "TestUtils.h"
+#include <GeoDataDocument.h>
+#include <GeoDataLineString.h>
+#include <GeoDataPlacemark.h>
+#include "geodata/writers/kml/KmlLineStringTagWriter.h"
+
+#include <limits>
+
+using namespace Marble;
+
+class TestKmlCoordinates : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void parseTest_data();
+    void parseTest();
+    void benchmarkLineString_data();
+    void benchmarkLineString();
+    void writeNumberTest_data();
+    void writeNumberTest();
+
+ private:
+    static QString lineStringKml( const QString &coordinates );
+};
+
+QString TestKmlCoordinates::lineStringKml( const QString &coordinates )
+{
+    return QString( "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                    "<kml xmlns=\"http://www.opengis.net/kml/2.2\">"
+                    "<Document><Placemark><LineString><coordinates>%1</coordinates></LineString></Placemark></Document>"
+                    "</kml>" ).arg( coordinates );
+}
+
+void TestKmlCoordinates::parseTest_data()
+{
+    QTest::addColumn<QString>( "coordinates" );
+    QTest::addColumn<int>( "size" );
+    QTest::addColumn<qreal>( "lon" );
+    QTest::addColumn<qreal>( "lat" );
+    QTest::addColumn<qreal>( "alt" );
+
+    addRow() << "8.4,49.0" << 1 << 8.4 << 49.0 << 0.0;
+    addRow() << "8.4,49.0,110.5 9,50,0" << 2 << 8.4 << 49.0 << 110.5;
+    addRow() << "\n\t-122.207881,37.371915,156\n\t-122.205712,37.373288,152\n" << 2 << -122.207881 << 37.371915 << 156.0;
+    addRow() << "8.4 , 49.0 ,110.5   9,50" << 2 << 8.4 << 49.0 << 110.5;
+    addRow() << "1e1,-2.5E1,0.000001" << 1 << 10.0 << -25.0 << 0.000001;
+    addRow() << "0.12345678901234567,+1.0" << 1 << 0.12345678901234567 << 1.0 << 0.0;
+    addRow() << "" << 0 << 0.0 << 0.0 << 0.0;
+}
+
+void TestKmlCoordinates::parseTest()
+{
+    QFETCH( QString, coordinates );
+    QFETCH( int, size );
+    QFETCH( qreal, lon );
+    QFETCH( qreal, lat );
+    QFETCH( qreal, alt );
+
+    GeoDataDocument *const document = parseKml( lineStringKml( coordinates ) );
+    QCOMPARE( document->placemarkList().size(), 1 );
+    const GeoDataLineString *const lineString = dynamic_cast<const GeoDataLineString *>( document->placemarkList().first()->geometry() );
+    QVERIFY( lineString );
+    QCOMPARE( lineString->size(), size );
+    if ( size > 0 ) {
+        QFUZZYCOMPARE( lineString->first().longitude( GeoDataCoordinates::Degree ), lon, 0.0000001 );
+        QFUZZYCOMPARE( lineString->first().latitude( GeoDataCoordinates::Degree ), lat, 0.0000001 );
+        QFUZZYCOMPARE( lineString->first().altitude(), alt, 0.0000001 );
+    }
+
+    delete document;
+}
+
+void TestKmlCoordinates::benchmarkLineString_data()
+{
+    QTest::addColumn<int>( "size" );
+
+    addRow() << 1000;
+    addRow() << 200000;
+}
+
+void TestKmlCoordinates::benchmarkLineString()
+{
+    QFETCH( int, size );
+
+    // a track as written by GPS devices, one coordinate per line
+    QString coordinates;
+    coordinates.reserve( 40 * size );
+    for ( int i = 0; i < size; ++i ) {
+        coordinates += QString( "\n%1,%2,%3" ).arg( -122.2 + i * 0.000001, 0, 'f', 6 )
+                                              .arg( 37.3 + i * 0.000002, 0, 'f', 6 )
+                                              .arg( 150 + i % 100 );
+    }
+    const QString content = lineStringKml( coordinates );
+
+    QBENCHMARK {
+        GeoDataDocument *const document = parseKml( content );
+        const GeoDataLineString *const lineString = dynamic_cast<const GeoDataLineString *>( document->placemarkList().first()->geometry() );
+        QCOMPARE( lineString->size(), size );
+        delete document;
+    }
+}
+
+void TestKmlCoordinates::writeNumberTest_data()
+{
+    QTest::addColumn<qreal>( "value" );
+    QTest::addColumn<int>( "decimals" );
+
+    addRow() << 8.4 << 10;
+    addRow() << -122.207881 << 10;
+    addRow() << 0.0 << 2;
+    addRow() << -0.0 << 2;
+    addRow() << -0.001 << 2;
+    addRow() << 0.999 << 2;
+    addRow() << -99.995 << 2;
+    // halfway between two results, exactly or almost
+    addRow() << 0.125 << 2;
+    addRow() << -0.125 << 2;
+    addRow() << 2.5 << 0;
+    addRow() << -3.5 << 0;
+    addRow() << 1.005 << 2;
+    addRow() << 2.675 << 2;
+    addRow() << 0.00000000005 << 10;
+    // the scaled value needs all 53 bits of the mantissa
+    addRow() << 900719.9254740991 << 10;
+    addRow() << 4503599627370497.0 << 0;
+    addRow() << 9007199254740991.0 << 0;
+    addRow() << 1e15 << 2;
+    addRow() << -1e300 << 2;
+    addRow() << std::numeric_limits<qreal>::infinity() << 2;
+    addRow() << -std::numeric_limits<qreal>::infinity() << 2;
+    addRow() << std::numeric_limits<qreal>::quiet_NaN() << 10;
+}
+
+void TestKmlCoordinates::writeNumberTest()
+{
+    QFETCH( qreal, value );
+    QFETCH( int, decimals );
+
+    QByteArray buffer( "1," );
+    KmlLineStringTagWriter::appendNumber( buffer, value, decimals );
+    QCOMPARE( QString::fromLatin1( buffer ), "1," + QString::number( value, 'f', decimals ) );
+}
+
+QTEST_MAIN( TestKmlCoordinates )
+
+#include "TestKmlCoordinates.moc"
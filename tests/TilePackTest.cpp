@@ -0,0 +1,266 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QSharedMemory>
+#include <QtTest/QtTest>
+
+#include "MarbleGlobal.h"
+#include "TilePack.h"
+
+namespace Marble
+{
+
+class TilePackTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void init();
+    void cleanup();
+    void testInsert();
+    void testReopen();
+    void testDataCopy();
+    void testCompact();
+    void testClear();
+    void testShrink();
+    void testReadOnly();
+    void testImportFiles();
+
+ private:
+    static QByteArray tileData( char fill, int size = 1000 );
+    void removeDirectory();
+
+    QString m_directory;
+};
+
+QByteArray TilePackTest::tileData( char fill, int size )
+{
+    return QByteArray( size, fill );
+}
+
+void TilePackTest::removeDirectory()
+{
+    QDirIterator it( m_directory, QDir::Files, QDirIterator::Subdirectories );
+    while ( it.hasNext() ) {
+        QFile::remove( it.next() );
+    }
+    QDir( m_directory ).rmpath( "." );
+    QDir().rmpath( m_directory );
+}
+
+void TilePackTest::init()
+{
+    m_directory = QDir::cleanPath( QDir::tempPath() + QString( "/marble-tile-pack-test-%1/%2" )
+                                   .arg( QCoreApplication::applicationPid() )
+                                   .arg( QTest::currentTestFunction() ) );
+    removeDirectory();
+}
+
+void TilePackTest::cleanup()
+{
+    TilePack::closeAll();
+    removeDirectory();
+}
+
+void TilePackTest::testInsert()
+{
+    TilePack *const pack = TilePack::open( m_directory );
+    QVERIFY( pack->isWritable() );
+    QCOMPARE( TilePack::find( m_directory + "/5/3/7.jpg" ), pack );
+    QVERIFY( !pack->contains( "5/3/7.jpg" ) );
+
+    const QDateTime lastModified = QDateTime::fromTime_t( 1300000000 );
+    pack->insert( "5/3/7.jpg", tileData( 'a' ), lastModified );
+    QVERIFY( pack->contains( "5/3/7.jpg" ) );
+    QCOMPARE( pack->data( "5/3/7.jpg" ), tileData( 'a' ) );
+
+    // flushed tiles are read from the pack file
+    pack->flush();
+    QVERIFY( pack->contains( "5/3/7.jpg" ) );
+    QCOMPARE( pack->data( "5/3/7.jpg" ), tileData( 'a' ) );
+    QCOMPARE( pack->lastModified( "5/3/7.jpg" ), lastModified );
+    QCOMPARE( pack->size(), QFileInfo( pack->fileName() ).size() );
+    QVERIFY( pack->data( "5/3/8.jpg" ).isEmpty() );
+}
+
+void TilePackTest::testReopen()
+{
+    TilePack *pack = TilePack::open( m_directory );
+    pack->insert( "5/3/7.jpg", tileData( 'a' ) );
+    pack->insert( "6/3/7.jpg", tileData( 'b' ) );
+    pack->insert( "5/3/7.jpg", tileData( 'c' ) );
+    TilePack::closeAll();
+
+    pack = TilePack::open( m_directory );
+    QCOMPARE( pack->data( "5/3/7.jpg" ), tileData( 'c' ) );
+    QCOMPARE( pack->data( "6/3/7.jpg" ), tileData( 'b' ) );
+
+    // records missing in the index are recovered from the pack
+    TilePack::closeAll();
+    QFile index( m_directory + "/tiles.idx" );
+    QVERIFY( index.open( QIODevice::ReadWrite ) );
+    QVERIFY( index.resize( 0 ) );
+    index.close();
+
+    pack = TilePack::open( m_directory );
+    QCOMPARE( pack->data( "5/3/7.jpg" ), tileData( 'c' ) );
+    QCOMPARE( pack->data( "6/3/7.jpg" ), tileData( 'b' ) );
+}
+
+void TilePackTest::testDataCopy()
+{
+    TilePack *const pack = TilePack::open( m_directory );
+    pack->insert( "5/3/7.jpg", tileData( 'a' ) );
+    pack->flush();
+
+    // the tile stays valid after the pack was rewritten and unmapped
+    const QByteArray data = pack->data( "5/3/7.jpg" );
+    pack->clear( maxBaseTileLevel );
+    QVERIFY( !pack->contains( "5/3/7.jpg" ) );
+    QCOMPARE( data, tileData( 'a' ) );
+}
+
+void TilePackTest::testCompact()
+{
+    TilePack *const pack = TilePack::open( m_directory );
+    pack->insert( "5/3/7.jpg", tileData( 'a' ) );
+    pack->insert( "6/3/7.jpg", tileData( 'b' ) );
+    pack->flush();
+    const qint64 size = pack->size();
+
+    // replaced tiles take up space until the pack is compacted
+    pack->insert( "5/3/7.jpg", tileData( 'c' ) );
+    pack->flush();
+    const qint64 replacedSize = pack->size() - size;
+    QVERIFY( replacedSize > 1000 );
+
+    QCOMPARE( pack->compact(), replacedSize );
+    QCOMPARE( pack->size(), size );
+    QCOMPARE( pack->data( "5/3/7.jpg" ), tileData( 'c' ) );
+    QCOMPARE( pack->data( "6/3/7.jpg" ), tileData( 'b' ) );
+    QCOMPARE( pack->compact(), qint64( 0 ) );
+
+    // the rewritten index is used after reopening
+    TilePack::closeAll();
+    TilePack *const reopened = TilePack::open( m_directory );
+    QCOMPARE( reopened->size(), size );
+    QCOMPARE( reopened->data( "5/3/7.jpg" ), tileData( 'c' ) );
+    QCOMPARE( reopened->data( "6/3/7.jpg" ), tileData( 'b' ) );
+}
+
+void TilePackTest::testClear()
+{
+    TilePack *const pack = TilePack::open( m_directory );
+    pack->insert( "3/1/2.jpg", tileData( 'a' ) );
+    pack->insert( "5/3/7.jpg", tileData( 'b' ) );
+    pack->insert( "5/3/7.jpg.meta", tileData( 'c', 10 ) );
+    pack->flush();
+
+    QVERIFY( pack->clear( maxBaseTileLevel ) > 1000 );
+    QCOMPARE( pack->data( "3/1/2.jpg" ), tileData( 'a' ) );
+    QVERIFY( !pack->contains( "5/3/7.jpg" ) );
+    QVERIFY( !pack->contains( "5/3/7.jpg.meta" ) );
+}
+
+void TilePackTest::testShrink()
+{
+    TilePack *const pack = TilePack::open( m_directory );
+    pack->insert( "3/1/2.jpg", tileData( 'a' ), QDateTime::fromTime_t( 1000000000 ) );
+    pack->insert( "5/3/7.jpg", tileData( 'b' ), QDateTime::fromTime_t( 1100000000 ) );
+    pack->insert( "5/3/7.jpg.meta", tileData( 'c', 10 ), QDateTime::fromTime_t( 1300000000 ) );
+    pack->insert( "5/3/8.jpg", tileData( 'd' ), QDateTime::fromTime_t( 1200000000 ) );
+    pack->flush();
+    const qint64 size = pack->size();
+
+    // the oldest tile above the base level goes first, along with its meta data
+    const qint64 freed = pack->shrink( 1 );
+    QVERIFY( freed > 1000 );
+    QCOMPARE( pack->size(), size - freed );
+    QVERIFY( pack->contains( "3/1/2.jpg" ) );
+    QVERIFY( !pack->contains( "5/3/7.jpg" ) );
+    QVERIFY( !pack->contains( "5/3/7.jpg.meta" ) );
+    QCOMPARE( pack->data( "5/3/8.jpg" ), tileData( 'd' ) );
+
+    // base tiles are never removed
+    pack->shrink( size );
+    QVERIFY( pack->contains( "3/1/2.jpg" ) );
+    QVERIFY( !pack->contains( "5/3/8.jpg" ) );
+}
+
+void TilePackTest::testReadOnly()
+{
+    // another process writing the pack holds the lock
+    QSharedMemory writerLock( QString( "marble-tile-pack-%1" ).arg( qHash( m_directory ) ) );
+    QVERIFY( writerLock.create( 1 ) );
+
+    TilePack *const pack = TilePack::open( m_directory );
+    QVERIFY( !pack->isWritable() );
+
+    // tiles are stored as files, which the writing process imports later on
+    pack->insert( "5/3/7.jpg", tileData( 'a' ) );
+    pack->flush();
+    QFile file( m_directory + "/5/3/7.jpg" );
+    QVERIFY( file.open( QIODevice::ReadOnly ) );
+    QCOMPARE( file.readAll(), tileData( 'a' ) );
+    QCOMPARE( QFileInfo( pack->fileName() ).size(), qint64( 0 ) );
+
+    // until then they are read from the files
+    QVERIFY( pack->contains( "5/3/7.jpg" ) );
+    QCOMPARE( pack->data( "5/3/7.jpg" ), tileData( 'a' ) );
+    QCOMPARE( pack->lastModified( "5/3/7.jpg" ), QFileInfo( file ).lastModified() );
+}
+
+void TilePackTest::testImportFiles()
+{
+    const QDateTime past = QDateTime::currentDateTime().addSecs( -3600 );
+    const QDateTime future = QDateTime::currentDateTime().addSecs( 3600 );
+
+    TilePack *pack = TilePack::open( m_directory );
+    pack->insert( "5/3/7.jpg", tileData( 'a' ), past );
+    pack->insert( "5/3/8.jpg", tileData( 'b' ), future );
+    TilePack::closeAll();
+
+    {
+        // another process writing the pack holds the lock
+        QSharedMemory writerLock( QString( "marble-tile-pack-%1" ).arg( qHash( m_directory ) ) );
+        QVERIFY( writerLock.create( 1 ) );
+
+        pack = TilePack::open( m_directory );
+        QVERIFY( !pack->isWritable() );
+
+        // files newer than the tiles of the pack take precedence
+        pack->insert( "5/3/7.jpg", tileData( 'c' ) );
+        pack->insert( "5/3/8.jpg", tileData( 'd' ) );
+        QCOMPARE( pack->data( "5/3/7.jpg" ), tileData( 'c' ) );
+        QCOMPARE( pack->data( "5/3/8.jpg" ), tileData( 'b' ) );
+        QCOMPARE( pack->lastModified( "5/3/8.jpg" ), QDateTime::fromTime_t( future.toTime_t() ) );
+        TilePack::closeAll();
+    }
+
+    // the writing process replaces older tiles by the files and removes all of them
+    pack = TilePack::open( m_directory );
+    QVERIFY( pack->isWritable() );
+    for ( int i = 0; i < 50 && QDir( m_directory + "/5/3" ).exists(); ++i ) {
+        QTest::qWait( 100 );
+    }
+    QVERIFY( !QFile::exists( m_directory + "/5/3/7.jpg" ) );
+    QVERIFY( !QFile::exists( m_directory + "/5/3/8.jpg" ) );
+    QCOMPARE( pack->data( "5/3/7.jpg" ), tileData( 'c' ) );
+    QVERIFY( pack->lastModified( "5/3/7.jpg" ) > past );
+    QCOMPARE( pack->data( "5/3/8.jpg" ), tileData( 'b' ) );
+}
+
+}
+
+QTEST_MAIN( Marble::TilePackTest )
+
+#include "TilePackTest.moc"
@@ -0,0 +1,264 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QTextStream>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QtTest>
+
+#include "GeoDataLatLonBox.h"
+#include "GeoSceneTiled.h"
+#include "TileId.h"
+#include "TileSeeder.h"
+
+namespace Marble
+{
+
+class TileSeederTest : public QObject
+{
+    Q_OBJECT
+
+ public:
+    TileSeederTest();
+
+ private slots:
+    void init();
+    void cleanup();
+    void testTileAt();
+    void testBoxRegion_data();
+    void testBoxRegion();
+    void testBoxRegionDateLine();
+    void testBoxRegionMercator();
+    void testResume();
+    void testOtherRegionCheckpoint();
+
+ private:
+    void storeTile( const TileId &id );
+    void removeDirectory();
+    static QRect bottomLevelCoords( const TileCoordsPyramid &pyramid );
+
+    GeoSceneTiled m_texture;
+    QString m_directory;
+    QString m_checkpointFile;
+};
+
+TileSeederTest::TileSeederTest()
+    : m_texture( "seeder" )
+{
+    // two tiles on level 0, tiles expire after an hour
+    m_texture.setSourceDir( "earth/seeder" );
+    m_texture.setFileFormat( "PNG" );
+    m_texture.setLevelZeroColumns( 2 );
+    m_texture.setLevelZeroRows( 1 );
+    m_texture.setExpire( 3600 );
+    // nothing listens there, the downloads never finish during the tests
+    m_texture.addDownloadUrl( QUrl( "http://127.0.0.1:1/" ) );
+}
+
+void TileSeederTest::storeTile( const TileId &id )
+{
+    const QString fileName = m_directory + '/' + m_texture.relativeTileFileName( id );
+    QDir().mkpath( QFileInfo( fileName ).path() );
+    QFile file( fileName );
+    QVERIFY( file.open( QIODevice::WriteOnly ) );
+    file.write( "not really a png" );
+}
+
+void TileSeederTest::removeDirectory()
+{
+    QDirIterator it( m_directory, QDir::Files, QDirIterator::Subdirectories );
+    while ( it.hasNext() ) {
+        QFile::remove( it.next() );
+    }
+    QDirIterator dirs( m_directory, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories );
+    QStringList directories;
+    while ( dirs.hasNext() ) {
+        directories.prepend( dirs.next() );
+    }
+    foreach ( const QString &directory, directories ) {
+        QDir().rmdir( directory );
+    }
+    QDir().rmdir( m_directory );
+}
+
+QRect TileSeederTest::bottomLevelCoords( const TileCoordsPyramid &pyramid )
+{
+    return pyramid.coords( pyramid.bottomLevel() );
+}
+
+void TileSeederTest::init()
+{
+    m_directory = QDir::tempPath() + QString( "/marble-tile-seeder-test-%1" ).arg( QCoreApplication::applicationPid() );
+    m_checkpointFile = m_directory + "/checkpoint";
+    removeDirectory();
+    QDir().mkpath( m_directory );
+}
+
+void TileSeederTest::cleanup()
+{
+    removeDirectory();
+}
+
+void TileSeederTest::testTileAt()
+{
+    // levels 0 and 1 of the columns 1 to 3 of level 1, followed by a single tile on level 2
+    TileCoordsPyramid first( 0, 1 );
+    first.setBottomLevelCoords( QRect( 1, 0, 3, 2 ) );
+    TileCoordsPyramid second( 2, 2 );
+    second.setBottomLevelCoords( QRect( 5, 3, 1, 1 ) );
+
+    TileSeeder seeder( &m_texture, m_directory );
+    seeder.setRegion( QVector<TileCoordsPyramid>() << first << second );
+    QCOMPARE( seeder.tileCount(), qint64( 2 + 6 + 1 ) );
+
+    const QString sourceDir = m_texture.sourceDir();
+    QCOMPARE( seeder.tileAt( 0 ), TileId( sourceDir, 0, 0, 0 ) );
+    QCOMPARE( seeder.tileAt( 1 ), TileId( sourceDir, 0, 1, 0 ) );
+    QCOMPARE( seeder.tileAt( 2 ), TileId( sourceDir, 1, 1, 0 ) );
+    QCOMPARE( seeder.tileAt( 4 ), TileId( sourceDir, 1, 3, 0 ) );
+    QCOMPARE( seeder.tileAt( 5 ), TileId( sourceDir, 1, 1, 1 ) );
+    QCOMPARE( seeder.tileAt( 7 ), TileId( sourceDir, 1, 3, 1 ) );
+    QCOMPARE( seeder.tileAt( 8 ), TileId( sourceDir, 2, 5, 3 ) );
+}
+
+void TileSeederTest::testBoxRegion_data()
+{
+    QTest::addColumn<GeoDataLatLonBox>( "box" );
+    QTest::addColumn<int>( "bottomLevel" );
+    QTest::addColumn<QRect>( "coords" );
+
+    QTest::newRow( "world" ) << GeoDataLatLonBox( 90, -90, 180, -180, GeoDataCoordinates::Degree )
+                             << 2 << QRect( 0, 0, 8, 4 );
+    // tiles of level 3 span 22.5 degrees
+    QTest::newRow( "equator" ) << GeoDataLatLonBox( 10, -10, 50, 40, GeoDataCoordinates::Degree )
+                               << 3 << QRect( 9, 3, 2, 2 );
+    QTest::newRow( "inside a tile" ) << GeoDataLatLonBox( 50, 49, 11, 10, GeoDataCoordinates::Degree )
+                                     << 3 << QRect( 8, 1, 1, 1 );
+}
+
+void TileSeederTest::testBoxRegion()
+{
+    QFETCH( GeoDataLatLonBox, box );
+    QFETCH( int, bottomLevel );
+    QFETCH( QRect, coords );
+
+    const QVector<TileCoordsPyramid> region = TileSeeder::boxRegion( &m_texture, box, 0, bottomLevel );
+    QCOMPARE( region.size(), 1 );
+    QCOMPARE( region.first().topLevel(), 0 );
+    QCOMPARE( region.first().bottomLevel(), bottomLevel );
+    QCOMPARE( bottomLevelCoords( region.first() ), coords );
+}
+
+void TileSeederTest::testBoxRegionDateLine()
+{
+    // the box is split into the parts east and west of the date line
+    const GeoDataLatLonBox box( 10, -10, -170, 170, GeoDataCoordinates::Degree );
+    QVERIFY( box.crossesDateLine() );
+
+    const QVector<TileCoordsPyramid> region = TileSeeder::boxRegion( &m_texture, box, 3, 3 );
+    QCOMPARE( region.size(), 2 );
+    QCOMPARE( bottomLevelCoords( region.at( 0 ) ), QRect( 15, 3, 1, 2 ) );
+    QCOMPARE( bottomLevelCoords( region.at( 1 ) ), QRect( 0, 3, 1, 2 ) );
+}
+
+void TileSeederTest::testBoxRegionMercator()
+{
+    GeoSceneTiled texture( "mercator" );
+    texture.setSourceDir( "earth/mercator" );
+    texture.setLevelZeroColumns( 1 );
+    texture.setLevelZeroRows( 1 );
+    texture.setProjection( GeoSceneTiled::Mercator );
+
+    // latitudes beyond the end of the projection are clamped
+    const GeoDataLatLonBox world( 90, -90, 180, -180, GeoDataCoordinates::Degree );
+    QCOMPARE( bottomLevelCoords( TileSeeder::boxRegion( &texture, world, 2, 2 ).first() ), QRect( 0, 0, 4, 4 ) );
+
+    const GeoDataLatLonBox north( 89, 1, 180, -180, GeoDataCoordinates::Degree );
+    QCOMPARE( bottomLevelCoords( TileSeeder::boxRegion( &texture, north, 1, 1 ).first() ), QRect( 0, 0, 2, 1 ) );
+}
+
+void TileSeederTest::testResume()
+{
+    const GeoDataLatLonBox world( 90, -90, 180, -180, GeoDataCoordinates::Degree );
+    const QVector<TileCoordsPyramid> region = TileSeeder::boxRegion( &m_texture, world, 0, 1 );
+
+    {
+        TileSeeder seeder( &m_texture, m_directory );
+        seeder.setRegion( region );
+        seeder.setCheckpointFile( m_checkpointFile );
+        seeder.setMaximumConnections( 1 );
+        QCOMPARE( seeder.tileCount(), qint64( 2 + 8 ) );
+
+        // fresh tiles are skipped, the fifth one is requested
+        for ( int i = 0; i < 4; ++i ) {
+            storeTile( seeder.tileAt( i ) );
+        }
+        seeder.start();
+        QVERIFY( seeder.isRunning() );
+        QCOMPARE( seeder.skippedCount(), 4 );
+        QCOMPARE( seeder.processedCount(), qint64( 4 ) );
+
+        // the checkpoint points to the tile still being downloaded
+        seeder.stop();
+        QFile file( m_checkpointFile );
+        QVERIFY( file.open( QIODevice::ReadOnly ) );
+        QTextStream stream( &file );
+        QCOMPARE( stream.readLine(), m_texture.sourceDir() );
+        QCOMPARE( stream.readLine(), QString( "10" ) );
+        QCOMPARE( stream.readLine(), QString( "4" ) );
+
+        for ( int i = 4; i < seeder.tileCount(); ++i ) {
+            storeTile( seeder.tileAt( i ) );
+        }
+    }
+
+    // the tiles in front of the checkpoint are not checked again
+    TileSeeder seeder( &m_texture, m_directory );
+    seeder.setRegion( region );
+    seeder.setCheckpointFile( m_checkpointFile );
+    QSignalSpy finishedSpy( &seeder, SIGNAL(finished()) );
+
+    seeder.start();
+    QCOMPARE( finishedSpy.count(), 1 );
+    QVERIFY( !seeder.isRunning() );
+    QCOMPARE( seeder.processedCount(), qint64( 10 ) );
+    QCOMPARE( seeder.skippedCount(), 6 );
+    QVERIFY( !QFile::exists( m_checkpointFile ) );
+}
+
+void TileSeederTest::testOtherRegionCheckpoint()
+{
+    const GeoDataLatLonBox world( 90, -90, 180, -180, GeoDataCoordinates::Degree );
+
+    TileSeeder seeder( &m_texture, m_directory );
+    seeder.setRegion( TileSeeder::boxRegion( &m_texture, world, 0, 1 ) );
+    seeder.setCheckpointFile( m_checkpointFile );
+    for ( int i = 0; i < seeder.tileCount(); ++i ) {
+        storeTile( seeder.tileAt( i ) );
+    }
+
+    // written for a region with another number of tiles
+    QFile file( m_checkpointFile );
+    QVERIFY( file.open( QIODevice::WriteOnly ) );
+    QTextStream( &file ) << m_texture.sourceDir() << '\n' << 42 << '\n' << 8 << '\n';
+    file.close();
+
+    seeder.start();
+    QVERIFY( !seeder.isRunning() );
+    QCOMPARE( seeder.processedCount(), qint64( 10 ) );
+    QCOMPARE( seeder.skippedCount(), 10 );
+}
+
+}
+
+QTEST_MAIN( Marble::TileSeederTest )
+
+#include "TileSeederTest.moc"
@@ -20,7 +20,7 @@ namespace Marble
 {
 
 SqlWriter::SqlWriter( const QString &filename, QObject* parent ) :
-    Writer( parent ), m_placemarkId( 0 )
+    Writer( parent ), m_placemarkId( 0 ), m_hasSpatialIndex( false )
 {
     QSqlDatabase database = QSqlDatabase::addDatabase( "QSQLITE" );
     database.setDatabaseName( filename );
@@ -31,6 +31,7 @@ SqlWriter::SqlWriter( const QString &filename, QObject* parent ) :
 
     execQuery( "DROP TABLE IF EXISTS placemarks;" );
     execQuery( "CREATE TABLE placemarks ("
+               " id INTEGER PRIMARY KEY,"
                " regionId INTEGER,"
                " nameId INTEGER,"
                " number VARCHAR(8),"
@@ -62,6 +63,17 @@ SqlWriter::SqlWriter( const QString &filename, QObject* parent ) :
                " FROM names"
                " INNER JOIN placemarks"
                " ON names.id=placemarks.nameId" );
+
+    // Spatial index for nearest neighbor searches. Requires SQLite's rtree module,
+    // the search runner falls back to sorting by distance without it
+    execQuery( "DROP TABLE IF EXISTS placemarksRtree" );
+    QSqlQuery rtreeQuery;
+    m_hasSpatialIndex = rtreeQuery.exec( "CREATE VIRTUAL TABLE placemarksRtree USING rtree("
+                                         " id, minLon, maxLon, minLat, maxLat )" );
+    if ( !m_hasSpatialIndex ) {
+        qWarning() << "SQLite rtree module not available, not creating a spatial index:" << rtreeQuery.lastError();
+    }
+
     execQuery( "BEGIN TRANSACTION" );
 }
 
@@ -118,6 +130,19 @@ void SqlWriter::addOsmPlacemark( const OsmPlacemark &placemark )
     query.addBindValue( placemark.longitude() );
     query.addBindValue( placemark.latitude() );
     execQuery( query );
+
+    if ( m_hasSpatialIndex ) {
+        QSqlQuery rtreeQuery;
+        rtreeQuery.prepare( "INSERT INTO placemarksRtree"
+                            " (id, minLon, maxLon, minLat, maxLat)"
+                            " VALUES (?, ?, ?, ?, ?)" );
+        rtreeQuery.addBindValue( query.lastInsertId() );
+        rtreeQuery.addBindValue( placemark.longitude() );
+        rtreeQuery.addBindValue( placemark.longitude() );
+        rtreeQuery.addBindValue( placemark.latitude() );
+        rtreeQuery.addBindValue( placemark.latitude() );
+        execQuery( rtreeQuery );
+    }
 }
 
 void SqlWriter::execQuery( const QString &query ) const
@@ -43,6 +43,8 @@ private:
     QPair<int, QString> m_lastPlacemark;
 
     int m_placemarkId;
+
+    bool m_hasSpatialIndex;
 };
 
 }
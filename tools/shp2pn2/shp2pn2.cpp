@@ -28,6 +28,11 @@
 //
 // The parser has to convert these relative coordinates to absolute coordinates.
 //
+// Version 2 of the format stores the same polygons, but the file header is followed by an index that holds
+// for each polygon its bounding box (west, south, east and north in the units of the absolute nodes), its
+// total number of nodes and the byte offset of its Polygon Header in the file. This way polygons can be
+// located without reading the ones in front of them, so the parser decodes them concurrently.
+//
 // Copyright 2012 Torsten Rahn <rahn@kde.org>
 // Copyright 2012 Cezar Mocan <mocancezar@gmail.com>
 //
@@ -38,6 +43,7 @@
 #include <QtCore/QFileInfo>
 #include <QtCore/QFile>
 #include <QtCore/QDataStream>
+#include <QtCore/QByteArray>
 #include <QtGui/QApplication>
 #include <QtGui/QTreeView>
  
@@ -103,10 +109,30 @@ quint32 getParentNodes( QVector<GeoDataCoordinates>::Iterator begin, QVector<Geo
     return parentNodes;
 }
 
-void printAllNodes( QVector<GeoDataCoordinates>::Iterator begin, QVector<GeoDataCoordinates>::Iterator end, QDataStream &stream ) 
+// A polygon of the output file, encoded before the index can be written
+struct Pn2Polygon
+{
+    Pn2Polygon() : west( 32767 ), south( 32767 ), east( -32768 ), north( -32768 ), nodes( 0 ) {}
+
+    void extend( qint16 lat, qint16 lon ) {
+        west = qMin( west, lon );
+        south = qMin( south, lat );
+        east = qMax( east, lon );
+        north = qMax( north, lat );
+        ++nodes;
+    }
+
+    qint16 west, south, east, north;
+    quint32 nodes;
+    QByteArray data;
+};
+
+void printAllNodes( QVector<GeoDataCoordinates>::Iterator begin, QVector<GeoDataCoordinates>::Iterator end, QDataStream &stream, Pn2Polygon &polygon )
 {
 
     qint16 nrChildNodes; 
+    qint16 parentLat = 0;
+    qint16 parentLon = 0;
 
     QVector<GeoDataCoordinates>::Iterator it = begin;
     QVector<GeoDataCoordinates>::Iterator itAux = begin;
@@ -119,18 +145,34 @@ void printAllNodes( QVector<GeoDataCoordinates>::Iterator begin, QVector<GeoData
             for ( ; itAux2 != end && nodeDistance( (*it), (*itAux2) ) <= epsilon; ++itAux2 )
                 ++nrChildNodes;
 
-            qint16 lat = printFormat16( it->latitude( GeoDataCoordinates::Degree ) );
-            qint16 lon = printFormat16( it->longitude( GeoDataCoordinates::Degree ) );
+            parentLat = printFormat16( it->latitude( GeoDataCoordinates::Degree ) );
+            parentLon = printFormat16( it->longitude( GeoDataCoordinates::Degree ) );
 
-            stream << lat << lon << nrChildNodes;
+            stream << parentLat << parentLon << nrChildNodes;
+            polygon.extend( parentLat, parentLon );
         }
         else { // relative nodes
             qint8 lat = printFormat8( latDistance( (*it), (*itAux) ) );
             qint8 lon = printFormat8( lonDistance( (*it), (*itAux) ) );
             stream << lat << lon;
+            // the bounding box covers the nodes as the parser decodes them
+            polygon.extend( parentLat + lat, parentLon + lon );
         }
     }
 }
+
+Pn2Polygon encodePolygon( quint32 id, quint8 flag, GeoDataLineString &linestring )
+{
+    Pn2Polygon polygon;
+    QDataStream stream( &polygon.data, QIODevice::WriteOnly );
+
+    QVector<GeoDataCoordinates>::Iterator jBegin = linestring.begin();
+    QVector<GeoDataCoordinates>::Iterator jEnd = linestring.end();
+    stream << id << getParentNodes( jBegin, jEnd ) << flag;
+    printAllNodes( jBegin, jEnd, stream, polygon );
+
+    return polygon;
+}
  
 int main(int argc, char** argv)
 {
@@ -155,48 +197,12 @@ int main(int argc, char** argv)
  
     GeoDataDocument* document = manager->openFile( inputFilename );
 
-    QFile file( outputFilename );
-    file.open( QIODevice::WriteOnly );
-    QDataStream stream( &file );
-
-    quint8 fileHeaderVersion;
-    quint32 fileHeaderPolygons;
-
-    fileHeaderVersion = 1;
-    fileHeaderPolygons = 0; // This variable counts the number of polygons inside the document
+    QVector<Pn2Polygon> polygons;
+    quint32 polyCurrentID = 0;
 
     QVector<GeoDataFeature*>::Iterator i = document->begin();
     QVector<GeoDataFeature*>::Iterator const end = document->end();
 
-    for (; i != end; ++i) {
-        GeoDataPlacemark* placemark = static_cast<GeoDataPlacemark*>( *i );
-
-        // Types of placemarks
-        GeoDataPolygon* polygon = dynamic_cast<GeoDataPolygon*>( placemark->geometry() );
-        GeoDataLineString* linestring = dynamic_cast<GeoDataLineString*>( placemark->geometry() );
-        GeoDataMultiGeometry* multigeom = dynamic_cast<GeoDataMultiGeometry*>( placemark->geometry() );
-
-        if ( polygon ) {
-            fileHeaderPolygons += 1 + polygon->innerBoundaries().size(); // outer boundary + number of inner boundaries of the polygon
-        }
-
-        if ( linestring ) {
-            ++fileHeaderPolygons;
-        }
-
-        if ( multigeom ) {
-            fileHeaderPolygons += multigeom->size(); // number of polygons inside the multigeometry
-        }
-    }
-
-    stream << fileHeaderVersion << fileHeaderPolygons;
-
-    i = document->begin();
-
-    quint32 polyCurrentID = 0;
-    quint32 polyParentNodes;
-    quint8 polyFlag; 
-
     for ( ; i != end; ++i ) {
         GeoDataPlacemark* placemark = static_cast<GeoDataPlacemark*>( *i );
 
@@ -206,52 +212,21 @@ int main(int argc, char** argv)
         GeoDataMultiGeometry* multigeom = dynamic_cast<GeoDataMultiGeometry*>( placemark->geometry() );
 
         if ( polygon ) {
-
             // Outer boundary
-            ++polyCurrentID;
-            QVector<GeoDataCoordinates>::Iterator jBegin = polygon->outerBoundary().begin();
-            QVector<GeoDataCoordinates>::Iterator jEnd = polygon->outerBoundary().end();
-            polyParentNodes = getParentNodes( jBegin, jEnd );
-            polyFlag = OUTERBOUNDARY;
-
-            stream << polyCurrentID << polyParentNodes << polyFlag;
-
-            printAllNodes( jBegin, jEnd, stream );
+            polygons.append( encodePolygon( ++polyCurrentID, OUTERBOUNDARY, polygon->outerBoundary() ) );
 
             // Inner boundaries
             QVector<GeoDataLinearRing>::Iterator inner = polygon->innerBoundaries().begin();
             QVector<GeoDataLinearRing>::Iterator innerEnd = polygon->innerBoundaries().end();
 
             for ( ; inner != innerEnd; ++inner ) {
-                GeoDataLinearRing linearring = static_cast<GeoDataLinearRing>( *inner );
-
-                ++polyCurrentID;
-                jBegin = linearring.begin();
-                jEnd = linearring.end();
-                polyParentNodes = getParentNodes( jBegin, jEnd );
-                polyFlag = INNERBOUNDARY;
-
-                stream << polyCurrentID << polyParentNodes << polyFlag;
-
-                printAllNodes( jBegin, jEnd, stream );
-               
+                polygons.append( encodePolygon( ++polyCurrentID, INNERBOUNDARY, *inner ) );
             }
-
         }
 
         if ( linestring ) {
-            ++polyCurrentID;
-            QVector<GeoDataCoordinates>::Iterator jBegin = linestring->begin();
-            QVector<GeoDataCoordinates>::Iterator jEnd = linestring->end();
-            polyParentNodes = getParentNodes( jBegin, jEnd );
-            if ( linestring->isClosed() )
-                polyFlag = LINEARRING;
-            else
-                polyFlag = LINESTRING;
-
-            stream << polyCurrentID << polyParentNodes << polyFlag;
-
-            printAllNodes( jBegin, jEnd, stream );
+            const quint8 polyFlag = linestring->isClosed() ? LINEARRING : LINESTRING;
+            polygons.append( encodePolygon( ++polyCurrentID, polyFlag, *linestring ) );
         }
 
         if ( multigeom ) {
@@ -261,22 +236,30 @@ int main(int argc, char** argv)
     
             for ( ; multi != multiEnd; ++multi ) {
                 GeoDataLineString* currLineString = dynamic_cast<GeoDataLineString*>( *multi );
-
-                ++polyCurrentID;
-                QVector<GeoDataCoordinates>::Iterator jBegin = currLineString->begin();
-                QVector<GeoDataCoordinates>::Iterator jEnd = currLineString->end();
-                polyParentNodes = getParentNodes( jBegin, jEnd );
-                if ( currLineString->isClosed() )
-                    polyFlag = LINEARRING;
-                else
-                    polyFlag = LINESTRING;
-
-                stream << polyCurrentID << polyParentNodes << polyFlag;
-
-                printAllNodes( jBegin, jEnd, stream );
+                const quint8 polyFlag = currLineString->isClosed() ? LINEARRING : LINESTRING;
+                polygons.append( encodePolygon( ++polyCurrentID, polyFlag, *currLineString ) );
             }
             
         }
     }
 
+    QFile file( outputFilename );
+    file.open( QIODevice::WriteOnly );
+    QDataStream stream( &file );
+
+    const quint8 fileHeaderVersion = 2;
+    const quint32 fileHeaderPolygons = polygons.size();
+    stream << fileHeaderVersion << fileHeaderPolygons;
+
+    // The polygons follow the file header of 5 bytes and the index of 16 bytes per polygon
+    quint32 offset = 5 + 16 * fileHeaderPolygons;
+    foreach ( const Pn2Polygon &polygon, polygons ) {
+        stream << polygon.west << polygon.south << polygon.east << polygon.north << polygon.nodes << offset;
+        offset += polygon.data.size();
+    }
+
+    foreach ( const Pn2Polygon &polygon, polygons ) {
+        stream.writeRawData( polygon.data.constData(), polygon.data.size() );
+    }
+
 }
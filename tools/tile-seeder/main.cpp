@@ -0,0 +1,248 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+// Downloads the tiles of a region into the local tile cache without user
+// interface, e.g. to prepare caches for offline devices on a build server.
+
+#include <GeoDataDocument.h>
+#include <GeoDataLatLonBox.h>
+#include <GeoDataLinearRing.h>
+#include <GeoDataLineString.h>
+#include <GeoDataParser.h>
+#include <GeoDataPlacemark.h>
+#include <GeoDataPolygon.h>
+#include <GeoSceneDocument.h>
+#include <GeoSceneHead.h>
+#include <GeoSceneLayer.h>
+#include <GeoSceneMap.h>
+#include <GeoSceneTiled.h>
+#include <MapThemeManager.h>
+#include <TileSeeder.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+#include <QtCore/QUrl>
+
+#include <iostream>
+
+using namespace std;
+using namespace Marble;
+
+void usage( const char *name )
+{
+    cerr << "Usage: " << name << " [options] mapThemeId" << endl;
+    cerr << "  mapThemeId, e.g. earth/openstreetmap/openstreetmap.dgml" << endl;
+    cerr << "Region (one of):" << endl;
+    cerr << "  --bbox west,south,east,north  bounding box in degrees" << endl;
+    cerr << "  --route file.kml              corridor around the first line string" << endl;
+    cerr << "  --offset meters               width of the route corridor, 500 by default" << endl;
+    cerr << "  --polygon file.kml            the first polygon" << endl;
+    cerr << "Options:" << endl;
+    cerr << "  --levels top-bottom           tile levels, e.g. 0-14" << endl;
+    cerr << "  --connections n               concurrent requests, 4 by default" << endl;
+    cerr << "  --rate n                      maximum requests per second" << endl;
+    cerr << "  --mirror url                  download from this server instead" << endl;
+    cerr << "  --checkpoint file             save progress there and resume from it" << endl;
+    cerr << "  --cache directory             tile cache, the local Marble directory by default" << endl;
+}
+
+const GeoDataGeometry *findGeometry( const GeoDataContainer *container, bool polygon )
+{
+    foreach ( const GeoDataFeature *feature, container->featureList() ) {
+        const GeoDataContainer *child = dynamic_cast<const GeoDataContainer *>( feature );
+        if ( child ) {
+            const GeoDataGeometry *geometry = findGeometry( child, polygon );
+            if ( geometry )
+                return geometry;
+        }
+
+        const GeoDataPlacemark *placemark = dynamic_cast<const GeoDataPlacemark *>( feature );
+        if ( !placemark )
+            continue;
+
+        const GeoDataGeometry *geometry = placemark->geometry();
+        if ( polygon && ( dynamic_cast<const GeoDataPolygon *>( geometry )
+                          || dynamic_cast<const GeoDataLinearRing *>( geometry ) ) )
+            return geometry;
+        if ( !polygon && dynamic_cast<const GeoDataLineString *>( geometry )
+             && !dynamic_cast<const GeoDataLinearRing *>( geometry ) )
+            return geometry;
+    }
+
+    return 0;
+}
+
+GeoDataDocument *openKml( const QString &fileName )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        cerr << "Cannot open " << fileName.toStdString() << endl;
+        return 0;
+    }
+
+    GeoDataParser parser( GeoData_KML );
+    if ( !parser.read( &file ) ) {
+        cerr << "Error parsing " << fileName.toStdString() << ": " << parser.errorString().toStdString() << endl;
+        return 0;
+    }
+
+    return dynamic_cast<GeoDataDocument *>( parser.releaseDocument() );
+}
+
+class ProgressPrinter : public QObject
+{
+    Q_OBJECT
+
+ public:
+    ProgressPrinter() : m_percent( -1 ) {}
+
+ public Q_SLOTS:
+    void printProgress( qint64 processed, qint64 total )
+    {
+        const int percent = total > 0 ? int( 100 * processed / total ) : 100;
+        if ( percent != m_percent ) {
+            m_percent = percent;
+            cerr << "\r" << processed << " of " << total << " tiles (" << percent << "%)" << flush;
+        }
+    }
+
+ private:
+    int m_percent;
+};
+
+int main( int argc, char *argv[] )
+{
+    QCoreApplication app( argc, argv );
+
+    QStringList arguments = app.arguments();
+    arguments.removeFirst();
+    if ( arguments.isEmpty() ) {
+        usage( argv[0] );
+        return 1;
+    }
+    const QString mapThemeId = arguments.takeLast();
+
+    QString bbox, route, polygon, levels = "0-10", mirror, checkpoint, cache;
+    qreal offset = 500.0;
+    int connections = 4;
+    qreal rate = 0.0;
+
+    while ( arguments.size() >= 2 ) {
+        const QString option = arguments.takeFirst();
+        const QString value = arguments.takeFirst();
+        if ( option == "--bbox" )
+            bbox = value;
+        else if ( option == "--route" )
+            route = value;
+        else if ( option == "--offset" )
+            offset = value.toDouble();
+        else if ( option == "--polygon" )
+            polygon = value;
+        else if ( option == "--levels" )
+            levels = value;
+        else if ( option == "--connections" )
+            connections = value.toInt();
+        else if ( option == "--rate" )
+            rate = value.toDouble();
+        else if ( option == "--mirror" )
+            mirror = value;
+        else if ( option == "--checkpoint" )
+            checkpoint = value;
+        else if ( option == "--cache" )
+            cache = value;
+        else {
+            usage( argv[0] );
+            return 1;
+        }
+    }
+
+    const QStringList levelRange = levels.split( '-' );
+    if ( !arguments.isEmpty() || levelRange.size() != 2 ) {
+        usage( argv[0] );
+        return 1;
+    }
+    const int topLevel = levelRange.first().toInt();
+    const int bottomLevel = levelRange.last().toInt();
+
+    MapThemeManager mapThemeManager;
+    GeoSceneDocument *const mapTheme = mapThemeManager.loadMapTheme( mapThemeId );
+    if ( !mapTheme ) {
+        cerr << "Cannot load map theme " << mapThemeId.toStdString() << endl;
+        return 2;
+    }
+
+    const GeoSceneLayer *const layer = static_cast<const GeoSceneLayer *>( mapTheme->map()->layer( mapTheme->head()->theme() ) );
+    const GeoSceneTiled *const texture = layer ? dynamic_cast<const GeoSceneTiled *>( layer->groundDataset() ) : 0;
+    if ( !texture ) {
+        cerr << "The map theme " << mapThemeId.toStdString() << " has no tiles" << endl;
+        return 2;
+    }
+
+    TileSeeder seeder( texture, cache );
+    GeoDataDocument *document = 0;
+
+    if ( !bbox.isEmpty() ) {
+        const QStringList corners = bbox.split( ',' );
+        if ( corners.size() != 4 ) {
+            usage( argv[0] );
+            return 1;
+        }
+        const GeoDataLatLonBox box( corners[3].toDouble(), corners[1].toDouble(),
+                                    corners[2].toDouble(), corners[0].toDouble(), GeoDataCoordinates::Degree );
+        seeder.setRegion( TileSeeder::boxRegion( texture, box, topLevel, bottomLevel ) );
+    }
+    else if ( !route.isEmpty() ) {
+        document = openKml( route );
+        const GeoDataLineString *path = document ? static_cast<const GeoDataLineString *>( findGeometry( document, false ) ) : 0;
+        if ( !path ) {
+            cerr << "No line string found in " << route.toStdString() << endl;
+            return 3;
+        }
+        seeder.setRegion( TileSeeder::pathRegion( texture, *path, offset, topLevel, bottomLevel ) );
+    }
+    else if ( !polygon.isEmpty() ) {
+        document = openKml( polygon );
+        const GeoDataGeometry *geometry = document ? findGeometry( document, true ) : 0;
+        const GeoDataPolygon *area = dynamic_cast<const GeoDataPolygon *>( geometry );
+        const GeoDataLinearRing *ring = area ? &area->outerBoundary() : dynamic_cast<const GeoDataLinearRing *>( geometry );
+        if ( !ring ) {
+            cerr << "No polygon found in " << polygon.toStdString() << endl;
+            return 3;
+        }
+        seeder.setRegion( TileSeeder::boxRegion( texture, ring->latLonAltBox(), topLevel, bottomLevel ) );
+        seeder.setPolygon( *ring );
+    }
+    else {
+        usage( argv[0] );
+        return 1;
+    }
+
+    seeder.setMaximumConnections( connections );
+    seeder.setMaximumRate( rate );
+    if ( !mirror.isEmpty() )
+        seeder.setMirror( QUrl( mirror ) );
+    seeder.setCheckpointFile( checkpoint );
+
+    ProgressPrinter printer;
+    QObject::connect( &seeder, SIGNAL(progressChanged(qint64,qint64)), &printer, SLOT(printProgress(qint64,qint64)) );
+    QObject::connect( &seeder, SIGNAL(finished()), &app, SLOT(quit()) );
+
+    seeder.start();
+    if ( seeder.isRunning() )
+        app.exec();
+
+    cerr << endl << seeder.downloadedCount() << " downloaded, " << seeder.unchangedCount() << " unchanged, "
+         << seeder.skippedCount() << " skipped, " << seeder.failedCount() << " failed" << endl;
+
+    delete document;
+    delete mapTheme;
+    return seeder.failedCount() > 0 ? 4 : 0;
+}
+
+#include "main.moc"